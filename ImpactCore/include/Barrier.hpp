@@ -1,6 +1,7 @@
 #pragma once
 #include "error.hpp"
 #include <mutex>
+#include <condition_variable>
 
 namespace Impact {
 
@@ -0,0 +1,111 @@
+#pragma once
+#include "error.hpp"
+#include "RegionAllocator.hpp"
+#include "memory_accounting.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include <typeindex>
+#include <type_traits>
+#include <utility>
+
+namespace Impact {
+
+// ObjectArena declarations
+
+/*
+An ObjectArena owns a set of long-lived objects that all share the lifetime of the arena.
+Objects of the same type are placed contiguously in a memory region dedicated to that type,
+and are referred to through plain pointers. When the arena is destroyed, the objects are
+destructed in the reverse order of their creation and all memory is freed in bulk.
+*/
+class ObjectArena {
+
+private:
+
+    // Record of a created object requiring its destructor to be called
+    struct DestructibleObject
+    {
+        void* object; // Pointer to the object
+        void (*destruct)(void*); // Function calling the destructor of the object
+    };
+
+    const size_t block_size; // Size of each memory block in the per-type regions
+    const size_t initial_block_size; // Size of the first memory block in each per-type region
+    const MemoryCategory category; // Category that the memory of the arena is attributed to in memory accounting
+    std::map< std::type_index, std::unique_ptr<RegionAllocator> > regions; // Memory region for each type of object
+    std::vector<DestructibleObject> destructible_objects; // Created objects with non-trivial destructors
+    std::map< const void*, std::shared_ptr<const void> > retained_objects; // Shared objects kept alive by the arena
+
+    RegionAllocator& regionFor(const std::type_index& type);
+
+    template <typename T>
+    static void destruct(void* object);
+
+public:
+
+    ObjectArena(size_t block_size = 65536,
+                MemoryCategory category = MemoryCategory::Other,
+                size_t initial_block_size = 0);
+
+    ~ObjectArena();
+
+    ObjectArena(const ObjectArena& other) = delete;
+    ObjectArena& operator=(const ObjectArena& other) = delete;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... arguments);
+
+    template <typename T>
+    T* retain(const std::shared_ptr<T>& object);
+};
+
+// ObjectArena inline method definitions
+
+// Each per-type region starts with a block of the initial size (if given) and grows its blocks up to the block size,
+// so that types with few objects do not commit a full block
+inline ObjectArena::ObjectArena(size_t block_size /* = 65536 */,
+                                MemoryCategory category /* = MemoryCategory::Other */,
+                                size_t initial_block_size /* = 0 */)
+    : block_size(block_size),
+      initial_block_size(initial_block_size),
+      category(category),
+      regions(),
+      destructible_objects(),
+      retained_objects()
+{
+    imp_assert(block_size % 16 == 0);
+}
+
+template <typename T>
+inline void ObjectArena::destruct(void* object)
+{
+    static_cast<T*>(object)->~T();
+}
+
+// Constructs a new object of type T in the region for type T and returns a pointer to it
+template <typename T, typename... Args>
+inline T* ObjectArena::create(Args&&... arguments)
+{
+    static_assert(alignof(T) <= 16, "ObjectArena only supports types with alignment of up to 16 bytes");
+
+    T* object = new (regionFor(typeid(T)).allocate(sizeof(T))) T(std::forward<Args>(arguments)...);
+
+    if (!std::is_trivially_destructible<T>::value)
+        destructible_objects.push_back({object, &ObjectArena::destruct<T>});
+
+    return object;
+}
+
+// Keeps the given shared object alive for the lifetime of the arena and returns a plain pointer to it
+template <typename T>
+inline T* ObjectArena::retain(const std::shared_ptr<T>& object)
+{
+    if (object)
+        retained_objects.emplace(object.get(), object);
+
+    return object.get();
+}
+
+} // Impact
@@ -1,6 +1,8 @@
 #pragma once
 #include "error.hpp"
+#include "memory_accounting.hpp"
 #include <cstdint>
+#include <algorithm>
 #include <list>
 #include <utility>
 
@@ -13,6 +15,8 @@ class RegionAllocator {
 private:
 
     const size_t block_size; // Size of each memory block (default is 256 kB)
+    size_t next_block_size; // Size of the next block to allocate, which doubles from the initial size up to block_size
+    const MemoryCategory category; // Category that the allocated blocks are attributed to in memory accounting
     uint8_t* current_block; // Latest allocated memory block
     size_t current_position; // Offset within the current block to next free memory position
     size_t current_block_size; // Size of the current block (usually equal to block_size)
@@ -21,7 +25,9 @@ private:
 
 public:
 
-    RegionAllocator(size_t block_size = 262144);
+    RegionAllocator(size_t block_size = 262144,
+                    MemoryCategory category = MemoryCategory::RegionAllocators,
+                    size_t initial_block_size = 0);
 
     ~RegionAllocator();
 
@@ -35,8 +41,14 @@ public:
 
 // RegionAllocator inline method definitions
 
-inline RegionAllocator::RegionAllocator(size_t block_size /* = 262144 */)
+// If an initial block size smaller than the block size is given, the first block gets the initial size
+// and each subsequent block is twice as large until the full block size is reached
+inline RegionAllocator::RegionAllocator(size_t block_size /* = 262144 */,
+                                        MemoryCategory category /* = MemoryCategory::RegionAllocators */,
+                                        size_t initial_block_size /* = 0 */)
     : block_size(block_size),
+      next_block_size((initial_block_size > 0)? std::min(initial_block_size, block_size) : block_size),
+      category(category),
       current_block(nullptr),
       current_position(0),
       current_block_size(0),
@@ -44,6 +56,7 @@ inline RegionAllocator::RegionAllocator(size_t block_size /* = 262144 */)
       available_blocks()
 {
     imp_assert(block_size % 16 == 0);
+    imp_assert(next_block_size % 16 == 0);
 }
 
 } // Impact
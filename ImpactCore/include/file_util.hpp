@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+namespace Impact {
+
+// File utility function declarations
+
+bool fileExists(const std::string& filename);
+
+bool replaceFile(const std::string& source_filename,
+                 const std::string& destination_filename);
+
+bool removeFile(const std::string& filename);
+
+} // Impact
@@ -1,6 +1,7 @@
 #pragma once
 #include "precision.hpp"
 #include <string>
+#include <vector>
 #include <cmath>
 
 namespace Impact {
@@ -12,6 +13,10 @@ bool writePFM(const std::string& filename,
               unsigned int width, unsigned int height,
 			  float pixel_scale);
 
+bool readPFM(const std::string& filename,
+             std::vector<imp_float>* pixel_values,
+             unsigned int* width, unsigned int* height);
+
 // Image utility inline function definitions
 
 inline float gammaEncoded(float pixel_value)
@@ -22,6 +22,7 @@ constexpr imp_float IMP_PI_OVER_FOUR = IMP_PI/4;
 constexpr imp_float IMP_THREE_PI_OVER_TWO = 3*IMP_PI_OVER_TWO;
 constexpr imp_float IMP_ONE_OVER_PI = 1/IMP_PI;
 constexpr imp_float IMP_ONE_OVER_TWO_PI = 1/IMP_TWO_PI;
+constexpr imp_float IMP_ONE_OVER_FOUR_PI = 1/IMP_FOUR_PI;
 constexpr imp_float IMP_DEG_TO_RAD = IMP_PI/180;
 constexpr imp_float IMP_RAD_TO_DEG = 180/IMP_PI;
 
@@ -10,6 +10,21 @@ namespace Impact {
 #define IMP_L1_CACHE_LINE_SIZE 64
 #endif
 
+// Set default value for the size of huge memory pages
+#ifndef IMP_HUGE_PAGE_SIZE
+#define IMP_HUGE_PAGE_SIZE 2097152
+#endif
+
+// Memory function declarations
+
+void setHugePagesEnabled(bool enabled);
+
+bool hugePagesEnabled();
+
+void* allocateLarge(size_t size);
+
+void freeLarge(void* pointer);
+
 // Inline memory function definitions
 
 inline void* allocateAligned(size_t size)
@@ -39,6 +54,48 @@ inline T* allocateAligned(size_t count)
     return (T*)(allocateAligned(count*sizeof(T)));
 }
 
+template <typename T>
+inline T* allocateLarge(size_t count)
+{
+    return (T*)(allocateLarge(count*sizeof(T)));
+}
+
+// Standard library compatible allocator for containers that may grow large
+template <typename T>
+class LargeAllocator {
+
+public:
+
+    typedef T value_type;
+
+    LargeAllocator() {}
+
+    template <typename U>
+    LargeAllocator(const LargeAllocator<U>& other) {}
+
+    T* allocate(size_t count)
+    {
+        return allocateLarge<T>(count);
+    }
+
+    void deallocate(T* pointer, size_t count)
+    {
+        freeLarge(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const LargeAllocator<U>& other) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const LargeAllocator<U>& other) const
+    {
+        return false;
+    }
+};
+
 // Memory macros
 
 #define allocated_on_stack(type, count) (type*)alloca((count)*sizeof(type))
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Impact {
+
+// Memory accounting declarations
+
+// Categories that tracked memory can be attributed to
+enum class MemoryCategory
+{
+    Geometry,              // Shapes, models and lights owned by the scene
+    Transformations,       // Stored transformations and their inverses
+    AccelerationStructure, // Acceleration structure nodes and model references
+    SensorPixels,          // Sensor pixel arrays and sensor region pixels
+    SamplerArrays,         // Sample component arrays held by samplers
+    RegionAllocators,      // Blocks held by general purpose region allocators
+    IrradianceCache,       // Records and octree nodes of irradiance caches
+    PathGuide,             // Spatial and directional trees of path guides
+    Other,                 // Anything not belonging to the above categories
+    Count                  // Number of categories (not a category itself)
+};
+
+// Keeps track of an amount of memory attributed to a category, and updates the global
+// counters accordingly when it is copied or destroyed
+class TrackedMemory {
+
+private:
+
+    MemoryCategory category; // Category the memory is attributed to
+    size_t n_bytes; // Number of bytes currently tracked
+
+public:
+
+    explicit TrackedMemory(MemoryCategory category);
+
+    TrackedMemory(const TrackedMemory& other);
+
+    TrackedMemory& operator=(const TrackedMemory& other);
+
+    ~TrackedMemory();
+
+    void add(size_t n_added_bytes);
+
+    void remove(size_t n_removed_bytes);
+
+    size_t bytes() const;
+};
+
+// Memory accounting function declarations
+
+void trackAllocation(MemoryCategory category, size_t n_bytes);
+
+void trackDeallocation(MemoryCategory category, size_t n_bytes);
+
+size_t currentMemoryUsage(MemoryCategory category);
+
+size_t peakMemoryUsage(MemoryCategory category);
+
+size_t peakTotalMemoryUsage();
+
+const char* memoryCategoryName(MemoryCategory category);
+
+std::string formattedMemorySize(size_t n_bytes);
+
+std::string memoryUsageReport();
+
+// TrackedMemory inline method definitions
+
+inline TrackedMemory::TrackedMemory(MemoryCategory category)
+    : category(category),
+      n_bytes(0)
+{}
+
+inline TrackedMemory::TrackedMemory(const TrackedMemory& other)
+    : category(other.category),
+      n_bytes(other.n_bytes)
+{
+    trackAllocation(category, n_bytes);
+}
+
+inline TrackedMemory& TrackedMemory::operator=(const TrackedMemory& other)
+{
+    if (this != &other)
+    {
+        trackDeallocation(category, n_bytes);
+
+        category = other.category;
+        n_bytes = other.n_bytes;
+
+        trackAllocation(category, n_bytes);
+    }
+
+    return *this;
+}
+
+inline TrackedMemory::~TrackedMemory()
+{
+    trackDeallocation(category, n_bytes);
+}
+
+inline void TrackedMemory::add(size_t n_added_bytes)
+{
+    n_bytes += n_added_bytes;
+    trackAllocation(category, n_added_bytes);
+}
+
+inline void TrackedMemory::remove(size_t n_removed_bytes)
+{
+    n_bytes -= n_removed_bytes;
+    trackDeallocation(category, n_removed_bytes);
+}
+
+inline size_t TrackedMemory::bytes() const
+{
+    return n_bytes;
+}
+
+} // Impact
@@ -23,4 +23,6 @@ void parallelFor(const std::function<void (uint64_t)>& loop_body,
 void parallelFor2D(const std::function<void (uint32_t, uint32_t)>& loop_body,
                    uint32_t n_iterations_inner, uint32_t n_iterations_outer);
 
+void executeOnEachThread(const std::function<void ()>& function);
+
 } // Impact
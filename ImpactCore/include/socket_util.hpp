@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Impact {
+
+// Socket declarations
+
+/*
+Owns a stream socket connected over TCP or, on Linux, a Unix domain socket.
+Addresses are given as "host:port" for TCP (with an empty host or "*" meaning
+all interfaces when listening) or as "unix:path" for a Unix domain socket.
+*/
+class Socket {
+
+public:
+
+    #ifdef IMP_IS_WINDOWS
+    typedef uintptr_t Handle;
+    #else // Linux
+    typedef int Handle;
+    #endif
+
+private:
+
+    Handle handle; // Handle of the underlying operating system socket
+    std::string unix_socket_path; // Path of the Unix domain socket file to remove when closing a listening socket (empty otherwise)
+
+    explicit Socket(Handle handle);
+
+public:
+
+    Socket();
+
+    Socket(Socket&& other);
+
+    Socket& operator=(Socket&& other);
+
+    ~Socket();
+
+    Socket(const Socket& other) = delete;
+    Socket& operator=(const Socket& other) = delete;
+
+    static Socket listenOn(const std::string& address);
+
+    static Socket connectTo(const std::string& address);
+
+    Socket acceptConnection();
+
+    bool isOpen() const;
+
+    void close();
+
+    bool waitUntilReadable(double timeout_seconds);
+
+    bool sendAll(const void* data, size_t n_bytes);
+
+    bool receiveAll(void* data, size_t n_bytes);
+};
+
+} // Impact
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace Impact {
+
+// StatisticsAccumulator declarations
+
+/*
+Holds the merged values of all registered statistics variables. Each thread
+keeps its own thread-local copy of every variable, and the copies are added
+to the accumulator when the statistics of all threads are merged.
+*/
+class StatisticsAccumulator {
+
+private:
+
+    std::map<std::string, int64_t> counters; // Total count for each counter
+    std::map<std::string, int64_t> rates; // Total count for each counter reported per second
+    std::map< std::string, std::pair<int64_t, int64_t> > ratios; // Total numerator and denominator for each ratio
+    std::map< std::string, std::vector<int64_t> > histograms; // Total count in each bin for each histogram
+
+public:
+
+    void addCounter(const std::string& title, int64_t value);
+
+    void addRate(const std::string& title, int64_t value);
+
+    void addRatio(const std::string& title, int64_t numerator, int64_t denominator);
+
+    void addHistogram(const std::string& title, const int64_t* bin_counts, unsigned int n_bins);
+
+    void clear();
+
+    std::string report(double elapsed_seconds) const;
+};
+
+// StatisticsRegisterer declarations
+
+// Registers a function that adds the current thread's values of a set of
+// statistics variables to an accumulator and resets them
+class StatisticsRegisterer {
+
+public:
+
+    StatisticsRegisterer(void (*reporter)(StatisticsAccumulator&));
+};
+
+// Statistics function declarations
+
+void mergeThreadStatistics();
+
+void clearStatistics();
+
+std::string statisticsReport(double elapsed_seconds);
+
+} // Impact
+
+// Statistics macros
+
+/*
+The macros below compile to nothing unless IMP_ENABLE_STATISTICS is defined.
+Variables must be defined at namespace scope in a source file, and can be
+referred to from other files after declaring them with IMP_STAT_EXTERN.
+*/
+#ifdef IMP_ENABLE_STATISTICS
+
+#define IMP_STAT_COUNTER(title, variable) \
+    thread_local int64_t variable = 0; \
+    static ::Impact::StatisticsRegisterer variable##_registerer([](::Impact::StatisticsAccumulator& accumulator) \
+    { \
+        accumulator.addCounter(title, variable); \
+        variable = 0; \
+    })
+
+#define IMP_STAT_RATE(title, variable) \
+    thread_local int64_t variable = 0; \
+    static ::Impact::StatisticsRegisterer variable##_registerer([](::Impact::StatisticsAccumulator& accumulator) \
+    { \
+        accumulator.addRate(title, variable); \
+        variable = 0; \
+    })
+
+#define IMP_STAT_RATIO(title, numerator_variable, denominator_variable) \
+    thread_local int64_t numerator_variable = 0; \
+    thread_local int64_t denominator_variable = 0; \
+    static ::Impact::StatisticsRegisterer numerator_variable##_registerer([](::Impact::StatisticsAccumulator& accumulator) \
+    { \
+        accumulator.addRatio(title, numerator_variable, denominator_variable); \
+        numerator_variable = 0; \
+        denominator_variable = 0; \
+    })
+
+// Histogram with unit bins for the values 0 to n_bins - 2, with the last bin counting all larger values
+#define IMP_STAT_HISTOGRAM(title, variable, n_bins) \
+    thread_local int64_t variable[n_bins] = {}; \
+    static ::Impact::StatisticsRegisterer variable##_registerer([](::Impact::StatisticsAccumulator& accumulator) \
+    { \
+        accumulator.addHistogram(title, variable, n_bins); \
+        for (unsigned int bin_idx = 0; bin_idx < n_bins; bin_idx++) \
+            variable[bin_idx] = 0; \
+    })
+
+#define IMP_STAT_EXTERN(variable) \
+    extern thread_local int64_t variable
+
+#define IMP_STAT_INCREMENT(variable) ((void)(++(variable)))
+
+#define IMP_STAT_ADD(variable, value) ((void)((variable) += (int64_t)(value)))
+
+#define IMP_STAT_HISTOGRAM_ADD(variable, value) \
+    ((void)(++(variable)[((uint64_t)(value) < sizeof(variable)/sizeof(int64_t) - 1)? (uint64_t)(value) : sizeof(variable)/sizeof(int64_t) - 1]))
+
+#else // Statistics disabled
+
+#define IMP_STAT_COUNTER(title, variable)
+#define IMP_STAT_RATE(title, variable)
+#define IMP_STAT_RATIO(title, numerator_variable, denominator_variable)
+#define IMP_STAT_HISTOGRAM(title, variable, n_bins)
+#define IMP_STAT_EXTERN(variable)
+#define IMP_STAT_INCREMENT(variable) ((void)0)
+#define IMP_STAT_ADD(variable, value) ((void)0)
+#define IMP_STAT_HISTOGRAM_ADD(variable, value) ((void)0)
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace Impact {
+
+// TraceScope declarations
+
+/*
+Measures the wall time between its construction and destruction, and records it as
+a span on the track of the current thread if tracing is enabled when the scope ends.
+The recorded spans are written in the trace event format of chrome://tracing and Perfetto.
+*/
+class TraceScope {
+
+private:
+
+    const char* name; // Name of the span (must be a string literal or otherwise outlive the scope)
+    std::string arguments; // Comma separated list of JSON members to attach to the span
+    double start_time; // Time when the scope was entered [microseconds since program start]
+
+public:
+
+    explicit TraceScope(const char* name);
+
+    TraceScope(const char* name, const std::string& arguments);
+
+    ~TraceScope();
+
+    TraceScope(const TraceScope& other) = delete;
+    TraceScope& operator=(const TraceScope& other) = delete;
+};
+
+// Tracing function declarations
+
+void beginTracing();
+
+bool endTracing(const std::string& filename);
+
+bool tracingEnabled();
+
+double traceTime();
+
+std::string escapedForJSON(const std::string& text);
+
+} // Impact
+
+// Tracing macros
+
+#define IMP_TRACE_CONCATENATED_(a, b) a##b
+#define IMP_TRACE_CONCATENATED(a, b) IMP_TRACE_CONCATENATED_(a, b)
+
+// Records the remainder of the enclosing block as a span with the given name
+#define IMP_TRACE_SCOPE(name) \
+    ::Impact::TraceScope IMP_TRACE_CONCATENATED(trace_scope_, __LINE__)(name)
+
+// Like IMP_TRACE_SCOPE, but also attaches the given arguments (only evaluated when tracing is enabled)
+#define IMP_TRACE_SCOPE_WITH_ARGUMENTS(name, arguments) \
+    ::Impact::TraceScope IMP_TRACE_CONCATENATED(trace_scope_, __LINE__)(name, (::Impact::tracingEnabled())? std::string(arguments) : std::string())
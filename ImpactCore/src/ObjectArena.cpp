@@ -0,0 +1,32 @@
+#include "ObjectArena.hpp"
+
+namespace Impact {
+
+// ObjectArena method definitions
+
+ObjectArena::~ObjectArena()
+{
+    // Destruct objects in reverse order of creation, so that objects are destroyed before anything they were created from
+    for (auto iter = destructible_objects.rbegin(); iter != destructible_objects.rend(); iter++)
+        iter->destruct(iter->object);
+
+    destructible_objects.clear();
+
+    // The memory regions free their blocks when they are destroyed
+    regions.clear();
+
+    retained_objects.clear();
+}
+
+// Returns the memory region holding objects of the given type, creating it if necessary
+RegionAllocator& ObjectArena::regionFor(const std::type_index& type)
+{
+    auto entry = regions.find(type);
+
+    if (entry == regions.end())
+        entry = regions.emplace(type, std::unique_ptr<RegionAllocator>(new RegionAllocator(block_size, category, initial_block_size))).first;
+
+    return *(entry->second);
+}
+
+} // Impact
@@ -13,18 +13,23 @@ RegionAllocator::~RegionAllocator()
 
     for (; iter != used_blocks.end(); iter++)
     {
-        freeAligned(iter->second);
+        trackDeallocation(category, iter->first);
+        freeLarge(iter->second);
         iter->second = nullptr;
     }
 
     for (iter = available_blocks.begin(); iter != available_blocks.end(); iter++)
     {
-        freeAligned(iter->second);
+        trackDeallocation(category, iter->first);
+        freeLarge(iter->second);
         iter->second = nullptr;
     }
 
     if (current_block)
-        freeAligned(current_block);
+    {
+        trackDeallocation(category, current_block_size);
+        freeLarge(current_block);
+    }
 }
 
 // Returns a pointer to a region of memory with room for the given number of bytes
@@ -65,9 +70,13 @@ void* RegionAllocator::allocate(size_t n_bytes)
         if (!current_block)
         {
             // Make sure that the block is not too small to hold the requested allocation amount
-            current_block_size = std::max(n_bytes, block_size);
+            current_block_size = std::max(n_bytes, next_block_size);
+
+            next_block_size = std::min(2*next_block_size, block_size);
+
+            current_block = allocateLarge<uint8_t>(current_block_size);
 
-            current_block = allocateAligned<uint8_t>(current_block_size);
+            trackAllocation(category, current_block_size);
         }
 
         // Current position is now the beginning of the new block
@@ -0,0 +1,43 @@
+#include "file_util.hpp"
+#include "error.hpp"
+#include <cstdio>
+#include <fstream>
+
+#ifdef IMP_IS_WINDOWS
+#include <windows.h>
+#endif
+
+namespace Impact {
+
+// File utility function definitions
+
+bool fileExists(const std::string& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    return file.good();
+}
+
+// Renames the source file to the destination filename, replacing any existing destination file
+// in a single step so that readers see either the old or the new file, never a partially written one
+bool replaceFile(const std::string& source_filename,
+                 const std::string& destination_filename)
+{
+    #ifdef IMP_IS_WINDOWS
+    bool success = MoveFileExA(source_filename.c_str(), destination_filename.c_str(),
+                               MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    #else // Linux
+    bool success = std::rename(source_filename.c_str(), destination_filename.c_str()) == 0;
+    #endif
+
+    if (!success)
+        printErrorMessage("could not move \"%s\" to \"%s\"", source_filename.c_str(), destination_filename.c_str());
+
+    return success;
+}
+
+bool removeFile(const std::string& filename)
+{
+    return std::remove(filename.c_str()) == 0;
+}
+
+} // Impact
@@ -1,8 +1,11 @@
 #include "image_util.hpp"
 #include "error.hpp"
+#include "tracing.hpp"
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 namespace Impact {
 
@@ -13,6 +16,8 @@ bool writePFM(const std::string& filename,
               unsigned int width, unsigned int height,
 			  float pixel_scale)
 {
+    IMP_TRACE_SCOPE("Write PFM");
+
     imp_check(pixel_values);
 
     float scale = (machineIsBigEndian())? 1.0f : -1.0f;
@@ -65,4 +70,93 @@ bool writePFM(const std::string& filename,
     return true;
 }
 
+// Reads the linear RGB values of the given PFM image into the given vector, row by row from top to bottom.
+// PFM files store the rows from bottom to top, so the row order is reversed. Grayscale images are expanded
+// to RGB, and the values are multiplied with the scale given in the header.
+bool readPFM(const std::string& filename,
+             std::vector<imp_float>* pixel_values,
+             unsigned int* width, unsigned int* height)
+{
+    IMP_TRACE_SCOPE("Read PFM");
+
+    imp_check(pixel_values && width && height);
+
+    std::ifstream file;
+    file.open(filename.c_str(), std::ios::binary);
+
+    if (!file.is_open())
+    {
+        printErrorMessage("cannot open file \"%s\" for input", filename.c_str());
+        return false;
+    }
+
+    // Read header
+    std::string identifier;
+    long long file_width = 0, file_height = 0;
+    float scale = 0;
+
+    file >> identifier >> file_width >> file_height >> scale;
+
+    unsigned int n_channels = (identifier == "PF")? 3 : ((identifier == "Pf")? 1 : 0);
+
+    if (!file || n_channels == 0 || file_width <= 0 || file_height <= 0 || scale == 0)
+    {
+        printErrorMessage("file \"%s\" is not a valid PFM image", filename.c_str());
+        return false;
+    }
+
+    // Skip the single whitespace character separating the header from the data
+    file.get();
+
+    // A negative scale indicates little-endian data
+    bool data_is_big_endian = (scale > 0);
+    bool swap_bytes = (data_is_big_endian != (machineIsBigEndian() != 0));
+    scale = std::abs(scale);
+
+    size_t n_values = (size_t)n_channels*file_width*file_height;
+    std::unique_ptr<float[]> input_buffer(new float[n_values]);
+
+    file.read(reinterpret_cast<char*>(&input_buffer[0]), n_values*sizeof(float));
+
+    if (!file)
+    {
+        printErrorMessage("file \"%s\" ended before all pixel values were read", filename.c_str());
+        return false;
+    }
+
+    file.close();
+
+    if (swap_bytes)
+    {
+        for (size_t idx = 0; idx < n_values; idx++)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &input_buffer[idx], sizeof(float));
+            bits = (bits >> 24) | ((bits >> 8) & 0x0000ff00u) | ((bits << 8) & 0x00ff0000u) | (bits << 24);
+            std::memcpy(&input_buffer[idx], &bits, sizeof(float));
+        }
+    }
+
+    *width = (unsigned int)file_width;
+    *height = (unsigned int)file_height;
+
+    pixel_values->resize(3*(size_t)(*width)*(*height));
+
+    size_t idx = 0;
+    size_t input_idx;
+
+    // Loop through the rows of the file from the last (top of the image) to the first
+    for (int j = (int)(*height) - 1; j >= 0; j--) {
+        for (unsigned int i = 0; i < *width; i++)
+        {
+            input_idx = n_channels*((size_t)j*(*width) + i);
+
+            for (unsigned int c = 0; c < 3; c++)
+                (*pixel_values)[idx++] = (imp_float)(input_buffer[input_idx + ((n_channels == 3)? c : 0)]*scale);
+        }
+    }
+
+    return true;
+}
+
 } // Impact
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "memory.hpp"
+#include "error.hpp"
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#ifdef IMP_IS_WINDOWS
+#include <windows.h>
+#else // Linux
+#include <sys/mman.h>
+#endif
+
+namespace Impact {
+
+// Memory global variables
+
+static std::atomic<bool> use_huge_pages(true); // Whether large allocations should request huge pages
+static std::mutex huge_page_mutex; // Mutex guarding the table of huge page allocations
+static std::map<void*, size_t> huge_page_allocations; // Start address and mapped size of each allocation backed by huge pages
+
+// Memory function definitions
+
+// Rounds the given size up to a whole number of huge pages
+static size_t roundedUpToHugePages(size_t size)
+{
+    return ((size + IMP_HUGE_PAGE_SIZE - 1)/IMP_HUGE_PAGE_SIZE)*IMP_HUGE_PAGE_SIZE;
+}
+
+// Maps memory backed by huge pages, or returns a null pointer if this is not possible
+static void* mapHugePages(size_t mapped_size)
+{
+    #ifdef IMP_IS_WINDOWS
+
+    // Large pages require the "Lock pages in memory" privilege, so this will fail for most users
+    SIZE_T large_page_size = GetLargePageMinimum();
+
+    if (large_page_size == 0 || mapped_size % large_page_size != 0)
+        return nullptr;
+
+    return VirtualAlloc(nullptr, mapped_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+    #else // Linux
+
+    #ifdef MAP_HUGETLB
+    // First try to get pages from the pool of explicitly reserved huge pages
+    void* pointer = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (pointer != MAP_FAILED)
+        return pointer;
+    #endif
+
+    // Otherwise fall back to transparent huge pages, which require the region to be aligned to the huge page size.
+    // We map an extra page worth of memory and unmap the parts outside the aligned region.
+
+    size_t padded_size = mapped_size + IMP_HUGE_PAGE_SIZE;
+
+    void* padded_pointer = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (padded_pointer == MAP_FAILED)
+        return nullptr;
+
+    uint8_t* padded_start = (uint8_t*)padded_pointer;
+    uint8_t* aligned_start = (uint8_t*)(((uintptr_t)padded_start + IMP_HUGE_PAGE_SIZE - 1) & ~((uintptr_t)IMP_HUGE_PAGE_SIZE - 1));
+
+    size_t head_size = aligned_start - padded_start;
+    size_t tail_size = padded_size - head_size - mapped_size;
+
+    if (head_size > 0)
+        munmap(padded_start, head_size);
+
+    if (tail_size > 0)
+        munmap(aligned_start + mapped_size, tail_size);
+
+    #ifdef MADV_HUGEPAGE
+    madvise(aligned_start, mapped_size, MADV_HUGEPAGE);
+    #endif
+
+    return aligned_start;
+
+    #endif
+}
+
+static void unmapHugePages(void* pointer, size_t mapped_size)
+{
+    #ifdef IMP_IS_WINDOWS
+    VirtualFree(pointer, 0, MEM_RELEASE);
+    #else // Linux
+    munmap(pointer, mapped_size);
+    #endif
+}
+
+void setHugePagesEnabled(bool enabled)
+{
+    use_huge_pages = enabled;
+}
+
+bool hugePagesEnabled()
+{
+    return use_huge_pages;
+}
+
+// Allocates memory aligned to (at least) a cache line, using huge pages for allocations
+// spanning at least one huge page if enabled. Must be freed with freeLarge.
+void* allocateLarge(size_t size)
+{
+    if (use_huge_pages && size >= IMP_HUGE_PAGE_SIZE)
+    {
+        size_t mapped_size = roundedUpToHugePages(size);
+
+        void* pointer = mapHugePages(mapped_size);
+
+        if (pointer)
+        {
+            std::lock_guard<std::mutex> lock(huge_page_mutex);
+            huge_page_allocations[pointer] = mapped_size;
+
+            return pointer;
+        }
+    }
+
+    return allocateAligned(size);
+}
+
+// Frees memory allocated with allocateLarge
+void freeLarge(void* pointer)
+{
+    if (!pointer)
+        return;
+
+    size_t mapped_size = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(huge_page_mutex);
+
+        auto entry = huge_page_allocations.find(pointer);
+
+        if (entry != huge_page_allocations.end())
+        {
+            mapped_size = entry->second;
+            huge_page_allocations.erase(entry);
+        }
+    }
+
+    if (mapped_size > 0)
+        unmapHugePages(pointer, mapped_size);
+    else
+        freeAligned(pointer);
+}
+
+} // Impact
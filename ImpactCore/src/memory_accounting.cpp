@@ -0,0 +1,125 @@
+#include "memory_accounting.hpp"
+#include "error.hpp"
+#include "string_util.hpp"
+#include <atomic>
+#include <algorithm>
+
+namespace Impact {
+
+// Memory accounting global variables
+
+constexpr unsigned int n_memory_categories = static_cast<unsigned int>(MemoryCategory::Count);
+
+static std::atomic<int64_t> current_usage[n_memory_categories]; // Number of bytes currently in use for each category
+static std::atomic<int64_t> peak_usage[n_memory_categories]; // Highest number of bytes in use at any time for each category
+static std::atomic<int64_t> current_total_usage(0); // Number of bytes currently in use in total
+static std::atomic<int64_t> peak_total_usage(0); // Highest number of bytes in use in total at any time
+
+// Memory accounting function definitions
+
+// Raises the given peak value to the given value if it is larger
+static void updatePeak(std::atomic<int64_t>& peak, int64_t value)
+{
+    int64_t old_peak = peak.load(std::memory_order_relaxed);
+
+    while (value > old_peak && !peak.compare_exchange_weak(old_peak, value, std::memory_order_relaxed));
+}
+
+// Registers that the given number of bytes has been allocated for the given category
+void trackAllocation(MemoryCategory category, size_t n_bytes)
+{
+    if (n_bytes == 0)
+        return;
+
+    unsigned int category_idx = static_cast<unsigned int>(category);
+    imp_assert(category_idx < n_memory_categories);
+
+    int64_t usage = current_usage[category_idx].fetch_add((int64_t)n_bytes, std::memory_order_relaxed) + (int64_t)n_bytes;
+    int64_t total_usage = current_total_usage.fetch_add((int64_t)n_bytes, std::memory_order_relaxed) + (int64_t)n_bytes;
+
+    updatePeak(peak_usage[category_idx], usage);
+    updatePeak(peak_total_usage, total_usage);
+}
+
+// Registers that the given number of bytes has been freed for the given category
+void trackDeallocation(MemoryCategory category, size_t n_bytes)
+{
+    if (n_bytes == 0)
+        return;
+
+    unsigned int category_idx = static_cast<unsigned int>(category);
+    imp_assert(category_idx < n_memory_categories);
+
+    current_usage[category_idx].fetch_sub((int64_t)n_bytes, std::memory_order_relaxed);
+    current_total_usage.fetch_sub((int64_t)n_bytes, std::memory_order_relaxed);
+}
+
+size_t currentMemoryUsage(MemoryCategory category)
+{
+    return (size_t)std::max<int64_t>(0, current_usage[static_cast<unsigned int>(category)].load(std::memory_order_relaxed));
+}
+
+size_t peakMemoryUsage(MemoryCategory category)
+{
+    return (size_t)peak_usage[static_cast<unsigned int>(category)].load(std::memory_order_relaxed);
+}
+
+size_t peakTotalMemoryUsage()
+{
+    return (size_t)peak_total_usage.load(std::memory_order_relaxed);
+}
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+        case MemoryCategory::Geometry:              return "Geometry";
+        case MemoryCategory::Transformations:       return "Transformations";
+        case MemoryCategory::AccelerationStructure: return "Accelerator";
+        case MemoryCategory::SensorPixels:          return "Sensor pixels";
+        case MemoryCategory::SamplerArrays:         return "Sampler arrays";
+        case MemoryCategory::RegionAllocators:      return "Region allocators";
+        case MemoryCategory::IrradianceCache:       return "Irradiance cache";
+        case MemoryCategory::PathGuide:             return "Path guide";
+        case MemoryCategory::Other:                 return "Other";
+        default:                                    return "Unknown";
+    }
+}
+
+// Returns a human readable representation of the given number of bytes
+std::string formattedMemorySize(size_t n_bytes)
+{
+    if (n_bytes < 1024)
+        return formatString("%u B", (unsigned int)n_bytes);
+    else if (n_bytes < 1024*1024)
+        return formatString("%.1f kB", n_bytes/1024.0);
+    else if (n_bytes < 1024*1024*1024)
+        return formatString("%.1f MB", n_bytes/(1024.0*1024.0));
+    else
+        return formatString("%.2f GB", n_bytes/(1024.0*1024.0*1024.0));
+}
+
+// Returns a table with the peak and current memory usage for each category
+std::string memoryUsageReport()
+{
+    std::string report = formatString("Memory usage:"
+                                      "\n    %-20s%-14s%s",
+                                      "Category:", "Peak", "Current");
+
+    for (unsigned int category_idx = 0; category_idx < n_memory_categories; category_idx++)
+    {
+        MemoryCategory category = static_cast<MemoryCategory>(category_idx);
+
+        report += formatString("\n    %-20s%-14s%s",
+                               (std::string(memoryCategoryName(category)) + ":").c_str(),
+                               formattedMemorySize(peakMemoryUsage(category)).c_str(),
+                               formattedMemorySize(currentMemoryUsage(category)).c_str());
+    }
+
+    report += formatString("\n    %-20s%s",
+                           "Peak total:", formattedMemorySize(peakTotalMemoryUsage()).c_str());
+
+    return report;
+}
+
+} // Impact
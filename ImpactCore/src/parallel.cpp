@@ -1,5 +1,6 @@
 #include "parallel.hpp"
 #include "error.hpp"
+#include "Barrier.hpp"
 #include <thread>
 #include <mutex>
 #include <vector>
@@ -352,4 +353,28 @@ void parallelFor2D(const std::function<void (uint32_t, uint32_t)>& loop_body,
     }
 }
 
+// Executes the given function exactly once on each thread (including the calling thread)
+void executeOnEachThread(const std::function<void ()>& function)
+{
+    imp_check(!threads.empty() || IMP_N_THREADS == 1);
+
+    if (threads.empty())
+    {
+        function();
+        return;
+    }
+
+    // Every thread must wait at the barrier after executing its iteration,
+    // which prevents any thread from picking up more than one iteration
+    Barrier barrier(IMP_N_THREADS);
+
+    parallelFor(
+    [&](uint64_t thread_idx)
+    {
+        function();
+        barrier.wait();
+    },
+    IMP_N_THREADS);
+}
+
 } // Impact
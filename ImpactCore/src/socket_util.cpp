@@ -0,0 +1,398 @@
+#include "socket_util.hpp"
+#include "error.hpp"
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+
+#ifdef IMP_IS_WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else // Linux
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace Impact {
+
+// Socket global variables
+
+#ifdef IMP_IS_WINDOWS
+static const Socket::Handle invalid_socket_handle = INVALID_SOCKET;
+#else // Linux
+static const Socket::Handle invalid_socket_handle = -1;
+#endif
+
+static const char unix_socket_prefix[] = "unix:"; // Prefix of addresses referring to Unix domain sockets
+
+// Socket utility functions
+
+// Makes sure the socket library is ready for use (only needed on Windows)
+static void initializeSockets()
+{
+    #ifdef IMP_IS_WINDOWS
+    static std::once_flag initialization_flag;
+
+    std::call_once(initialization_flag,
+    []()
+    {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+            printErrorMessage("could not initialize Windows sockets");
+    });
+    #endif
+}
+
+static void closeSocketHandle(Socket::Handle handle)
+{
+    #ifdef IMP_IS_WINDOWS
+    closesocket(handle);
+    #else // Linux
+    ::close(handle);
+    #endif
+}
+
+static bool isUnixSocketAddress(const std::string& address)
+{
+    return address.compare(0, sizeof(unix_socket_prefix) - 1, unix_socket_prefix) == 0;
+}
+
+// Splits a "host:port" address into its host and port parts
+static bool splitHostAndPort(const std::string& address, std::string* host, std::string* port)
+{
+    size_t separator_idx = address.rfind(':');
+
+    if (separator_idx == std::string::npos || separator_idx + 1 == address.size())
+    {
+        printErrorMessage("invalid socket address \"%s\" (expected \"host:port\" or \"unix:path\")", address.c_str());
+        return false;
+    }
+
+    *host = address.substr(0, separator_idx);
+    *port = address.substr(separator_idx + 1);
+
+    if (*host == "*")
+        host->clear();
+
+    return true;
+}
+
+#ifndef IMP_IS_WINDOWS
+// Fills in the Unix domain socket address for the given "unix:path" address
+static bool unixSocketAddress(const std::string& address, sockaddr_un* socket_address)
+{
+    const std::string& path = address.substr(sizeof(unix_socket_prefix) - 1);
+
+    if (path.empty() || path.size() >= sizeof(socket_address->sun_path))
+    {
+        printErrorMessage("invalid Unix socket path \"%s\"", path.c_str());
+        return false;
+    }
+
+    std::memset(socket_address, 0, sizeof(sockaddr_un));
+    socket_address->sun_family = AF_UNIX;
+    std::strncpy(socket_address->sun_path, path.c_str(), sizeof(socket_address->sun_path) - 1);
+
+    return true;
+}
+#endif
+
+// Socket method definitions
+
+Socket::Socket()
+    : handle(invalid_socket_handle),
+      unix_socket_path()
+{}
+
+Socket::Socket(Handle handle)
+    : handle(handle),
+      unix_socket_path()
+{}
+
+Socket::Socket(Socket&& other)
+    : handle(other.handle),
+      unix_socket_path(std::move(other.unix_socket_path))
+{
+    other.handle = invalid_socket_handle;
+    other.unix_socket_path.clear();
+}
+
+Socket& Socket::operator=(Socket&& other)
+{
+    if (this != &other)
+    {
+        close();
+
+        handle = other.handle;
+        unix_socket_path = std::move(other.unix_socket_path);
+
+        other.handle = invalid_socket_handle;
+        other.unix_socket_path.clear();
+    }
+
+    return *this;
+}
+
+Socket::~Socket()
+{
+    close();
+}
+
+// Creates a socket listening for connections on the given address.
+// The returned socket is closed if the address could not be bound.
+Socket Socket::listenOn(const std::string& address)
+{
+    initializeSockets();
+
+    Socket listener;
+
+    if (isUnixSocketAddress(address))
+    {
+        #ifdef IMP_IS_WINDOWS
+        printErrorMessage("Unix domain sockets are not supported on this platform");
+        #else // Linux
+        sockaddr_un socket_address;
+
+        if (!unixSocketAddress(address, &socket_address))
+            return listener;
+
+        listener.handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (listener.handle == invalid_socket_handle)
+        {
+            printErrorMessage("could not create socket for \"%s\"", address.c_str());
+            return listener;
+        }
+
+        // Remove any socket file left behind by an earlier process
+        ::unlink(socket_address.sun_path);
+
+        if (::bind(listener.handle, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) != 0 ||
+            ::listen(listener.handle, SOMAXCONN) != 0)
+        {
+            printErrorMessage("could not listen on \"%s\"", address.c_str());
+            listener.close();
+            return listener;
+        }
+
+        listener.unix_socket_path = socket_address.sun_path;
+        #endif
+
+        return listener;
+    }
+
+    std::string host, port;
+
+    if (!splitHostAndPort(address, &host, &port))
+        return listener;
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    addrinfo* address_list = nullptr;
+
+    if (getaddrinfo((host.empty())? nullptr : host.c_str(), port.c_str(), &hints, &address_list) != 0)
+    {
+        printErrorMessage("could not resolve address \"%s\"", address.c_str());
+        return listener;
+    }
+
+    // Bind to the first of the resolved addresses that works
+    for (addrinfo* entry = address_list; entry; entry = entry->ai_next)
+    {
+        listener.handle = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+
+        if (listener.handle == invalid_socket_handle)
+            continue;
+
+        int reuse_address = 1;
+        setsockopt(listener.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse_address), sizeof(reuse_address));
+
+        if (::bind(listener.handle, entry->ai_addr, (int)entry->ai_addrlen) == 0 &&
+            ::listen(listener.handle, SOMAXCONN) == 0)
+            break;
+
+        listener.close();
+    }
+
+    freeaddrinfo(address_list);
+
+    if (!listener.isOpen())
+        printErrorMessage("could not listen on \"%s\"", address.c_str());
+
+    return listener;
+}
+
+// Creates a socket connected to the given address.
+// The returned socket is closed if no connection could be made.
+Socket Socket::connectTo(const std::string& address)
+{
+    initializeSockets();
+
+    Socket connection;
+
+    if (isUnixSocketAddress(address))
+    {
+        #ifndef IMP_IS_WINDOWS
+        sockaddr_un socket_address;
+
+        if (!unixSocketAddress(address, &socket_address))
+            return connection;
+
+        connection.handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (connection.handle != invalid_socket_handle &&
+            ::connect(connection.handle, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) != 0)
+            connection.close();
+        #endif
+
+        return connection;
+    }
+
+    std::string host, port;
+
+    if (!splitHostAndPort(address, &host, &port))
+        return connection;
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* address_list = nullptr;
+
+    if (getaddrinfo((host.empty())? "localhost" : host.c_str(), port.c_str(), &hints, &address_list) != 0)
+        return connection;
+
+    for (addrinfo* entry = address_list; entry; entry = entry->ai_next)
+    {
+        connection.handle = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+
+        if (connection.handle == invalid_socket_handle)
+            continue;
+
+        if (::connect(connection.handle, entry->ai_addr, (int)entry->ai_addrlen) == 0)
+            break;
+
+        connection.close();
+    }
+
+    freeaddrinfo(address_list);
+
+    return connection;
+}
+
+// Waits for a connection on a listening socket and returns a socket for it
+Socket Socket::acceptConnection()
+{
+    imp_assert(isOpen());
+
+    return Socket(::accept(handle, nullptr, nullptr));
+}
+
+bool Socket::isOpen() const
+{
+    return handle != invalid_socket_handle;
+}
+
+void Socket::close()
+{
+    if (!isOpen())
+        return;
+
+    closeSocketHandle(handle);
+    handle = invalid_socket_handle;
+
+    #ifndef IMP_IS_WINDOWS
+    if (!unix_socket_path.empty())
+        ::unlink(unix_socket_path.c_str());
+    #endif
+
+    unix_socket_path.clear();
+}
+
+// Waits until there is data (or a connection, for listening sockets) available to read.
+// Returns false if the timeout expired first. A non-positive timeout waits indefinitely.
+bool Socket::waitUntilReadable(double timeout_seconds)
+{
+    imp_assert(isOpen());
+
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(handle, &read_set);
+
+    timeval timeout;
+    timeout.tv_sec = (long)timeout_seconds;
+    timeout.tv_usec = (long)((timeout_seconds - (double)timeout.tv_sec)*1e6);
+
+    int result = select((int)handle + 1, &read_set, nullptr, nullptr, (timeout_seconds > 0)? &timeout : nullptr);
+
+    return result > 0;
+}
+
+// Sends the given number of bytes, returning false if the connection failed
+bool Socket::sendAll(const void* data, size_t n_bytes)
+{
+    imp_assert(isOpen());
+
+    const char* remaining_data = static_cast<const char*>(data);
+
+    while (n_bytes > 0)
+    {
+        #ifdef IMP_IS_WINDOWS
+        int n_sent_bytes = ::send(handle, remaining_data, (int)std::min<size_t>(n_bytes, 1 << 30), 0);
+        #else // Linux
+        ssize_t n_sent_bytes = ::send(handle, remaining_data, n_bytes, MSG_NOSIGNAL);
+
+        if (n_sent_bytes < 0 && errno == EINTR)
+            continue;
+        #endif
+
+        if (n_sent_bytes <= 0)
+            return false;
+
+        remaining_data += n_sent_bytes;
+        n_bytes -= (size_t)n_sent_bytes;
+    }
+
+    return true;
+}
+
+// Receives exactly the given number of bytes, returning false if the connection was closed or failed first
+bool Socket::receiveAll(void* data, size_t n_bytes)
+{
+    imp_assert(isOpen());
+
+    char* remaining_data = static_cast<char*>(data);
+
+    while (n_bytes > 0)
+    {
+        #ifdef IMP_IS_WINDOWS
+        int n_received_bytes = ::recv(handle, remaining_data, (int)std::min<size_t>(n_bytes, 1 << 30), 0);
+        #else // Linux
+        ssize_t n_received_bytes = ::recv(handle, remaining_data, n_bytes, 0);
+
+        if (n_received_bytes < 0 && errno == EINTR)
+            continue;
+        #endif
+
+        if (n_received_bytes <= 0)
+            return false;
+
+        remaining_data += n_received_bytes;
+        n_bytes -= (size_t)n_received_bytes;
+    }
+
+    return true;
+}
+
+} // Impact
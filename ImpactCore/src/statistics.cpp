@@ -0,0 +1,143 @@
+#include "statistics.hpp"
+#include "parallel.hpp"
+#include "string_util.hpp"
+#include <mutex>
+#include <algorithm>
+
+namespace Impact {
+
+// Statistics global variables
+
+// The registered reporter functions (kept in a function-local static so that
+// registration from static initializers in other files is safe)
+static std::vector<void (*)(StatisticsAccumulator&)>& registeredReporters()
+{
+    static std::vector<void (*)(StatisticsAccumulator&)> reporters;
+    return reporters;
+}
+
+static StatisticsAccumulator accumulator; // Holds the merged statistics of all threads
+static std::mutex accumulator_mutex; // Mutex that must be owned when adding to the accumulator
+
+// StatisticsAccumulator method definitions
+
+void StatisticsAccumulator::addCounter(const std::string& title, int64_t value)
+{
+    counters[title] += value;
+}
+
+void StatisticsAccumulator::addRate(const std::string& title, int64_t value)
+{
+    rates[title] += value;
+}
+
+void StatisticsAccumulator::addRatio(const std::string& title, int64_t numerator, int64_t denominator)
+{
+    std::pair<int64_t, int64_t>& ratio = ratios[title];
+    ratio.first += numerator;
+    ratio.second += denominator;
+}
+
+void StatisticsAccumulator::addHistogram(const std::string& title, const int64_t* bin_counts, unsigned int n_bins)
+{
+    std::vector<int64_t>& histogram = histograms[title];
+
+    if (histogram.size() < n_bins)
+        histogram.resize(n_bins, 0);
+
+    for (unsigned int bin_idx = 0; bin_idx < n_bins; bin_idx++)
+        histogram[bin_idx] += bin_counts[bin_idx];
+}
+
+void StatisticsAccumulator::clear()
+{
+    counters.clear();
+    rates.clear();
+    ratios.clear();
+    histograms.clear();
+}
+
+// Returns a table with the accumulated statistics, using the given elapsed time to compute rates
+std::string StatisticsAccumulator::report(double elapsed_seconds) const
+{
+    std::string report = formatString("Statistics:"
+                                      "\n    %-32s%.2f s",
+                                      "Elapsed time:", elapsed_seconds);
+
+    for (const auto& counter : counters)
+    {
+        report += formatString("\n    %-32s%lld",
+                               (counter.first + ":").c_str(), (long long)counter.second);
+    }
+
+    for (const auto& rate : rates)
+    {
+        report += formatString("\n    %-32s%-14lld(%.4g /s)",
+                               (rate.first + ":").c_str(), (long long)rate.second,
+                               (elapsed_seconds > 0)? rate.second/elapsed_seconds : 0.0);
+    }
+
+    for (const auto& ratio : ratios)
+    {
+        report += formatString("\n    %-32s%-14.4g(%lld/%lld)",
+                               (ratio.first + ":").c_str(),
+                               (ratio.second.second > 0)? (double)ratio.second.first/ratio.second.second : 0.0,
+                               (long long)ratio.second.first, (long long)ratio.second.second);
+    }
+
+    for (const auto& histogram : histograms)
+    {
+        report += formatString("\n    %-32s", (histogram.first + ":").c_str());
+
+        size_t n_bins = histogram.second.size();
+
+        for (size_t bin_idx = 0; bin_idx < n_bins; bin_idx++)
+        {
+            report += formatString((bin_idx + 1 < n_bins)? "[%u] %lld  " : "[%u+] %lld",
+                                   (unsigned int)bin_idx, (long long)histogram.second[bin_idx]);
+        }
+    }
+
+    return report;
+}
+
+// StatisticsRegisterer method definitions
+
+StatisticsRegisterer::StatisticsRegisterer(void (*reporter)(StatisticsAccumulator&))
+{
+    registeredReporters().push_back(reporter);
+}
+
+// Statistics function definitions
+
+// Adds the thread-local statistics of every thread to the global accumulator and resets them
+void mergeThreadStatistics()
+{
+    const std::vector<void (*)(StatisticsAccumulator&)>& reporters = registeredReporters();
+
+    if (reporters.empty())
+        return;
+
+    executeOnEachThread(
+    [&]()
+    {
+        std::lock_guard<std::mutex> lock(accumulator_mutex);
+
+        for (auto reporter : reporters)
+            reporter(accumulator);
+    });
+}
+
+void clearStatistics()
+{
+    std::lock_guard<std::mutex> lock(accumulator_mutex);
+    accumulator.clear();
+}
+
+std::string statisticsReport(double elapsed_seconds)
+{
+    std::lock_guard<std::mutex> lock(accumulator_mutex);
+    return accumulator.report(elapsed_seconds);
+}
+
+} // Impact
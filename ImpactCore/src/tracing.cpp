@@ -0,0 +1,202 @@
+#include "tracing.hpp"
+#include "error.hpp"
+#include "parallel.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <set>
+#include <memory>
+#include <fstream>
+#include <iomanip>
+
+namespace Impact {
+
+// Tracing declarations
+
+// A completed span recorded by a TraceScope
+struct TraceEvent
+{
+    const char* name; // Name of the span
+    std::string arguments; // Comma separated list of JSON members attached to the span
+    double start_time; // Time when the span started [microseconds since program start]
+    double duration; // Duration of the span [microseconds]
+};
+
+// The spans recorded by a single thread
+struct ThreadTrace
+{
+    unsigned int thread_id; // Identifier of the thread (used as the track identifier)
+    std::vector<TraceEvent> events; // Spans recorded by the thread
+};
+
+// Tracing global variables
+
+static const std::chrono::steady_clock::time_point program_start_time = std::chrono::steady_clock::now(); // Reference time for all timestamps
+
+static std::atomic<bool> tracing_enabled(false); // Whether completed spans are currently recorded
+static std::atomic<unsigned int> trace_generation(0); // Incremented whenever the recorded traces are discarded
+
+static std::vector< std::unique_ptr<ThreadTrace> > thread_traces; // Trace buffer for each thread that has recorded spans
+static std::mutex thread_traces_mutex; // Mutex that must be owned when modifying the list of trace buffers
+
+static thread_local ThreadTrace* current_thread_trace = nullptr; // Trace buffer of the current thread
+static thread_local unsigned int current_thread_trace_generation = 0; // Generation that the trace buffer of the current thread belongs to
+
+// Tracing function definitions
+
+// Returns the trace buffer of the current thread, creating it if necessary
+static ThreadTrace& threadTrace()
+{
+    unsigned int generation = trace_generation.load(std::memory_order_acquire);
+
+    if (!current_thread_trace || current_thread_trace_generation != generation)
+    {
+        std::lock_guard<std::mutex> lock(thread_traces_mutex);
+
+        thread_traces.emplace_back(new ThreadTrace{IMP_THREAD_ID, std::vector<TraceEvent>()});
+
+        current_thread_trace = thread_traces.back().get();
+        current_thread_trace_generation = generation;
+    }
+
+    return *current_thread_trace;
+}
+
+// Discards any previously recorded spans and starts recording new ones
+void beginTracing()
+{
+    std::lock_guard<std::mutex> lock(thread_traces_mutex);
+
+    thread_traces.clear();
+    trace_generation.fetch_add(1, std::memory_order_acq_rel);
+
+    tracing_enabled.store(true, std::memory_order_release);
+}
+
+// Stops recording and writes all recorded spans to the given file as trace event JSON.
+// Must not be called while other threads may be recording spans.
+bool endTracing(const std::string& filename)
+{
+    tracing_enabled.store(false, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(thread_traces_mutex);
+
+    std::ofstream file;
+    file.open(filename.c_str());
+
+    if (!file.is_open())
+    {
+        printErrorMessage("cannot open file \"%s\" for output", filename.c_str());
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+    bool is_first_event = true;
+
+    // Give each thread track a name
+    std::set<unsigned int> thread_ids;
+
+    for (const auto& thread_trace : thread_traces)
+        thread_ids.insert(thread_trace->thread_id);
+
+    for (unsigned int thread_id : thread_ids)
+    {
+        const std::string& thread_name = (thread_id == 0)? std::string("Main thread") : "Worker thread " + std::to_string(thread_id);
+
+        file << ((is_first_event)? "\n" : ",\n")
+             << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread_id
+             << ", \"args\": {\"name\": \"" << thread_name << "\"}}";
+
+        is_first_event = false;
+    }
+
+    // Write a complete event for each span
+    for (const auto& thread_trace : thread_traces)
+    {
+        for (const TraceEvent& event : thread_trace->events)
+        {
+            file << ((is_first_event)? "\n" : ",\n")
+                 << "{\"name\": \"" << escapedForJSON(event.name)
+                 << "\", \"cat\": \"RayImpact\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread_trace->thread_id
+                 << ", \"ts\": " << event.start_time
+                 << ", \"dur\": " << event.duration;
+
+            if (!event.arguments.empty())
+                file << ", \"args\": {" << event.arguments << "}";
+
+            file << "}";
+
+            is_first_event = false;
+        }
+    }
+
+    file << "\n]}\n";
+    file.close();
+
+    thread_traces.clear();
+    trace_generation.fetch_add(1, std::memory_order_acq_rel);
+
+    return true;
+}
+
+bool tracingEnabled()
+{
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Returns the number of microseconds elapsed since the start of the program
+double traceTime()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - program_start_time).count();
+}
+
+// Returns a copy of the given text with special characters escaped for use in a JSON string
+std::string escapedForJSON(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+
+    for (char character : text)
+    {
+        switch (character)
+        {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:   escaped += character; break;
+        }
+    }
+
+    return escaped;
+}
+
+// TraceScope method definitions
+
+TraceScope::TraceScope(const char* name)
+    : name(name),
+      arguments(),
+      start_time(traceTime())
+{}
+
+TraceScope::TraceScope(const char* name, const std::string& arguments)
+    : name(name),
+      arguments(arguments),
+      start_time(traceTime())
+{}
+
+TraceScope::~TraceScope()
+{
+    if (!tracingEnabled())
+        return;
+
+    double end_time = traceTime();
+
+    threadTrace().events.push_back({name, std::move(arguments), start_time, end_time - start_time});
+}
+
+} // Impact
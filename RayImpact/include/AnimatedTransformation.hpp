@@ -51,7 +51,17 @@ public:
     RayWithOffsets operator()(const RayWithOffsets& ray) const;
 
     BoundingBoxF encompassMotionInBoundingBox(const BoundingBoxF& initial_bounds) const;
+
+    bool hasRotationalMotion() const;
 };
 
+// AnimatedTransformation inline method definitions
+
+// Whether the transformation rotates over time, in which case the bounds of moving points can not yet be computed
+inline bool AnimatedTransformation::hasRotationalMotion() const
+{
+    return is_animated && has_rotation;
+}
+
 } // RayImpact
 } // Impact
@@ -133,7 +133,7 @@ public:
                       const Vector3F& world_incident_direction,
                       BXDFType type = BSDF_ALL) const;
 
-    Spectrum reduced(const Vector3F& outgoing_direction,
+    Spectrum reduced(const Vector3F& world_outgoing_direction,
                      unsigned int n_samples,
                      const Point2F* samples,
                      BXDFType type = BSDF_ALL) const;
@@ -150,8 +150,8 @@ public:
                     BXDFType type = BSDF_ALL,
 					BXDFType* sampled_type = nullptr) const;
 
-    imp_float pdf(const Vector3F& outgoing_direction,
-                  const Vector3F& incident_direction,
+    imp_float pdf(const Vector3F& world_outgoing_direction,
+                  const Vector3F& world_incident_direction,
                   BXDFType type = BSDF_ALL) const;
 };
 
@@ -54,6 +54,8 @@ inline BilinearInterpolationTexture<T>::BilinearInterpolationTexture(const T& va
 template <typename T>
 inline T BilinearInterpolationTexture<T>::evaluate(const SurfaceScatteringEvent& scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_texture_evaluations);
+
     Vector2F dstdx, dstdy;
 
     const Point2F& coord = mapper->textureCoordinate(scattering_event, &dstdx, &dstdy);
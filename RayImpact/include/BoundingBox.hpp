@@ -106,6 +106,18 @@ inline BoundingBox<T> intersectionOf(const BoundingBox<T>& bounding_box_1,
                           min(bounding_box_1.upper_corner, bounding_box_2.upper_corner));
 }
 
+// Computes the squared distance from the given point to the closest point inside the bounding box
+template <typename T>
+inline T squaredDistanceBetween(const BoundingBox<T>& bounding_box,
+                                const Point3<T>& point)
+{
+    T distance_x = std::max(std::max(bounding_box.lower_corner.x - point.x, point.x - bounding_box.upper_corner.x), (T)0);
+    T distance_y = std::max(std::max(bounding_box.lower_corner.y - point.y, point.y - bounding_box.upper_corner.y), (T)0);
+    T distance_z = std::max(std::max(bounding_box.lower_corner.z - point.z, point.z - bounding_box.upper_corner.z), (T)0);
+
+    return distance_x*distance_x + distance_y*distance_y + distance_z*distance_z;
+}
+
 template <typename T>
 inline std::ostream& operator<<(std::ostream& stream, const BoundingBox<T>& box)
 {
@@ -213,14 +225,14 @@ inline Vector3<T> BoundingBox<T>::diagonal() const
 template <typename T>
 inline T BoundingBox<T>::surfaceArea() const
 {
-    const Vector3<T>& diagonal = diagonal();
+    const Vector3<T>& diagonal = this->diagonal();
     return 2*(diagonal.x*diagonal.y + diagonal.y*diagonal.z + diagonal.z*diagonal.x);
 }
 
 template <typename T>
 inline T BoundingBox<T>::volume() const
 {
-    const Vector3<T>& diagonal = diagonal();
+    const Vector3<T>& diagonal = this->diagonal();
     return diagonal.x*diagonal.y*diagonal.z;
 }
 
@@ -228,7 +240,7 @@ inline T BoundingBox<T>::volume() const
 template <typename T>
 inline unsigned int BoundingBox<T>::maxDimension() const
 {
-    const Vector3<T>& diagonal = diagonal();
+    const Vector3<T>& diagonal = this->diagonal();
     return (diagonal.x >= diagonal.y)? ((diagonal.x >= diagonal.z)? 0 : 2) : ((diagonal.y >= diagonal.z)? 1 : 2);
 }
 
@@ -237,7 +249,7 @@ inline unsigned int BoundingBox<T>::maxDimension() const
 template <typename T>
 inline Vector3<T> BoundingBox<T>::getLocalCoordinate(const Point3<T>& global_coord) const
 {
-    Vector3<T>& local_coord = global_coord - lower_corner;
+    Vector3<T> local_coord = global_coord - lower_corner;
 
     if (upper_corner.x > lower_corner.x)
         local_coord.x /= upper_corner.x - lower_corner.x;
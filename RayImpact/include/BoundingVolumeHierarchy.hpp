@@ -1,8 +1,10 @@
 #pragma once
 #include "Model.hpp"
 #include "RegionAllocator.hpp"
+#include "ObjectArena.hpp"
+#include "memory.hpp"
+#include "memory_accounting.hpp"
 #include "ParameterSet.hpp"
-#include <memory>
 #include <vector>
 
 namespace Impact {
@@ -67,18 +69,20 @@ private:
 
     const unsigned int max_models_in_node; // Maxium allowed number of models that can be contained in a BVH node
     const SplitMethod split_method; // The method to use for partitioning models
-    std::vector< std::shared_ptr<Model> > models; // All the models contained in the BVH
+    std::vector< const Model*, LargeAllocator<const Model*> > models; // All the models contained in the BVH
+    std::vector<BoundingBoxF> model_bounding_boxes; // World space bounding box of each model, for culling ray packets
+    TrackedMemory memory; // Accounting of the memory used by the BVH
 
     BVHNode* buildRecursive(RegionAllocator& allocator,
                             std::vector<BVHModelBound>& model_bounds,
                             unsigned int start_model_idx,
                             unsigned int end_model_idx,
                             unsigned int* n_models_total,
-                            std::vector< std::shared_ptr<Model> >& models_ordered);
+                            std::vector<const Model*>& models_ordered);
 
 public:
 
-    BoundingVolumeHierarchy(const std::vector< std::shared_ptr<Model> >& contained_models,
+    BoundingVolumeHierarchy(const std::vector<const Model*>& contained_models,
                             unsigned int max_models_in_node = 1,
                             SplitMethod split_method = SplitMethod::SAH);
 
@@ -88,12 +92,21 @@ public:
                    SurfaceScatteringEvent* scattering_event) const;
 
     bool hasIntersection(const Ray& ray) const;
+
+    void intersectPacket(const RayPacket& packet,
+                         SurfaceScatteringEvent* scattering_events,
+                         bool* has_intersections) const;
+
+    uint32_t hasIntersectionPacket(const RayPacket& packet) const;
+
+    const Model* occludingModel(const Ray& ray) const;
 };
 
 // BoundingVolumeHierarchy function declarations
 
-std::shared_ptr<Model> createBoundingVolumeHierarchy(const std::vector< std::shared_ptr<Model> >& models,
-                                                     const ParameterSet& parameters);
+Model* createBoundingVolumeHierarchy(const std::vector<const Model*>& models,
+                                     const ParameterSet& parameters,
+                                     ObjectArena& arena);
 
 } // RayImpact
 } // Impact
@@ -3,6 +3,7 @@
 #include "math.hpp"
 #include "geometry.hpp"
 #include "BoundingRectangle.hpp"
+#include "BoundingBox.hpp"
 #include "Ray.hpp"
 #include "Transformation.hpp"
 #include "AnimatedTransformation.hpp"
@@ -30,7 +31,7 @@ public:
     AnimatedTransformation camera_to_world; // Transformation from camera space to world space
     const imp_float shutter_opening_time; // Point in time that the shutter opens
     const imp_float shutter_closing_time; // Point in time that the shutter closes
-    Sensor* sensor; // The sensor used by the camera
+    Sensor* sensor; // The sensor used by the camera (owned by the camera)
     const Medium* medium; // The medium surrounding the camera
 
     Camera(const AnimatedTransformation& camera_to_world,
@@ -39,11 +40,17 @@ public:
            Sensor* sensor,
            const Medium* medium);
 
+    virtual ~Camera();
+
     virtual imp_float generateRay(const CameraSample& sample,
                                   Ray* ray) const = 0;
 
     virtual imp_float generateRayWithOffsets(const CameraSample& sample,
                                              RayWithOffsets* ray) const;
+
+    virtual bool computeViewBounds(const BoundingRectangleF& raster_bounds,
+                                   const BoundingBoxF& scene_bounds,
+                                   BoundingBoxF* view_bounds) const;
 };
 
 // ProjectiveCamera declarations
@@ -60,6 +67,11 @@ protected:
     imp_float lens_radius; // Radius of the camera aperture
     imp_float focal_distance; // Distance in camera space at which objects are in focus
 
+    bool viewBoundsFromCornerRays(const Point3F corner_origins[4],
+                                  const Vector3F corner_directions[4],
+                                  const BoundingBoxF& scene_bounds,
+                                  BoundingBoxF* view_bounds) const;
+
 public:
 
     ProjectiveCamera(const AnimatedTransformation& camera_to_world,
@@ -87,5 +99,20 @@ inline Camera::Camera(const AnimatedTransformation& camera_to_world,
       medium(medium)
 {}
 
+inline Camera::~Camera()
+{
+    delete sensor;
+}
+
+// Computes a world space bounding box containing every point inside the given scene bounds that
+// can be reached by an eye ray through the given region of the sensor, and returns whether such
+// bounds could be found. The default implementation makes no attempt and returns false.
+inline bool Camera::computeViewBounds(const BoundingRectangleF& raster_bounds,
+                                      const BoundingBoxF& scene_bounds,
+                                      BoundingBoxF* view_bounds) const
+{
+    return false;
+}
+
 } // RayImpact
 } // Impact
@@ -39,6 +39,8 @@ inline ConstantTexture<T>::ConstantTexture(const T& value)
 template <typename T>
 inline T ConstantTexture<T>::evaluate(const SurfaceScatteringEvent& scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_texture_evaluations);
+
     return value;
 }
 
@@ -7,7 +7,7 @@
 #include "ScatteringEvent.hpp"
 #include "ParameterSet.hpp"
 #include "error.hpp"
-#include <memory>
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -43,14 +43,18 @@ public:
                          bool test_alpha_texture = true) const;
 
     imp_float surfaceArea() const;
+
+    ScatteringEvent sampleSurface(const Point2F& uniform_sample,
+                                  imp_float* pdf_value) const;
 };
 
 // Cylinder function declarations
 
-std::shared_ptr<Shape> createCylinder(const Transformation* object_to_world,
-                                      const Transformation* world_to_object,
-                                      bool has_reverse_orientation,
-                                      const ParameterSet& parameters);
+Shape* createCylinder(const Transformation* object_to_world,
+                      const Transformation* world_to_object,
+                      bool has_reverse_orientation,
+                      const ParameterSet& parameters,
+                      ObjectArena& arena);
 
 // Cylinder inline method definitions
 
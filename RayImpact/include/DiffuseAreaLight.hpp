@@ -3,7 +3,8 @@
 #include "Shape.hpp"
 #include "ParameterSet.hpp"
 #include "math.hpp"
-#include <memory>
+#include "geometry.hpp"
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -15,7 +16,7 @@ class DiffuseAreaLight : public AreaLight {
 private:
 
     const RadianceSpectrum emitted_radiance; // The radiance emitted from each point on the surface
-    std::shared_ptr<Shape> shape; // The shape representing the emitting surface
+    const Shape* shape; // The shape representing the emitting surface
     const imp_float surface_area; // The total area of the surface
 
 public:
@@ -24,7 +25,7 @@ public:
                      const MediumInterface& medium_interface,
                      const RadianceSpectrum& emitted_radiance,
                      unsigned int n_samples,
-                     const std::shared_ptr<Shape>& shape);
+                     const Shape* shape);
 
     RadianceSpectrum sampleIncidentRadiance(const ScatteringEvent& scattering_event,
                                             const Point2F& uniform_sample,
@@ -32,18 +33,32 @@ public:
                                             imp_float* pdf_value,
                                             VisibilityTester* visibility_tester) const;
 
+    imp_float incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                  const Vector3F& incident_direction) const;
+
     RadianceSpectrum emittedRadiance(const ScatteringEvent& scattering_event,
                                      const Vector3F& outgoing_direction) const;
 
+    RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                           const Point2F& direction_sample,
+                                           imp_float time,
+                                           Ray* emitted_ray,
+                                           Normal3F* surface_normal,
+                                           imp_float* position_pdf_value,
+                                           imp_float* direction_pdf_value) const;
+
     PowerSpectrum emittedPower() const;
+
+    bool computeBounds(LightBounds* bounds) const;
 };
 
 // DiffuseAreaLight function declarations
 
-std::shared_ptr<AreaLight> createDiffuseAreaLight(const Transformation& light_to_world,
-                                                  const MediumInterface& medium_interface,
-                                                  const ParameterSet& parameters,
-                                                  std::shared_ptr<Shape> shape);
+AreaLight* createDiffuseAreaLight(const Transformation& light_to_world,
+                                  const MediumInterface& medium_interface,
+                                  const ParameterSet& parameters,
+                                  const Shape* shape,
+                                  ObjectArena& arena);
 
 // DiffuseAreaLight inline method definitions
 
@@ -51,21 +66,43 @@ inline DiffuseAreaLight::DiffuseAreaLight(const Transformation& light_to_world,
 										  const MediumInterface& medium_interface,
 										  const RadianceSpectrum& emitted_radiance,
 										  unsigned int n_samples,
-										  const std::shared_ptr<Shape>& shape)
+										  const Shape* shape)
     : AreaLight::AreaLight(light_to_world, medium_interface, n_samples),
       emitted_radiance(emitted_radiance),
       shape(shape),
       surface_area(shape->surfaceArea())
 {}
 
+// Samples a point on the surface as seen from the given scattering event and returns the
+// radiance emitted from it towards the scattering event. The probability density is with
+// respect to solid angle at the scattering event.
 inline RadianceSpectrum DiffuseAreaLight::sampleIncidentRadiance(const ScatteringEvent& scattering_event,
 																 const Point2F& uniform_sample,
 																 Vector3F* incident_direction,
 																 imp_float* pdf_value,
 																 VisibilityTester* visibility_tester) const
 {
-    printSevereMessage("\"DiffuseAreaLight::sampleIncidentRadiance\" has not been implemented");
-    return RadianceSpectrum(0.0f);
+    ScatteringEvent light_event = shape->sampleSurfaceFrom(scattering_event, uniform_sample, pdf_value);
+
+    light_event.medium_interface = medium_interface;
+    light_event.time = scattering_event.time;
+
+    if (*pdf_value == 0 || squaredDistanceBetween(light_event.position, scattering_event.position) == 0)
+    {
+        *pdf_value = 0;
+        return RadianceSpectrum(0.0f);
+    }
+
+    *incident_direction = (light_event.position - scattering_event.position).normalized();
+    *visibility_tester = VisibilityTester(scattering_event, light_event);
+
+    return emittedRadiance(light_event, -(*incident_direction));
+}
+
+inline imp_float DiffuseAreaLight::incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                                       const Vector3F& incident_direction) const
+{
+    return shape->pdfFrom(scattering_event, incident_direction);
 }
 
 inline RadianceSpectrum DiffuseAreaLight::emittedRadiance(const ScatteringEvent& scattering_event,
@@ -79,5 +116,18 @@ inline PowerSpectrum DiffuseAreaLight::emittedPower() const
     return (IMP_PI*surface_area)*emitted_radiance;
 }
 
+
+// The surface normals of a general shape may point in any direction, and emission covers the hemisphere around each normal
+inline bool DiffuseAreaLight::computeBounds(LightBounds* bounds) const
+{
+    bounds->bounding_box = shape->worldSpaceBoundingBox();
+    bounds->axis = Vector3F(0, 0, 1);
+    bounds->cos_normal_angle = -1;
+    bounds->cos_emission_angle = 0;
+    bounds->power = emittedPower().tristimulusY();
+
+    return true;
+}
+
 } // RayImpact
 } // Impact
@@ -2,7 +2,7 @@
 #include "Light.hpp"
 #include "ParameterSet.hpp"
 #include "math.hpp"
-#include <memory>
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -24,7 +24,7 @@ public:
                  const Vector3F& direction,
                  const RadianceSpectrum& radiance);
 
-    void DistantLight::preprocess(const Scene& scene);
+    void preprocess(const Scene& scene);
 
     RadianceSpectrum sampleIncidentRadiance(const ScatteringEvent& scattering_event,
                                             const Point2F& uniform_sample,
@@ -32,14 +32,23 @@ public:
                                             imp_float* pdf_value,
                                             VisibilityTester* visibility_tester) const;
 
+    RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                           const Point2F& direction_sample,
+                                           imp_float time,
+                                           Ray* emitted_ray,
+                                           Normal3F* surface_normal,
+                                           imp_float* position_pdf_value,
+                                           imp_float* direction_pdf_value) const;
+
     PowerSpectrum emittedPower() const;
 };
 
 // DistantLight function declarations
 
-std::shared_ptr<Light> createDistantLight(const Transformation& light_to_world,
-                                          const MediumInterface& medium_interface,
-                                          const ParameterSet& parameters);
+Light* createDistantLight(const Transformation& light_to_world,
+                          const MediumInterface& medium_interface,
+                          const ParameterSet& parameters,
+                          ObjectArena& arena);
 
 // DistantLight inline method definitions
 
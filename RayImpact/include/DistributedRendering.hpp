@@ -0,0 +1,98 @@
+#pragma once
+#include "precision.hpp"
+#include "TileScheduler.hpp"
+#include "socket_util.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Impact {
+namespace RayImpact {
+
+// Forward declarations
+class Sensor;
+class SensorRegion;
+
+// Part played by the process when a single image is rendered by multiple processes
+enum class DistributedRole
+{
+    None,        // Render the image alone
+    Coordinator, // Hand out tiles to worker processes and merge the returned pixels into the sensor
+    Worker       // Render the tiles handed out by a coordinator
+};
+
+// RenderCoordinator declarations
+
+/*
+Distributes the tiles of each rendering pass among worker processes connected over sockets,
+and merges the pixel values they send back into the sensor. Every worker thread uses its own
+connection, and the tile assigned to a connection that fails or times out is handed to another.
+*/
+class RenderCoordinator {
+
+private:
+
+    Sensor& sensor; // The sensor to merge the rendered pixels into
+    TileScheduler& scheduler; // Scheduler providing the tiles to hand out
+    const unsigned int n_samples_per_pixel; // Total number of samples per pixel (must match that of the workers)
+    const unsigned int n_pass_samples; // Number of samples per pixel in each pass (must match that of the workers)
+    const std::string address; // Address to listen for workers on
+    const double worker_timeout; // Number of seconds to wait for a tile before giving up on the worker (no limit if 0)
+
+    Socket listener; // Socket accepting connections from workers
+    std::thread accept_thread; // Thread accepting connections from workers
+    std::vector<std::thread> connection_threads; // Thread serving each connection
+
+    std::mutex mutex; // Mutex that must be owned when accessing the state below
+    std::condition_variable condition; // Signals changes in the state below
+    unsigned int first_sample_idx; // Index of the first sample per pixel in the current pass
+    unsigned int n_samples; // Number of samples per pixel in the current pass
+    bool pass_is_active; // Whether tiles of the current pass are being handed out
+    bool is_finished; // Whether all passes are done and the workers should be dismissed
+    unsigned int n_outstanding_tiles; // Number of tiles handed out whose results have not been merged yet
+    unsigned int n_connected_workers; // Number of connections currently being served
+
+    void acceptWorkers();
+
+    void serveWorker(Socket connection);
+
+    bool acquireTile(Tile* tile, unsigned int* tile_first_sample_idx, unsigned int* tile_n_samples);
+
+    void completeTile(const Tile& tile, bool was_merged, double cost);
+
+public:
+
+    RenderCoordinator(Sensor& sensor,
+                      TileScheduler& scheduler,
+                      unsigned int n_samples_per_pixel,
+                      unsigned int n_pass_samples,
+                      const std::string& address,
+                      double worker_timeout = 0);
+
+    ~RenderCoordinator();
+
+    bool start();
+
+    void renderPass(unsigned int pass_first_sample_idx, unsigned int pass_n_samples);
+
+    void finish();
+};
+
+// Distributed rendering function declarations
+
+void runRenderWorker(const std::string& address,
+                     const Sensor& sensor,
+                     unsigned int n_samples_per_pixel,
+                     unsigned int n_pass_samples,
+                     const std::function<std::unique_ptr<SensorRegion> (const Tile&, unsigned int, unsigned int)>& render_tile);
+
+bool parseDistributedRole(const std::string& name, DistributedRole* role);
+
+const char* distributedRoleName(DistributedRole role);
+
+} // RayImpact
+} // Impact
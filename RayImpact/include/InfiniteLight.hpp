@@ -0,0 +1,100 @@
+#pragma once
+#include "Light.hpp"
+#include "ParameterSet.hpp"
+#include "math.hpp"
+#include "sampling.hpp"
+#include "ObjectArena.hpp"
+#include <vector>
+#include <memory>
+
+namespace Impact {
+namespace RayImpact {
+
+// InfiniteLight declarations
+
+/*
+Light surrounding the scene at an infinite distance, with the radiance arriving from each direction given by
+a latitude-longitude radiance map. The u-coordinate of the map corresponds to the spherical phi-coordinate of
+the light space direction and the v-coordinate to the theta-coordinate, so that the top row of the map lies
+around the light space z-axis. Incident directions are sampled from a piecewise-constant distribution over the
+map texels, weighted by their radiance and by sin(theta) to account for the compression of the texels towards
+the poles, so that bright regions like the sun are sampled in proportion to their contribution.
+*/
+class InfiniteLight : public Light {
+
+private:
+
+    const RadianceSpectrum radiance_scale; // Scale factor for the radiance values of the map
+    const unsigned int map_width; // Number of texels in the phi-direction of the radiance map
+    const unsigned int map_height; // Number of texels in the theta-direction of the radiance map
+    std::vector<RadianceSpectrum> radiance_map; // Radiance of each texel, row by row from theta = 0
+    std::unique_ptr<DistributionFunction2D> distribution; // Distribution for sampling texels of the map
+    RadianceSpectrum integrated_radiance; // Integral of the radiance over all directions
+    Point3F scene_center; // Center of scene bounding sphere
+    imp_float scene_radius; // Radius of scene bounding sphere
+
+    RadianceSpectrum lookupRadiance(const Point2F& map_point) const;
+
+    Vector3F mapPointToDirection(const Point2F& map_point, imp_float* sin_theta) const;
+
+    Point2F directionToMapPoint(const Vector3F& direction, imp_float* sin_theta) const;
+
+public:
+
+    InfiniteLight(const Transformation& light_to_world,
+                  const RadianceSpectrum& radiance_scale,
+                  const imp_float* rgb_values,
+                  unsigned int map_width,
+                  unsigned int map_height,
+                  unsigned int n_samples);
+
+    void preprocess(const Scene& scene);
+
+    RadianceSpectrum sampleIncidentRadiance(const ScatteringEvent& scattering_event,
+                                            const Point2F& uniform_sample,
+                                            Vector3F* incident_direction,
+                                            imp_float* pdf_value,
+                                            VisibilityTester* visibility_tester) const;
+
+    imp_float incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                  const Vector3F& incident_direction) const;
+
+    RadianceSpectrum emittedRadianceFromDirection(const RayWithOffsets& ray) const;
+
+    RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                           const Point2F& direction_sample,
+                                           imp_float time,
+                                           Ray* emitted_ray,
+                                           Normal3F* surface_normal,
+                                           imp_float* position_pdf_value,
+                                           imp_float* direction_pdf_value) const;
+
+    PowerSpectrum emittedPower() const;
+};
+
+// InfiniteLight function declarations
+
+Light* createInfiniteLight(const Transformation& light_to_world,
+                           const MediumInterface& medium_interface,
+                           const ParameterSet& parameters,
+                           ObjectArena& arena);
+
+// InfiniteLight inline method definitions
+
+// Returns the radiance of the texel containing the given point in the unit square
+inline RadianceSpectrum InfiniteLight::lookupRadiance(const Point2F& map_point) const
+{
+    unsigned int i = (unsigned int)clamp((int)(map_point.x*map_width), 0, (int)map_width - 1);
+    unsigned int j = (unsigned int)clamp((int)(map_point.y*map_height), 0, (int)map_height - 1);
+
+    return radiance_map[j*map_width + i];
+}
+
+// The power is that of the radiance entering the scene bounding sphere through its cross-section
+inline PowerSpectrum InfiniteLight::emittedPower() const
+{
+    return (IMP_PI*scene_radius*scene_radius)*integrated_radiance;
+}
+
+} // RayImpact
+} // Impact
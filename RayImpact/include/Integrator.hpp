@@ -6,7 +6,11 @@
 #include "Spectrum.hpp"
 #include "Ray.hpp"
 #include "ScatteringEvent.hpp"
+#include "TileScheduler.hpp"
+#include "BSDF.hpp"
+#include "ShadowRayBatch.hpp"
 #include <memory>
+#include <vector>
 
 namespace Impact {
 namespace RayImpact {
@@ -27,12 +31,46 @@ class SampleIntegrator : public Integrator {
 
 private:
 
-    std::shared_ptr<Sampler> sampler; // The sample generator used by the integrator
+    bool findTileLights(const Scene& scene, const Tile& tile, std::vector<Light*>* tile_lights) const;
+
+    std::unique_ptr<SensorRegion> renderTileWithPackets(const Scene& scene,
+                                                        const Tile& tile,
+                                                        unsigned int first_sample_idx,
+                                                        unsigned int n_samples,
+                                                        imp_float error_threshold);
 
 protected:
 
+    std::shared_ptr<Sampler> sampler; // The sample generator used by the integrator
     std::shared_ptr<const Camera> camera; // The camera providing eye rays and holding the sensor with the final image
 
+    virtual std::unique_ptr<SensorRegion> renderTile(const Scene& scene,
+                                                     const Tile& tile,
+                                                     unsigned int first_sample_idx,
+                                                     unsigned int n_samples,
+                                                     imp_float error_threshold = 0);
+
+    virtual bool supportsRayPackets() const;
+
+    virtual bool usesTileLightLists() const;
+
+    virtual RadianceSpectrum incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                              SurfaceScatteringEvent* scattering_event,
+                                                              const Scene& scene,
+                                                              Sampler& sampler,
+                                                              RegionAllocator& allocator,
+                                                              unsigned int scattering_count = 0,
+                                                              ShadowRayBatch* shadow_ray_batch = nullptr,
+                                                              const std::vector<Light*>* tile_lights = nullptr,
+                                                              OccluderCache* occluder_cache = nullptr) const;
+
+    bool specularlyScatteredRay(const RayWithOffsets& outgoing_ray,
+                                const SurfaceScatteringEvent& scattering_event,
+                                BXDFType type,
+                                const Point2F& uniform_sample,
+                                RayWithOffsets* incident_ray,
+                                Spectrum* weight) const;
+
 public:
 
     SampleIntegrator(std::shared_ptr<const Camera> camera,
@@ -44,36 +82,61 @@ public:
                                               const Scene& scene,
                                               Sampler& sampler,
                                               RegionAllocator& allocator,
-                                              unsigned int scattering_count = 0) const = 0;
+                                              unsigned int scattering_count = 0,
+                                              OccluderCache* occluder_cache = nullptr) const = 0;
 
     RadianceSpectrum specularlyReflectedRadiance(const RayWithOffsets& outgoing_ray,
                                                  const SurfaceScatteringEvent& scattering_event,
                                                  const Scene& scene,
                                                  Sampler& sampler,
                                                  RegionAllocator& allocator,
-                                                 unsigned int scattering_count) const;
+                                                 unsigned int scattering_count,
+                                                 OccluderCache* occluder_cache = nullptr) const;
 
     RadianceSpectrum specularlyTransmittedRadiance(const RayWithOffsets& outgoing_ray,
                                                    const SurfaceScatteringEvent& scattering_event,
                                                    const Scene& scene,
                                                    Sampler& sampler,
                                                    RegionAllocator& allocator,
-                                                   unsigned int scattering_count) const;
+                                                   unsigned int scattering_count,
+                                                   OccluderCache* occluder_cache = nullptr) const;
 
     void render(const Scene& scene);
 
 	void renderSinglePixel(const Scene& scene, const Point2I& single_pixel);
 };
 
+// Integrator function declarations
+
+void beginPixelSamples(Sampler& sampler,
+                       const BoundingRectangleI& sampling_bounds,
+                       const Point2I& pixel,
+                       unsigned int first_sample_idx);
+
 // SampleIntegrator inline method definitions
 
 inline SampleIntegrator::SampleIntegrator(std::shared_ptr<const Camera> camera,
 										  std::shared_ptr<Sampler> sampler)
-    : camera(camera), sampler(sampler)
+    : sampler(sampler), camera(camera)
 {}
 
 inline void SampleIntegrator::preprocess(const Scene& scene, Sampler& sampler)
 {}
 
+// Whether the integrator overrides incidentRadianceFromIntersection, so that the intersections
+// of eye rays can be found in packets and shadow rays can be batched for each tile
+inline bool SampleIntegrator::supportsRayPackets() const
+{
+    return false;
+}
+
+// Whether the integrator can make use of a list of the lights that may illuminate the eye ray intersections in a
+// tile, so that such a list should be built for each tile rendered with ray packets and passed to
+// incidentRadianceFromIntersection
+inline bool SampleIntegrator::usesTileLightLists() const
+{
+    return false;
+}
+
 } // RayImpact
 } // Impact
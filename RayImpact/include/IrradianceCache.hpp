@@ -0,0 +1,125 @@
+#pragma once
+#include "precision.hpp"
+#include "geometry.hpp"
+#include "Spectrum.hpp"
+#include "BoundingBox.hpp"
+#include "RegionAllocator.hpp"
+#include <atomic>
+#include <mutex>
+
+namespace Impact {
+namespace RayImpact {
+
+// IrradianceCache declarations
+
+/*
+Cache of irradiance values at surface points, for reusing expensive hemisphere gathers of indirect
+irradiance on diffuse surfaces (Ward et al. 1988). Each record holds the irradiance gathered at a point
+together with its rotational and translational gradients (Ward & Heckbert 1992) and a validity radius
+given by the harmonic mean distance to the surfaces seen from the point. The irradiance at a new point is
+interpolated from the records whose estimated error there is below the error tolerance, extrapolated with
+their gradients. The records are stored in an octree, where each record is added to the nodes overlapping
+its region of validity that are about the same size as that region. Records and octree nodes are linked
+into the tree without locks, so any number of threads can look up and add records concurrently. Only their
+allocation from the tracked region allocator of the cache is serialized. Records are never removed.
+*/
+class IrradianceCache {
+
+private:
+
+    // Irradiance gathered at a surface point
+    struct IrradianceRecord
+    {
+        Point3F position; // Position where the irradiance was gathered
+        Vector3F surface_normal; // Normal of the hemisphere the irradiance was gathered over
+        IrradianceSpectrum irradiance; // The gathered irradiance
+        Vector3F rotational_gradients[Spectrum::n_coefficients]; // Change of each irradiance coefficient with rotation of the normal
+        Vector3F translational_gradients[Spectrum::n_coefficients]; // Change of each irradiance coefficient with translation of the position
+        imp_float radius; // Validity radius of the record
+    };
+
+    // Entry in the list of records of an octree node
+    struct RecordNode
+    {
+        const IrradianceRecord* record; // The record
+        RecordNode* next; // Next entry in the list (null if this is the last entry)
+    };
+
+    // Node of the octree
+    struct OctreeNode
+    {
+        std::atomic<OctreeNode*> children[8]; // Child nodes for each octant (null until a record is added to it)
+        std::atomic<RecordNode*> records; // Records stored in the node
+
+        OctreeNode();
+    };
+
+    static constexpr unsigned int max_depth = 16; // Maximum depth of the octree
+
+    const BoundingBoxF bounds; // Region covered by the root node of the octree
+    const imp_float error_tolerance; // Largest estimated error for which a record can be used for interpolation
+    const imp_float min_radius; // Smallest validity radius of a record
+    const imp_float max_radius; // Largest validity radius of a record
+
+    OctreeNode root; // Root node of the octree
+    RegionAllocator allocator; // Allocator for the records and octree nodes
+    std::mutex allocator_mutex; // Mutex for avoiding simultaneous allocations by different threads
+
+    void addRecordToNode(OctreeNode* node,
+                         const BoundingBoxF& node_bounds,
+                         const IrradianceRecord* record,
+                         const BoundingBoxF& record_bounds,
+                         unsigned int depth);
+
+    void* allocate(size_t n_bytes);
+
+    static BoundingBoxF octantBounds(const BoundingBoxF& node_bounds, unsigned int octant_idx);
+
+public:
+
+    IrradianceCache(const BoundingBoxF& bounds,
+                    imp_float error_tolerance,
+                    imp_float min_radius,
+                    imp_float max_radius);
+
+    IrradianceCache(const IrradianceCache& other) = delete;
+    IrradianceCache& operator=(const IrradianceCache& other) = delete;
+
+    bool interpolatedIrradiance(const Point3F& position,
+                                const Vector3F& surface_normal,
+                                IrradianceSpectrum* irradiance) const;
+
+    IrradianceSpectrum addRecord(const Point3F& position,
+                                 const Vector3F& x_axis,
+                                 const Vector3F& y_axis,
+                                 const Vector3F& surface_normal,
+                                 unsigned int n_theta_strata,
+                                 unsigned int n_phi_strata,
+                                 const RadianceSpectrum* radiances,
+                                 const imp_float* distances);
+};
+
+// IrradianceCache inline method definitions
+
+inline IrradianceCache::OctreeNode::OctreeNode()
+    : records(nullptr)
+{
+    for (unsigned int octant_idx = 0; octant_idx < 8; octant_idx++)
+        children[octant_idx].store(nullptr, std::memory_order_relaxed);
+}
+
+// Returns the bounds of the given octant of a node with the given bounds
+inline BoundingBoxF IrradianceCache::octantBounds(const BoundingBoxF& node_bounds, unsigned int octant_idx)
+{
+    const Point3F& center = node_bounds.lower_corner + node_bounds.diagonal()*0.5f;
+
+    return BoundingBoxF(Point3F((octant_idx & 1)? center.x : node_bounds.lower_corner.x,
+                                (octant_idx & 2)? center.y : node_bounds.lower_corner.y,
+                                (octant_idx & 4)? center.z : node_bounds.lower_corner.z),
+                        Point3F((octant_idx & 1)? node_bounds.upper_corner.x : center.x,
+                                (octant_idx & 2)? node_bounds.upper_corner.y : center.y,
+                                (octant_idx & 4)? node_bounds.upper_corner.z : center.z));
+}
+
+} // RayImpact
+} // Impact
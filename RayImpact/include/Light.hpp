@@ -6,14 +6,19 @@
 #include "Spectrum.hpp"
 #include "ScatteringEvent.hpp"
 #include "Sampler.hpp"
+#include "BoundingBox.hpp"
 #include "error.hpp"
 #include <algorithm>
+#include <unordered_map>
 
 namespace Impact {
 namespace RayImpact {
 
 // Forward declarations
 class Scene;
+class Model;
+class Light;
+class OccluderCache;
 
 // VisibilityTester declarations
 
@@ -34,11 +39,55 @@ public:
     const ScatteringEvent& startPoint() const;
     const ScatteringEvent& endPoint() const;
 
+    Ray shadowRay() const;
+
     bool beamIsUnobstructed(const Scene& scene) const;
 
+    bool beamIsUnobstructed(const Scene& scene,
+                            const Light* light,
+                            OccluderCache* occluder_cache) const;
+
     TransmissionSpectrum beamTransmittance(const Scene& scene, Sampler& sampler) const;
 };
 
+// OccluderCache declarations
+
+/*
+Remembers the model that most recently occluded a shadow ray towards each light. Shadow rays from nearby
+points towards the same light are often blocked by the same model, so testing that model first frequently
+proves a ray occluded without traversing the scene. A hit on the cached model is always a real occlusion,
+so the cache never changes the outcome of a visibility test. Each thread keeps its own cache for the tile
+it is rendering.
+*/
+class OccluderCache {
+
+private:
+
+    std::unordered_map<const Light*, const Model*> occluders; // The model that last occluded a shadow ray towards each light
+
+public:
+
+    OccluderCache();
+
+    const Model* cachedOccluder(const Light* light) const;
+
+    void update(const Light* light, const Model* occluder);
+
+    void clear();
+};
+
+// LightBounds declarations
+
+// Bounds on the positions and directions from which a light emits, used for building light hierarchies
+struct LightBounds
+{
+    BoundingBoxF bounding_box; // Bounds on the emitting positions
+    Vector3F axis; // Central direction of the cone bounding the surface normals of the emitter
+    imp_float cos_normal_angle; // Cosine of the angle between the axis and the normal cone surface
+    imp_float cos_emission_angle; // Cosine of the largest angle between a normal and an emitted direction
+    imp_float power; // Scalar measure of the emitted power
+};
+
 // Light declarations
 
 enum LightFlags
@@ -77,9 +126,24 @@ public:
                                                     imp_float* pdf_value,
                                                     VisibilityTester* visibility_tester) const = 0;
 
+    virtual imp_float incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                          const Vector3F& incident_direction) const;
+
     virtual RadianceSpectrum emittedRadianceFromDirection(const RayWithOffsets& ray) const;
 
+    virtual RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                                   const Point2F& direction_sample,
+                                                   imp_float time,
+                                                   Ray* emitted_ray,
+                                                   Normal3F* surface_normal,
+                                                   imp_float* position_pdf_value,
+                                                   imp_float* direction_pdf_value) const;
+
     virtual PowerSpectrum emittedPower() const = 0;
+
+    virtual bool computeBounds(LightBounds* bounds) const;
+
+    virtual bool mayIlluminate(const BoundingBoxF& region) const;
 };
 
 // AreaLight declarations
@@ -127,11 +191,52 @@ inline Light::Light(LightFlags flags,
 inline void Light::preprocess(const Scene& scene)
 {}
 
+// Computes bounds on the emission of the light and returns whether it has any. Lights
+// that emit from infinitely far away have no bounds, which is the default.
+inline bool Light::computeBounds(LightBounds* bounds) const
+{
+    return false;
+}
+
+// Returns false only if the light can not illuminate any point inside the given region.
+// The default implementation assumes that every point may be illuminated.
+inline bool Light::mayIlluminate(const BoundingBoxF& region) const
+{
+    return true;
+}
+
+// Returns the probability density with respect to solid angle of sampleIncidentRadiance choosing the given
+// incident direction. Lights with a delta distribution can never be sampled from other directions, so the
+// default implementation returns zero.
+inline imp_float Light::incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                            const Vector3F& incident_direction) const
+{
+    return 0;
+}
+
 inline RadianceSpectrum Light::emittedRadianceFromDirection(const RayWithOffsets& ray) const
 {
     return RadianceSpectrum(0.0f);
 }
 
+// Samples a ray leaving the light, for tracing light paths from the light into the scene, and returns the radiance
+// carried by the ray (or the intensity for lights with a delta position). The surface normal at the origin of the ray
+// is returned along with the probability densities of the origin (with respect to area) and the direction (with respect
+// to solid angle). Lights with a delta position or direction give a density of one for the delta part. The default
+// implementation is for lights that can not be sampled this way, and returns zero densities.
+inline RadianceSpectrum Light::sampleEmittedRadiance(const Point2F& position_sample,
+                                                     const Point2F& direction_sample,
+                                                     imp_float time,
+                                                     Ray* emitted_ray,
+                                                     Normal3F* surface_normal,
+                                                     imp_float* position_pdf_value,
+                                                     imp_float* direction_pdf_value) const
+{
+    *position_pdf_value = 0;
+    *direction_pdf_value = 0;
+    return RadianceSpectrum(0.0f);
+}
+
 // AreaLight inline method definitions
 
 inline AreaLight::AreaLight(LightFlags flags,
@@ -147,6 +252,29 @@ inline AreaLight::AreaLight(const Transformation& light_to_world,
     : Light::Light(LightFlags(LIGHT_HAS_AREA), light_to_world, medium_interface, n_samples)
 {}
 
+// OccluderCache inline method definitions
+
+inline OccluderCache::OccluderCache()
+    : occluders()
+{}
+
+// Returns the model that last occluded a shadow ray towards the given light, or null if there is none
+inline const Model* OccluderCache::cachedOccluder(const Light* light) const
+{
+    auto iter = occluders.find(light);
+    return (iter != occluders.end())? iter->second : nullptr;
+}
+
+inline void OccluderCache::update(const Light* light, const Model* occluder)
+{
+    occluders[light] = occluder;
+}
+
+inline void OccluderCache::clear()
+{
+    occluders.clear();
+}
+
 // VisibilityTester inline method definitions
 
 inline VisibilityTester::VisibilityTester()
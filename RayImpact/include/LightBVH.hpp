@@ -0,0 +1,89 @@
+#pragma once
+#include "LightSelector.hpp"
+#include "Light.hpp"
+#include "Scene.hpp"
+#include "ScatteringEvent.hpp"
+#include "BoundingBox.hpp"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace Impact {
+namespace RayImpact {
+
+// LightBVH declarations
+
+/*
+Binary hierarchy over the lights in a scene, where each node stores the bounding box, normal cone
+and total power of the lights below it. A light is selected by descending from the root and
+choosing each child with probability proportional to an upper bound on the importance of its lights
+for the scattering event, which accounts for distance, the orientation of the emitters and the
+orientation of the receiving surface. Lights without bounds (infinite lights) are kept outside the
+hierarchy and selected uniformly, with the same probability as the hierarchy as a whole.
+*/
+class LightBVH : public LightSelector {
+
+private:
+
+    // A node in the hierarchy. The first child of an interior node immediately follows it.
+    struct Node
+    {
+        LightBounds bounds; // Bounds on the emission of all lights below the node
+        unsigned int second_child_or_light_idx; // Index of the second child node, or of the light if the node is a leaf
+        bool is_leaf; // Whether the node contains a single light
+    };
+
+    // A bounded light to be placed in the hierarchy
+    struct BuildLight
+    {
+        unsigned int light_idx; // Index of the light in the list of bounded lights
+        LightBounds bounds; // Bounds on the emission of the light
+        Point3F centroid; // Center of the bounding box of the light
+    };
+
+    std::vector<const Light*> bounded_lights; // Lights contained in the hierarchy
+    std::vector<const Light*> infinite_lights; // Lights outside the hierarchy
+    std::vector<Node> nodes; // Nodes of the hierarchy in depth-first order
+    std::unordered_map<const Light*, uint64_t> light_bit_trails; // Path to the leaf of each light in the hierarchy (bit i is set if the second child is taken at depth i)
+
+    unsigned int buildNodes(std::vector<BuildLight>& build_lights,
+                            unsigned int start_idx,
+                            unsigned int end_idx,
+                            uint64_t bit_trail,
+                            unsigned int depth);
+
+    imp_float hierarchyProbability() const;
+
+public:
+
+    LightBVH(const std::vector<Light*>& lights);
+
+    const Light* selectLight(const ScatteringEvent& scattering_event,
+                             imp_float uniform_sample,
+                             imp_float* selection_probability) const;
+
+    imp_float selectionProbability(const ScatteringEvent& scattering_event,
+                                   const Light* light) const;
+};
+
+// LightBVH function declarations
+
+LightBounds unionOf(const LightBounds& bounds_1, const LightBounds& bounds_2);
+
+imp_float lightImportance(const LightBounds& bounds,
+                          const Point3F& position,
+                          const Normal3F& surface_normal);
+
+// LightBVH inline method definitions
+
+// Returns the probability of selecting a light from the hierarchy rather than one of the infinite lights
+inline imp_float LightBVH::hierarchyProbability() const
+{
+    if (nodes.empty())
+        return 0;
+
+    return 1.0f/(infinite_lights.size() + 1);
+}
+
+} // RayImpact
+} // Impact
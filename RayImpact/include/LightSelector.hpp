@@ -0,0 +1,124 @@
+#pragma once
+#include "precision.hpp"
+#include "Light.hpp"
+#include "Scene.hpp"
+#include "ScatteringEvent.hpp"
+#include "sampling.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace Impact {
+namespace RayImpact {
+
+// LightSelector declarations
+
+// Strategies for choosing which lights to sample at a scattering event
+enum class LightSelectionStrategy
+{
+    ALL, // Sample every light
+    UNIFORM, // Select lights with equal probability
+    POWER, // Select lights with probability proportional to their emitted power
+    BVH // Select lights by descending a light hierarchy according to their estimated importance
+};
+
+/*
+Randomly selects lights to sample at a scattering event, so that the cost of estimating the direct
+radiance does not grow with the number of lights. A contribution found by sampling a selected
+light must be divided by the probability of selecting it.
+*/
+class LightSelector {
+
+public:
+
+    virtual ~LightSelector() {}
+
+    virtual const Light* selectLight(const ScatteringEvent& scattering_event,
+                                     imp_float uniform_sample,
+                                     imp_float* selection_probability) const = 0;
+
+    virtual imp_float selectionProbability(const ScatteringEvent& scattering_event,
+                                           const Light* light) const = 0;
+};
+
+// UniformLightSelector declarations
+
+class UniformLightSelector : public LightSelector {
+
+private:
+
+    const std::vector<Light*> lights; // The lights to select from
+
+public:
+
+    UniformLightSelector(const std::vector<Light*>& lights);
+
+    const Light* selectLight(const ScatteringEvent& scattering_event,
+                             imp_float uniform_sample,
+                             imp_float* selection_probability) const;
+
+    imp_float selectionProbability(const ScatteringEvent& scattering_event,
+                                   const Light* light) const;
+};
+
+// PowerLightSelector declarations
+
+class PowerLightSelector : public LightSelector {
+
+private:
+
+    const std::vector<Light*> lights; // The lights to select from
+    std::unordered_map<const Light*, unsigned int> light_indices; // Index of each light in the list of lights
+    DistributionFunction1D power_distribution; // Distribution of emitted power over the lights
+    bool has_power; // Whether any of the lights emits power
+
+public:
+
+    PowerLightSelector(const std::vector<Light*>& lights);
+
+    const Light* selectLight(const ScatteringEvent& scattering_event,
+                             imp_float uniform_sample,
+                             imp_float* selection_probability) const;
+
+    imp_float selectionProbability(const ScatteringEvent& scattering_event,
+                                   const Light* light) const;
+};
+
+// LightSelector function declarations
+
+LightSelectionStrategy lightSelectionStrategyFromName(const std::string& strategy_name);
+
+LightSelector* createLightSelector(LightSelectionStrategy strategy,
+                                   const Scene& scene);
+
+// UniformLightSelector inline method definitions
+
+inline UniformLightSelector::UniformLightSelector(const std::vector<Light*>& lights)
+    : lights(lights)
+{}
+
+inline const Light* UniformLightSelector::selectLight(const ScatteringEvent& scattering_event,
+                                                      imp_float uniform_sample,
+                                                      imp_float* selection_probability) const
+{
+    if (lights.empty())
+    {
+        *selection_probability = 0;
+        return nullptr;
+    }
+
+    unsigned int n_lights = (unsigned int)lights.size();
+
+    *selection_probability = 1.0f/n_lights;
+
+    return lights[std::min((unsigned int)(uniform_sample*n_lights), n_lights - 1)];
+}
+
+inline imp_float UniformLightSelector::selectionProbability(const ScatteringEvent& scattering_event,
+                                                            const Light* light) const
+{
+    return (lights.empty())? 0 : 1.0f/lights.size();
+}
+
+} // RayImpact
+} // Impact
@@ -47,6 +47,8 @@ inline MixedTexture<T>::MixedTexture(const std::shared_ptr< Texture<T> >& textur
 template <typename T>
 inline T MixedTexture<T>::evaluate(const SurfaceScatteringEvent& scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_texture_evaluations);
+
     imp_float texture_2_weight = mixing_ratio->evaluate(scattering_event);
 
     return (1 - texture_2_weight)*texture_1->evaluate(scattering_event) + texture_2_weight*texture_2->evaluate(scattering_event);
@@ -4,17 +4,22 @@
 #include "RegionAllocator.hpp"
 #include "BoundingBox.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
 #include "Transformation.hpp"
 #include "AnimatedTransformation.hpp"
 #include "ScatteringEvent.hpp"
 #include "Shape.hpp"
 #include "Material.hpp"
 #include "Light.hpp"
-#include <memory>
+#include "statistics.hpp"
 
 namespace Impact {
 namespace RayImpact {
 
+// Model statistics variables
+
+IMP_STAT_EXTERN(n_primitive_tests);
+
 // Model declarations
 
 class Model {
@@ -28,6 +33,14 @@ public:
 
     virtual bool hasIntersection(const Ray& ray) const = 0;
 
+    virtual void intersectPacket(const RayPacket& packet,
+                                 SurfaceScatteringEvent* scattering_events,
+                                 bool* has_intersections) const;
+
+    virtual uint32_t hasIntersectionPacket(const RayPacket& packet) const;
+
+    virtual const Model* occludingModel(const Ray& ray) const;
+
     virtual const AreaLight* getAreaLight() const = 0;
 
     virtual const Material* getMaterial() const = 0;
@@ -44,16 +57,16 @@ class GeometricModel : public Model {
 
 private:
 
-    std::shared_ptr<Shape> shape; // The shape associated with the model
-    std::shared_ptr<Material> material; // The material associated with the model
-    std::shared_ptr<AreaLight> area_light; // The area light (if any) associated with the model
+    const Shape* shape; // The shape associated with the model
+    const Material* material; // The material associated with the model
+    const AreaLight* area_light; // The area light (if any) associated with the model
     MediumInterface medium_interface; // The interface between the media on the inside and the outside of the model
 
 public:
 
-    GeometricModel(const std::shared_ptr<Shape>& shape,
-                   const std::shared_ptr<Material>& material,
-                   const std::shared_ptr<AreaLight>& area_light,
+    GeometricModel(const Shape* shape,
+                   const Material* material,
+                   const AreaLight* area_light,
                    const MediumInterface& medium_interface);
 
     BoundingBoxF worldSpaceBoundingBox() const;
@@ -79,12 +92,12 @@ class TransformedModel : public Model {
 
 private:
 
-    std::shared_ptr<Model> model; // The underlying model for the transformed model
+    const Model* model; // The underlying model for the transformed model
     const AnimatedTransformation model_to_world; // The transformation from the shape's notion of world space to actual world space
 
 public:
 
-    TransformedModel(const std::shared_ptr<Model>& model,
+    TransformedModel(const Model* model,
                      const AnimatedTransformation& model_to_world);
 
     BoundingBoxF worldSpaceBoundingBox() const;
@@ -122,9 +135,9 @@ public:
 
 // GeometricModel inline method definitions
 
-inline GeometricModel::GeometricModel(const std::shared_ptr<Shape>& shape,
-									  const std::shared_ptr<Material>& material,
-									  const std::shared_ptr<AreaLight>& area_light,
+inline GeometricModel::GeometricModel(const Shape* shape,
+									  const Material* material,
+									  const AreaLight* area_light,
 									  const MediumInterface& medium_interface)
     : shape(shape),
       material(material),
@@ -139,17 +152,18 @@ inline BoundingBoxF GeometricModel::worldSpaceBoundingBox() const
 
 inline bool GeometricModel::hasIntersection(const Ray& ray) const
 {
+    IMP_STAT_INCREMENT(n_primitive_tests);
     return shape->hasIntersection(ray);
 }
 
 inline const AreaLight* GeometricModel::getAreaLight() const
 {
-    return area_light.get();
+    return area_light;
 }
 
 inline const Material* GeometricModel::getMaterial() const
 {
-    return material.get();
+    return material;
 }
 
 inline void GeometricModel::generateBSDF(SurfaceScatteringEvent* scattering_event,
@@ -166,7 +180,7 @@ inline void GeometricModel::generateBSDF(SurfaceScatteringEvent* scattering_even
 
 // TransformedModel inline method definitions
 
-inline TransformedModel::TransformedModel(const std::shared_ptr<Model>& model,
+inline TransformedModel::TransformedModel(const Model* model,
 										  const AnimatedTransformation& model_to_world)
     : model(model),
       model_to_world(model_to_world)
@@ -32,6 +32,10 @@ public:
 
     imp_float generateRayWithOffsets(const CameraSample& sample,
                                      RayWithOffsets* ray) const;
+
+    bool computeViewBounds(const BoundingRectangleF& raster_bounds,
+                           const BoundingBoxF& scene_bounds,
+                           BoundingBoxF* view_bounds) const;
 };
 
 // OrthographicCamera function declarations
@@ -0,0 +1,216 @@
+#pragma once
+#include "Integrator.hpp"
+#include "ParameterSet.hpp"
+#include "LightSelector.hpp"
+#include "IrradianceCache.hpp"
+#include "SDTree.hpp"
+#include "math.hpp"
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// PathIntegrator declarations
+
+/*
+Unidirectional path tracer. At each scattering event along a path, the direct radiance from
+every light is estimated by sampling the light, and the path is continued in a direction sampled
+from the BSDF. Radiance emitted from lights that the continued path hits is combined with the
+light samples using multiple importance sampling with the power heuristic. After a given number
+of scatterings, paths with low throughput are terminated by Russian roulette. For scenes with many
+lights, a light selector can be used to sample only a few randomly selected lights at each event.
+Optionally, the indirect radiance at the first scattering event of camera paths on purely diffuse
+surfaces is computed from an irradiance cache rather than by continuing the path. Missing cache
+records are created on demand by gathering the indirect radiance over the hemisphere with paths
+traced by the integrator itself. The path is still continued by one BSDF sample to pick up radiance
+emitted directly from lights, so that it can be combined with the light samples as usual.
+Paths can also be guided by a distribution of incident radiance learned in an SD-tree over a number of
+training passes before rendering. At scattering events without specular components, the direction is then
+sampled either from the BSDF or from the learned distribution, and the combined probability density is used
+both for the path throughput and for the multiple importance sampling weights.
+*/
+class PathIntegrator : public SampleIntegrator {
+
+private:
+
+    // Scattering event along a path where incident radiance will be recorded into the path guide
+    struct GuidedVertex
+    {
+        Point3F position; // Position of the scattering event
+        Vector3F incident_direction; // Sampled direction that the path was continued in
+        imp_float pdf_value; // Probability density of the sampled direction
+        Spectrum path_throughput; // Path throughput after the scattering event
+        RadianceSpectrum previous_radiance; // Radiance gathered along the path before the path was continued
+    };
+
+    const unsigned int max_scattering_count; // Maximum number of scatterings along each path
+    const unsigned int roulette_scattering_count; // Number of scatterings after which paths may be terminated by Russian roulette
+    const LightSelectionStrategy light_selection_strategy; // Strategy for choosing which lights to sample at each scattering event
+    const unsigned int n_selected_lights; // Number of lights to select at each scattering event (unless all lights are sampled)
+    std::unique_ptr<LightSelector> light_selector; // Selects the lights to sample (null if all lights are sampled)
+    const bool use_irradiance_cache; // Whether to use an irradiance cache for indirect radiance on diffuse surfaces
+    const unsigned int n_irradiance_theta_strata; // Number of theta strata for the gathers of the irradiance cache records
+    const unsigned int n_irradiance_phi_strata; // Number of phi strata for the gathers of the irradiance cache records
+    const imp_float irradiance_error_tolerance; // Largest estimated error for interpolating irradiance cache records
+    const imp_float min_irradiance_radius; // Smallest validity radius of an irradiance cache record, relative to the scene radius
+    const imp_float max_irradiance_radius; // Largest validity radius of an irradiance cache record, relative to the scene radius
+    std::unique_ptr<IrradianceCache> irradiance_cache; // Cache of indirect irradiance (null if not used)
+    const bool use_path_guiding; // Whether to guide paths with a learned distribution of incident radiance
+    const unsigned int n_guide_training_passes; // Number of passes for learning the path guiding distribution
+    const imp_float bsdf_sampling_fraction; // Probability of sampling the BSDF rather than the path guide at guided events
+    std::unique_ptr<SDTree> path_guide; // Learned distribution of incident radiance (null if not used)
+    bool path_guide_is_training; // Whether radiance estimates are currently being recorded into the path guide
+
+    RadianceSpectrum sampledDirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                           const Scene& scene,
+                                           Sampler& sampler,
+                                           const Spectrum& path_throughput,
+                                           const DirectionalQuadtree* guide_distribution,
+                                           ShadowRayBatch* shadow_ray_batch,
+                                           OccluderCache* occluder_cache,
+                                           bool* used_sample_arrays) const;
+
+    RadianceSpectrum sampledLightRadiance(const Light& light,
+                                          const SurfaceScatteringEvent& scattering_event,
+                                          const Point2F& uniform_sample,
+                                          unsigned int n_light_samples,
+                                          imp_float selection_probability,
+                                          const Scene& scene,
+                                          const Spectrum& path_throughput,
+                                          const DirectionalQuadtree* guide_distribution,
+                                          ShadowRayBatch* shadow_ray_batch,
+                                          OccluderCache* occluder_cache) const;
+
+    imp_float emittedRadianceWeight(const Light& light,
+                                    const Sampler& sampler,
+                                    bool used_light_sample_arrays,
+                                    const ScatteringEvent& previous_scattering_event,
+                                    const Vector3F& incident_direction,
+                                    imp_float bsdf_pdf_value) const;
+
+    const DirectionalQuadtree* guideDistribution(const SurfaceScatteringEvent& scattering_event) const;
+
+    Spectrum sampledScatteringDirection(const SurfaceScatteringEvent& scattering_event,
+                                        const DirectionalQuadtree* guide_distribution,
+                                        Sampler& sampler,
+                                        Vector3F* incident_direction,
+                                        imp_float* pdf_value,
+                                        BXDFType* sampled_type) const;
+
+    imp_float scatteringPDF(const SurfaceScatteringEvent& scattering_event,
+                            const Vector3F& incident_direction,
+                            const DirectionalQuadtree* guide_distribution) const;
+
+    void recordGuidedVertices(const GuidedVertex* guided_vertices,
+                              unsigned int n_guided_vertices,
+                              const RadianceSpectrum& total_radiance) const;
+
+    void trainPathGuide(const Scene& scene);
+
+    bool usesIrradianceCache(const SurfaceScatteringEvent& scattering_event) const;
+
+    RadianceSpectrum cachedIndirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                            const Scene& scene,
+                                            Sampler& sampler,
+                                            RegionAllocator& allocator,
+                                            OccluderCache* occluder_cache) const;
+
+    IrradianceSpectrum gatheredIndirectIrradiance(const SurfaceScatteringEvent& scattering_event,
+                                                  const Vector3F& surface_normal,
+                                                  const Scene& scene,
+                                                  Sampler& sampler,
+                                                  RegionAllocator& allocator,
+                                                  OccluderCache* occluder_cache) const;
+
+protected:
+
+    bool supportsRayPackets() const;
+
+    RadianceSpectrum incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                      SurfaceScatteringEvent* scattering_event,
+                                                      const Scene& scene,
+                                                      Sampler& sampler,
+                                                      RegionAllocator& allocator,
+                                                      unsigned int scattering_count = 0,
+                                                      ShadowRayBatch* shadow_ray_batch = nullptr,
+                                                      const std::vector<Light*>* tile_lights = nullptr,
+                                                      OccluderCache* occluder_cache = nullptr) const;
+
+public:
+
+    PathIntegrator(std::shared_ptr<const Camera> camera,
+                   std::shared_ptr<Sampler> sampler,
+                   unsigned int max_scattering_count,
+                   unsigned int roulette_scattering_count,
+                   LightSelectionStrategy light_selection_strategy,
+                   unsigned int n_selected_lights,
+                   bool use_irradiance_cache = false,
+                   unsigned int n_irradiance_samples = 256,
+                   imp_float irradiance_error_tolerance = 0.3f,
+                   imp_float min_irradiance_radius = 0.005f,
+                   imp_float max_irradiance_radius = 0.2f,
+                   bool use_path_guiding = false,
+                   unsigned int n_guide_training_passes = 6,
+                   imp_float bsdf_sampling_fraction = 0.5f);
+
+    void preprocess(const Scene& scene, Sampler& sampler);
+
+    RadianceSpectrum incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                      const Scene& scene,
+                                      Sampler& sampler,
+                                      RegionAllocator& allocator,
+                                      unsigned int scattering_count = 0,
+                                      OccluderCache* occluder_cache = nullptr) const;
+};
+
+// PathIntegrator function declarations
+
+Integrator* createPathIntegrator(std::shared_ptr<const Camera> camera,
+                                 std::shared_ptr<Sampler> sampler,
+                                 const ParameterSet& parameters);
+
+// PathIntegrator inline method definitions
+
+inline PathIntegrator::PathIntegrator(std::shared_ptr<const Camera> camera,
+                                      std::shared_ptr<Sampler> sampler,
+                                      unsigned int max_scattering_count,
+                                      unsigned int roulette_scattering_count,
+                                      LightSelectionStrategy light_selection_strategy,
+                                      unsigned int n_selected_lights,
+                                      bool use_irradiance_cache /* = false */,
+                                      unsigned int n_irradiance_samples /* = 256 */,
+                                      imp_float irradiance_error_tolerance /* = 0.3f */,
+                                      imp_float min_irradiance_radius /* = 0.005f */,
+                                      imp_float max_irradiance_radius /* = 0.2f */,
+                                      bool use_path_guiding /* = false */,
+                                      unsigned int n_guide_training_passes /* = 6 */,
+                                      imp_float bsdf_sampling_fraction /* = 0.5f */)
+    : SampleIntegrator::SampleIntegrator(camera, sampler),
+      max_scattering_count(max_scattering_count),
+      roulette_scattering_count(roulette_scattering_count),
+      light_selection_strategy(light_selection_strategy),
+      n_selected_lights(std::max(1u, n_selected_lights)),
+      light_selector(),
+      use_irradiance_cache(use_irradiance_cache),
+      n_irradiance_theta_strata(std::max(1u, (unsigned int)std::round(std::sqrt(n_irradiance_samples*IMP_ONE_OVER_PI)))),
+      n_irradiance_phi_strata(std::max(1u, n_irradiance_samples/n_irradiance_theta_strata)),
+      irradiance_error_tolerance(irradiance_error_tolerance),
+      min_irradiance_radius(min_irradiance_radius),
+      max_irradiance_radius(max_irradiance_radius),
+      irradiance_cache(),
+      use_path_guiding(use_path_guiding),
+      n_guide_training_passes(n_guide_training_passes),
+      bsdf_sampling_fraction(clamp(bsdf_sampling_fraction, 0.0f, 1.0f)),
+      path_guide(),
+      path_guide_is_training(false)
+{}
+
+inline bool PathIntegrator::supportsRayPackets() const
+{
+    return true;
+}
+
+} // RayImpact
+} // Impact
@@ -33,6 +33,10 @@ public:
 
     imp_float generateRayWithOffsets(const CameraSample& sample,
                                      RayWithOffsets* ray) const;
+
+    bool computeViewBounds(const BoundingRectangleF& raster_bounds,
+                           const BoundingBoxF& scene_bounds,
+                           BoundingBoxF* view_bounds) const;
 };
 
 // PerspectiveCamera function declarations
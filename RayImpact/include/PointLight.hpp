@@ -2,7 +2,7 @@
 #include "Light.hpp"
 #include "ParameterSet.hpp"
 #include "math.hpp"
-#include <memory>
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -15,12 +15,14 @@ private:
 
     const Point3F position; // The world-space position of the light
     const IntensitySpectrum emitted_intensity; // The power per solid angle emitted by the light
+    const imp_float range; // Distance beyond which the light emits no radiance
 
 public:
 
     PointLight(const Transformation& light_to_world,
                const MediumInterface& medium_interface,
-               const IntensitySpectrum& emitted_intensity);
+               const IntensitySpectrum& emitted_intensity,
+               imp_float range = IMP_INFINITY);
 
     RadianceSpectrum sampleIncidentRadiance(const ScatteringEvent& scattering_event,
                                             const Point2F& uniform_sample,
@@ -28,25 +30,40 @@ public:
                                             imp_float* pdf_value,
                                             VisibilityTester* visibility_tester) const;
 
+    RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                           const Point2F& direction_sample,
+                                           imp_float time,
+                                           Ray* emitted_ray,
+                                           Normal3F* surface_normal,
+                                           imp_float* position_pdf_value,
+                                           imp_float* direction_pdf_value) const;
+
     PowerSpectrum emittedPower() const;
+
+    bool computeBounds(LightBounds* bounds) const;
+
+    bool mayIlluminate(const BoundingBoxF& region) const;
 };
 
 // PointLight function declarations
 
-std::shared_ptr<Light> createPointLight(const Transformation& light_to_world,
-                                        const MediumInterface& medium_interface,
-                                        const ParameterSet& parameters);
+Light* createPointLight(const Transformation& light_to_world,
+                        const MediumInterface& medium_interface,
+                        const ParameterSet& parameters,
+                        ObjectArena& arena);
 
 // PointLight inline method definitions
 
 inline PointLight::PointLight(const Transformation& light_to_world,
 							  const MediumInterface& medium_interface,
-							  const IntensitySpectrum& emitted_intensity)
+							  const IntensitySpectrum& emitted_intensity,
+							  imp_float range /* = IMP_INFINITY */)
     : Light::Light(LightFlags(LIGHT_POSITION_IS_DELTA),
                    light_to_world,
                    medium_interface),
     position(light_to_world(Point3F(0, 0, 0))),
-    emitted_intensity(emitted_intensity)
+    emitted_intensity(emitted_intensity),
+    range(range)
 {}
 
 inline PowerSpectrum PointLight::emittedPower() const
@@ -54,5 +71,24 @@ inline PowerSpectrum PointLight::emittedPower() const
     return IMP_FOUR_PI*emitted_intensity;
 }
 
+
+// A point light emits in all directions from a single position
+inline bool PointLight::computeBounds(LightBounds* bounds) const
+{
+    bounds->bounding_box = BoundingBoxF(position);
+    bounds->axis = Vector3F(0, 0, 1);
+    bounds->cos_normal_angle = -1;
+    bounds->cos_emission_angle = 0;
+    bounds->power = emittedPower().tristimulusY();
+
+    return true;
+}
+
+// A point light can only illuminate regions that are within its range
+inline bool PointLight::mayIlluminate(const BoundingBoxF& region) const
+{
+    return squaredDistanceBetween(region, position) <= range*range;
+}
+
 } // RayImpact
 } // Impact
@@ -0,0 +1,98 @@
+#pragma once
+#include "Integrator.hpp"
+#include "ParameterSet.hpp"
+#include <memory>
+#include <algorithm>
+
+namespace Impact {
+namespace RayImpact {
+
+// PreviewIntegrator declarations
+
+// Quantity that a preview integrator computes for the surface seen through each pixel
+enum class PreviewQuantity
+{
+    AMBIENT_OCCLUSION, // Fraction of the cosine-weighted hemisphere that is unoccluded within the maximum distance
+    ALBEDO, // Hemispherical-directional reflectance of the BSDF towards the camera
+    NORMALS, // Shading normal, with components mapped from [-1, 1] to [0, 1]
+    DEPTH // Distance from the camera, divided by the maximum distance if it is finite
+};
+
+/*
+Cheap integrator for look development and layout checks, which computes a simple quantity at the first
+surface seen from the camera rather than the scattered radiance. Ambient occlusion is estimated by tracing
+cosine-weighted rays over the hemisphere and only testing whether they hit anything within the maximum
+distance. The other quantities need only the single intersection of the eye ray, and no shadow rays are traced.
+*/
+class PreviewIntegrator : public SampleIntegrator {
+
+private:
+
+    const PreviewQuantity quantity; // The quantity to compute
+    const unsigned int n_samples; // Number of occlusion rays or reflectance samples at each intersection
+    const imp_float max_distance; // Largest distance of occluders for ambient occlusion, or distance mapped to white for depth
+
+    imp_float ambientOcclusion(const SurfaceScatteringEvent& scattering_event,
+                               const Scene& scene,
+                               Sampler& sampler) const;
+
+protected:
+
+    bool supportsRayPackets() const;
+
+    RadianceSpectrum incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                      SurfaceScatteringEvent* scattering_event,
+                                                      const Scene& scene,
+                                                      Sampler& sampler,
+                                                      RegionAllocator& allocator,
+                                                      unsigned int scattering_count = 0,
+                                                      ShadowRayBatch* shadow_ray_batch = nullptr,
+                                                      const std::vector<Light*>* tile_lights = nullptr,
+                                                      OccluderCache* occluder_cache = nullptr) const;
+
+public:
+
+    PreviewIntegrator(std::shared_ptr<const Camera> camera,
+                      std::shared_ptr<Sampler> sampler,
+                      PreviewQuantity quantity,
+                      unsigned int n_samples,
+                      imp_float max_distance);
+
+    void preprocess(const Scene& scene, Sampler& sampler);
+
+    RadianceSpectrum incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                      const Scene& scene,
+                                      Sampler& sampler,
+                                      RegionAllocator& allocator,
+                                      unsigned int scattering_count = 0,
+                                      OccluderCache* occluder_cache = nullptr) const;
+};
+
+// PreviewIntegrator function declarations
+
+Integrator* createPreviewIntegrator(std::shared_ptr<const Camera> camera,
+                                    std::shared_ptr<Sampler> sampler,
+                                    PreviewQuantity quantity,
+                                    const ParameterSet& parameters);
+
+// PreviewIntegrator inline method definitions
+
+inline PreviewIntegrator::PreviewIntegrator(std::shared_ptr<const Camera> camera,
+                                            std::shared_ptr<Sampler> sampler,
+                                            PreviewQuantity quantity,
+                                            unsigned int n_samples,
+                                            imp_float max_distance)
+    : SampleIntegrator::SampleIntegrator(camera, sampler),
+      quantity(quantity),
+      n_samples(std::max(1u, n_samples)),
+      max_distance(max_distance)
+{}
+
+// Eye ray intersections can be found in packets since every quantity starts from the first intersection
+inline bool PreviewIntegrator::supportsRayPackets() const
+{
+    return true;
+}
+
+} // RayImpact
+} // Impact
@@ -0,0 +1,224 @@
+#pragma once
+#include "precision.hpp"
+#include "error.hpp"
+#include "geometry.hpp"
+#include "BoundingBox.hpp"
+#include "Ray.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// RayPacket macros
+
+#define IMP_MAX_PACKET_SIZE 16
+
+// RayPacket declarations
+
+/*
+A small group of rays, typically eye rays through neighbouring pixels, that are traversed
+together. The origins and inverse directions are also stored as one array per coordinate, so
+that the slab tests of all the rays against a bounding box can be vectorized by the compiler.
+If all the directions lie in the same octant, the packet is coherent and the ranges of the
+origins and inverse directions are used to cull bounding boxes for the whole packet at once.
+*/
+class RayPacket {
+
+private:
+
+    imp_float origin_x[IMP_MAX_PACKET_SIZE]; // x-components of the ray origins
+    imp_float origin_y[IMP_MAX_PACKET_SIZE]; // y-components of the ray origins
+    imp_float origin_z[IMP_MAX_PACKET_SIZE]; // z-components of the ray origins
+    imp_float inverse_direction_x[IMP_MAX_PACKET_SIZE]; // x-components of the inverted ray directions
+    imp_float inverse_direction_y[IMP_MAX_PACKET_SIZE]; // y-components of the inverted ray directions
+    imp_float inverse_direction_z[IMP_MAX_PACKET_SIZE]; // z-components of the inverted ray directions
+
+    Point3F min_origin; // Smallest origin coordinates in the packet
+    Point3F max_origin; // Largest origin coordinates in the packet
+    Vector3F min_inverse_direction; // Smallest inverted direction components in the packet
+    Vector3F max_inverse_direction; // Largest inverted direction components in the packet
+    bool has_finite_inverse_directions; // Whether no direction component is zero
+
+public:
+
+    Ray rays[IMP_MAX_PACKET_SIZE]; // The rays in the packet (their max distances shrink as intersections are found)
+    unsigned int n_rays; // Number of rays in the packet
+    bool is_coherent; // Whether all ray directions lie in the same octant
+
+    RayPacket();
+
+    unsigned int addRay(const Ray& ray);
+
+    void prepare();
+
+    bool mayIntersect(const BoundingBoxF& bounding_box) const;
+
+    uint32_t intersectingRays(const BoundingBoxF& bounding_box) const;
+};
+
+// RayPacket inline method definitions
+
+inline RayPacket::RayPacket()
+    : n_rays(0),
+      is_coherent(false)
+{}
+
+// Adds a copy of the given ray to the packet and returns its index
+inline unsigned int RayPacket::addRay(const Ray& ray)
+{
+    imp_assert(n_rays < IMP_MAX_PACKET_SIZE);
+
+    rays[n_rays] = ray;
+
+    return n_rays++;
+}
+
+// Fills the per-coordinate arrays and determines the coherence and
+// coordinate ranges of the packet. Must be called after adding the rays.
+inline void RayPacket::prepare()
+{
+    is_coherent = n_rays > 0;
+    has_finite_inverse_directions = true;
+
+    for (unsigned int ray_idx = 0; ray_idx < n_rays; ray_idx++)
+    {
+        const Ray& ray = rays[ray_idx];
+
+        origin_x[ray_idx] = ray.origin.x;
+        origin_y[ray_idx] = ray.origin.y;
+        origin_z[ray_idx] = ray.origin.z;
+
+        inverse_direction_x[ray_idx] = 1.0f/ray.direction.x;
+        inverse_direction_y[ray_idx] = 1.0f/ray.direction.y;
+        inverse_direction_z[ray_idx] = 1.0f/ray.direction.z;
+
+        has_finite_inverse_directions = has_finite_inverse_directions &&
+                                        std::abs(inverse_direction_x[ray_idx]) < IMP_INFINITY &&
+                                        std::abs(inverse_direction_y[ray_idx]) < IMP_INFINITY &&
+                                        std::abs(inverse_direction_z[ray_idx]) < IMP_INFINITY;
+
+        // The sign of the inverted direction also distinguishes negative zero components
+        is_coherent = is_coherent &&
+                      (inverse_direction_x[ray_idx] < 0) == (inverse_direction_x[0] < 0) &&
+                      (inverse_direction_y[ray_idx] < 0) == (inverse_direction_y[0] < 0) &&
+                      (inverse_direction_z[ray_idx] < 0) == (inverse_direction_z[0] < 0);
+    }
+
+    if (!is_coherent || !has_finite_inverse_directions)
+        return;
+
+    min_origin = rays[0].origin;
+    max_origin = rays[0].origin;
+    min_inverse_direction = Vector3F(inverse_direction_x[0], inverse_direction_y[0], inverse_direction_z[0]);
+    max_inverse_direction = min_inverse_direction;
+
+    for (unsigned int ray_idx = 1; ray_idx < n_rays; ray_idx++)
+    {
+        const Vector3F inverse_direction(inverse_direction_x[ray_idx], inverse_direction_y[ray_idx], inverse_direction_z[ray_idx]);
+
+        min_origin = min(min_origin, rays[ray_idx].origin);
+        max_origin = max(max_origin, rays[ray_idx].origin);
+        min_inverse_direction = min(min_inverse_direction, inverse_direction);
+        max_inverse_direction = max(max_inverse_direction, inverse_direction);
+    }
+}
+
+// Performs a conservative interval arithmetic slab test for the whole packet. Returns false
+// only if none of the rays can intersect the given bounding box within their max distance.
+inline bool RayPacket::mayIntersect(const BoundingBoxF& bounding_box) const
+{
+    if (!is_coherent || !has_finite_inverse_directions)
+        return true;
+
+    imp_float max_entry_distance = 0;
+    imp_float min_exit_distance = IMP_INFINITY;
+
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+        // Directions are coherent, so the near and far planes are the same for all rays
+        bool is_negative = min_inverse_direction[dim] < 0;
+
+        imp_float near_plane = is_negative? bounding_box.upper_corner[dim] : bounding_box.lower_corner[dim];
+        imp_float far_plane = is_negative? bounding_box.lower_corner[dim] : bounding_box.upper_corner[dim];
+
+        // Bounds of (plane - origin)*inverse_direction over the ranges of origins and inverse directions
+        imp_float near_offsets[2] = {near_plane - max_origin[dim], near_plane - min_origin[dim]};
+        imp_float far_offsets[2] = {far_plane - max_origin[dim], far_plane - min_origin[dim]};
+
+        imp_float min_near_distance = IMP_INFINITY;
+        imp_float max_far_distance = -IMP_INFINITY;
+
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            min_near_distance = std::min(min_near_distance, std::min(near_offsets[i]*min_inverse_direction[dim],
+                                                                     near_offsets[i]*max_inverse_direction[dim]));
+
+            max_far_distance = std::max(max_far_distance, std::max(far_offsets[i]*min_inverse_direction[dim],
+                                                                   far_offsets[i]*max_inverse_direction[dim]));
+        }
+
+        max_entry_distance = std::max(max_entry_distance, min_near_distance);
+        min_exit_distance = std::min(min_exit_distance, max_far_distance*maxDistanceSafetyFactor);
+    }
+
+    imp_float max_ray_distance = 0;
+
+    for (unsigned int ray_idx = 0; ray_idx < n_rays; ray_idx++)
+        max_ray_distance = std::max(max_ray_distance, rays[ray_idx].max_distance);
+
+    return max_entry_distance <= min_exit_distance && max_entry_distance <= max_ray_distance;
+}
+
+// Performs the slab test for each ray in the packet and returns a bit mask
+// with the bits of the rays that intersect the given bounding box set
+inline uint32_t RayPacket::intersectingRays(const BoundingBoxF& bounding_box) const
+{
+    const imp_float lower_x = bounding_box.lower_corner.x;
+    const imp_float lower_y = bounding_box.lower_corner.y;
+    const imp_float lower_z = bounding_box.lower_corner.z;
+    const imp_float upper_x = bounding_box.upper_corner.x;
+    const imp_float upper_y = bounding_box.upper_corner.y;
+    const imp_float upper_z = bounding_box.upper_corner.z;
+
+    uint32_t mask = 0;
+
+    // Branch-free loop over the rays, so that it can be vectorized
+    for (unsigned int ray_idx = 0; ray_idx < n_rays; ray_idx++)
+    {
+        imp_float distance_1_x = (lower_x - origin_x[ray_idx])*inverse_direction_x[ray_idx];
+        imp_float distance_2_x = (upper_x - origin_x[ray_idx])*inverse_direction_x[ray_idx];
+        imp_float distance_1_y = (lower_y - origin_y[ray_idx])*inverse_direction_y[ray_idx];
+        imp_float distance_2_y = (upper_y - origin_y[ray_idx])*inverse_direction_y[ray_idx];
+        imp_float distance_1_z = (lower_z - origin_z[ray_idx])*inverse_direction_z[ray_idx];
+        imp_float distance_2_z = (upper_z - origin_z[ray_idx])*inverse_direction_z[ray_idx];
+
+        // The comparisons are ordered so that a NaN distance (from a zero direction component
+        // with the origin in a slab plane) makes the slab of that dimension be ignored
+        imp_float entry_distance = 0;
+        imp_float exit_distance = rays[ray_idx].max_distance;
+
+        imp_float near_x = (distance_2_x < distance_1_x)? distance_2_x : distance_1_x;
+        imp_float far_x = (distance_1_x < distance_2_x)? distance_2_x : distance_1_x;
+        imp_float near_y = (distance_2_y < distance_1_y)? distance_2_y : distance_1_y;
+        imp_float far_y = (distance_1_y < distance_2_y)? distance_2_y : distance_1_y;
+        imp_float near_z = (distance_2_z < distance_1_z)? distance_2_z : distance_1_z;
+        imp_float far_z = (distance_1_z < distance_2_z)? distance_2_z : distance_1_z;
+
+        entry_distance = (near_x > entry_distance)? near_x : entry_distance;
+        entry_distance = (near_y > entry_distance)? near_y : entry_distance;
+        entry_distance = (near_z > entry_distance)? near_z : entry_distance;
+
+        exit_distance = (far_x*maxDistanceSafetyFactor < exit_distance)? far_x*maxDistanceSafetyFactor : exit_distance;
+        exit_distance = (far_y*maxDistanceSafetyFactor < exit_distance)? far_y*maxDistanceSafetyFactor : exit_distance;
+        exit_distance = (far_z*maxDistanceSafetyFactor < exit_distance)? far_z*maxDistanceSafetyFactor : exit_distance;
+
+        mask |= (uint32_t)(entry_distance <= exit_distance) << ray_idx;
+    }
+
+    return mask;
+}
+
+} // RayImpact
+} // Impact
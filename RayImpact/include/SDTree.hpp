@@ -0,0 +1,225 @@
+#pragma once
+#include "precision.hpp"
+#include "geometry.hpp"
+#include "BoundingBox.hpp"
+#include "AtomicFloat.hpp"
+#include "memory_accounting.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace Impact {
+namespace RayImpact {
+
+// DirectionalQuadtree declarations
+
+/*
+Piecewise-constant distribution over the sphere of directions, represented by a quadtree over the unit
+square. Directions are mapped to the square with the cylindrical equal-area mapping (cos(theta) and phi
+rescaled to [0, 1]), so the density with respect to solid angle is the density in the square divided by 4*pi.
+Each node holds the energy recorded in each of its quadrants, which is the sum of the energies of the
+quadrant's children if it has any. Energies are recorded with atomic additions, so the tree can be filled
+from any number of threads as long as its structure is not modified at the same time.
+*/
+class DirectionalQuadtree {
+
+private:
+
+    // Node of the quadtree
+    struct Node
+    {
+        AtomicFloat energies[4]; // Energy recorded in each quadrant (indexed by x-half + 2*y-half)
+        uint32_t children[4]; // Index of the child node of each quadrant (0 if the quadrant is a leaf)
+
+        Node();
+        Node(const Node& other);
+        Node& operator=(const Node& other);
+
+        imp_float totalEnergy() const;
+    };
+
+    std::vector<Node> nodes; // Nodes of the tree (the first is the root)
+
+    void buildNode(uint32_t node_idx,
+                   const DirectionalQuadtree& source,
+                   uint32_t source_node_idx,
+                   imp_float node_energy,
+                   imp_float threshold_energy,
+                   unsigned int depth);
+
+    static unsigned int quadrantIndex(Point2F* point);
+
+    static unsigned int sampledHalf(imp_float lower_energy, imp_float upper_energy, imp_float* uniform_sample);
+
+    static Point2F directionToSquare(const Vector3F& direction);
+
+    static Vector3F squareToDirection(const Point2F& point);
+
+public:
+
+    static constexpr unsigned int max_depth = 20; // Maximum depth of the quadtree
+
+    DirectionalQuadtree();
+
+    imp_float totalEnergy() const;
+
+    size_t memoryUsage() const;
+
+    void record(const Vector3F& direction, imp_float energy);
+
+    Vector3F sample(const Point2F& uniform_sample, imp_float* pdf_value) const;
+
+    imp_float pdf(const Vector3F& direction) const;
+
+    void refine(const DirectionalQuadtree& source, imp_float subdivision_threshold);
+};
+
+// SDTree declarations
+
+/*
+Spatio-directional tree for learning the distribution of incident radiance in a scene (Müller et al. 2017).
+A binary tree subdivides the scene bounds by halving along alternating axes, and each of its leaves holds two
+directional quadtrees: one that incident radiance estimates are recorded into during the current training
+iteration, and one with the distribution learned in the previous iteration, which is used for sampling.
+When an iteration ends, leaves that received many samples are split, the recorded distribution becomes the
+sampling distribution, and the recording quadtree is rebuilt with finer quadrants where the most energy was
+recorded. Recording only performs atomic updates, so all threads can record into the tree without locks.
+*/
+class SDTree {
+
+private:
+
+    // Directional distributions of a spatial leaf
+    struct Leaf
+    {
+        DirectionalQuadtree sampling_distribution; // Distribution learned in the previous iteration
+        DirectionalQuadtree recording_distribution; // Distribution being recorded in the current iteration
+        std::atomic<uint32_t> n_samples; // Number of samples recorded in the current iteration
+
+        Leaf();
+    };
+
+    // Node of the spatial binary tree
+    struct Node
+    {
+        uint32_t children[2]; // Indices of the lower and upper child nodes (0 if the node is a leaf)
+        unsigned int split_axis; // Axis that the node is split along
+        unsigned int depth; // Depth of the node in the tree
+        uint32_t leaf_idx; // Index of the directional distributions of the node (if it is a leaf)
+    };
+
+    static constexpr unsigned int max_depth = 48; // Maximum depth of the spatial tree
+
+    const BoundingBoxF bounds; // Region covered by the root node
+    const imp_float spatial_threshold; // Number of samples above which a spatial leaf is split in the first iteration
+    const imp_float directional_threshold; // Fraction of the total energy above which a directional quadrant is subdivided
+
+    std::vector<Node> nodes; // Nodes of the spatial tree (the first is the root)
+    std::vector< std::unique_ptr<Leaf> > leaves; // Directional distributions of the spatial leaves
+    unsigned int n_iterations; // Number of completed training iterations
+    TrackedMemory memory; // Accounting of the memory used by the tree
+
+    void updateMemoryUsage();
+
+    uint32_t leafNodeIndex(const Point3F& position) const;
+
+    void splitNode(uint32_t node_idx, imp_float n_samples, imp_float sample_threshold);
+
+public:
+
+    SDTree(const BoundingBoxF& bounds,
+           imp_float spatial_threshold = 12000,
+           imp_float directional_threshold = 0.01f);
+
+    SDTree(const SDTree& other) = delete;
+    SDTree& operator=(const SDTree& other) = delete;
+
+    const DirectionalQuadtree& samplingDistribution(const Point3F& position) const;
+
+    void record(const Point3F& position, const Vector3F& direction, imp_float energy);
+
+    void refine();
+
+    unsigned int numberOfLeaves() const;
+};
+
+// DirectionalQuadtree inline method definitions
+
+inline DirectionalQuadtree::Node::Node()
+{
+    for (unsigned int quadrant_idx = 0; quadrant_idx < 4; quadrant_idx++)
+        children[quadrant_idx] = 0;
+}
+
+inline DirectionalQuadtree::Node::Node(const Node& other)
+{
+    *this = other;
+}
+
+inline DirectionalQuadtree::Node& DirectionalQuadtree::Node::operator=(const Node& other)
+{
+    for (unsigned int quadrant_idx = 0; quadrant_idx < 4; quadrant_idx++)
+    {
+        energies[quadrant_idx] = (imp_float)other.energies[quadrant_idx];
+        children[quadrant_idx] = other.children[quadrant_idx];
+    }
+
+    return *this;
+}
+
+inline imp_float DirectionalQuadtree::Node::totalEnergy() const
+{
+    return energies[0] + energies[1] + energies[2] + energies[3];
+}
+
+inline DirectionalQuadtree::DirectionalQuadtree()
+    : nodes(1)
+{}
+
+inline imp_float DirectionalQuadtree::totalEnergy() const
+{
+    return nodes[0].totalEnergy();
+}
+
+// Returns the number of bytes allocated for the nodes of the quadtree
+inline size_t DirectionalQuadtree::memoryUsage() const
+{
+    return nodes.capacity()*sizeof(Node);
+}
+
+// Returns the index of the quadrant containing the given point in the unit square of a node,
+// and transforms the point to the unit square of the quadrant
+inline unsigned int DirectionalQuadtree::quadrantIndex(Point2F* point)
+{
+    unsigned int x_half = (point->x >= 0.5f)? 1 : 0;
+    unsigned int y_half = (point->y >= 0.5f)? 1 : 0;
+
+    point->x = std::min(2*point->x - x_half, IMP_ONE_MINUS_EPS);
+    point->y = std::min(2*point->y - y_half, IMP_ONE_MINUS_EPS);
+
+    return x_half + 2*y_half;
+}
+
+// SDTree inline method definitions
+
+inline SDTree::Leaf::Leaf()
+    : sampling_distribution(),
+      recording_distribution(),
+      n_samples(0)
+{}
+
+// Returns the distribution for sampling directions at the given position
+inline const DirectionalQuadtree& SDTree::samplingDistribution(const Point3F& position) const
+{
+    return leaves[nodes[leafNodeIndex(position)].leaf_idx]->sampling_distribution;
+}
+
+inline unsigned int SDTree::numberOfLeaves() const
+{
+    return (unsigned int)leaves.size();
+}
+
+} // RayImpact
+} // Impact
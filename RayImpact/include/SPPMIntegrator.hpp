@@ -0,0 +1,126 @@
+#pragma once
+#include "Integrator.hpp"
+#include "ParameterSet.hpp"
+#include "LightSelector.hpp"
+#include "RegionAllocator.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "AtomicFloat.hpp"
+#include "BoundingBox.hpp"
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+namespace Impact {
+namespace RayImpact {
+
+// SPPMIntegrator declarations
+
+/*
+Stochastic progressive photon mapping. Each iteration first follows an eye ray through every pixel along specular
+scattering until it reaches a surface with a non-specular BSDF, where a visible point is recorded and the direct
+radiance is estimated by sampling a light. The visible points are inserted into a hashed uniform grid, with each
+point covering the cells overlapped by the photon gathering radius of its pixel. Photons are then emitted from lights
+selected in proportion to their emitted power and traced through the scene in parallel, and at every surface a photon
+hits after its first scattering, it adds its flux atomically to the visible points within their radius. At the end of
+each iteration, the radius of each pixel that received photons is shrunk so that the estimate converges, and the
+accumulated flux is scaled accordingly.
+*/
+class SPPMIntegrator : public Integrator {
+
+private:
+
+    // State of the photon density estimate for a single pixel
+    struct SPPMPixel
+    {
+        imp_float radius = 0; // Current photon gathering radius
+        RadianceSpectrum direct_radiance = RadianceSpectrum(0.0f); // Sum of the direct radiance estimates of all iterations
+        RadianceSpectrum flux = RadianceSpectrum(0.0f); // Accumulated flux of the photons gathered within the radius, scaled to the current radius
+        imp_float n_photons = 0; // Effective number of photons that the accumulated flux is based on
+
+        Point3F position; // Position of the visible point of the current iteration
+        Vector3F outgoing_direction; // Direction from the visible point back along the eye path
+        const BSDF* bsdf = nullptr; // BSDF at the visible point (null if the current iteration found no visible point)
+        Spectrum weight = Spectrum(0.0f); // Path throughput from the camera to the visible point
+
+        AtomicFloat photon_flux[Spectrum::n_coefficients]; // Flux of the photons gathered in the current iteration
+        std::atomic<uint32_t> n_new_photons{0}; // Number of photons gathered in the current iteration
+    };
+
+    // Entry in the list of visible points overlapping a grid cell
+    struct SPPMPixelNode
+    {
+        SPPMPixel* pixel; // The pixel whose visible point overlaps the cell
+        SPPMPixelNode* next; // Next entry in the list (null if this is the last entry)
+    };
+
+    static constexpr imp_float photon_fraction = 2.0f/3.0f; // Fraction of the newly gathered photons to keep when shrinking the radius
+
+    std::shared_ptr<const Camera> camera; // The camera providing eye rays and holding the sensor with the final image
+    std::shared_ptr<Sampler> sampler; // The sample generator used for the eye paths (with one sample per iteration)
+    const unsigned int n_iterations; // Number of iterations to perform
+    const unsigned int photons_per_iteration; // Number of photons to emit in each iteration
+    const unsigned int max_scattering_count; // Maximum number of scatterings along each eye path and photon path
+    const imp_float initial_radius; // Photon gathering radius of each pixel before the first iteration
+
+    void findVisiblePoint(const Scene& scene,
+                          const LightSelector& light_selector,
+                          const Point2I& pixel,
+                          Sampler& pixel_sampler,
+                          RegionAllocator& allocator,
+                          OccluderCache* occluder_cache,
+                          SPPMPixel* sppm_pixel) const;
+
+    RadianceSpectrum sampledDirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                           const Scene& scene,
+                                           const LightSelector& light_selector,
+                                           Sampler& pixel_sampler,
+                                           OccluderCache* occluder_cache) const;
+
+    void tracePhoton(const Scene& scene,
+                     const LightSelector& light_selector,
+                     const std::atomic<SPPMPixelNode*>* grid,
+                     uint32_t grid_size,
+                     const BoundingBoxF& grid_bounds,
+                     const Point3I& grid_resolution,
+                     RandomNumberGenerator& rng,
+                     RegionAllocator& allocator) const;
+
+public:
+
+    SPPMIntegrator(std::shared_ptr<const Camera> camera,
+                   std::shared_ptr<Sampler> sampler,
+                   unsigned int photons_per_iteration,
+                   unsigned int max_scattering_count,
+                   imp_float initial_radius);
+
+    void render(const Scene& scene);
+
+    void renderSinglePixel(const Scene& scene, const Point2I& single_pixel);
+};
+
+// SPPMIntegrator function declarations
+
+Integrator* createSPPMIntegrator(std::shared_ptr<const Camera> camera,
+                                 std::shared_ptr<Sampler> sampler,
+                                 const ParameterSet& parameters);
+
+// SPPMIntegrator inline method definitions
+
+// The number of iterations is given by the number of samples per pixel of the sampler,
+// so that each iteration uses the next sample of every pixel for its eye paths
+inline SPPMIntegrator::SPPMIntegrator(std::shared_ptr<const Camera> camera,
+                                      std::shared_ptr<Sampler> sampler,
+                                      unsigned int photons_per_iteration,
+                                      unsigned int max_scattering_count,
+                                      imp_float initial_radius)
+    : camera(camera),
+      sampler(sampler),
+      n_iterations(sampler->n_samples_per_pixel),
+      photons_per_iteration(std::max(1u, photons_per_iteration)),
+      max_scattering_count(std::max(1u, max_scattering_count)),
+      initial_radius(initial_radius)
+{}
+
+} // RayImpact
+} // Impact
@@ -1,6 +1,7 @@
 #pragma once
 #include "precision.hpp"
 #include "RandomNumberGenerator.hpp"
+#include "memory_accounting.hpp"
 #include "geometry.hpp"
 #include "Camera.hpp"
 #include <vector>
@@ -28,12 +29,18 @@ protected:
     std::vector< std::vector<imp_float> > sample_component_arrays_1D; // 1D sample component arrays
     std::vector< std::vector<Point2F> > sample_component_arrays_2D; // 1D sample component arrays
 
+    TrackedMemory array_memory; // Accounting of the memory used by the sample arrays
+
 public:
 
     const unsigned int n_samples_per_pixel; // Total number of samples that will be generated for each pixel
 
     Sampler(unsigned int n_samples_per_pixel);
 
+    virtual ~Sampler() {}
+
+    virtual void setSeed(unsigned int seed);
+
     virtual void setPixel(const Point2I& pixel);
 
     virtual bool beginNextSample();
@@ -79,6 +86,8 @@ public:
     PixelSampler(unsigned int n_samples_per_pixel,
                  unsigned int n_sampled_dimensions);
 
+    void setSeed(unsigned int seed);
+
     void setPixel(const Point2I& pixel);
 
     bool beginNextSample();
@@ -124,7 +133,8 @@ public:
 // Sampler inline method definitions
 
 inline Sampler::Sampler(unsigned int n_samples_per_pixel)
-    : n_samples_per_pixel(n_samples_per_pixel)
+    : array_memory(MemoryCategory::SamplerArrays),
+      n_samples_per_pixel(n_samples_per_pixel)
 {}
 
 inline unsigned int Sampler::roundedArraySize(unsigned int n_samples) const
@@ -45,6 +45,8 @@ inline ScaledTexture<T_scale, T>::ScaledTexture(const std::shared_ptr< Texture<T
 template <typename T_scale, typename T>
 inline T ScaledTexture<T_scale, T>::evaluate(const SurfaceScatteringEvent& scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_texture_evaluations);
+
     return scale->evaluate(scattering_event)*texture->evaluate(scattering_event);
 }
 
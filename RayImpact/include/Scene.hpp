@@ -1,36 +1,54 @@
 #pragma once
 #include "BoundingBox.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
 #include "ScatteringEvent.hpp"
 #include "Model.hpp"
 #include "Light.hpp"
+#include "ObjectArena.hpp"
+#include "statistics.hpp"
 #include <memory>
+#include <cstdint>
 #include <vector>
 
 namespace Impact {
 namespace RayImpact {
 
+// Scene statistics variables
+
+IMP_STAT_EXTERN(n_scene_rays);
+
 // Scene declarations
 
 class Scene {
 
 private:
 
-    std::shared_ptr<Model> model_aggregate; // An aggregate of all models in the scene
+    std::unique_ptr<ObjectArena> arena; // Arena owning the models, shapes and lights in the scene
+    const Model* model_aggregate; // An aggregate of all models in the scene
     BoundingBoxF world_bounding_box; // Bounding box encompassing all models in the scene
 
 public:
 
-    std::vector< std::shared_ptr<Light> > lights; // All lights in the scene
+    std::vector<Light*> lights; // All lights in the scene
 
-    Scene(std::shared_ptr<Model> model_aggregate,
-          const std::vector< std::shared_ptr<Light> >& lights);
+    Scene(std::unique_ptr<ObjectArena> arena,
+          const Model* model_aggregate,
+          const std::vector<Light*>& lights);
 
     const BoundingBoxF& worldSpaceBoundingBox() const;
 
     bool intersect(const Ray& ray, SurfaceScatteringEvent* scattering_event) const;
 
     bool hasIntersection(const Ray& ray) const;
+
+    const Model* occludingModel(const Ray& ray) const;
+
+    void intersectPacket(const RayPacket& packet,
+                         SurfaceScatteringEvent* scattering_events,
+                         bool* has_intersections) const;
+
+    void occluded(const Ray* rays, unsigned int n_rays, uint64_t* occlusion_mask) const;
 };
 
 // Scene inline method definitions
@@ -42,13 +60,29 @@ inline const BoundingBoxF& Scene::worldSpaceBoundingBox() const
 
 inline bool Scene::intersect(const Ray& ray, SurfaceScatteringEvent* scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_scene_rays);
     return model_aggregate->intersect(ray, scattering_event);
 }
 
 inline bool Scene::hasIntersection(const Ray& ray) const
 {
+    IMP_STAT_INCREMENT(n_scene_rays);
     return model_aggregate->hasIntersection(ray);
 }
 
+inline const Model* Scene::occludingModel(const Ray& ray) const
+{
+    IMP_STAT_INCREMENT(n_scene_rays);
+    return model_aggregate->occludingModel(ray);
+}
+
+inline void Scene::intersectPacket(const RayPacket& packet,
+                                   SurfaceScatteringEvent* scattering_events,
+                                   bool* has_intersections) const
+{
+    IMP_STAT_ADD(n_scene_rays, packet.n_rays);
+    model_aggregate->intersectPacket(packet, scattering_events, has_intersections);
+}
+
 } // RayImpact
 } // Impact
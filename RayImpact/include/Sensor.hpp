@@ -1,11 +1,15 @@
 #pragma once
 #include "precision.hpp"
-#include "AtomicFloat.hpp"
+#include "math.hpp"
 #include "geometry.hpp"
 #include "BoundingRectangle.hpp"
 #include "Filter.hpp"
 #include "Spectrum.hpp"
 #include "ParameterSet.hpp"
+#include "memory_accounting.hpp"
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,6 +21,8 @@ namespace RayImpact {
 // Forward declarations
 class SensorRegion;
 struct RawPixel;
+struct PixelSampleStatistics;
+struct RenderProgress;
 
 // Sensor declarations
 
@@ -28,11 +34,10 @@ private:
     {
         imp_float xyz_values[3] = {0.0f, 0.0f, 0.0f}; // Tristrimulus color values for the pixel
         imp_float sum_of_filter_weights = 0; // Sum of filter weights for samples contributing to the pixel
-        AtomicFloat xyz_sums_of_splats[3]; // Sums of the tristimulus color values accumulated by splats
-        imp_float pad; // Extra variable to ensure alignment in memory
     };
 
-    std::unique_ptr<Pixel[]> pixels; // The sensor pixels
+    Pixel* pixels; // The sensor pixels
+    TrackedMemory pixel_memory; // Accounting of the memory used by the sensor pixels
 
     const imp_float final_image_scale; // Scale factor to apply to the final image before writing to file
 
@@ -41,8 +46,29 @@ private:
 
     std::mutex mutex; // Mutex for avoiding simultaneous modifications of the sensor pixels by different threads
 
+    std::vector<PixelSampleStatistics> sample_statistics; // Luminance statistics of the samples taken in each pixel of the sampling bounds (empty unless enabled)
+    TrackedMemory statistics_memory; // Accounting of the memory used by the sample statistics
+
+    // Splat waiting in the splat cache of a thread
+    struct CachedSplat
+    {
+        uint32_t crop_window_pixel_idx; // Index of the pixel receiving the splat
+        imp_float xyz_values[3]; // Tristimulus color values of the splat
+    };
+
+    static constexpr size_t splat_cache_size = 4096; // Number of splats each thread can cache before they are added to the splat sums
+
+    std::vector<imp_float> splat_xyz_sums; // Sums of the tristimulus color values accumulated by splats in each pixel (empty unless enabled)
+    std::vector< std::vector<CachedSplat> > thread_splat_caches; // Splats added by each thread since its cache was last flushed
+    std::mutex splat_mutex; // Mutex for avoiding simultaneous modifications of the splat sums by different threads
+    TrackedMemory splat_memory; // Accounting of the memory used by the splat sums and caches
+
     Pixel& pixel(const Point2I& pixel_position);
 
+    void flushSplatCache(std::vector<CachedSplat>& splat_cache);
+
+    size_t samplingPixelIndex(const Point2I& sampling_pixel) const;
+
 public:
 
     const Vector2I full_resolution; // Total number of pixels along each dimension of the sensor
@@ -58,6 +84,8 @@ public:
            const std::string& output_filename,
            imp_float final_image_scale = 1);
 
+    ~Sensor();
+
     BoundingRectangleI samplingBounds() const;
 
     BoundingRectangleF physicalExtent() const;
@@ -66,12 +94,33 @@ public:
 
     void mergeSensorRegion(std::unique_ptr<SensorRegion> sensor_region);
 
+    bool mergePixelValues(const BoundingRectangleI& region_pixel_bounds,
+                          const imp_float* region_pixel_values);
+
+    void enableSampleStatistics();
+
+    bool hasSampleStatistics() const;
+
+    imp_float relativeError(const Point2I& sampling_pixel) const;
+
+    unsigned int numberOfUnconvergedPixels(imp_float error_threshold) const;
+
     void setPixels(const EnergySpectrum* pixel_values);
 
+    void enableSplats();
+
+    bool hasSplats() const;
+
     void addSplat(const Point2F& sample_position,
                   const RadianceSpectrum& radiance);
 
+    void mergeSplats();
+
     void writeImage(imp_float splat_scale = 1);
+
+    bool writeCheckpoint(const std::string& filename, const RenderProgress& progress);
+
+    bool readCheckpoint(const std::string& filename, RenderProgress* progress);
 };
 
 // SensorSection declarations
@@ -81,19 +130,24 @@ class SensorRegion {
 private:
 
     const BoundingRectangleI pixel_bounds; // Boundary rectangle encompassing all pixels in the sensor region
+    const BoundingRectangleI sampling_bounds; // Boundary rectangle encompassing all pixels that samples are taken in
     const Vector2F filter_radius; // Radius vector of the filter used by the sensor
     const Vector2F inverse_filter_radius; // Reciprocal of the radius vector
     const unsigned int filter_table_width; // The width of the filter table used by the sensor
     const imp_float* filter_table; // The table of filter values used by the sensor
 
     std::vector<RawPixel> pixels; // The pixels contained in the sensor region
+    std::vector<PixelSampleStatistics> sample_statistics; // Luminance statistics for each pixel in the sampling bounds (empty if not tracked)
+    TrackedMemory pixel_memory; // Accounting of the memory used by the region pixels
 
 public:
 
     SensorRegion(const BoundingRectangleI& pixel_bounds,
+                 const BoundingRectangleI& sampling_bounds,
                  const Vector2F& filter_radius,
                  const unsigned int filter_table_width,
-                 const imp_float* filter_table);
+                 const imp_float* filter_table,
+                 bool track_sample_statistics = false);
 
     void addSample(const Point2F& sample_position,
                    const RadianceSpectrum& radiance,
@@ -101,9 +155,15 @@ public:
 
     const BoundingRectangleI& pixelBounds() const;
 
+    const BoundingRectangleI& samplingBounds() const;
+
     const RawPixel& rawPixel(const Point2I& pixel_position) const;
 
     RawPixel& rawPixel(const Point2I& pixel_position);
+
+    const PixelSampleStatistics* sampleStatistics(const Point2I& sampling_pixel) const;
+
+    void computePixelValues(imp_float* region_pixel_values) const;
 };
 
 struct RawPixel
@@ -112,6 +172,27 @@ struct RawPixel
     imp_float sum_of_filter_weights = 0; // Sum of filter weights for samples contributing to the pixel
 };
 
+// Running sums used for estimating the mean luminance of the samples in a pixel and its variance
+struct PixelSampleStatistics
+{
+    double sum_of_luminances = 0; // Sum of the luminances of all samples taken in the pixel
+    double sum_of_squared_luminances = 0; // Sum of the squared luminances of all samples taken in the pixel
+    uint32_t n_samples = 0; // Number of samples taken in the pixel
+
+    void add(const PixelSampleStatistics& other);
+
+    imp_float relativeError() const;
+};
+
+// State of a progressive rendering that is stored along with the sensor pixels in a checkpoint
+struct RenderProgress
+{
+    uint32_t n_samples_per_pixel = 0; // Total number of samples per pixel to render
+    uint32_t n_pass_samples = 0; // Number of samples per pixel computed in each pass
+    uint32_t n_completed_samples = 0; // Number of samples per pixel computed so far
+    uint32_t n_completed_passes = 0; // Number of passes completed so far
+};
+
 // Sensor function declarations
 
 Sensor* createImageSensor(std::unique_ptr<Filter> filter,
@@ -121,21 +202,68 @@ Sensor* createImageSensor(std::unique_ptr<Filter> filter,
 // SensorSection inline method definitions
 
 inline SensorRegion::SensorRegion(const BoundingRectangleI& pixel_bounds,
+                                  const BoundingRectangleI& sampling_bounds,
 								  const Vector2F& filter_radius,
 								  const unsigned int filter_table_width,
-								  const imp_float* filter_table)
+								  const imp_float* filter_table,
+                                  bool track_sample_statistics /* = false */)
     : pixel_bounds(pixel_bounds),
+      sampling_bounds(sampling_bounds),
       filter_radius(filter_radius),
       inverse_filter_radius(1.0f/filter_radius.x, 1.0f/filter_radius.y),
       filter_table_width(filter_table_width),
       filter_table(filter_table),
-      pixels(std::max(0, pixel_bounds.area()))
-{}
+      pixels(std::max(0, pixel_bounds.area())),
+      sample_statistics((track_sample_statistics)? std::max(0, sampling_bounds.area()) : 0),
+      pixel_memory(MemoryCategory::SensorPixels)
+{
+    pixel_memory.add(pixels.size()*sizeof(RawPixel) + sample_statistics.size()*sizeof(PixelSampleStatistics));
+}
 
 inline const BoundingRectangleI& SensorRegion::pixelBounds() const
 {
     return pixel_bounds;
 }
 
+inline const BoundingRectangleI& SensorRegion::samplingBounds() const
+{
+    return sampling_bounds;
+}
+
+// Returns the sample statistics for the given pixel, or a null pointer if they are not tracked
+inline const PixelSampleStatistics* SensorRegion::sampleStatistics(const Point2I& sampling_pixel) const
+{
+    if (sample_statistics.empty())
+        return nullptr;
+
+    int region_width = sampling_bounds.upper_corner.x - sampling_bounds.lower_corner.x;
+
+    return &sample_statistics[region_width*(sampling_pixel.y - sampling_bounds.lower_corner.y)
+                                         + (sampling_pixel.x - sampling_bounds.lower_corner.x)];
+}
+
+// PixelSampleStatistics inline method definitions
+
+inline void PixelSampleStatistics::add(const PixelSampleStatistics& other)
+{
+    sum_of_luminances += other.sum_of_luminances;
+    sum_of_squared_luminances += other.sum_of_squared_luminances;
+    n_samples += other.n_samples;
+}
+
+// Returns the standard error of the mean luminance relative to the mean luminance.
+// Pixels with fewer than two samples are given an infinite error.
+inline imp_float PixelSampleStatistics::relativeError() const
+{
+    if (n_samples < 2)
+        return IMP_INFINITY;
+
+    double mean = sum_of_luminances/n_samples;
+    double variance = std::max(0.0, (sum_of_squared_luminances - n_samples*mean*mean)/(n_samples - 1));
+
+    // The small offset keeps almost black pixels from requiring an excessive number of samples
+    return (imp_float)(std::sqrt(variance/n_samples)/(mean + 1e-3));
+}
+
 } // RayImpact
 } // Impact
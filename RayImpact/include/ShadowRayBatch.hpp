@@ -0,0 +1,87 @@
+#pragma once
+#include "precision.hpp"
+#include "geometry.hpp"
+#include "Spectrum.hpp"
+#include "Ray.hpp"
+#include "Scene.hpp"
+#include "Sensor.hpp"
+#include "Light.hpp"
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+namespace Impact {
+namespace RayImpact {
+
+// ShadowRayBatch declarations
+
+/*
+Defers the shadow rays of the samples in a tile so that they can be traced together with
+Scene::occluded. An integrator adds the unoccluded contribution of each shadow ray to the
+batch while computing a sample, and the sample itself (without those contributions) once it is
+complete. When enough shadow rays have accumulated, they are traced, the contributions of the
+unoccluded rays are added to their samples and the samples are added to the sensor region.
+Samples without shadow rays are added to the sensor region immediately. Any remaining shadow rays
+must be traced with traceShadowRays before the sensor region is used. Shadow rays that are added together
+with their light are first tested against the model that last occluded a shadow ray towards that light
+in the tile, and only the rays it does not occlude are traced through the scene.
+*/
+class ShadowRayBatch {
+
+private:
+
+    // A completed sample waiting for its shadow rays to be traced
+    struct PendingSample
+    {
+        Point2F sensor_point; // Position of the sample on the sensor
+        RadianceSpectrum radiance; // Radiance of the sample, excluding the contributions of its shadow rays
+        imp_float weight; // Weight of the sample
+    };
+
+    const Scene& scene; // The scene to trace the shadow rays in
+    SensorRegion& sensor_region; // The sensor region to add the samples to
+    const unsigned int max_shadow_rays; // Number of accumulated shadow rays that triggers tracing
+
+    std::vector<PendingSample> pending_samples; // Completed samples that have shadow rays
+    std::vector<Ray> shadow_rays; // Accumulated shadow rays
+    std::vector<RadianceSpectrum> contributions; // Radiance contributed by each shadow ray if it is unoccluded
+    std::vector<unsigned int> sample_indices; // Index of the pending sample that each shadow ray belongs to
+    std::vector<const Light*> shadow_ray_lights; // Light that each shadow ray points towards (null if unknown)
+    std::vector<uint64_t> occlusion_mask; // Bit mask marking the occluded shadow rays
+
+    OccluderCache occluder_cache; // The model that last occluded a shadow ray towards each light in the tile
+    std::vector<Ray> traced_rays; // Shadow rays that were not occluded by their cached occluder
+    std::vector<unsigned int> traced_ray_indices; // Index of each traced ray among all the shadow rays
+    std::vector<uint64_t> traced_occlusion_mask; // Bit mask marking the occluded traced rays
+    std::unordered_set<const Light*> updated_lights; // Lights whose cached occluder has been updated in the current batch
+    unsigned int n_current_shadow_rays; // Number of shadow rays added for the sample currently being computed
+
+public:
+
+    ShadowRayBatch(const Scene& scene,
+                   SensorRegion& sensor_region,
+                   unsigned int max_shadow_rays = 512);
+
+    void addShadowRay(const Ray& shadow_ray,
+                      const RadianceSpectrum& contribution,
+                      const Light* light = nullptr);
+
+    void addSample(const Point2F& sensor_point,
+                   const RadianceSpectrum& radiance,
+                   imp_float weight);
+
+    void traceShadowRays();
+
+    OccluderCache* occluderCache();
+};
+
+// ShadowRayBatch inline method definitions
+
+// Returns the occluder cache of the tile, which can also be used for shadow rays that are traced immediately
+inline OccluderCache* ShadowRayBatch::occluderCache()
+{
+    return &occluder_cache;
+}
+
+} // RayImpact
+} // Impact
@@ -36,6 +36,20 @@ public:
                                  bool test_alpha_texture = true) const;
 
     virtual imp_float surfaceArea() const = 0;
+
+    virtual ScatteringEvent sampleSurface(const Point2F& uniform_sample,
+                                          imp_float* pdf_value) const = 0;
+
+    virtual ScatteringEvent sampleSurfaceFrom(const ScatteringEvent& reference_event,
+                                              const Point2F& uniform_sample,
+                                              imp_float* pdf_value) const;
+
+    virtual imp_float pdfFrom(const ScatteringEvent& reference_event,
+                              const Vector3F& incident_direction) const;
+
+protected:
+
+    Normal3F worldSpaceSurfaceNormal(const Normal3F& object_space_surface_normal) const;
 };
 
 // Shape function declarations
@@ -65,5 +79,17 @@ inline BoundingBoxF Shape::worldSpaceBoundingBox() const
     return (*object_to_world)(objectSpaceBoundingBox());
 }
 
+// Transforms an object space surface normal with the same orientation as dpdu x dpdv to world space, and
+// reverses it under the same conditions as the surface normals of scattering events found by intersection
+inline Normal3F Shape::worldSpaceSurfaceNormal(const Normal3F& object_space_surface_normal) const
+{
+    Normal3F surface_normal = (*object_to_world)(object_space_surface_normal).normalized();
+
+    if (has_reverse_orientation ^ transformation_swaps_handedness)
+        surface_normal.reverse();
+
+    return surface_normal;
+}
+
 } // RayImpact
 } // Impact
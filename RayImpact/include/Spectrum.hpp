@@ -25,6 +25,7 @@ typedef Spectrum EnergySpectrum;
 typedef Spectrum PowerSpectrum;
 typedef Spectrum IntensitySpectrum;
 typedef Spectrum RadianceSpectrum;
+typedef Spectrum IrradianceSpectrum;
 typedef Spectrum ReflectionSpectrum;
 typedef Spectrum TransmissionSpectrum;
 
@@ -91,6 +92,8 @@ public:
 
     bool hasNaNs() const;
 
+    imp_float maxCoefficient() const;
+
     CoefficientSpectrum clamped(imp_float lower_limit = 0,
                                 imp_float upper_limit = IMP_INFINITY) const;
 };
@@ -443,6 +446,17 @@ inline bool CoefficientSpectrum<n>::hasNaNs() const
     return false;
 }
 
+template <unsigned int n>
+inline imp_float CoefficientSpectrum<n>::maxCoefficient() const
+{
+    imp_float max_coefficient = coefficients[0];
+
+    for (unsigned int i = 1; i < n; i++)
+        max_coefficient = std::max(max_coefficient, coefficients[i]);
+
+    return max_coefficient;
+}
+
 template <unsigned int n>
 inline CoefficientSpectrum<n> CoefficientSpectrum<n>::clamped(imp_float lower_limit /* = 0 */,
                                                               imp_float upper_limit /* = IMP_INFINITY */) const
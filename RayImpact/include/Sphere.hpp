@@ -7,7 +7,7 @@
 #include "ScatteringEvent.hpp"
 #include "ParameterSet.hpp"
 #include "error.hpp"
-#include <memory>
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -47,14 +47,25 @@ public:
                          bool test_alpha_texture = true) const;
 
     imp_float surfaceArea() const;
+
+    ScatteringEvent sampleSurface(const Point2F& uniform_sample,
+                                  imp_float* pdf_value) const;
+
+    ScatteringEvent sampleSurfaceFrom(const ScatteringEvent& reference_event,
+                                      const Point2F& uniform_sample,
+                                      imp_float* pdf_value) const;
+
+    imp_float pdfFrom(const ScatteringEvent& reference_event,
+                      const Vector3F& incident_direction) const;
 };
 
 // Sphere function declarations
 
-std::shared_ptr<Shape> createSphere(const Transformation* object_to_world,
-                                    const Transformation* world_to_object,
-                                    bool has_reverse_orientation,
-                                    const ParameterSet& parameters);
+Shape* createSphere(const Transformation* object_to_world,
+                    const Transformation* world_to_object,
+                    bool has_reverse_orientation,
+                    const ParameterSet& parameters,
+                    ObjectArena& arena);
 
 // Sphere inline method definitions
 
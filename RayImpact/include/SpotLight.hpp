@@ -2,7 +2,7 @@
 #include "Light.hpp"
 #include "ParameterSet.hpp"
 #include "math.hpp"
-#include <memory>
+#include "ObjectArena.hpp"
 
 namespace Impact {
 namespace RayImpact {
@@ -17,6 +17,7 @@ private:
     const IntensitySpectrum emitted_intensity; // The power per solid angle emitted by the light
     const imp_float cos_max_angle; // Cosine of the angular width of the full light cone
     const imp_float cos_falloff_start_angle; // Cosine of the angular width of the interior (full-intensity) light cone
+    const imp_float range; // Distance beyond which the light emits no radiance
 
     imp_float falloffInDirection(const Vector3F& direction) const;
 
@@ -26,7 +27,8 @@ public:
               const MediumInterface& medium_interface,
               const IntensitySpectrum& emitted_intensity,
               imp_float max_angle,
-              imp_float falloff_start_angle);
+              imp_float falloff_start_angle,
+              imp_float range = IMP_INFINITY);
 
     RadianceSpectrum sampleIncidentRadiance(const ScatteringEvent& scattering_event,
                                             const Point2F& uniform_sample,
@@ -34,14 +36,27 @@ public:
                                             imp_float* pdf_value,
                                             VisibilityTester* visibility_tester) const;
 
+    RadianceSpectrum sampleEmittedRadiance(const Point2F& position_sample,
+                                           const Point2F& direction_sample,
+                                           imp_float time,
+                                           Ray* emitted_ray,
+                                           Normal3F* surface_normal,
+                                           imp_float* position_pdf_value,
+                                           imp_float* direction_pdf_value) const;
+
     PowerSpectrum emittedPower() const;
+
+    bool computeBounds(LightBounds* bounds) const;
+
+    bool mayIlluminate(const BoundingBoxF& region) const;
 };
 
 // SpotLight function declarations
 
-std::shared_ptr<Light> createSpotLight(const Transformation& light_to_world,
-                                       const MediumInterface& medium_interface,
-                                       const ParameterSet& parameters);
+Light* createSpotLight(const Transformation& light_to_world,
+                       const MediumInterface& medium_interface,
+                       const ParameterSet& parameters,
+                       ObjectArena& arena);
 
 // PointLight inline method definitions
 
@@ -49,14 +64,16 @@ inline SpotLight::SpotLight(const Transformation& light_to_world,
 							const MediumInterface& medium_interface,
 							const IntensitySpectrum& emitted_intensity,
 							imp_float max_angle,
-							imp_float falloff_start_angle)
+							imp_float falloff_start_angle,
+							imp_float range /* = IMP_INFINITY */)
     : Light::Light(LightFlags(LIGHT_POSITION_IS_DELTA),
                    light_to_world,
                    medium_interface),
     position(light_to_world(Point3F(0, 0, 0))),
     emitted_intensity(emitted_intensity),
     cos_max_angle(std::cos(degreesToRadians(clamp(max_angle, 0.0f, 180.0f)))),
-    cos_falloff_start_angle(std::cos(degreesToRadians(clamp(falloff_start_angle, 0.0f, max_angle))))
+    cos_falloff_start_angle(std::cos(degreesToRadians(clamp(falloff_start_angle, 0.0f, max_angle)))),
+    range(range)
 {}
 
 inline PowerSpectrum SpotLight::emittedPower() const
@@ -64,5 +81,19 @@ inline PowerSpectrum SpotLight::emittedPower() const
     return (IMP_TWO_PI*(1 - 0.5f*(cos_max_angle + cos_falloff_start_angle)))*emitted_intensity;
 }
 
+
+// The normal cone of a spot light covers the full-intensity cone, and emission
+// extends from there out to the edge of the falloff region
+inline bool SpotLight::computeBounds(LightBounds* bounds) const
+{
+    bounds->bounding_box = BoundingBoxF(position);
+    bounds->axis = light_to_world(Vector3F(0, 0, 1)).normalized();
+    bounds->cos_normal_angle = cos_falloff_start_angle;
+    bounds->cos_emission_angle = std::cos(std::acos(cos_max_angle) - std::acos(cos_falloff_start_angle));
+    bounds->power = emittedPower().tristimulusY();
+
+    return true;
+}
+
 } // RayImpact
 } // Impact
@@ -5,6 +5,7 @@
 #include "Transformation.hpp"
 #include "ScatteringEvent.hpp"
 #include "ParameterSet.hpp"
+#include "statistics.hpp"
 #include <sstream>
 #include <string>
 #include <ostream>
@@ -12,6 +13,10 @@
 namespace Impact {
 namespace RayImpact {
 
+// Texture statistics variables
+
+IMP_STAT_EXTERN(n_texture_evaluations);
+
 // Texture declarations
 
 template <typename T>
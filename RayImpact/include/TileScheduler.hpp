@@ -0,0 +1,139 @@
+#pragma once
+#include "geometry.hpp"
+#include "BoundingRectangle.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace Impact {
+namespace RayImpact {
+
+// Order in which the tiles of a pass are handed out
+enum class TileOrdering
+{
+    Scanline, // Row by row from the top
+    Hilbert,  // Along a Hilbert curve through the tiles, for coherent memory access
+    Cost      // Most expensive tiles first, based on the costs measured in the previous pass (Hilbert order before that)
+};
+
+// Tile declarations
+
+struct Tile
+{
+    BoundingRectangleI bounds; // Bounds of the pixels to sample in the tile
+    unsigned int base_tile_idx; // Index of the base tile that this tile covers all or part of
+    unsigned int seed; // Seed to use for the sampler of the tile (unique among all tiles of all passes)
+};
+
+// TileScheduler declarations
+
+/*
+Divides the sampling bounds of a sensor into tiles and hands them out to the rendering threads.
+The tile size is chosen from the resolution, number of samples per pixel and number of threads
+unless given explicitly. When only a few tiles remain in a pass, the next tiles to be handed out
+are split into quadrants so that no single large tile keeps one thread busy while the others idle.
+*/
+class TileScheduler {
+
+private:
+
+    const BoundingRectangleI sampling_bounds; // Bounds of all pixels to sample
+    const TileOrdering ordering; // Order in which the base tiles are handed out
+    const unsigned int n_threads; // Number of threads requesting tiles
+    const int tile_extent; // Width and height of the base tiles
+    const int min_split_extent; // Smallest width or height of a tile produced by splitting
+
+    std::vector<BoundingRectangleI> base_tiles; // The tiles that the sampling bounds are divided into
+    std::vector<double> tile_costs; // Measured cost of each base tile
+    bool has_tile_costs; // Whether the tile costs have been assigned
+    unsigned int pass_idx; // Index of the current pass
+    bool has_begun_pass; // Whether any pass has been begun
+
+    std::deque<Tile> queued_tiles; // Tiles remaining to be handed out in the current pass
+    std::mutex mutex; // Mutex that must be owned when modifying the queued tiles and costs
+
+    void sortTileIndices(std::vector<unsigned int>& tile_indices) const;
+
+    Tile createTile(const BoundingRectangleI& bounds, unsigned int base_tile_idx) const;
+
+public:
+
+    TileScheduler(const BoundingRectangleI& sampling_bounds,
+                  unsigned int n_samples_per_pixel,
+                  unsigned int n_threads,
+                  TileOrdering ordering,
+                  int tile_extent = 0);
+
+    static int automaticTileExtent(const Vector2I& sampling_extents,
+                                   unsigned int n_samples_per_pixel,
+                                   unsigned int n_threads);
+
+    unsigned int numberOfBaseTiles() const;
+
+    const BoundingRectangleI& baseTileBounds(unsigned int base_tile_idx) const;
+
+    int tileExtent() const;
+
+    TileOrdering tileOrdering() const;
+
+    unsigned int passIndex() const;
+
+    bool hasTileCosts() const;
+
+    void addTileCost(unsigned int base_tile_idx, double cost);
+
+    void beginPass();
+
+    void resumeAfterPass(unsigned int completed_pass_idx);
+
+    bool nextTile(Tile* tile);
+
+    void requeueTile(const Tile& tile);
+
+    unsigned int numberOfQueuedTiles();
+};
+
+// TileScheduler function declarations
+
+uint64_t hilbertCurveIndex(uint32_t n, uint32_t x, uint32_t y);
+
+bool parseTileOrdering(const std::string& name, TileOrdering* ordering);
+
+const char* tileOrderingName(TileOrdering ordering);
+
+// TileScheduler inline method definitions
+
+inline unsigned int TileScheduler::numberOfBaseTiles() const
+{
+    return (unsigned int)base_tiles.size();
+}
+
+inline const BoundingRectangleI& TileScheduler::baseTileBounds(unsigned int base_tile_idx) const
+{
+    return base_tiles[base_tile_idx];
+}
+
+inline int TileScheduler::tileExtent() const
+{
+    return tile_extent;
+}
+
+inline TileOrdering TileScheduler::tileOrdering() const
+{
+    return ordering;
+}
+
+inline unsigned int TileScheduler::passIndex() const
+{
+    return pass_idx;
+}
+
+inline bool TileScheduler::hasTileCosts() const
+{
+    return has_tile_costs;
+}
+
+} // RayImpact
+} // Impact
@@ -0,0 +1,205 @@
+#pragma once
+#include "Integrator.hpp"
+#include "Light.hpp"
+#include "ParameterSet.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace Impact {
+namespace RayImpact {
+
+// WavefrontRayQueue declarations
+
+// Rays waiting to be traced, stored as separate arrays for each ray property
+struct WavefrontRayQueue
+{
+    std::vector<Point3F> origins; // Origin of each ray
+    std::vector<Vector3F> directions; // Direction of each ray
+    std::vector<imp_float> times; // Point in time associated with each ray
+    std::vector<uint8_t> has_offsets; // Whether each ray has offset rays
+    std::vector<Point3F> x_offset_origins; // Origin of the x-offset ray of each ray
+    std::vector<Vector3F> x_offset_directions; // Direction of the x-offset ray of each ray
+    std::vector<Point3F> y_offset_origins; // Origin of the y-offset ray of each ray
+    std::vector<Vector3F> y_offset_directions; // Direction of the y-offset ray of each ray
+    std::vector<Spectrum> weights; // Factor to multiply the radiance along each ray with before accumulating it
+    std::vector<uint32_t> sample_indices; // Index of the camera sample that each ray contributes to
+    std::vector<uint64_t> random_states; // State of the random sequence used for scattering the path of each ray
+
+    size_t size() const;
+
+    bool empty() const;
+
+    void clear();
+
+    void push(const RayWithOffsets& ray,
+              const Spectrum& weight,
+              uint32_t sample_idx,
+              uint64_t random_state);
+
+    RayWithOffsets ray(size_t ray_idx) const;
+};
+
+// WavefrontShadowQueue declarations
+
+// Shadow rays waiting to be traced, along with the radiance they contribute if unobstructed
+struct WavefrontShadowQueue
+{
+    std::vector<VisibilityTester> visibility_testers; // End points of each shadow ray
+    std::vector<RadianceSpectrum> contributions; // Radiance contributed to the camera sample if the shadow ray is unobstructed
+    std::vector<uint32_t> sample_indices; // Index of the camera sample that each shadow ray contributes to
+    std::vector<const Light*> lights; // Light that each shadow ray points towards
+
+    size_t size() const;
+
+    void clear();
+
+    void push(const VisibilityTester& visibility_tester,
+              const RadianceSpectrum& contribution,
+              uint32_t sample_idx,
+              const Light* light);
+};
+
+// Queues and intermediate results reused by the stages of a wavefront
+struct WavefrontBuffers
+{
+    WavefrontRayQueue rays; // Rays to trace at the current scattering depth
+    WavefrontRayQueue secondary_rays; // Rays generated for the next scattering depth
+    WavefrontShadowQueue shadow_rays; // Shadow rays generated at the current scattering depth
+    std::vector<SurfaceScatteringEvent> scattering_events; // Intersection found for each ray at the current depth
+    std::vector<uint32_t> hit_ray_indices; // Indices of the rays at the current depth that hit a surface
+    std::vector<RadianceSpectrum> sample_radiances; // Radiance accumulated for each camera sample
+    OccluderCache occluder_cache; // The model that last occluded a shadow ray towards each light in the tile
+};
+
+// WavefrontIntegrator declarations
+
+/*
+Computes the same direct lighting and specular scattering as the Whitted integrator, but processes many
+camera samples at once in separate stages instead of following each sample depth first. For each scattering
+depth, all queued rays are intersected, the hits are sorted by material and shaded, and the resulting shadow
+rays are traced together, so that each stage works on a large array of similar work items.
+*/
+class WavefrontIntegrator : public SampleIntegrator {
+
+private:
+
+    const unsigned int max_scattering_count; // Maxium number of allowed scatterings for each eye ray
+    const unsigned int wavefront_size; // Maximum number of camera samples traced together
+
+    void intersectRays(const Scene& scene, WavefrontBuffers& buffers) const;
+
+    void shadeHits(const Scene& scene,
+                   WavefrontBuffers& buffers,
+                   RegionAllocator& allocator,
+                   unsigned int scattering_count) const;
+
+    void traceShadowRays(const Scene& scene, WavefrontBuffers& buffers) const;
+
+    void traceWavefront(const Scene& scene,
+                        WavefrontBuffers& buffers,
+                        RegionAllocator& allocator,
+                        unsigned int first_scattering_count = 0) const;
+
+protected:
+
+    std::unique_ptr<SensorRegion> renderTile(const Scene& scene,
+                                             const Tile& tile,
+                                             unsigned int first_sample_idx,
+                                             unsigned int n_samples,
+                                             imp_float error_threshold = 0);
+
+public:
+
+    WavefrontIntegrator(std::shared_ptr<const Camera> camera,
+                        std::shared_ptr<Sampler> sampler,
+                        unsigned int max_scattering_count,
+                        unsigned int wavefront_size);
+
+    RadianceSpectrum incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                      const Scene& scene,
+                                      Sampler& sampler,
+                                      RegionAllocator& allocator,
+                                      unsigned int scattering_count = 0,
+                                      OccluderCache* occluder_cache = nullptr) const;
+};
+
+// WavefrontIntegrator function declarations
+
+Integrator* createWavefrontIntegrator(std::shared_ptr<const Camera> camera,
+                                      std::shared_ptr<Sampler> sampler,
+                                      const ParameterSet& parameters);
+
+// WavefrontRayQueue inline method definitions
+
+inline size_t WavefrontRayQueue::size() const
+{
+    return origins.size();
+}
+
+inline bool WavefrontRayQueue::empty() const
+{
+    return origins.empty();
+}
+
+inline void WavefrontRayQueue::push(const RayWithOffsets& ray,
+                                    const Spectrum& weight,
+                                    uint32_t sample_idx,
+                                    uint64_t random_state)
+{
+    origins.push_back(ray.origin);
+    directions.push_back(ray.direction);
+    times.push_back(ray.time);
+    has_offsets.push_back(ray.has_offsets);
+    x_offset_origins.push_back(ray.x_offset_ray_origin);
+    x_offset_directions.push_back(ray.x_offset_ray_direction);
+    y_offset_origins.push_back(ray.y_offset_ray_origin);
+    y_offset_directions.push_back(ray.y_offset_ray_direction);
+    weights.push_back(weight);
+    sample_indices.push_back(sample_idx);
+    random_states.push_back(random_state);
+}
+
+inline RayWithOffsets WavefrontRayQueue::ray(size_t ray_idx) const
+{
+    RayWithOffsets ray(origins[ray_idx], directions[ray_idx], IMP_INFINITY, times[ray_idx]);
+
+    ray.has_offsets = has_offsets[ray_idx] != 0;
+    ray.x_offset_ray_origin = x_offset_origins[ray_idx];
+    ray.x_offset_ray_direction = x_offset_directions[ray_idx];
+    ray.y_offset_ray_origin = y_offset_origins[ray_idx];
+    ray.y_offset_ray_direction = y_offset_directions[ray_idx];
+
+    return ray;
+}
+
+// WavefrontShadowQueue inline method definitions
+
+inline size_t WavefrontShadowQueue::size() const
+{
+    return visibility_testers.size();
+}
+
+inline void WavefrontShadowQueue::push(const VisibilityTester& visibility_tester,
+                                       const RadianceSpectrum& contribution,
+                                       uint32_t sample_idx,
+                                       const Light* light)
+{
+    visibility_testers.push_back(visibility_tester);
+    contributions.push_back(contribution);
+    sample_indices.push_back(sample_idx);
+    lights.push_back(light);
+}
+
+// WavefrontIntegrator inline method definitions
+
+inline WavefrontIntegrator::WavefrontIntegrator(std::shared_ptr<const Camera> camera,
+                                                std::shared_ptr<Sampler> sampler,
+                                                unsigned int max_scattering_count,
+                                                unsigned int wavefront_size)
+    : SampleIntegrator::SampleIntegrator(camera, sampler),
+      max_scattering_count(max_scattering_count),
+      wavefront_size(wavefront_size)
+{}
+
+} // RayImpact
+} // Impact
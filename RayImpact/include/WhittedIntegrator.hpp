@@ -1,6 +1,9 @@
 #pragma once
 #include "Integrator.hpp"
 #include "ParameterSet.hpp"
+#include "LightSelector.hpp"
+#include <memory>
+#include <algorithm>
 
 namespace Impact {
 namespace RayImpact {
@@ -11,18 +14,53 @@ class WhittedIntegrator : public SampleIntegrator {
 
 private:
     const unsigned int max_scattering_count; // Maxium number of allowed scatterings for each eye ray
+    const LightSelectionStrategy light_selection_strategy; // Strategy for choosing which lights to sample at each scattering event
+    const unsigned int n_selected_lights; // Number of lights to select at each scattering event (unless all lights are sampled)
+    std::unique_ptr<LightSelector> light_selector; // Selects the lights to sample (null if all lights are sampled)
+    const bool culls_tile_lights; // Whether to skip lights that can not illuminate the eye ray intersections in a tile
+
+    RadianceSpectrum sampledLightRadiance(const Light& light,
+                                          const SurfaceScatteringEvent& scattering_event,
+                                          const Point2F& uniform_sample,
+                                          unsigned int n_light_samples,
+                                          imp_float selection_probability,
+                                          const Scene& scene,
+                                          ShadowRayBatch* shadow_ray_batch,
+                                          OccluderCache* occluder_cache) const;
 
 public:
 
     WhittedIntegrator(std::shared_ptr<const Camera> camera,
                       std::shared_ptr<Sampler> sampler,
-                      unsigned int max_scattering_count);
+                      unsigned int max_scattering_count,
+                      LightSelectionStrategy light_selection_strategy,
+                      unsigned int n_selected_lights,
+                      bool culls_tile_lights = false);
+
+    void preprocess(const Scene& scene, Sampler& sampler);
 
     RadianceSpectrum incidentRadiance(const RayWithOffsets& outgoing_ray,
                                       const Scene& scene,
                                       Sampler& sampler,
                                       RegionAllocator& allocator,
-                                      unsigned int scattering_count = 0) const;
+                                      unsigned int scattering_count = 0,
+                                      OccluderCache* occluder_cache = nullptr) const;
+
+protected:
+
+    bool supportsRayPackets() const;
+
+    bool usesTileLightLists() const;
+
+    RadianceSpectrum incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                      SurfaceScatteringEvent* scattering_event,
+                                                      const Scene& scene,
+                                                      Sampler& sampler,
+                                                      RegionAllocator& allocator,
+                                                      unsigned int scattering_count = 0,
+                                                      ShadowRayBatch* shadow_ray_batch = nullptr,
+                                                      const std::vector<Light*>* tile_lights = nullptr,
+                                                      OccluderCache* occluder_cache = nullptr) const;
 };
 
 // WhittedIntegrator function declarations
@@ -35,10 +73,28 @@ Integrator* createWhittedIntegrator(std::shared_ptr<const Camera> camera,
 
 inline WhittedIntegrator::WhittedIntegrator(std::shared_ptr<const Camera> camera,
 											std::shared_ptr<Sampler> sampler,
-											unsigned int max_scattering_count)
+											unsigned int max_scattering_count,
+											LightSelectionStrategy light_selection_strategy,
+											unsigned int n_selected_lights,
+											bool culls_tile_lights /* = false */)
     : SampleIntegrator::SampleIntegrator(camera, sampler),
-      max_scattering_count(max_scattering_count)
+      max_scattering_count(max_scattering_count),
+      light_selection_strategy(light_selection_strategy),
+      n_selected_lights(std::max(1u, n_selected_lights)),
+      light_selector(),
+      culls_tile_lights(culls_tile_lights)
 {}
 
+inline bool WhittedIntegrator::supportsRayPackets() const
+{
+    return true;
+}
+
+// Tile light lists only apply when every light is sampled
+inline bool WhittedIntegrator::usesTileLightLists() const
+{
+    return culls_tile_lights && light_selection_strategy == LightSelectionStrategy::ALL;
+}
+
 } // RayImpact
 } // Impact
@@ -1,6 +1,8 @@
 #pragma once
 #include "geometry.hpp"
 #include "ParameterSet.hpp"
+#include "TileScheduler.hpp"
+#include "DistributedRendering.hpp"
 #include <string>
 
 namespace Impact {
@@ -11,6 +13,21 @@ struct Options
     unsigned int n_threads = 0; // The number of threads to use for parallelization (determined automatically if set to 0)
     std::string image_filename = "out.pfm"; // The filename to use for the rendered image
 	int verbosity = 0;
+    bool use_huge_pages = true; // Whether to back large allocations with huge memory pages
+    std::string trace_filename = ""; // The filename to write a trace of the rendering phases to (no tracing if empty)
+    TileOrdering tile_ordering = TileOrdering::Hilbert; // Order in which the image tiles are rendered
+    int tile_extent = 0; // Width and height of the image tiles in pixels (determined automatically if set to 0)
+    unsigned int ray_packet_size = 0; // Number of eye rays (4, 8 or 16) to trace together as a packet for neighbouring pixels (no packets if set to 0)
+    unsigned int n_pass_samples = 0; // Number of samples per pixel to compute in each progressive pass (all in one pass if set to 0)
+    double snapshot_interval = 0; // Number of seconds between each intermediate image written during progressive rendering (none if set to 0)
+    unsigned int snapshot_pass_interval = 0; // Number of passes between each intermediate image written during progressive rendering (none if set to 0)
+    double time_budget = 0; // Number of seconds after which progressive rendering is stopped (no limit if set to 0)
+    std::string checkpoint_filename = ""; // The filename to periodically write the rendering state to and resume from (no checkpoints if empty)
+    double checkpoint_interval = 0; // Minimum number of seconds between each checkpoint (a checkpoint after every pass if set to 0)
+    imp_float adaptive_error_threshold = 0; // Relative error below which pixels stop receiving samples (no adaptive sampling if set to 0)
+    DistributedRole distributed_role = DistributedRole::None; // Part played by the process in rendering an image with multiple processes
+    std::string distributed_address = "localhost:47800"; // Address the coordinator listens on and the workers connect to ("host:port" or "unix:path")
+    double worker_timeout = 0; // Number of seconds the coordinator waits for a tile before handing it to another worker (no limit if set to 0)
 };
 
 extern Options RIMP_OPTIONS; // Global rendering options
@@ -14,7 +14,7 @@ namespace RayImpact {
 // Temporary forward declarations
 
 class BSSRDF{};
-enum class TransportMode{ Radiance };
+enum class TransportMode{ Radiance, Importance };
 class Medium{};
 class MediumInterface{ public: const Medium* inside; const Medium* outside; };
 
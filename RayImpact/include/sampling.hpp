@@ -4,6 +4,7 @@
 #include "RandomNumberGenerator.hpp"
 #include "geometry.hpp"
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include <cmath>
 
@@ -35,6 +36,34 @@ public:
     imp_float discretePDF(unsigned int idx) const;
 };
 
+// DistributionFunction2D declarations
+
+/*
+Piecewise-constant distribution over the unit square, given by a grid of values. A point is sampled by
+first choosing the v-coordinate from the marginal distribution of the row integrals, and then the
+u-coordinate from the conditional distribution of the chosen row.
+*/
+class DistributionFunction2D {
+
+private:
+
+    std::vector<DistributionFunction1D> conditional_distributions; // Distribution of the u-coordinate for each row
+    std::unique_ptr<DistributionFunction1D> marginal_distribution; // Distribution of the v-coordinate
+
+public:
+
+    DistributionFunction2D(const imp_float* values,
+                           unsigned int n_values_u,
+                           unsigned int n_values_v);
+
+    Point2F continuousSample(const Point2F& uniform_sample,
+                             imp_float* pdf_value) const;
+
+    imp_float pdf(const Point2F& point) const;
+
+    imp_float integral() const;
+};
+
 // Sampling function declarations
 
 // Fills the given array with stratified sample values covering the unit interval
@@ -68,6 +97,13 @@ Vector3F uniformHemisphereSample(const Point2F& uniform_sample);
 // Given a sample point inside the unit square, returns a cosine-weighted sampled direction vector in the unit hemisphere around the z-axis
 Vector3F cosineWeightedHemisphereSample(const Point2F& uniform_sample);
 
+// Given a sample point inside the unit square, returns a uniformly sampled direction vector on the unit sphere
+Vector3F uniformSphereSample(const Point2F& uniform_sample);
+
+// Given a sample point inside the unit square, returns a uniformly sampled direction vector inside the cone around
+// the z-axis with the given cosine of the angle between the cone axis and the cone surface
+Vector3F uniformConeSample(const Point2F& uniform_sample, imp_float cos_max_angle);
+
 // DistributionFunction1D inline method definitions
 
 inline unsigned int DistributionFunction1D::size() const
@@ -80,8 +116,52 @@ inline imp_float DistributionFunction1D::discretePDF(unsigned int idx) const
     return values[idx]/(integral*size());
 }
 
+// DistributionFunction2D inline method definitions
+
+inline imp_float DistributionFunction2D::integral() const
+{
+    return marginal_distribution->integral;
+}
+
 // Sampling inline function definitions
 
+// Computes the probability density, with respect to solid angle, of uniformly sampled directions on the unit sphere
+inline imp_float uniformSpherePDF()
+{
+    return IMP_ONE_OVER_FOUR_PI;
+}
+
+// Computes the probability density, with respect to solid angle, of cosine-weighted sampled directions in the
+// hemisphere, given the cosine of the angle between the direction and the hemisphere axis
+inline imp_float cosineWeightedHemispherePDF(imp_float cos_theta)
+{
+    return cos_theta*IMP_ONE_OVER_PI;
+}
+
+// Computes the probability density, with respect to solid angle, of uniformly sampled directions
+// inside a cone with the given cosine of the angle between the cone axis and the cone surface
+inline imp_float uniformConePDF(imp_float cos_max_angle)
+{
+    return 1/(IMP_TWO_PI*(1 - cos_max_angle));
+}
+
+// Computes the multiple importance sampling weight of a sample drawn from the first of two distributions,
+// given the number of samples and probability density of each distribution, using the power heuristic
+inline imp_float powerHeuristic(unsigned int n_samples_1, imp_float pdf_value_1,
+                                unsigned int n_samples_2, imp_float pdf_value_2)
+{
+    imp_float weight_1 = n_samples_1*pdf_value_1;
+    imp_float weight_2 = n_samples_2*pdf_value_2;
+
+    if (weight_1 == 0)
+        return 0;
+
+    if (std::isinf(weight_1*weight_1))
+        return 1;
+
+    return (weight_1*weight_1)/(weight_1*weight_1 + weight_2*weight_2);
+}
+
 // Shuffles the elements in the given array into a random order
 template <typename T>
 inline void shuffleArray(T* elements,
@@ -1,9 +1,15 @@
 #include "BSDF.hpp"
 #include "sampling.hpp"
+#include "statistics.hpp"
 
 namespace Impact {
 namespace RayImpact {
 
+// BSDF statistics variables
+
+IMP_STAT_COUNTER("BSDF evaluations", n_bsdf_evaluations);
+IMP_STAT_COUNTER("BSDF samples", n_bsdf_samples);
+
 // BXDF method definitions
 
 Spectrum BXDF::sample(const Vector3F& outgoing_direction,
@@ -90,6 +96,8 @@ Spectrum BSDF::evaluate(const Vector3F& world_outgoing_direction,
                         const Vector3F& world_incident_direction,
                         BXDFType type /* = BSDF_ALL */) const
 {
+    IMP_STAT_INCREMENT(n_bsdf_evaluations);
+
     bool is_reflection = world_outgoing_direction.dot(geometric_normal)*world_incident_direction.dot(geometric_normal) > 0;
 
     const Vector3F& outgoing_direction = worldToLocal(world_outgoing_direction);
@@ -110,13 +118,16 @@ Spectrum BSDF::evaluate(const Vector3F& world_outgoing_direction,
     return result;
 }
 
-Spectrum BSDF::reduced(const Vector3F& outgoing_direction,
+Spectrum BSDF::reduced(const Vector3F& world_outgoing_direction,
                        unsigned int n_samples,
                        const Point2F* samples,
                        BXDFType type /* = BSDF_ALL */) const
 {
     Spectrum result(0.0f);
 
+    // The BXDF components work in the local shading coordinate system
+    const Vector3F& outgoing_direction = worldToLocal(world_outgoing_direction);
+
     for (unsigned int i = 0; i < n_bxdfs; i++)
     {
         if (bxdfs[i]->containedIn(type))
@@ -149,6 +160,8 @@ Spectrum BSDF::sample(const Vector3F& world_outgoing_direction,
                       BXDFType type /* = BSDF_ALL */,
 					  BXDFType* sampled_type /* = nullptr */) const
 {
+    IMP_STAT_INCREMENT(n_bsdf_samples);
+
 	*pdf_value = 0;
 
     unsigned int n_matching_components = numberOfComponents(type);
@@ -176,7 +189,7 @@ Spectrum BSDF::sample(const Vector3F& world_outgoing_direction,
 	imp_assert(bxdf);
 
 	// Remap the first sample value to ensure that it is uniformly distributed
-	Point2F remapped_uniform_sample(n_matching_components*uniform_sample.x - count, uniform_sample.y);
+	Point2F remapped_uniform_sample(std::min(n_matching_components*uniform_sample.x - component, IMP_ONE_MINUS_EPS), uniform_sample.y);
 
 	Vector3F incident_direction;
 	const Vector3F& outgoing_direction = worldToLocal(world_outgoing_direction);
@@ -224,10 +237,23 @@ Spectrum BSDF::sample(const Vector3F& world_outgoing_direction,
 	return bsdf_value;
 }
 
-imp_float BSDF::pdf(const Vector3F& outgoing_direction,
-                    const Vector3F& incident_direction,
+// Computes the probability density of sampling the given incident direction with the sample method
+imp_float BSDF::pdf(const Vector3F& world_outgoing_direction,
+                    const Vector3F& world_incident_direction,
                     BXDFType type /* = BSDF_ALL */) const
 {
+	unsigned int n_matching_components = numberOfComponents(type);
+
+	if (n_matching_components == 0)
+		return 0;
+
+	// The BXDFs work with directions in the local shading coordinate system
+	const Vector3F& outgoing_direction = worldToLocal(world_outgoing_direction);
+	const Vector3F& incident_direction = worldToLocal(world_incident_direction);
+
+	if (outgoing_direction.z == 0)
+		return 0;
+
 	imp_float pdf_value = 0;
 
 	for (unsigned int i = 0; i < n_bxdfs; i++)
@@ -236,9 +262,7 @@ imp_float BSDF::pdf(const Vector3F& outgoing_direction,
 			pdf_value += bxdfs[i]->pdf(outgoing_direction, incident_direction);
 	}
 
-	pdf_value /= n_bxdfs;
-
-	return pdf_value;
+	return pdf_value/n_matching_components;
 }
 
 } // RayImpact
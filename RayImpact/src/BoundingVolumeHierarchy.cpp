@@ -6,15 +6,29 @@
 namespace Impact {
 namespace RayImpact {
 
+// BoundingVolumeHierarchy statistics variables
+
+IMP_STAT_RATIO("Coherent ray packets", n_coherent_ray_packets, n_ray_packets);
+IMP_STAT_RATIO("Packet box tests culled", n_culled_packet_box_tests, n_packet_box_tests);
+
 // BoundingVolumeHierarchy method definitions
 
-BoundingVolumeHierarchy::BoundingVolumeHierarchy(const std::vector< std::shared_ptr<Model> >& contained_models,
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(const std::vector<const Model*>& contained_models,
                                                  unsigned int max_models_in_node /* = 1 */,
                                                  SplitMethod split_method /* = SplitMethod::SAH */)
     : max_models_in_node(std::min(255u, max_models_in_node)),
       split_method(split_method),
-      models(contained_models)
+      models(contained_models.begin(), contained_models.end()),
+      model_bounding_boxes(),
+      memory(MemoryCategory::AccelerationStructure)
 {
+    model_bounding_boxes.reserve(models.size());
+
+    for (auto iter = models.begin(); iter != models.end(); iter++)
+        model_bounding_boxes.push_back((*iter)->worldSpaceBoundingBox());
+
+    memory.add(models.capacity()*sizeof(const Model*) + model_bounding_boxes.capacity()*sizeof(BoundingBoxF));
+
 	if (models.size() == 0)
         return;
 
@@ -28,7 +42,7 @@ BoundingVolumeHierarchy::BoundingVolumeHierarchy(const std::vector< std::shared_
 
     RegionAllocator allocator(1024*1024);
     unsigned int n_nodes_total = 0;
-    std::vector< std::shared_ptr<Model> > models_ordered;
+    std::vector<const Model*> models_ordered;
     BVHNode* root_node;
 
     // Build the BVH using the given split method
@@ -51,7 +65,7 @@ BVHNode* BoundingVolumeHierarchy::buildRecursive(RegionAllocator& allocator,
                                                  unsigned int start_model_idx,
                                                  unsigned int end_model_idx,
                                                  unsigned int* n_models_total,
-                                                 std::vector< std::shared_ptr<Model> >& models_ordered)
+                                                 std::vector<const Model*>& models_ordered)
 {
     // Allocate memory for new node
     BVHNode* node = allocator.allocate<BVHNode>();
@@ -219,6 +233,10 @@ bool BoundingVolumeHierarchy::intersect(const Ray& ray,
 		}
 	}
 
+	// Return the intersection distance via the ray max_distance attribute
+	if (has_intersection)
+		ray.max_distance = closest_distance;
+
 	return has_intersection;
 }
 
@@ -234,10 +252,135 @@ bool BoundingVolumeHierarchy::hasIntersection(const Ray& ray) const
 	return false;
 }
 
+const Model* BoundingVolumeHierarchy::occludingModel(const Ray& ray) const
+{
+    for (const Model* model : models)
+    {
+        const Model* occluder = model->occludingModel(ray);
+
+        if (occluder)
+            return occluder;
+    }
+
+    return nullptr;
+}
+
+// Finds the closest intersection of each ray in the packet. Coherent packets are tested against the bounding box
+// of each model as a whole before the individual rays are tested, and each ray is only intersected with the
+// models whose bounding boxes it passes through. Incoherent packets are traced one ray at a time.
+void BoundingVolumeHierarchy::intersectPacket(const RayPacket& packet,
+                                              SurfaceScatteringEvent* scattering_events,
+                                              bool* has_intersections) const
+{
+    imp_assert(scattering_events && has_intersections);
+
+    IMP_STAT_INCREMENT(n_ray_packets);
+
+    if (!packet.is_coherent)
+    {
+        Model::intersectPacket(packet, scattering_events, has_intersections);
+        return;
+    }
+
+    IMP_STAT_INCREMENT(n_coherent_ray_packets);
+
+    imp_float closest_distances[IMP_MAX_PACKET_SIZE]; // Distance to the closest intersection found so far for each ray
+
+    for (unsigned int ray_idx = 0; ray_idx < packet.n_rays; ray_idx++)
+    {
+        has_intersections[ray_idx] = false;
+        closest_distances[ray_idx] = packet.rays[ray_idx].max_distance;
+    }
+
+    for (size_t model_idx = 0; model_idx < models.size(); model_idx++)
+    {
+        const BoundingBoxF& bounding_box = model_bounding_boxes[model_idx];
+
+        IMP_STAT_INCREMENT(n_packet_box_tests);
+
+        if (!packet.mayIntersect(bounding_box))
+        {
+            IMP_STAT_INCREMENT(n_culled_packet_box_tests);
+            continue;
+        }
+
+        uint32_t ray_mask = packet.intersectingRays(bounding_box);
+
+        while (ray_mask)
+        {
+            unsigned int ray_idx = 0;
+            while (!(ray_mask & (1u << ray_idx)))
+                ray_idx++;
+
+            ray_mask &= ~(1u << ray_idx);
+
+            // Models are not required to shrink the max distance of the ray, so only closer intersections are accepted
+            SurfaceScatteringEvent tmp_scattering_event;
+            const Ray& ray = packet.rays[ray_idx];
+
+            if (models[model_idx]->intersect(ray, &tmp_scattering_event) && ray.max_distance <= closest_distances[ray_idx])
+            {
+                has_intersections[ray_idx] = true;
+                closest_distances[ray_idx] = ray.max_distance;
+                scattering_events[ray_idx] = tmp_scattering_event;
+            }
+
+            ray.max_distance = closest_distances[ray_idx];
+        }
+    }
+}
+
+// Tests each ray in the packet for an intersection and returns a bit mask with the bits of the intersecting
+// rays set. Coherent packets are culled against the model bounding boxes like in intersectPacket, and
+// rays that are already known to intersect are not tested again.
+uint32_t BoundingVolumeHierarchy::hasIntersectionPacket(const RayPacket& packet) const
+{
+    IMP_STAT_INCREMENT(n_ray_packets);
+
+    if (!packet.is_coherent)
+        return Model::hasIntersectionPacket(packet);
+
+    IMP_STAT_INCREMENT(n_coherent_ray_packets);
+
+    const uint32_t all_rays_mask = (packet.n_rays < 32)? (1u << packet.n_rays) - 1 : ~0u;
+
+    uint32_t intersecting_ray_mask = 0;
+
+    for (size_t model_idx = 0; model_idx < models.size() && intersecting_ray_mask != all_rays_mask; model_idx++)
+    {
+        const BoundingBoxF& bounding_box = model_bounding_boxes[model_idx];
+
+        IMP_STAT_INCREMENT(n_packet_box_tests);
+
+        if (!packet.mayIntersect(bounding_box))
+        {
+            IMP_STAT_INCREMENT(n_culled_packet_box_tests);
+            continue;
+        }
+
+        uint32_t ray_mask = packet.intersectingRays(bounding_box) & ~intersecting_ray_mask;
+
+        while (ray_mask)
+        {
+            unsigned int ray_idx = 0;
+            while (!(ray_mask & (1u << ray_idx)))
+                ray_idx++;
+
+            ray_mask &= ~(1u << ray_idx);
+
+            if (models[model_idx]->hasIntersection(packet.rays[ray_idx]))
+                intersecting_ray_mask |= 1u << ray_idx;
+        }
+    }
+
+    return intersecting_ray_mask;
+}
+
 // BoundingVolumeHierarchy function definitions
 
-std::shared_ptr<Model> createBoundingVolumeHierarchy(const std::vector< std::shared_ptr<Model> >& models,
-                                                     const ParameterSet& parameters)
+Model* createBoundingVolumeHierarchy(const std::vector<const Model*>& models,
+                                     const ParameterSet& parameters,
+                                     ObjectArena& arena)
 {
     unsigned int max_node_size = (unsigned int)std::abs(parameters.getSingleIntValue("max_node_size", 1));
     std::string split_method_name = parameters.getSingleStringValue("split_method", "sah");
@@ -269,9 +412,9 @@ std::shared_ptr<Model> createBoundingVolumeHierarchy(const std::vector< std::sha
 						 "Split method:", split_method_name.c_str());
 	}
 
-    return std::make_shared<BoundingVolumeHierarchy>(models,
-                                                     max_node_size,
-                                                     split_method);
+    return arena.create<BoundingVolumeHierarchy>(models,
+                                                 max_node_size,
+                                                 split_method);
 }
 
 } // RayImpact
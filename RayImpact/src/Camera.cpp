@@ -79,5 +79,64 @@ ProjectiveCamera::ProjectiveCamera(const AnimatedTransformation& camera_to_world
     raster_to_camera = camera_to_screen.inverted()*raster_to_screen;
 }
 
+// Computes the view bounds for a region of the sensor from the camera space rays through the lens center at the four
+// corners of the region, whose directions are scaled to unit depth. The rays through the region form a volume whose
+// points depend linearly on the sensor position, the lens position and the depth separately, so the volume is bounded
+// by the points at the extremes of each: the corners of the region, the corners of the square enclosing the lens, and
+// zero depth and the largest distance from the lens to the scene bounds.
+bool ProjectiveCamera::viewBoundsFromCornerRays(const Point3F corner_origins[4],
+                                                const Vector3F corner_directions[4],
+                                                const BoundingBoxF& scene_bounds,
+                                                BoundingBoxF* view_bounds) const
+{
+    if (camera_to_world.hasRotationalMotion())
+        return false;
+
+    // Find bounds on the lens over the shutter interval, so that no eye ray origin is outside them
+    const BoundingBoxF& lens_bounds = camera_to_world.encompassMotionInBoundingBox(BoundingBoxF(Point3F(-lens_radius, -lens_radius, 0),
+                                                                                                Point3F( lens_radius,  lens_radius, 0)));
+
+    imp_float max_depth = unionOf(scene_bounds, lens_bounds).diagonal().length();
+
+    BoundingBoxF camera_space_bounds;
+
+    for (unsigned int corner_idx = 0; corner_idx < 4; corner_idx++)
+    {
+        const Point3F& origin = corner_origins[corner_idx];
+        const Vector3F& direction = corner_directions[corner_idx];
+
+        if (lens_radius > 0)
+        {
+            // Rays from every point on the lens pass through the point where the ray through the lens center meets the plane of focus
+            const Point3F& focus_point = origin + direction*focal_distance;
+
+            if (focus_point.z >= 0)
+                return false;
+
+            imp_float max_focus_point_scale = max_depth/(-focus_point.z);
+
+            for (unsigned int lens_corner_idx = 0; lens_corner_idx < 4; lens_corner_idx++)
+            {
+                const Point3F lens_point((lens_corner_idx & 1)? lens_radius : -lens_radius,
+                                         (lens_corner_idx & 2)? lens_radius : -lens_radius,
+                                         0);
+
+                camera_space_bounds.enclose(lens_point);
+                camera_space_bounds.enclose(lens_point + (focus_point - lens_point)*max_focus_point_scale);
+            }
+        }
+        else
+        {
+            camera_space_bounds.enclose(origin);
+            camera_space_bounds.enclose(origin + direction*max_depth);
+        }
+    }
+
+    // Include every camera position during the shutter interval, and leave some room for rounding errors
+    *view_bounds = camera_to_world.encompassMotionInBoundingBox(camera_space_bounds).expanded(1e-3f*max_depth);
+
+    return true;
+}
+
 } // RayImpact
 } // Impact
@@ -3,6 +3,7 @@
 #include "ErrorFloat.hpp"
 #include "geometry.hpp"
 #include "api.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace Impact {
@@ -324,12 +325,35 @@ bool Cylinder::hasIntersection(const Ray& ray,
     return true;
 }
 
+// Samples a point uniformly by area on the partial cylinder
+ScatteringEvent Cylinder::sampleSurface(const Point2F& uniform_sample,
+                                        imp_float* pdf_value) const
+{
+    imp_float sample_y = ::Impact::lerp(y_min, y_max, uniform_sample.x);
+    imp_float sample_phi = uniform_sample.y*phi_max;
+
+    const Point3F sample_point(radius*std::sin(sample_phi), sample_y, radius*std::cos(sample_phi));
+
+    const Vector3F& sample_point_error = Vector3F(std::abs(sample_point.x), 0, std::abs(sample_point.z))*errorPowerBound(3);
+
+    Vector3F position_error;
+    const Point3F& position = (*object_to_world)(sample_point, sample_point_error, &position_error);
+
+    // dpdu x dpdv points towards the axis of the cylinder
+    const Normal3F& surface_normal = worldSpaceSurfaceNormal(Normal3F(-sample_point.x, 0, -sample_point.z));
+
+    *pdf_value = 1/surfaceArea();
+
+    return ScatteringEvent(position, position_error, Vector3F(0, 0, 0), surface_normal, MediumInterface(), 0);
+}
+
 // Cylinder function definitions
 
-std::shared_ptr<Shape> createCylinder(const Transformation* object_to_world,
-                                      const Transformation* world_to_object,
-                                      bool has_reverse_orientation,
-                                      const ParameterSet& parameters)
+Shape* createCylinder(const Transformation* object_to_world,
+                      const Transformation* world_to_object,
+                      bool has_reverse_orientation,
+                      const ParameterSet& parameters,
+                      ObjectArena& arena)
 {
     imp_float radius = parameters.getSingleFloatValue("radius", 1.0f);
     imp_float bottom = parameters.getSingleFloatValue("bottom", -1.0f);
@@ -357,12 +381,12 @@ std::shared_ptr<Shape> createCylinder(const Transformation* object_to_world,
 						 "Forward direction:", (*object_to_world)(Vector3F(0, 0, 1)).toString().c_str());
 	}
 
-    return std::make_shared<Cylinder>(object_to_world,
-                                      world_to_object,
-                                      has_reverse_orientation,
-                                      radius,
-                                      bottom*radius, top*radius,
-                                      sweep_angle);
+    return arena.create<Cylinder>(object_to_world,
+                                  world_to_object,
+                                  has_reverse_orientation,
+                                  radius,
+                                  bottom*radius, top*radius,
+                                  sweep_angle);
 }
 
 } // RayImpact
@@ -1,16 +1,51 @@
 #include "DiffuseAreaLight.hpp"
+#include "sampling.hpp"
 #include "api.hpp"
 #include <cmath>
 
 namespace Impact {
 namespace RayImpact {
 
+// DiffuseAreaLight method definitions
+
+// Samples a point uniformly on the surface and a cosine-weighted direction in the hemisphere around its normal
+RadianceSpectrum DiffuseAreaLight::sampleEmittedRadiance(const Point2F& position_sample,
+                                                         const Point2F& direction_sample,
+                                                         imp_float time,
+                                                         Ray* emitted_ray,
+                                                         Normal3F* surface_normal,
+                                                         imp_float* position_pdf_value,
+                                                         imp_float* direction_pdf_value) const
+{
+    ScatteringEvent light_event = shape->sampleSurface(position_sample, position_pdf_value);
+
+    light_event.medium_interface = medium_interface;
+    light_event.time = time;
+
+    *surface_normal = light_event.surface_normal;
+
+    const Vector3F& local_direction = cosineWeightedHemisphereSample(direction_sample);
+
+    *direction_pdf_value = cosineWeightedHemispherePDF(local_direction.z);
+
+    const Vector3F normal(light_event.surface_normal);
+    Vector3F tangent_1, tangent_2;
+    coordinateSystem(normal, &tangent_1, &tangent_2);
+
+    const Vector3F& direction = tangent_1*local_direction.x + tangent_2*local_direction.y + normal*local_direction.z;
+
+    *emitted_ray = light_event.spawnRay(direction);
+
+    return emittedRadiance(light_event, direction);
+}
+
 // DiffuseAreaLight function definitions
 
-std::shared_ptr<AreaLight> createDiffuseAreaLight(const Transformation& light_to_world,
-                                                  const MediumInterface& medium_interface,
-                                                  const ParameterSet& parameters,
-                                                  std::shared_ptr<Shape> shape)
+AreaLight* createDiffuseAreaLight(const Transformation& light_to_world,
+                                  const MediumInterface& medium_interface,
+                                  const ParameterSet& parameters,
+                                  const Shape* shape,
+                                  ObjectArena& arena)
 {
     const RadianceSpectrum& radiance = parameters.getSingleSpectrumValue("radiance", RadianceSpectrum(1.0f));
     unsigned int samples = (unsigned int)std::abs(parameters.getSingleIntValue("samples", 1));
@@ -26,11 +61,11 @@ std::shared_ptr<AreaLight> createDiffuseAreaLight(const Transformation& light_to
 						 "Samples:", samples);
 	}
 
-    return std::make_shared<DiffuseAreaLight>(light_to_world,
-                                              medium_interface,
-                                              radiance,
-                                              samples,
-                                              shape);
+    return arena.create<DiffuseAreaLight>(light_to_world,
+                                          medium_interface,
+                                          radiance,
+                                          samples,
+                                          shape);
 }
 
 } // RayImpact
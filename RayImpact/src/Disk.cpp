@@ -2,6 +2,7 @@
 #include "math.hpp"
 #include "geometry.hpp"
 #include "api.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace Impact {
@@ -171,12 +172,33 @@ bool Disk::hasIntersection(const Ray& ray,
     return true;
 }
 
+// Samples a point uniformly by area on the partial annulus
+ScatteringEvent Disk::sampleSurface(const Point2F& uniform_sample,
+                                    imp_float* pdf_value) const
+{
+    imp_float sample_radius = std::sqrt(::Impact::lerp(inner_radius*inner_radius, radius*radius, uniform_sample.x));
+    imp_float sample_phi = uniform_sample.y*phi_max;
+
+    const Point3F sample_point(sample_radius*std::sin(sample_phi), y, sample_radius*std::cos(sample_phi));
+
+    Vector3F position_error;
+    const Point3F& position = (*object_to_world)(sample_point, &position_error);
+
+    // dpdu x dpdv points along the negative y-axis
+    const Normal3F& surface_normal = worldSpaceSurfaceNormal(Normal3F(0, -1, 0));
+
+    *pdf_value = 1/surfaceArea();
+
+    return ScatteringEvent(position, position_error, Vector3F(0, 0, 0), surface_normal, MediumInterface(), 0);
+}
+
 // Disk function definitions
 
-std::shared_ptr<Shape> createDisk(const Transformation* object_to_world,
-                                  const Transformation* world_to_object,
-                                  bool has_reverse_orientation,
-                                  const ParameterSet& parameters)
+Shape* createDisk(const Transformation* object_to_world,
+                  const Transformation* world_to_object,
+                  bool has_reverse_orientation,
+                  const ParameterSet& parameters,
+                  ObjectArena& arena)
 {
     imp_float radius = parameters.getSingleFloatValue("radius", 1.0f);
     imp_float inner_radius = parameters.getSingleFloatValue("inner_radius", 0.0f);
@@ -202,12 +224,12 @@ std::shared_ptr<Shape> createDisk(const Transformation* object_to_world,
 						 "Forward direction:", (*object_to_world)(Vector3F(0, 0, 1)).toString().c_str());
 	}
 
-    return std::make_shared<Disk>(object_to_world,
-                                  world_to_object,
-                                  has_reverse_orientation,
-                                  radius, inner_radius,
-                                  height,
-                                  sweep_angle);
+    return arena.create<Disk>(object_to_world,
+                              world_to_object,
+                              has_reverse_orientation,
+                              radius, inner_radius,
+                              height,
+                              sweep_angle);
 }
 
 } // RayImpact
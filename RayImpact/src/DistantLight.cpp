@@ -1,5 +1,6 @@
 #include "DistantLight.hpp"
 #include "Scene.hpp"
+#include "sampling.hpp"
 #include "api.hpp"
 
 namespace Impact {
@@ -29,11 +30,36 @@ RadianceSpectrum DistantLight::sampleIncidentRadiance(const ScatteringEvent& sca
     return incident_radiance;
 }
 
+// Emits parallel rays from a disk that covers the bounding sphere of the scene as seen along the light direction
+RadianceSpectrum DistantLight::sampleEmittedRadiance(const Point2F& position_sample,
+                                                     const Point2F& direction_sample,
+                                                     imp_float time,
+                                                     Ray* emitted_ray,
+                                                     Normal3F* surface_normal,
+                                                     imp_float* position_pdf_value,
+                                                     imp_float* direction_pdf_value) const
+{
+    Vector3F disk_axis_1, disk_axis_2;
+    coordinateSystem(direction, &disk_axis_1, &disk_axis_2);
+
+    const Point2F& disk_sample = concentricDiskSample(position_sample);
+
+    const Point3F& origin = scene_center + (disk_axis_1*disk_sample.x + disk_axis_2*disk_sample.y - direction)*scene_radius;
+
+    *emitted_ray = Ray(origin, direction, IMP_INFINITY, time);
+    *surface_normal = Normal3F(direction);
+    *position_pdf_value = 1/(IMP_PI*scene_radius*scene_radius);
+    *direction_pdf_value = 1.0f;
+
+    return incident_radiance;
+}
+
 // DistantLight function definitions
 
-std::shared_ptr<Light> createDistantLight(const Transformation& light_to_world,
-                                          const MediumInterface& medium_interface,
-                                          const ParameterSet& parameters)
+Light* createDistantLight(const Transformation& light_to_world,
+                          const MediumInterface& medium_interface,
+                          const ParameterSet& parameters,
+                          ObjectArena& arena)
 {
     const Vector3F& direction = parameters.getSingleTripleValue("direction", Vector3F(0, 0, -1)).normalized();
     const RadianceSpectrum& radiance = parameters.getSingleSpectrumValue("radiance", RadianceSpectrum(1.0f));
@@ -49,9 +75,9 @@ std::shared_ptr<Light> createDistantLight(const Transformation& light_to_world,
 						 "Direction:", light_to_world(direction).toString().c_str());
 	}
 
-    return std::make_shared<DistantLight>(light_to_world,
-                                          direction,
-                                          radiance);
+    return arena.create<DistantLight>(light_to_world,
+                                      direction,
+                                      radiance);
 }
 
 } // RayImpact
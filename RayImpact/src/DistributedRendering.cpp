@@ -0,0 +1,475 @@
+#include "DistributedRendering.hpp"
+#include "error.hpp"
+#include "parallel.hpp"
+#include "tracing.hpp"
+#include "Sensor.hpp"
+#include "api.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Impact {
+namespace RayImpact {
+
+// Distributed rendering protocol declarations
+
+// Every message starts with a header, followed by a message structure and possibly an array of pixel values.
+// Values are sent in the native byte order, so all processes must run on machines of the same architecture.
+
+static const uint32_t protocol_version = 1; // Version of the message layout (must match between coordinator and workers)
+
+enum class MessageType : uint32_t
+{
+    Hello = 1,  // Sent by a worker when connecting, with a HelloMessage
+    Accept,     // Sent by the coordinator if the worker has the same settings
+    Reject,     // Sent by the coordinator if the worker has different settings
+    AssignTile, // Sent by the coordinator with a TileAssignmentMessage
+    TileResult, // Sent by a worker with a TileResultMessage and the pixel values of the tile
+    Finish      // Sent by the coordinator when there are no more tiles to render
+};
+
+struct MessageHeader
+{
+    uint32_t type; // Type of the message
+    uint32_t n_bytes; // Number of bytes following the header
+};
+
+struct HelloMessage
+{
+    uint32_t protocol_version; // Version of the protocol used by the worker
+    uint32_t float_size; // Number of bytes in the floating-point values sent by the worker
+    int32_t sampling_bounds[4]; // Sampling bounds of the worker's sensor
+    uint32_t n_samples_per_pixel; // Total number of samples per pixel of the worker's sampler
+    uint32_t n_pass_samples; // Number of samples per pixel in each pass
+};
+
+struct TileAssignmentMessage
+{
+    int32_t bounds[4]; // Bounds of the pixels to sample
+    uint32_t base_tile_idx; // Index of the base tile that the tile covers all or part of
+    uint32_t seed; // Seed for the sampler of the tile
+    uint32_t first_sample_idx; // Index of the first sample to compute for each pixel
+    uint32_t n_samples; // Number of samples to compute for each pixel
+};
+
+struct TileResultMessage
+{
+    int32_t pixel_bounds[4]; // Bounds of the sensor pixels that the tile contributed to (four values follow for each)
+};
+
+// Distributed rendering utility functions
+
+static bool sendMessage(Socket& connection, MessageType type,
+                        const void* message = nullptr, size_t message_size = 0,
+                        const void* values = nullptr, size_t values_size = 0)
+{
+    MessageHeader header = {(uint32_t)type, (uint32_t)(message_size + values_size)};
+
+    return connection.sendAll(&header, sizeof(header)) &&
+           (message_size == 0 || connection.sendAll(message, message_size)) &&
+           (values_size == 0 || connection.sendAll(values, values_size));
+}
+
+static bool receiveMessageHeader(Socket& connection, MessageHeader* header, double timeout_seconds = 0)
+{
+    if (timeout_seconds > 0 && !connection.waitUntilReadable(timeout_seconds))
+        return false;
+
+    return connection.receiveAll(header, sizeof(MessageHeader));
+}
+
+static void storeBounds(const BoundingRectangleI& bounds, int32_t* values)
+{
+    values[0] = bounds.lower_corner.x;
+    values[1] = bounds.lower_corner.y;
+    values[2] = bounds.upper_corner.x;
+    values[3] = bounds.upper_corner.y;
+}
+
+static BoundingRectangleI loadBounds(const int32_t* values)
+{
+    BoundingRectangleI bounds;
+
+    bounds.lower_corner = Point2I(values[0], values[1]);
+    bounds.upper_corner = Point2I(values[2], values[3]);
+
+    return bounds;
+}
+
+static HelloMessage createHelloMessage(const Sensor& sensor,
+                                       unsigned int n_samples_per_pixel,
+                                       unsigned int n_pass_samples)
+{
+    HelloMessage message;
+
+    message.protocol_version = protocol_version;
+    message.float_size = (uint32_t)sizeof(imp_float);
+    storeBounds(sensor.samplingBounds(), message.sampling_bounds);
+    message.n_samples_per_pixel = n_samples_per_pixel;
+    message.n_pass_samples = n_pass_samples;
+
+    return message;
+}
+
+// RenderCoordinator method definitions
+
+RenderCoordinator::RenderCoordinator(Sensor& sensor,
+                                     TileScheduler& scheduler,
+                                     unsigned int n_samples_per_pixel,
+                                     unsigned int n_pass_samples,
+                                     const std::string& address,
+                                     double worker_timeout /* = 0 */)
+    : sensor(sensor),
+      scheduler(scheduler),
+      n_samples_per_pixel(n_samples_per_pixel),
+      n_pass_samples(n_pass_samples),
+      address(address),
+      worker_timeout(worker_timeout),
+      listener(),
+      accept_thread(),
+      connection_threads(),
+      mutex(),
+      condition(),
+      first_sample_idx(0),
+      n_samples(0),
+      pass_is_active(false),
+      is_finished(false),
+      n_outstanding_tiles(0),
+      n_connected_workers(0)
+{}
+
+RenderCoordinator::~RenderCoordinator()
+{
+    finish();
+}
+
+// Starts listening for workers. Returns false if the address could not be listened on.
+bool RenderCoordinator::start()
+{
+    listener = Socket::listenOn(address);
+
+    if (!listener.isOpen())
+        return false;
+
+    accept_thread = std::thread(&RenderCoordinator::acceptWorkers, this);
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        printInfoMessage("Coordinating workers on \"%s\"", address.c_str());
+
+    return true;
+}
+
+// Hands out the tiles queued in the scheduler for the given range of samples and
+// waits until the results for all of them have been merged into the sensor
+void RenderCoordinator::renderPass(unsigned int pass_first_sample_idx, unsigned int pass_n_samples)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    first_sample_idx = pass_first_sample_idx;
+    n_samples = pass_n_samples;
+    pass_is_active = true;
+
+    if (n_connected_workers == 0 && RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        printInfoMessage("Waiting for workers to connect");
+
+    condition.notify_all();
+
+    condition.wait(lock, [&]() { return n_outstanding_tiles == 0 && scheduler.numberOfQueuedTiles() == 0; });
+
+    pass_is_active = false;
+}
+
+// Dismisses all workers and waits for the connection threads to finish
+void RenderCoordinator::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_finished = true;
+    }
+
+    condition.notify_all();
+
+    if (accept_thread.joinable())
+        accept_thread.join();
+
+    for (std::thread& connection_thread : connection_threads)
+        connection_thread.join();
+
+    connection_threads.clear();
+
+    listener.close();
+}
+
+// Accepts connections from workers until the rendering is finished, serving each on a separate thread
+void RenderCoordinator::acceptWorkers()
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (is_finished)
+                break;
+        }
+
+        // Wake up regularly to check whether the rendering has finished
+        if (!listener.waitUntilReadable(0.25))
+            continue;
+
+        Socket connection = listener.acceptConnection();
+
+        if (!connection.isOpen())
+            continue;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        connection_threads.emplace_back(&RenderCoordinator::serveWorker, this, std::move(connection));
+    }
+}
+
+// Verifies that the worker on the given connection uses the same settings, and then
+// assigns tiles to it until the rendering is finished or the connection fails
+void RenderCoordinator::serveWorker(Socket connection)
+{
+    const double handshake_timeout = 10;
+
+    MessageHeader header;
+    HelloMessage hello;
+
+    if (!receiveMessageHeader(connection, &header, handshake_timeout) ||
+        header.type != (uint32_t)MessageType::Hello ||
+        header.n_bytes != sizeof(HelloMessage) ||
+        !connection.receiveAll(&hello, sizeof(HelloMessage)))
+        return;
+
+    const HelloMessage& expected_hello = createHelloMessage(sensor, n_samples_per_pixel, n_pass_samples);
+
+    if (hello.protocol_version != expected_hello.protocol_version ||
+        hello.float_size != expected_hello.float_size ||
+        !std::equal(hello.sampling_bounds, hello.sampling_bounds + 4, expected_hello.sampling_bounds) ||
+        hello.n_samples_per_pixel != expected_hello.n_samples_per_pixel ||
+        hello.n_pass_samples != expected_hello.n_pass_samples)
+    {
+        printWarningMessage("rejected a worker with different scene or sampling settings");
+        sendMessage(connection, MessageType::Reject);
+        return;
+    }
+
+    if (!sendMessage(connection, MessageType::Accept))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        n_connected_workers++;
+    }
+
+    std::vector<imp_float> pixel_values;
+
+    Tile tile;
+    unsigned int tile_first_sample_idx;
+    unsigned int tile_n_samples;
+
+    bool connection_is_alive = true;
+
+    while (connection_is_alive && acquireTile(&tile, &tile_first_sample_idx, &tile_n_samples))
+    {
+        auto start_time = std::chrono::steady_clock::now();
+
+        TileAssignmentMessage assignment;
+        storeBounds(tile.bounds, assignment.bounds);
+        assignment.base_tile_idx = tile.base_tile_idx;
+        assignment.seed = tile.seed;
+        assignment.first_sample_idx = tile_first_sample_idx;
+        assignment.n_samples = tile_n_samples;
+
+        TileResultMessage result;
+
+        connection_is_alive = sendMessage(connection, MessageType::AssignTile, &assignment, sizeof(assignment)) &&
+                              receiveMessageHeader(connection, &header, worker_timeout) &&
+                              header.type == (uint32_t)MessageType::TileResult &&
+                              header.n_bytes >= sizeof(TileResultMessage) &&
+                              connection.receiveAll(&result, sizeof(TileResultMessage));
+
+        if (connection_is_alive)
+        {
+            const BoundingRectangleI& pixel_bounds = loadBounds(result.pixel_bounds);
+
+            size_t n_values = 4*(size_t)std::max(0, pixel_bounds.area());
+
+            pixel_values.resize(n_values);
+
+            connection_is_alive = header.n_bytes == sizeof(TileResultMessage) + n_values*sizeof(imp_float) &&
+                                  connection.receiveAll(pixel_values.data(), n_values*sizeof(imp_float)) &&
+                                  sensor.mergePixelValues(pixel_bounds, pixel_values.data());
+        }
+
+        completeTile(tile, connection_is_alive, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+    }
+
+    if (connection_is_alive)
+        sendMessage(connection, MessageType::Finish);
+    else
+        printWarningMessage("lost connection to a worker. Its tile will be rendered by another worker.");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    n_connected_workers--;
+}
+
+// Waits for a tile of the current pass to become available and returns it along with the range of samples to compute.
+// Returns false when the rendering is finished.
+bool RenderCoordinator::acquireTile(Tile* tile, unsigned int* tile_first_sample_idx, unsigned int* tile_n_samples)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    bool has_tile = false;
+
+    condition.wait(lock, [&]() { return (has_tile = pass_is_active && scheduler.nextTile(tile)) || is_finished; });
+
+    if (!has_tile)
+        return false;
+
+    n_outstanding_tiles++;
+
+    *tile_first_sample_idx = first_sample_idx;
+    *tile_n_samples = n_samples;
+
+    return true;
+}
+
+// Records that a handed out tile has either been merged into the sensor or must be handed out again
+void RenderCoordinator::completeTile(const Tile& tile, bool was_merged, double cost)
+{
+    if (was_merged)
+        scheduler.addTileCost(tile.base_tile_idx, cost);
+    else
+        scheduler.requeueTile(tile);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        n_outstanding_tiles--;
+    }
+
+    condition.notify_all();
+}
+
+// Distributed rendering function definitions
+
+// Renders tiles handed out by the coordinator at the given address until it has no more tiles.
+// Each thread connects separately, so that the coordinator can keep all of them busy.
+void runRenderWorker(const std::string& address,
+                     const Sensor& sensor,
+                     unsigned int n_samples_per_pixel,
+                     unsigned int n_pass_samples,
+                     const std::function<std::unique_ptr<SensorRegion> (const Tile&, unsigned int, unsigned int)>& render_tile)
+{
+    const double connection_timeout = 30;
+    const double connection_retry_interval = 0.5;
+
+    const HelloMessage& hello = createHelloMessage(sensor, n_samples_per_pixel, n_pass_samples);
+
+    std::atomic<unsigned int> n_rendered_tiles(0);
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        printInfoMessage("Rendering tiles for the coordinator on \"%s\"", address.c_str());
+
+    parallelFor(
+    [&](uint64_t thread_idx)
+    {
+        // Keep trying to connect for a while, since the coordinator may still be loading the scene
+        Socket connection;
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        while (!(connection = Socket::connectTo(address)).isOpen())
+        {
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count() > connection_timeout)
+            {
+                printErrorMessage("could not connect to the coordinator on \"%s\"", address.c_str());
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(connection_retry_interval));
+        }
+
+        MessageHeader header;
+
+        if (!sendMessage(connection, MessageType::Hello, &hello, sizeof(hello)) ||
+            !receiveMessageHeader(connection, &header))
+            return;
+
+        if (header.type != (uint32_t)MessageType::Accept)
+        {
+            if (thread_idx == 0)
+                printErrorMessage("the coordinator on \"%s\" uses different scene or sampling settings", address.c_str());
+
+            return;
+        }
+
+        std::vector<imp_float> pixel_values;
+
+        // Render assigned tiles until told to finish or the connection is lost
+        while (receiveMessageHeader(connection, &header) &&
+               header.type == (uint32_t)MessageType::AssignTile &&
+               header.n_bytes == sizeof(TileAssignmentMessage))
+        {
+            TileAssignmentMessage assignment;
+
+            if (!connection.receiveAll(&assignment, sizeof(assignment)))
+                break;
+
+            Tile tile = {loadBounds(assignment.bounds), assignment.base_tile_idx, assignment.seed};
+
+            std::unique_ptr<SensorRegion> sensor_region = render_tile(tile, assignment.first_sample_idx, assignment.n_samples);
+
+            TileResultMessage result;
+            storeBounds(sensor_region->pixelBounds(), result.pixel_bounds);
+
+            pixel_values.resize(4*(size_t)std::max(0, sensor_region->pixelBounds().area()));
+            sensor_region->computePixelValues(pixel_values.data());
+
+            {
+                IMP_TRACE_SCOPE("Send tile result");
+
+                if (!sendMessage(connection, MessageType::TileResult, &result, sizeof(result),
+                                 pixel_values.data(), pixel_values.size()*sizeof(imp_float)))
+                    break;
+            }
+
+            n_rendered_tiles++;
+        }
+    },
+    IMP_N_THREADS);
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        printInfoMessage("Rendered %u tiles for the coordinator", n_rendered_tiles.load());
+}
+
+bool parseDistributedRole(const std::string& name, DistributedRole* role)
+{
+    imp_assert(role);
+
+    if (name == "none")
+        *role = DistributedRole::None;
+    else if (name == "coordinator")
+        *role = DistributedRole::Coordinator;
+    else if (name == "worker")
+        *role = DistributedRole::Worker;
+    else
+        return false;
+
+    return true;
+}
+
+const char* distributedRoleName(DistributedRole role)
+{
+    switch (role)
+    {
+        case DistributedRole::None:        return "none";
+        case DistributedRole::Coordinator: return "coordinator";
+        case DistributedRole::Worker:      return "worker";
+        default:                           return "unknown";
+    }
+}
+
+} // RayImpact
+} // Impact
@@ -0,0 +1,220 @@
+#include "InfiniteLight.hpp"
+#include "Scene.hpp"
+#include "spherical.hpp"
+#include "image_util.hpp"
+#include "api.hpp"
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// InfiniteLight method definitions
+
+// The radiance map is given as RGB triples, row by row from the top of the map
+InfiniteLight::InfiniteLight(const Transformation& light_to_world,
+                             const RadianceSpectrum& radiance_scale,
+                             const imp_float* rgb_values,
+                             unsigned int map_width,
+                             unsigned int map_height,
+                             unsigned int n_samples)
+    : Light::Light(LightFlags(LIGHT_IS_INFINITE),
+                   light_to_world,
+                   MediumInterface(),
+                   n_samples),
+      radiance_scale(radiance_scale),
+      map_width(map_width),
+      map_height(map_height),
+      radiance_map(map_width*map_height),
+      distribution(),
+      integrated_radiance(0.0f),
+      scene_center(),
+      scene_radius(0)
+{
+    std::vector<imp_float> distribution_values(map_width*map_height);
+
+    imp_float texel_solid_angle_scale = (IMP_TWO_PI/map_width)*(IMP_PI/map_height);
+
+    for (unsigned int j = 0; j < map_height; j++)
+    {
+        imp_float sin_theta = std::sin(IMP_PI*(j + 0.5f)/map_height);
+
+        for (unsigned int i = 0; i < map_width; i++)
+        {
+            unsigned int texel_idx = j*map_width + i;
+
+            radiance_map[texel_idx] = (RadianceSpectrum::fromRGBValues(rgb_values + 3*texel_idx, SpectrumType::Illumination)*radiance_scale).clamped();
+
+            // Weight each texel by the solid angle it subtends, which is proportional to sin(theta)
+            distribution_values[texel_idx] = radiance_map[texel_idx].tristimulusY()*sin_theta;
+
+            integrated_radiance += radiance_map[texel_idx]*(sin_theta*texel_solid_angle_scale);
+        }
+    }
+
+    distribution.reset(new DistributionFunction2D(distribution_values.data(), map_width, map_height));
+
+    if (distribution->integral() == 0)
+        printWarningMessage("radiance map of infinite light is black");
+}
+
+void InfiniteLight::preprocess(const Scene& scene)
+{
+    scene.worldSpaceBoundingBox().boundingSphere(&scene_center, &scene_radius);
+}
+
+// Returns the light space direction corresponding to the given point in the unit square of the map
+Vector3F InfiniteLight::mapPointToDirection(const Point2F& map_point, imp_float* sin_theta) const
+{
+    imp_float theta = map_point.y*IMP_PI;
+    imp_float phi = map_point.x*IMP_TWO_PI;
+
+    *sin_theta = std::sin(theta);
+
+    return sphericalToDirection(std::cos(theta), *sin_theta, phi);
+}
+
+// Returns the point in the unit square of the map corresponding to the given normalized light space direction
+Point2F InfiniteLight::directionToMapPoint(const Vector3F& direction, imp_float* sin_theta) const
+{
+    imp_float theta = sphericalTheta(direction);
+
+    *sin_theta = std::sin(theta);
+
+    return Point2F(sphericalPhi(direction)*IMP_ONE_OVER_TWO_PI, theta*IMP_ONE_OVER_PI);
+}
+
+RadianceSpectrum InfiniteLight::sampleIncidentRadiance(const ScatteringEvent& scattering_event,
+                                                       const Point2F& uniform_sample,
+                                                       Vector3F* incident_direction,
+                                                       imp_float* pdf_value,
+                                                       VisibilityTester* visibility_tester) const
+{
+    imp_float map_pdf_value;
+    const Point2F& map_point = distribution->continuousSample(uniform_sample, &map_pdf_value);
+
+    imp_float sin_theta;
+    *incident_direction = light_to_world(mapPointToDirection(map_point, &sin_theta));
+
+    if (!(map_pdf_value > 0) || sin_theta == 0)
+    {
+        *pdf_value = 0;
+        return RadianceSpectrum(0.0f);
+    }
+
+    // Convert the density with respect to area in the map to a density with respect to solid angle
+    *pdf_value = map_pdf_value/(IMP_TWO_PI*IMP_PI*sin_theta);
+
+    const Point3F& outside_point = scattering_event.position + (*incident_direction)*(2*scene_radius);
+
+    *visibility_tester = VisibilityTester(ScatteringEvent(outside_point, medium_interface, scattering_event.time), scattering_event);
+
+    return lookupRadiance(map_point);
+}
+
+imp_float InfiniteLight::incidentRadiancePDF(const ScatteringEvent& scattering_event,
+                                             const Vector3F& incident_direction) const
+{
+    imp_float sin_theta;
+    const Point2F& map_point = directionToMapPoint(world_to_light(incident_direction).normalized(), &sin_theta);
+
+    if (sin_theta == 0)
+        return 0;
+
+    return distribution->pdf(map_point)/(IMP_TWO_PI*IMP_PI*sin_theta);
+}
+
+// Returns the radiance arriving along the given ray if it escapes the scene
+RadianceSpectrum InfiniteLight::emittedRadianceFromDirection(const RayWithOffsets& ray) const
+{
+    imp_float sin_theta;
+    return lookupRadiance(directionToMapPoint(world_to_light(ray.direction).normalized(), &sin_theta));
+}
+
+// Samples a direction from the radiance map and emits a parallel ray from a disk that covers
+// the bounding sphere of the scene as seen from that direction
+RadianceSpectrum InfiniteLight::sampleEmittedRadiance(const Point2F& position_sample,
+                                                      const Point2F& direction_sample,
+                                                      imp_float time,
+                                                      Ray* emitted_ray,
+                                                      Normal3F* surface_normal,
+                                                      imp_float* position_pdf_value,
+                                                      imp_float* direction_pdf_value) const
+{
+    imp_float map_pdf_value;
+    const Point2F& map_point = distribution->continuousSample(direction_sample, &map_pdf_value);
+
+    imp_float sin_theta;
+    const Vector3F& direction_to_light = light_to_world(mapPointToDirection(map_point, &sin_theta));
+
+    if (!(map_pdf_value > 0) || sin_theta == 0)
+    {
+        *position_pdf_value = 0;
+        *direction_pdf_value = 0;
+        return RadianceSpectrum(0.0f);
+    }
+
+    Vector3F disk_axis_1, disk_axis_2;
+    coordinateSystem(direction_to_light, &disk_axis_1, &disk_axis_2);
+
+    const Point2F& disk_sample = concentricDiskSample(position_sample);
+
+    const Point3F& origin = scene_center + (disk_axis_1*disk_sample.x + disk_axis_2*disk_sample.y + direction_to_light)*scene_radius;
+
+    *emitted_ray = Ray(origin, -direction_to_light, IMP_INFINITY, time);
+    *surface_normal = Normal3F(-direction_to_light);
+    *position_pdf_value = 1/(IMP_PI*scene_radius*scene_radius);
+    *direction_pdf_value = map_pdf_value/(IMP_TWO_PI*IMP_PI*sin_theta);
+
+    return lookupRadiance(map_point);
+}
+
+// InfiniteLight function definitions
+
+Light* createInfiniteLight(const Transformation& light_to_world,
+                           const MediumInterface& medium_interface,
+                           const ParameterSet& parameters,
+                           ObjectArena& arena)
+{
+    const RadianceSpectrum& radiance = parameters.getSingleSpectrumValue("radiance", RadianceSpectrum(1.0f));
+    const std::string& filename = parameters.getSingleStringValue("filename", "");
+    unsigned int samples = (unsigned int)std::abs(parameters.getSingleIntValue("samples", 1));
+
+    // Without a radiance map the light emits the given radiance uniformly
+    std::vector<imp_float> rgb_values(3, 1.0f);
+    unsigned int map_width = 1;
+    unsigned int map_height = 1;
+
+    if (!filename.empty() && !readPFM(filename, &rgb_values, &map_width, &map_height))
+    {
+        printErrorMessage("could not read radiance map for infinite light. Using constant radiance.");
+
+        rgb_values.assign(3, 1.0f);
+        map_width = 1;
+        map_height = 1;
+    }
+
+	if (RIMP_OPTIONS.verbosity >= IMP_LIGHTS_VERBOSITY)
+	{
+		printInfoMessage("Light:"
+						 "\n    %-20s%s"
+						 "\n    %-20s%s W/sr/m^2"
+						 "\n    %-20s%s"
+						 "\n    %-20s%u x %u"
+						 "\n    %-20s%u",
+						 "Type:", "Infinite",
+						 "Radiance scale:", radiance.toRGBString().c_str(),
+						 "Radiance map:", (filename.empty())? "none" : filename.c_str(),
+						 "Map resolution:", map_width, map_height,
+						 "Samples:", samples);
+	}
+
+    return arena.create<InfiniteLight>(light_to_world,
+                                       radiance,
+                                       rgb_values.data(),
+                                       map_width,
+                                       map_height,
+                                       samples);
+}
+
+} // RayImpact
+} // Impact
@@ -5,97 +5,61 @@
 #include "BoundingRectangle.hpp"
 #include "Sensor.hpp"
 #include "BSDF.hpp"
+#include "statistics.hpp"
+#include "tracing.hpp"
+#include "string_util.hpp"
+#include "file_util.hpp"
+#include "api.hpp"
 #include <algorithm>
 #include <cmath>
+#include <chrono>
 
 namespace Impact {
 namespace RayImpact {
 
-// SampleIntegrator method definitions
-
-RadianceSpectrum SampleIntegrator::specularlyReflectedRadiance(const RayWithOffsets& outgoing_ray,
-                                                               const SurfaceScatteringEvent& scattering_event,
-                                                               const Scene& scene,
-                                                               Sampler& sampler,
-                                                               RegionAllocator& allocator,
-                                                               unsigned int scattering_count) const
-{
-    const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
-    Vector3F incident_direction;
-
-    imp_float pdf_value;
-
-    BXDFType type = BXDFType(BSDF_REFLECTION | BSDF_SPECULAR);
-
-    const Spectrum& bsdf_value = scattering_event.bsdf->sample(outgoing_direction,
-                                                               &incident_direction,
-                                                               sampler.next2DSampleComponent(),
-                                                               &pdf_value,
-                                                               type);
-
-    const Normal3F& shading_normal = scattering_event.shading.surface_normal;
-
-    imp_float abs_cos_theta_incident = incident_direction.absDot(shading_normal);
-
-    if (pdf_value > 0 && !bsdf_value.isBlack() && abs_cos_theta_incident != 0)
-    {
-        RayWithOffsets incident_ray = scattering_event.spawnRay(incident_direction);
-
-        if (outgoing_ray.has_offsets)
-        {
-            incident_ray.has_offsets = true;
-
-            incident_ray.x_offset_ray_origin = scattering_event.position + scattering_event.dpdx;
-            incident_ray.y_offset_ray_origin = scattering_event.position + scattering_event.dpdy;
-
-            const Normal3F& dndx = scattering_event.shading.dndu*scattering_event.dudx +
-                                   scattering_event.shading.dndv*scattering_event.dvdx;
-
-            const Normal3F& dndy = scattering_event.shading.dndu*scattering_event.dudy +
-                                   scattering_event.shading.dndv*scattering_event.dvdy;
-
-            const Vector3F& dwodx = -outgoing_ray.x_offset_ray_direction - outgoing_direction;
-            const Vector3F& dwody = -outgoing_ray.y_offset_ray_direction - outgoing_direction;
-
-            imp_float dwodotndx = dwodx.dot(shading_normal) + outgoing_direction.dot(dndx);
-            imp_float dwodotndy = dwody.dot(shading_normal) + outgoing_direction.dot(dndy);
+// Integrator statistics variables
 
-            imp_float cos_theta_outgoing = outgoing_direction.dot(shading_normal);
+IMP_STAT_RATE("Camera rays", n_camera_rays);
+IMP_STAT_RATE("Specular rays", n_specular_rays);
+IMP_STAT_RATIO("Lights per tile light list", n_tile_lights, n_tile_light_lists);
 
-            incident_ray.x_offset_ray_direction = incident_direction -
-                                                  dwodx +
-                                                  2.0f*Vector3F(cos_theta_outgoing*dndx + dwodotndx*shading_normal);
+// Integrator utility functions
 
-            incident_ray.y_offset_ray_direction = incident_direction -
-                                                  dwody +
-                                                  2.0f*Vector3F(cos_theta_outgoing*dndy + dwodotndy*shading_normal);
-        }
+// Computes a seed for the samples of the given pixel that is unique among all pixels and sample ranges,
+// so that the samples do not depend on how the pixels were grouped into tiles or distributed among threads
+static unsigned int pixelSampleSeed(const BoundingRectangleI& sampling_bounds,
+                                    const Point2I& pixel,
+                                    unsigned int first_sample_idx)
+{
+    int sampling_width = sampling_bounds.upper_corner.x - sampling_bounds.lower_corner.x;
 
-        return bsdf_value*
-               incidentRadiance(incident_ray, scene, sampler, allocator, scattering_count + 1)*
-               (abs_cos_theta_incident/pdf_value);
-    }
-    else
-        return Spectrum(0.0f);
+    return (unsigned int)((uint64_t)first_sample_idx*(uint64_t)sampling_bounds.area() +
+                          (uint64_t)(sampling_width*(pixel.y - sampling_bounds.lower_corner.y) +
+                                                    (pixel.x - sampling_bounds.lower_corner.x)));
 }
 
-RadianceSpectrum SampleIntegrator::specularlyTransmittedRadiance(const RayWithOffsets& outgoing_ray,
-                                                                 const SurfaceScatteringEvent& scattering_event,
-                                                                 const Scene& scene,
-                                                                 Sampler& sampler,
-                                                                 RegionAllocator& allocator,
-                                                                 unsigned int scattering_count) const
+// SampleIntegrator method definitions
+
+// Samples the given type of specular scattering at the scattering event and computes the scattered ray, including
+// its offset rays if the outgoing ray has them. The weight to apply to the radiance along the scattered ray is
+// returned via the given pointer. Returns false if the scattering does not contribute.
+bool SampleIntegrator::specularlyScatteredRay(const RayWithOffsets& outgoing_ray,
+                                              const SurfaceScatteringEvent& scattering_event,
+                                              BXDFType type,
+                                              const Point2F& uniform_sample,
+                                              RayWithOffsets* incident_ray,
+                                              Spectrum* weight) const
 {
+    imp_assert(incident_ray && weight);
+
     const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
     Vector3F incident_direction;
 
     imp_float pdf_value;
 
-    BXDFType type = BXDFType(BSDF_TRANSMISSION | BSDF_SPECULAR);
-
     const Spectrum& bsdf_value = scattering_event.bsdf->sample(outgoing_direction,
                                                                &incident_direction,
-                                                               sampler.next2DSampleComponent(),
+                                                               uniform_sample,
                                                                &pdf_value,
                                                                type);
 
@@ -103,30 +67,34 @@ RadianceSpectrum SampleIntegrator::specularlyTransmittedRadiance(const RayWithOf
 
     imp_float abs_cos_theta_incident = incident_direction.absDot(shading_normal);
 
-    if (pdf_value > 0 && !bsdf_value.isBlack() && abs_cos_theta_incident != 0)
+    if (pdf_value == 0 || bsdf_value.isBlack() || abs_cos_theta_incident == 0)
+        return false;
+
+    *incident_ray = scattering_event.spawnRay(incident_direction);
+
+    if (outgoing_ray.has_offsets)
     {
-        RayWithOffsets incident_ray = scattering_event.spawnRay(incident_direction);
+        incident_ray->has_offsets = true;
 
-        if (outgoing_ray.has_offsets)
-        {
-            incident_ray.has_offsets = true;
+        incident_ray->x_offset_ray_origin = scattering_event.position + scattering_event.dpdx;
+        incident_ray->y_offset_ray_origin = scattering_event.position + scattering_event.dpdy;
 
-            incident_ray.x_offset_ray_origin = scattering_event.position + scattering_event.dpdx;
-            incident_ray.y_offset_ray_origin = scattering_event.position + scattering_event.dpdy;
+        const Normal3F& dndx = scattering_event.shading.dndu*scattering_event.dudx +
+                               scattering_event.shading.dndv*scattering_event.dvdx;
 
-            const Normal3F& dndx = scattering_event.shading.dndu*scattering_event.dudx +
-                                   scattering_event.shading.dndv*scattering_event.dvdx;
+        const Normal3F& dndy = scattering_event.shading.dndu*scattering_event.dudy +
+                               scattering_event.shading.dndv*scattering_event.dvdy;
 
-            const Normal3F& dndy = scattering_event.shading.dndu*scattering_event.dudy +
-                                   scattering_event.shading.dndv*scattering_event.dvdy;
+        const Vector3F& dwodx = -outgoing_ray.x_offset_ray_direction - outgoing_direction;
+        const Vector3F& dwody = -outgoing_ray.y_offset_ray_direction - outgoing_direction;
 
-            const Vector3F& dwodx = -outgoing_ray.x_offset_ray_direction - outgoing_direction;
-            const Vector3F& dwody = -outgoing_ray.y_offset_ray_direction - outgoing_direction;
+        imp_float dwodotndx = dwodx.dot(shading_normal) + outgoing_direction.dot(dndx);
+        imp_float dwodotndy = dwody.dot(shading_normal) + outgoing_direction.dot(dndy);
 
-            imp_float dwodotndx = dwodx.dot(shading_normal) + outgoing_direction.dot(dndx);
-            imp_float dwodotndy = dwody.dot(shading_normal) + outgoing_direction.dot(dndy);
+        imp_float cos_theta_outgoing = outgoing_direction.dot(shading_normal);
 
-            imp_float cos_theta_outgoing = outgoing_direction.dot(shading_normal);
+        if (type & BSDF_TRANSMISSION)
+        {
             imp_float cos_theta_incident = incident_direction.dot(shading_normal);
 
             imp_float refractive_index = scattering_event.bsdf->refractive_index_outside;
@@ -141,21 +109,69 @@ RadianceSpectrum SampleIntegrator::specularlyTransmittedRadiance(const RayWithOf
             imp_float dmudx = dmu_fac*dwodotndx;
             imp_float dmudy = dmu_fac*dwodotndy;
 
-            incident_ray.x_offset_ray_direction = incident_direction +
-                                                  refractive_index*dwodx -
-                                                  Vector3F(mu*dndx + dmudx*shading_normal);
+            incident_ray->x_offset_ray_direction = incident_direction +
+                                                   refractive_index*dwodx -
+                                                   Vector3F(mu*dndx + dmudx*shading_normal);
 
-            incident_ray.y_offset_ray_direction = incident_direction +
-                                                  refractive_index*dwody -
-                                                  Vector3F(mu*dndy + dmudy*shading_normal);
+            incident_ray->y_offset_ray_direction = incident_direction +
+                                                   refractive_index*dwody -
+                                                   Vector3F(mu*dndy + dmudy*shading_normal);
         }
+        else
+        {
+            incident_ray->x_offset_ray_direction = incident_direction -
+                                                   dwodx +
+                                                   2.0f*Vector3F(cos_theta_outgoing*dndx + dwodotndx*shading_normal);
 
-        return bsdf_value*
-               incidentRadiance(incident_ray, scene, sampler, allocator, scattering_count + 1)*
-               (abs_cos_theta_incident/pdf_value);
+            incident_ray->y_offset_ray_direction = incident_direction -
+                                                   dwody +
+                                                   2.0f*Vector3F(cos_theta_outgoing*dndy + dwodotndy*shading_normal);
+        }
     }
-    else
+
+    *weight = bsdf_value*(abs_cos_theta_incident/pdf_value);
+
+    return true;
+}
+
+RadianceSpectrum SampleIntegrator::specularlyReflectedRadiance(const RayWithOffsets& outgoing_ray,
+                                                               const SurfaceScatteringEvent& scattering_event,
+                                                               const Scene& scene,
+                                                               Sampler& sampler,
+                                                               RegionAllocator& allocator,
+                                                               unsigned int scattering_count,
+                                                               OccluderCache* occluder_cache /* = nullptr */) const
+{
+    RayWithOffsets incident_ray;
+    Spectrum weight;
+
+    if (!specularlyScatteredRay(outgoing_ray, scattering_event, BXDFType(BSDF_REFLECTION | BSDF_SPECULAR),
+                                sampler.next2DSampleComponent(), &incident_ray, &weight))
+        return Spectrum(0.0f);
+
+    IMP_STAT_INCREMENT(n_specular_rays);
+
+    return weight*incidentRadiance(incident_ray, scene, sampler, allocator, scattering_count + 1, occluder_cache);
+}
+
+RadianceSpectrum SampleIntegrator::specularlyTransmittedRadiance(const RayWithOffsets& outgoing_ray,
+                                                                 const SurfaceScatteringEvent& scattering_event,
+                                                                 const Scene& scene,
+                                                                 Sampler& sampler,
+                                                                 RegionAllocator& allocator,
+                                                                 unsigned int scattering_count,
+                                                                 OccluderCache* occluder_cache /* = nullptr */) const
+{
+    RayWithOffsets incident_ray;
+    Spectrum weight;
+
+    if (!specularlyScatteredRay(outgoing_ray, scattering_event, BXDFType(BSDF_TRANSMISSION | BSDF_SPECULAR),
+                                sampler.next2DSampleComponent(), &incident_ray, &weight))
         return Spectrum(0.0f);
+
+    IMP_STAT_INCREMENT(n_specular_rays);
+
+    return weight*incidentRadiance(incident_ray, scene, sampler, allocator, scattering_count + 1, occluder_cache);
 }
 
 void SampleIntegrator::renderSinglePixel(const Scene& scene, const Point2I& single_pixel)
@@ -176,8 +192,9 @@ void SampleIntegrator::renderSinglePixel(const Scene& scene, const Point2I& sing
     parallelFor2D(
     [&](uint32_t region_i, uint32_t region_j)
     {
-        // Create thread-private allocator
+        // Create thread-private allocator and occluder cache
         RegionAllocator allocator;
+        OccluderCache occluder_cache;
 
         // Create thread-private sampler
         unsigned int seed = region_j*n_sensor_regions_x + region_i;
@@ -218,7 +235,7 @@ void SampleIntegrator::renderSinglePixel(const Scene& scene, const Point2I& sing
 					// Compute the radiance incident on the sensor sample point
 					RadianceSpectrum incident_radiance(0.0f);
 					if (ray_weight > 0)
-						incident_radiance = incidentRadiance(eye_ray, scene, *region_sampler, allocator);
+						incident_radiance = incidentRadiance(eye_ray, scene, *region_sampler, allocator, 0, &occluder_cache);
 
 					// Check for invalid spectrum components
 
@@ -241,84 +258,520 @@ void SampleIntegrator::renderSinglePixel(const Scene& scene, const Point2I& sing
     camera->sensor->writeImage();
 }
 
+// Computes the given range of samples for the sensor pixels in the given tile and returns the sensor region they contribute to.
+// If an error threshold is given, pixels whose estimated relative error is below it are skipped.
+std::unique_ptr<SensorRegion> SampleIntegrator::renderTile(const Scene& scene,
+                                                           const Tile& tile,
+                                                           unsigned int first_sample_idx,
+                                                           unsigned int n_samples,
+                                                           imp_float error_threshold /* = 0 */)
+{
+    if (supportsRayPackets())
+        return renderTileWithPackets(scene, tile, first_sample_idx, n_samples, error_threshold);
+
+    IMP_TRACE_SCOPE_WITH_ARGUMENTS("Render tile", formatString("\"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d",
+                                                                tile.bounds.lower_corner.x, tile.bounds.lower_corner.y,
+                                                                tile.bounds.diagonal().x, tile.bounds.diagonal().y));
+
+    // Create thread-private allocator and occluder cache for the tile
+    RegionAllocator allocator;
+    OccluderCache occluder_cache;
+
+    // Create thread-private sampler
+    std::unique_ptr<Sampler> tile_sampler = sampler->cloned(tile.seed);
+
+    // Obtain the corresponding SensorRegion object from the sensor
+    std::unique_ptr<SensorRegion> sensor_region = camera->sensor->sensorRegion(tile.bounds);
+
+    const BoundingRectangleI& sampling_bounds = camera->sensor->samplingBounds();
+
+    // Loop over the pixels in the tile
+    for (Point2I pixel : tile.bounds)
+    {
+        // Skip pixels that have already converged
+        if (error_threshold > 0 && camera->sensor->relativeError(pixel) <= error_threshold)
+            continue;
+
+        // Set current pixel for the sampler
+        beginPixelSamples(*tile_sampler, sampling_bounds, pixel, first_sample_idx);
+
+        // Loop over the samples in the given range
+        for (unsigned int sample_idx = 0; sample_idx < n_samples; sample_idx++)
+        {
+            // Generate sample containing a point on the sensor, a point on the lens and a time
+            const CameraSample& camera_sample = tile_sampler->generateCameraSample(pixel);
+
+            // Get the eye ray for the camera sample
+            RayWithOffsets eye_ray;
+            imp_float ray_weight = camera->generateRayWithOffsets(camera_sample, &eye_ray);
+            eye_ray.scaleOffsets(1.0f/std::sqrt((imp_float)tile_sampler->n_samples_per_pixel));
+
+            // Compute the radiance incident on the sensor sample point
+            RadianceSpectrum incident_radiance(0.0f);
+            if (ray_weight > 0)
+            {
+                IMP_STAT_INCREMENT(n_camera_rays);
+                incident_radiance = incidentRadiance(eye_ray, scene, *tile_sampler, allocator, 0, &occluder_cache);
+            }
+
+            // Check for invalid spectrum components
+
+            // Add the sampled radiance to the sensor region
+            sensor_region->addSample(camera_sample.sensor_point, incident_radiance, ray_weight);
+
+            // Free memory allocated with the region allocator
+            allocator.release();
+
+            tile_sampler->beginNextSample();
+        }
+    }
+
+    return sensor_region;
+}
+
+// Like renderTile, but generates the eye rays for blocks of neighbouring pixels together (with the same sample index
+// for every pixel in a block) and finds their closest intersections as a ray packet before computing the radiance.
+// Each pixel of a block has its own sampler, so the samples are identical to those used by renderTile. The shadow
+// rays of the tile are batched. Without a configured packet size, each block consists of a single pixel.
+std::unique_ptr<SensorRegion> SampleIntegrator::renderTileWithPackets(const Scene& scene,
+                                                                      const Tile& tile,
+                                                                      unsigned int first_sample_idx,
+                                                                      unsigned int n_samples,
+                                                                      imp_float error_threshold)
+{
+    IMP_TRACE_SCOPE_WITH_ARGUMENTS("Render tile", formatString("\"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d",
+                                                                tile.bounds.lower_corner.x, tile.bounds.lower_corner.y,
+                                                                tile.bounds.diagonal().x, tile.bounds.diagonal().y));
+
+    // Packets of 4, 8 and 16 rays cover blocks of 2x2, 4x2 and 4x4 pixels
+    const unsigned int packet_size = std::min(std::max(1u, RIMP_OPTIONS.ray_packet_size), (unsigned int)IMP_MAX_PACKET_SIZE);
+    const int block_width = (packet_size >= 8)? 4 : ((packet_size >= 4)? 2 : 1);
+    const int block_height = (int)packet_size/block_width;
+
+    RegionAllocator allocator;
+
+    // Create a thread-private sampler for each pixel in a block
+    std::vector< std::unique_ptr<Sampler> > pixel_samplers;
+    pixel_samplers.reserve(packet_size);
+
+    for (unsigned int pixel_idx = 0; pixel_idx < packet_size; pixel_idx++)
+        pixel_samplers.push_back(sampler->cloned(tile.seed));
+
+    std::unique_ptr<SensorRegion> sensor_region = camera->sensor->sensorRegion(tile.bounds);
+
+    ShadowRayBatch shadow_ray_batch(scene, *sensor_region);
+
+    // Find the lights that may illuminate the eye ray intersections in the tile, if the integrator makes use of them
+    std::vector<Light*> tile_lights;
+    bool has_tile_lights = usesTileLightLists() && findTileLights(scene, tile, &tile_lights);
+
+    const BoundingRectangleI& sampling_bounds = camera->sensor->samplingBounds();
+
+    const imp_float offset_scale = 1.0f/std::sqrt((imp_float)sampler->n_samples_per_pixel);
+
+    Point2I block_pixels[IMP_MAX_PACKET_SIZE];
+    CameraSample camera_samples[IMP_MAX_PACKET_SIZE];
+    RayWithOffsets eye_rays[IMP_MAX_PACKET_SIZE];
+    imp_float ray_weights[IMP_MAX_PACKET_SIZE];
+    unsigned int packet_ray_indices[IMP_MAX_PACKET_SIZE];
+    SurfaceScatteringEvent scattering_events[IMP_MAX_PACKET_SIZE];
+    bool has_intersections[IMP_MAX_PACKET_SIZE];
+
+    // Loop over the pixel blocks in the tile
+    for (int block_y = tile.bounds.lower_corner.y; block_y < tile.bounds.upper_corner.y; block_y += block_height)
+    {
+        for (int block_x = tile.bounds.lower_corner.x; block_x < tile.bounds.upper_corner.x; block_x += block_width)
+        {
+            unsigned int n_block_pixels = 0;
+
+            // Find the pixels of the block that are inside the tile and have not converged
+            for (int y = block_y; y < std::min(block_y + block_height, tile.bounds.upper_corner.y); y++)
+            {
+                for (int x = block_x; x < std::min(block_x + block_width, tile.bounds.upper_corner.x); x++)
+                {
+                    Point2I pixel(x, y);
+
+                    if (error_threshold > 0 && camera->sensor->relativeError(pixel) <= error_threshold)
+                        continue;
+
+                    beginPixelSamples(*pixel_samplers[n_block_pixels], sampling_bounds, pixel, first_sample_idx);
+
+                    block_pixels[n_block_pixels++] = pixel;
+                }
+            }
+
+            for (unsigned int sample_idx = 0; sample_idx < n_samples; sample_idx++)
+            {
+                RayPacket packet;
+
+                // Generate the eye rays for the current sample of each pixel
+                for (unsigned int pixel_idx = 0; pixel_idx < n_block_pixels; pixel_idx++)
+                {
+                    camera_samples[pixel_idx] = pixel_samplers[pixel_idx]->generateCameraSample(block_pixels[pixel_idx]);
+
+                    ray_weights[pixel_idx] = camera->generateRayWithOffsets(camera_samples[pixel_idx], eye_rays + pixel_idx);
+                    eye_rays[pixel_idx].scaleOffsets(offset_scale);
+
+                    if (ray_weights[pixel_idx] > 0)
+                        packet_ray_indices[pixel_idx] = packet.addRay(eye_rays[pixel_idx]);
+                }
+
+                IMP_STAT_ADD(n_camera_rays, packet.n_rays);
+
+                packet.prepare();
+
+                scene.intersectPacket(packet, scattering_events, has_intersections);
+
+                // Compute the radiance incident on each sensor sample point from the found intersections
+                for (unsigned int pixel_idx = 0; pixel_idx < n_block_pixels; pixel_idx++)
+                {
+                    RadianceSpectrum incident_radiance(0.0f);
+
+                    if (ray_weights[pixel_idx] > 0)
+                    {
+                        unsigned int ray_idx = packet_ray_indices[pixel_idx];
+
+                        // Give the eye ray the distance to its intersection, as a single-ray intersection would have
+                        eye_rays[pixel_idx].max_distance = packet.rays[ray_idx].max_distance;
+
+                        incident_radiance = incidentRadianceFromIntersection(eye_rays[pixel_idx],
+                                                                             (has_intersections[ray_idx])? scattering_events + ray_idx : nullptr,
+                                                                             scene,
+                                                                             *pixel_samplers[pixel_idx],
+                                                                             allocator,
+                                                                             0,
+                                                                             &shadow_ray_batch,
+                                                                             (has_tile_lights)? &tile_lights : nullptr,
+                                                                             shadow_ray_batch.occluderCache());
+                    }
+
+                    shadow_ray_batch.addSample(camera_samples[pixel_idx].sensor_point, incident_radiance, ray_weights[pixel_idx]);
+
+                    allocator.release();
+
+                    pixel_samplers[pixel_idx]->beginNextSample();
+                }
+            }
+        }
+    }
+
+    shadow_ray_batch.traceShadowRays();
+
+    return sensor_region;
+}
+
+// Computes the radiance incident along the given ray when its closest intersection has already been
+// found (a null scattering event means that the ray escaped the scene). If a shadow ray batch is given,
+// shadow rays may be deferred to it instead of being traced immediately. If a tile light list is given, only
+// its lights can illuminate the intersection. If an occluder cache is given, shadow rays that are traced immediately
+// are first tested against the model that last occluded a shadow ray towards the same light. The default
+// implementation ignores the intersection, the batch and the light list and traces the ray again.
+RadianceSpectrum SampleIntegrator::incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                                    SurfaceScatteringEvent* scattering_event,
+                                                                    const Scene& scene,
+                                                                    Sampler& sampler,
+                                                                    RegionAllocator& allocator,
+                                                                    unsigned int scattering_count /* = 0 */,
+                                                                    ShadowRayBatch* shadow_ray_batch /* = nullptr */,
+                                                                    const std::vector<Light*>* tile_lights /* = nullptr */,
+                                                                    OccluderCache* occluder_cache /* = nullptr */) const
+{
+    return incidentRadiance(outgoing_ray, scene, sampler, allocator, scattering_count, occluder_cache);
+}
+
+// Finds the lights that may illuminate the part of the scene that eye rays through the given tile can reach, using
+// bounds on the visible region from the camera. Returns false if the camera could not bound the region, in which case
+// every light must be considered.
+bool SampleIntegrator::findTileLights(const Scene& scene, const Tile& tile, std::vector<Light*>* tile_lights) const
+{
+    const BoundingBoxF& scene_bounds = scene.worldSpaceBoundingBox();
+
+    // Sensor points of the samples lie anywhere inside their pixels, so the raster region extends to the far edges of the last pixels
+    const BoundingRectangleF raster_bounds(static_cast<Point2F>(tile.bounds.lower_corner),
+                                           static_cast<Point2F>(tile.bounds.upper_corner));
+
+    BoundingBoxF view_bounds;
+
+    if (!camera->computeViewBounds(raster_bounds, scene_bounds, &view_bounds))
+        return false;
+
+    tile_lights->clear();
+
+    // Eye rays that miss the scene bounds have no intersections to illuminate
+    if (!view_bounds.overlaps(scene_bounds))
+        return true;
+
+    const BoundingBoxF& visible_scene_bounds = intersectionOf(view_bounds, scene_bounds);
+
+    for (Light* light : scene.lights)
+    {
+        if (light->mayIlluminate(visible_scene_bounds))
+            tile_lights->push_back(light);
+    }
+
+    IMP_STAT_INCREMENT(n_tile_light_lists);
+    IMP_STAT_ADD(n_tile_lights, tile_lights->size());
+
+    return true;
+}
+
 void SampleIntegrator::render(const Scene& scene)
 {
-    preprocess(scene, *sampler);
+    IMP_TRACE_SCOPE("Render");
 
-    // Compute the number of sensor regions to use in each direction
+    {
+        IMP_TRACE_SCOPE("Preprocess");
+        preprocess(scene, *sampler);
+    }
 
-    const unsigned int sensor_region_extent = 16;
+    #ifdef IMP_ENABLE_STATISTICS
+    auto start_time = std::chrono::steady_clock::now();
+    #endif
 
-    const BoundingRectangleI& sensor_sampling_bounds = camera->sensor->samplingBounds();
-    const Vector2I& sampling_extents = sensor_sampling_bounds.diagonal();
+    const unsigned int n_samples_per_pixel = sampler->n_samples_per_pixel;
 
-    uint32_t n_sensor_regions_x = (sampling_extents.x + sensor_region_extent - 1)/sensor_region_extent;
-    uint32_t n_sensor_regions_y = (sampling_extents.y + sensor_region_extent - 1)/sensor_region_extent;
+    const DistributedRole distributed_role = RIMP_OPTIONS.distributed_role;
 
-    // Loop over each sensor region in parallel
-    parallelFor2D(
-    [&](uint32_t region_i, uint32_t region_j)
+    // Workers have no sample statistics for the pixels they are assigned, so adaptive sampling is only done locally
+    if (distributed_role != DistributedRole::None && RIMP_OPTIONS.adaptive_error_threshold > 0)
+        printWarningMessage("adaptive sampling is not supported for distributed rendering. All pixels will get all samples.");
+
+    const imp_float error_threshold = (distributed_role == DistributedRole::None)? RIMP_OPTIONS.adaptive_error_threshold : 0;
+    const bool use_adaptive_sampling = error_threshold > 0;
+
+    // Render all samples in a single pass unless progressive rendering has been requested.
+    // Adaptive sampling needs multiple passes, so it uses eight passes by default.
+    unsigned int n_pass_samples = n_samples_per_pixel;
+
+    if (RIMP_OPTIONS.n_pass_samples > 0)
+        n_pass_samples = std::min(RIMP_OPTIONS.n_pass_samples, n_samples_per_pixel);
+    else if (use_adaptive_sampling)
+        n_pass_samples = std::max(1u, n_samples_per_pixel/8);
+
+    // Track the luminance variance of each pixel so that converged pixels can be skipped
+    if (use_adaptive_sampling)
+        camera->sensor->enableSampleStatistics();
+
+    // A worker only renders the tiles it is assigned, leaving the passes and the image to the coordinator
+    if (distributed_role == DistributedRole::Worker)
     {
-        // Create thread-private allocator
-        RegionAllocator allocator;
+        runRenderWorker(RIMP_OPTIONS.distributed_address, *camera->sensor, n_samples_per_pixel, n_pass_samples,
+                        [&](const Tile& tile, unsigned int first_sample_idx, unsigned int n_samples)
+                        {
+                            return renderTile(scene, tile, first_sample_idx, n_samples);
+                        });
+        return;
+    }
 
-        // Create thread-private sampler
-        unsigned int seed = region_j*n_sensor_regions_x + region_i;
-        std::unique_ptr<Sampler> region_sampler = sampler->cloned(seed);
+    // Divide the sensor into tiles to be distributed among the threads
+    TileScheduler scheduler(camera->sensor->samplingBounds(),
+                            n_pass_samples,
+                            IMP_N_THREADS,
+                            RIMP_OPTIONS.tile_ordering,
+                            RIMP_OPTIONS.tile_extent);
 
-        // Compute the sampling bounds for the current sensor region
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+    {
+        printInfoMessage("Tiles:"
+                         "\n    %-20s%u"
+                         "\n    %-20s%d"
+                         "\n    %-20s%s",
+                         "Number:", scheduler.numberOfBaseTiles(),
+                         "Extent:", scheduler.tileExtent(),
+                         "Ordering:", tileOrderingName(scheduler.tileOrdering()));
+    }
 
-        Point2I lower_region_sampling_bounds(sensor_sampling_bounds.lower_corner.x + region_i*sensor_region_extent,
-                                             sensor_sampling_bounds.lower_corner.y + region_j*sensor_region_extent);
+    // Let worker processes render the tiles if this process is the coordinator
+    std::unique_ptr<RenderCoordinator> coordinator;
 
-        Point2I upper_region_sampling_bounds(std::min<int>(lower_region_sampling_bounds.x + sensor_region_extent, sensor_sampling_bounds.upper_corner.x),
-                                             std::min<int>(lower_region_sampling_bounds.y + sensor_region_extent, sensor_sampling_bounds.upper_corner.y));
+    if (distributed_role == DistributedRole::Coordinator)
+    {
+        coordinator.reset(new RenderCoordinator(*camera->sensor, scheduler, n_samples_per_pixel, n_pass_samples,
+                                                RIMP_OPTIONS.distributed_address, RIMP_OPTIONS.worker_timeout));
 
-        BoundingRectangleI region_sampling_bounds(lower_region_sampling_bounds, upper_region_sampling_bounds);
+        if (!coordinator->start())
+            return;
+    }
 
-        // Obtain the corresponding SensorRegion object from the sensor
-        std::unique_ptr<SensorRegion> sensor_region = camera->sensor->sensorRegion(region_sampling_bounds);
+    auto render_start_time = std::chrono::steady_clock::now();
+    auto last_snapshot_time = render_start_time;
+    auto last_checkpoint_time = render_start_time;
 
-        // Loop over the pixels in the region
-        for (Point2I pixel : region_sampling_bounds)
+    unsigned int n_completed_samples = 0;
+    unsigned int n_passes_since_snapshot = 0;
+    bool stopped_by_time_budget = false;
+
+    const std::string& checkpoint_filename = RIMP_OPTIONS.checkpoint_filename;
+
+    // Continue from the state stored in an existing checkpoint, provided it was made with the same sampling settings
+    if (!checkpoint_filename.empty())
+    {
+        RenderProgress progress;
+        progress.n_samples_per_pixel = n_samples_per_pixel;
+        progress.n_pass_samples = n_pass_samples;
+
+        if (camera->sensor->readCheckpoint(checkpoint_filename, &progress))
         {
-            // Set current pixel for the sampler
-            region_sampler->setPixel(pixel);
+            n_completed_samples = progress.n_completed_samples;
+            scheduler.resumeAfterPass(progress.n_completed_passes - 1);
+
+            if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+                printInfoMessage("Resuming from checkpoint \"%s\" after %u of %u samples per pixel",
+                                 checkpoint_filename.c_str(), n_completed_samples, n_samples_per_pixel);
+        }
+    }
+
+    // Render passes of samples until all samples have been computed or the time budget has run out
+    while (n_completed_samples < n_samples_per_pixel)
+    {
+        auto pass_start_time = std::chrono::steady_clock::now();
+
+        unsigned int first_sample_idx = n_completed_samples;
+        unsigned int n_samples = std::min(n_pass_samples, n_samples_per_pixel - n_completed_samples);
+
+        // Tiles are ordered by the costs measured in the previous pass
+        scheduler.beginPass();
 
-            // Loop over all samples provided by the sampler
-            do
+        IMP_TRACE_SCOPE_WITH_ARGUMENTS("Render pass", formatString("\"pass\": %u, \"first_sample\": %u, \"samples\": %u",
+                                                                    scheduler.passIndex(), first_sample_idx, n_samples));
+
+        // Let the workers, or otherwise every local thread, render tiles until there are none left
+        if (coordinator)
+        {
+            coordinator->renderPass(first_sample_idx, n_samples);
+        }
+        else
+        {
+            parallelFor(
+            [&](uint64_t thread_idx)
             {
-                // Generate sample containing a point on the sensor, a point on the lens and a time
-                const CameraSample& camera_sample = region_sampler->generateCameraSample(pixel);
+                Tile tile;
+
+                while (scheduler.nextTile(&tile))
+                {
+                    auto tile_start_time = std::chrono::steady_clock::now();
+
+                    // All pixels get the samples of the first pass, after which converged pixels are skipped
+                    camera->sensor->mergeSensorRegion(renderTile(scene, tile, first_sample_idx, n_samples, (first_sample_idx > 0)? error_threshold : 0));
+
+                    scheduler.addTileCost(tile.base_tile_idx,
+                                          std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start_time).count());
+                }
+            },
+            IMP_N_THREADS);
+        }
 
-                // Get the eye ray for the camera sample
-                RayWithOffsets eye_ray;
-                imp_float ray_weight = camera->generateRayWithOffsets(camera_sample, &eye_ray);
-                eye_ray.scaleOffsets(1.0f/std::sqrt((imp_float)region_sampler->n_samples_per_pixel));
+        // Add the splats of the pass to the image while no threads are adding more
+        camera->sensor->mergeSplats();
 
-                // Compute the radiance incident on the sensor sample point
-                RadianceSpectrum incident_radiance(0.0f);
-                if (ray_weight > 0)
-                    incident_radiance = incidentRadiance(eye_ray, scene, *region_sampler, allocator);
+        n_completed_samples += n_samples;
+        n_passes_since_snapshot++;
 
-                // Check for invalid spectrum components
+        if (n_completed_samples >= n_samples_per_pixel)
+            break;
 
-                // Add the sampled radiance to the sensor region
-                sensor_region->addSample(camera_sample.sensor_point, incident_radiance, ray_weight);
+        auto pass_end_time = std::chrono::steady_clock::now();
 
-                // Free memory allocated with the region allocator
-                allocator.release();
+        double elapsed_seconds = std::chrono::duration<double>(pass_end_time - render_start_time).count();
+        double pass_seconds = std::chrono::duration<double>(pass_end_time - pass_start_time).count();
 
-            } while (region_sampler->beginNextSample());
+        if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+            printInfoMessage("Completed %u of %u samples per pixel in %.2f s", n_completed_samples, n_samples_per_pixel, elapsed_seconds);
+
+        // Stop if all pixels have converged
+        if (use_adaptive_sampling)
+        {
+            unsigned int n_unconverged_pixels = camera->sensor->numberOfUnconvergedPixels(error_threshold);
+
+            if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+                printInfoMessage("%u pixels have a relative error above %g", n_unconverged_pixels, error_threshold);
+
+            if (n_unconverged_pixels == 0)
+                break;
         }
 
-        // Merge the sensor region into the full sensor
-        camera->sensor->mergeSensorRegion(std::move(sensor_region));
-    },
-    n_sensor_regions_x, n_sensor_regions_y);
+        // Stop if the next pass is not expected to finish within the time budget
+        if (RIMP_OPTIONS.time_budget > 0 && elapsed_seconds + pass_seconds > RIMP_OPTIONS.time_budget)
+        {
+            if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+                printInfoMessage("Stopping after %u samples per pixel to stay within the time budget of %g s", n_completed_samples, RIMP_OPTIONS.time_budget);
+
+            stopped_by_time_budget = true;
+            break;
+        }
+
+        // Save the rendering state if enough time has gone by since the last checkpoint
+        if (!checkpoint_filename.empty() &&
+            std::chrono::duration<double>(pass_end_time - last_checkpoint_time).count() >= RIMP_OPTIONS.checkpoint_interval)
+        {
+            camera->sensor->writeCheckpoint(checkpoint_filename, {n_samples_per_pixel, n_pass_samples, n_completed_samples, scheduler.passIndex() + 1});
+
+            last_checkpoint_time = std::chrono::steady_clock::now();
+        }
+
+        // Write an intermediate image if enough time or passes have gone by since the last one
+        bool snapshot_is_due = (RIMP_OPTIONS.snapshot_interval > 0 &&
+                                std::chrono::duration<double>(pass_end_time - last_snapshot_time).count() >= RIMP_OPTIONS.snapshot_interval) ||
+                               (RIMP_OPTIONS.snapshot_pass_interval > 0 &&
+                                n_passes_since_snapshot >= RIMP_OPTIONS.snapshot_pass_interval);
+
+        if (snapshot_is_due)
+        {
+            camera->sensor->writeImage();
+
+            last_snapshot_time = std::chrono::steady_clock::now();
+            n_passes_since_snapshot = 0;
+        }
+    }
+
+    // Dismiss the workers
+    if (coordinator)
+        coordinator->finish();
+
+    #ifdef IMP_ENABLE_STATISTICS
+    // Gather the statistics recorded by each thread during rendering
+    mergeThreadStatistics();
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+    {
+        double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        printInfoMessage("%s", statisticsReport(elapsed_seconds).c_str());
+    }
+
+    clearStatistics();
+    #endif
 
     // Write the final image to file
     camera->sensor->writeImage();
+
+    // Keep the state of an unfinished rendering so that it can be continued later, and discard it otherwise
+    if (!checkpoint_filename.empty())
+    {
+        if (stopped_by_time_budget)
+            camera->sensor->writeCheckpoint(checkpoint_filename, {n_samples_per_pixel, n_pass_samples, n_completed_samples, scheduler.passIndex() + 1});
+        else if (fileExists(checkpoint_filename))
+            removeFile(checkpoint_filename);
+    }
+}
+
+// Integrator function definitions
+
+// Prepares the sampler for computing samples of the given pixel, starting with the given sample index.
+// The sampler is seeded by the pixel so that every pass draws from the same set of pixel samples,
+// and the values generated beyond that set are seeded by the sample range so that they differ between passes.
+void beginPixelSamples(Sampler& sampler,
+                       const BoundingRectangleI& sampling_bounds,
+                       const Point2I& pixel,
+                       unsigned int first_sample_idx)
+{
+    sampler.setSeed(pixelSampleSeed(sampling_bounds, pixel, 0));
+    sampler.setPixel(pixel);
+
+    if (first_sample_idx > 0)
+    {
+        sampler.beginSampleIndex(first_sample_idx);
+        sampler.setSeed(pixelSampleSeed(sampling_bounds, pixel, first_sample_idx));
+    }
 }
 
 } // RayImpact
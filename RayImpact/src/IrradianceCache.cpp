@@ -0,0 +1,292 @@
+#include "IrradianceCache.hpp"
+#include "math.hpp"
+#include "statistics.hpp"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <new>
+
+namespace Impact {
+namespace RayImpact {
+
+// IrradianceCache statistics variables
+
+IMP_STAT_COUNTER("Irradiance cache records", n_irradiance_records);
+IMP_STAT_RATIO("Interpolated irradiance cache lookups", n_interpolated_irradiance_lookups, n_irradiance_lookups);
+IMP_STAT_RATIO("Records per irradiance interpolation", n_interpolated_irradiance_records, n_irradiance_interpolations);
+
+// IrradianceCache method definitions
+
+IrradianceCache::IrradianceCache(const BoundingBoxF& bounds,
+                                 imp_float error_tolerance,
+                                 imp_float min_radius,
+                                 imp_float max_radius)
+    : bounds(bounds),
+      error_tolerance(error_tolerance),
+      min_radius(min_radius),
+      max_radius(std::max(min_radius, max_radius)),
+      root(),
+      allocator(65536, MemoryCategory::IrradianceCache, 4096),
+      allocator_mutex()
+{}
+
+// Returns memory for a record or octree node from the allocator of the cache, which is attributed to the
+// irradiance cache in memory accounting and released when the cache is destroyed
+void* IrradianceCache::allocate(size_t n_bytes)
+{
+    std::lock_guard<std::mutex> lock(allocator_mutex);
+
+    return allocator.allocate(n_bytes);
+}
+
+// Computes the irradiance at the given position by interpolating the records that are valid there, and returns
+// whether any records could be used. The surface normal must be oriented towards the hemisphere of interest.
+bool IrradianceCache::interpolatedIrradiance(const Point3F& position,
+                                             const Vector3F& surface_normal,
+                                             IrradianceSpectrum* irradiance) const
+{
+    IMP_STAT_INCREMENT(n_irradiance_lookups);
+
+    if (!bounds.contains(position))
+        return false;
+
+    IrradianceSpectrum weighted_irradiance_sum(0.0f);
+    imp_float weight_sum = 0;
+
+    const OctreeNode* node = &root;
+    BoundingBoxF node_bounds = bounds;
+
+    // Check the records of every node containing the position, from the root down
+    while (node)
+    {
+        for (const RecordNode* entry = node->records.load(std::memory_order_acquire); entry; entry = entry->next)
+        {
+            const IrradianceRecord& record = *(entry->record);
+
+            imp_float cos_normal_angle = surface_normal.dot(record.surface_normal);
+
+            if (cos_normal_angle <= 0)
+                continue;
+
+            const Vector3F& offset = position - record.position;
+
+            // Estimate the error of using the record based on the distance and the change in normal
+            imp_float error = offset.length()/record.radius + std::sqrt(std::max<imp_float>(0, 1 - cos_normal_angle));
+
+            if (error >= error_tolerance)
+                continue;
+
+            // Skip records lying in front of the position, as they may not see the same surroundings
+            if (offset.dot(surface_normal + record.surface_normal) < -0.02f*record.radius)
+                continue;
+
+            // Let the weight fall to zero at the error tolerance to avoid discontinuities
+            imp_float weight = 1/std::max<imp_float>(error, 1e-4f) - 1/error_tolerance;
+
+            const Vector3F& normal_rotation = record.surface_normal.cross(surface_normal);
+
+            IrradianceSpectrum extrapolated_irradiance = record.irradiance;
+
+            for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+            {
+                extrapolated_irradiance[c] = std::max<imp_float>(0, extrapolated_irradiance[c] +
+                                                                    record.rotational_gradients[c].dot(normal_rotation) +
+                                                                    record.translational_gradients[c].dot(offset));
+            }
+
+            weighted_irradiance_sum += extrapolated_irradiance*weight;
+            weight_sum += weight;
+
+            IMP_STAT_INCREMENT(n_interpolated_irradiance_records);
+        }
+
+        // Descend into the octant containing the position
+        const Point3F& center = node_bounds.lower_corner + node_bounds.diagonal()*0.5f;
+
+        unsigned int octant_idx = ((position.x >= center.x)? 1 : 0) |
+                                  ((position.y >= center.y)? 2 : 0) |
+                                  ((position.z >= center.z)? 4 : 0);
+
+        node_bounds = octantBounds(node_bounds, octant_idx);
+        node = node->children[octant_idx].load(std::memory_order_acquire);
+    }
+
+    if (weight_sum == 0)
+        return false;
+
+    IMP_STAT_INCREMENT(n_interpolated_irradiance_lookups);
+    IMP_STAT_INCREMENT(n_irradiance_interpolations);
+
+    *irradiance = weighted_irradiance_sum/weight_sum;
+
+    return true;
+}
+
+/*
+Creates a record from a stratified cosine-weighted gather of incident radiance over the hemisphere around the given
+surface normal, adds it to the cache and returns the gathered irradiance. The x- and y-axes span the base plane of the
+hemisphere, with the phi-coordinate measured from the x-axis. The gather has the given numbers of strata in theta (with
+sin^2(theta) uniformly divided) and phi (uniformly divided), and the arrays hold the incident radiance and the distance
+to the surface hit for the sample in each stratum, ordered with phi varying fastest. Samples that escaped the scene have
+an infinite distance.
+*/
+IrradianceSpectrum IrradianceCache::addRecord(const Point3F& position,
+                                              const Vector3F& x_axis,
+                                              const Vector3F& y_axis,
+                                              const Vector3F& surface_normal,
+                                              unsigned int n_theta_strata,
+                                              unsigned int n_phi_strata,
+                                              const RadianceSpectrum* radiances,
+                                              const imp_float* distances)
+{
+    const unsigned int M = n_theta_strata;
+    const unsigned int N = n_phi_strata;
+
+    IrradianceRecord* record = new (allocate(sizeof(IrradianceRecord))) IrradianceRecord();
+
+    record->position = position;
+    record->surface_normal = surface_normal;
+    record->irradiance = IrradianceSpectrum(0.0f);
+
+    for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+    {
+        record->rotational_gradients[c] = Vector3F(0, 0, 0);
+        record->translational_gradients[c] = Vector3F(0, 0, 0);
+    }
+
+    imp_float inverse_distance_sum = 0;
+
+    for (unsigned int k = 0; k < N; k++)
+    {
+        // Base plane directions along and perpendicular to the center phi of the strata
+        imp_float phi_center = IMP_TWO_PI*(k + 0.5f)/N;
+        const Vector3F& u_k = x_axis*std::cos(phi_center) + y_axis*std::sin(phi_center);
+        const Vector3F& v_k = y_axis*std::cos(phi_center) - x_axis*std::sin(phi_center);
+
+        // Base plane direction perpendicular to the lower phi boundary of the strata
+        imp_float phi_lower = IMP_TWO_PI*k/N;
+        const Vector3F& v_k_lower = y_axis*std::cos(phi_lower) - x_axis*std::sin(phi_lower);
+
+        unsigned int previous_k = (k + N - 1) % N;
+
+        for (unsigned int j = 0; j < M; j++)
+        {
+            unsigned int idx = j*N + k;
+
+            const RadianceSpectrum& radiance = radiances[idx];
+
+            // Evaluate tan(theta) at the center of the theta stratum, so that the rotational
+            // gradient vanishes exactly for uniform radiance regardless of the sample jitter
+            imp_float tan_theta_center = std::sqrt((j + 0.5f)/(M - j - 0.5f));
+
+            record->irradiance += radiance;
+
+            inverse_distance_sum += 1/distances[idx];
+
+            for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+                record->rotational_gradients[c] += v_k*(radiance[c]*tan_theta_center);
+
+            // Change of the projected solid angle of the strata as the boundary to the previous theta stratum moves
+            if (j > 0)
+            {
+                imp_float min_distance = std::min(distances[idx], distances[idx - N]);
+
+                if (min_distance < IMP_INFINITY)
+                {
+                    imp_float sin_squared_theta_lower = (imp_float)j/M;
+                    imp_float factor = (IMP_TWO_PI/N)*std::sqrt(sin_squared_theta_lower)*(1 - sin_squared_theta_lower)/min_distance;
+
+                    for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+                        record->translational_gradients[c] += u_k*(factor*(radiance[c] - radiances[idx - N][c]));
+                }
+            }
+
+            // Change of the projected solid angle of the strata as the boundary to the previous phi stratum moves
+            imp_float min_distance = std::min(distances[idx], distances[j*N + previous_k]);
+
+            if (N > 1 && min_distance < IMP_INFINITY)
+            {
+                imp_float sin_theta_lower = std::sqrt((imp_float)j/M);
+                imp_float sin_theta_upper = std::sqrt((imp_float)(j + 1)/M);
+                imp_float factor = (sin_theta_upper - sin_theta_lower)/min_distance;
+
+                for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+                    record->translational_gradients[c] += v_k_lower*(factor*(radiance[c] - radiances[j*N + previous_k][c]));
+            }
+        }
+    }
+
+    imp_float projected_solid_angle_per_stratum = IMP_PI/(M*N);
+
+    record->irradiance *= projected_solid_angle_per_stratum;
+
+    for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+        record->rotational_gradients[c] *= projected_solid_angle_per_stratum;
+
+    // Use the harmonic mean distance to the surroundings as the validity radius, but make it smaller where the
+    // irradiance changes quickly with position
+    imp_float radius = (inverse_distance_sum > 0)? (M*N)/inverse_distance_sum : max_radius;
+
+    for (unsigned int c = 0; c < Spectrum::n_coefficients; c++)
+    {
+        imp_float gradient_magnitude = record->translational_gradients[c].length();
+
+        if (gradient_magnitude > 0 && record->irradiance[c] > 0)
+            radius = std::min(radius, record->irradiance[c]/gradient_magnitude);
+    }
+
+    record->radius = clamp(radius, min_radius, max_radius);
+
+    // Add the record to the octree nodes overlapping the region where it can be used
+    imp_float validity_extent = error_tolerance*record->radius;
+    const BoundingBoxF record_bounds(position - Vector3F(validity_extent, validity_extent, validity_extent),
+                                     position + Vector3F(validity_extent, validity_extent, validity_extent));
+
+    if (bounds.overlaps(record_bounds))
+        addRecordToNode(&root, bounds, record, record_bounds, 0);
+
+    IMP_STAT_INCREMENT(n_irradiance_records);
+
+    return record->irradiance;
+}
+
+// Adds the given record to the given node if the node is about the size of the record bounds, and otherwise
+// to the octants of the node overlapping the record bounds. Missing octant nodes are created as needed.
+void IrradianceCache::addRecordToNode(OctreeNode* node,
+                                      const BoundingBoxF& node_bounds,
+                                      const IrradianceRecord* record,
+                                      const BoundingBoxF& record_bounds,
+                                      unsigned int depth)
+{
+    if (depth == max_depth || node_bounds.diagonal().squaredLength() < 4*record_bounds.diagonal().squaredLength())
+    {
+        RecordNode* entry = new (allocate(sizeof(RecordNode))) RecordNode{record, node->records.load(std::memory_order_relaxed)};
+        while (!node->records.compare_exchange_weak(entry->next, entry, std::memory_order_release, std::memory_order_relaxed));
+        return;
+    }
+
+    for (unsigned int octant_idx = 0; octant_idx < 8; octant_idx++)
+    {
+        const BoundingBoxF& octant_bounds = octantBounds(node_bounds, octant_idx);
+
+        if (!octant_bounds.overlaps(record_bounds))
+            continue;
+
+        OctreeNode* child = node->children[octant_idx].load(std::memory_order_acquire);
+
+        // Create the child node if it does not exist, unless another thread gets to do it first
+        if (!child)
+        {
+            OctreeNode* new_child = new (allocate(sizeof(OctreeNode))) OctreeNode();
+
+            // A node that loses the race is left unused in the allocator
+            if (node->children[octant_idx].compare_exchange_strong(child, new_child, std::memory_order_acq_rel, std::memory_order_acquire))
+                child = new_child;
+        }
+
+        addRecordToNode(child, octant_bounds, record, record_bounds, depth + 1);
+    }
+}
+
+} // RayImpact
+} // Impact
@@ -1,14 +1,64 @@
 #include "Light.hpp"
 #include "Scene.hpp"
+#include "statistics.hpp"
 
 namespace Impact {
 namespace RayImpact {
 
+// Light statistics variables
+
+IMP_STAT_RATE("Shadow rays", n_shadow_rays);
+IMP_STAT_RATIO("Shadow rays occluded by cached occluder", n_cached_occluder_hits, n_cached_occluder_tests);
+
 // VisibilityTester method definitions
 
+// Returns the ray between the start and end points that must be unobstructed for the beam to be unobstructed
+Ray VisibilityTester::shadowRay() const
+{
+    return start_point.spawnRayTo(end_point);
+}
+
 bool VisibilityTester::beamIsUnobstructed(const Scene& scene) const
 {
-    return !scene.hasIntersection(start_point.spawnRayTo(end_point));
+    IMP_STAT_INCREMENT(n_shadow_rays);
+    return !scene.hasIntersection(shadowRay());
+}
+
+// Like beamIsUnobstructed, but first tests the model in the given cache that last occluded a shadow ray towards
+// the given light. If that model does not occlude the beam, the scene is traced and the cache is updated with the
+// model that does, if any. Without a cache, this is the same as the uncached test.
+bool VisibilityTester::beamIsUnobstructed(const Scene& scene,
+                                          const Light* light,
+                                          OccluderCache* occluder_cache) const
+{
+    if (!occluder_cache)
+        return beamIsUnobstructed(scene);
+
+    IMP_STAT_INCREMENT(n_shadow_rays);
+
+    const Ray& shadow_ray = shadowRay();
+
+    const Model* cached_occluder = occluder_cache->cachedOccluder(light);
+
+    if (cached_occluder)
+    {
+        IMP_STAT_INCREMENT(n_cached_occluder_tests);
+
+        if (cached_occluder->hasIntersection(shadow_ray))
+        {
+            IMP_STAT_INCREMENT(n_cached_occluder_hits);
+            return false;
+        }
+    }
+
+    const Model* occluder = scene.occludingModel(shadow_ray);
+
+    if (!occluder)
+        return true;
+
+    occluder_cache->update(light, occluder);
+
+    return false;
 }
 
 TransmissionSpectrum VisibilityTester::beamTransmittance(const Scene& scene, Sampler& sampler) const
@@ -0,0 +1,468 @@
+#include "LightBVH.hpp"
+#include "math.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// LightBVH statistics variables
+
+IMP_STAT_COUNTER("Light BVH nodes", n_light_bvh_nodes);
+IMP_STAT_COUNTER("Lights outside light BVH", n_infinite_bvh_lights);
+
+// LightBVH utility functions
+
+// Computes cos(max(0, a - b)) from the sines and cosines of the angles a and b
+static inline imp_float cosOfClampedDifference(imp_float sin_a, imp_float cos_a,
+                                               imp_float sin_b, imp_float cos_b)
+{
+    return (cos_a > cos_b)? 1 : cos_a*cos_b + sin_a*sin_b;
+}
+
+// Computes sin(max(0, a - b)) from the sines and cosines of the angles a and b
+static inline imp_float sinOfClampedDifference(imp_float sin_a, imp_float cos_a,
+                                               imp_float sin_b, imp_float cos_b)
+{
+    return (cos_a > cos_b)? 0 : sin_a*cos_b - cos_a*sin_b;
+}
+
+static inline imp_float sinFromCos(imp_float cos_angle)
+{
+    return std::sqrt(std::max<imp_float>(0, 1 - cos_angle*cos_angle));
+}
+
+// Estimates the cost of a node with the given bounds as its power times a measure of the solid angle its
+// normals and emission cover times its surface area, stretched for splits across thin dimensions
+static imp_float orientationCost(const LightBounds& bounds,
+                                 const Vector3F& node_diagonal,
+                                 unsigned int dim)
+{
+    if (bounds.power == 0)
+        return 0;
+
+    imp_float normal_angle = std::acos(clamp(bounds.cos_normal_angle, -1.0f, 1.0f));
+    imp_float emission_angle = std::acos(clamp(bounds.cos_emission_angle, -1.0f, 1.0f));
+    imp_float total_angle = std::min<imp_float>(normal_angle + emission_angle, IMP_PI);
+    imp_float sin_normal_angle = sinFromCos(bounds.cos_normal_angle);
+
+    imp_float solid_angle_measure = IMP_TWO_PI*(1 - bounds.cos_normal_angle) +
+                                    IMP_PI_OVER_TWO*(2*total_angle*sin_normal_angle -
+                                                     std::cos(normal_angle - 2*total_angle) -
+                                                     2*normal_angle*sin_normal_angle +
+                                                     bounds.cos_normal_angle);
+
+    imp_float stretch = std::max(node_diagonal.x, std::max(node_diagonal.y, node_diagonal.z))/node_diagonal[dim];
+
+    return bounds.power*solid_angle_measure*stretch*bounds.bounding_box.surfaceArea();
+}
+
+// LightBVH method definitions
+
+LightBVH::LightBVH(const std::vector<Light*>& lights)
+    : bounded_lights(),
+      infinite_lights(),
+      nodes(),
+      light_bit_trails()
+{
+    std::vector<BuildLight> build_lights;
+
+    for (const Light* light : lights)
+    {
+        LightBounds bounds;
+
+        if (!light->computeBounds(&bounds))
+        {
+            infinite_lights.push_back(light);
+        }
+        else if (bounds.power > 0)
+        {
+            build_lights.push_back({(unsigned int)bounded_lights.size(),
+                                    bounds,
+                                    0.5f*(bounds.bounding_box.lower_corner + bounds.bounding_box.upper_corner)});
+
+            bounded_lights.push_back(light);
+        }
+    }
+
+    if (!build_lights.empty())
+    {
+        nodes.reserve(2*build_lights.size() - 1);
+        buildNodes(build_lights, 0, (unsigned int)build_lights.size(), 0, 0);
+    }
+
+    IMP_STAT_ADD(n_light_bvh_nodes, nodes.size());
+    IMP_STAT_ADD(n_infinite_bvh_lights, infinite_lights.size());
+}
+
+// Recursively builds the hierarchy for the given range of lights and returns the index of the root node of the range.
+// Splits are chosen by binning the light centroids and minimizing the orientation cost of the two children.
+unsigned int LightBVH::buildNodes(std::vector<BuildLight>& build_lights,
+                                  unsigned int start_idx,
+                                  unsigned int end_idx,
+                                  uint64_t bit_trail,
+                                  unsigned int depth)
+{
+    imp_assert(start_idx < end_idx);
+    imp_assert(depth < 64);
+
+    unsigned int node_idx = (unsigned int)nodes.size();
+    nodes.emplace_back();
+
+    if (end_idx - start_idx == 1)
+    {
+        const BuildLight& build_light = build_lights[start_idx];
+
+        nodes[node_idx] = {build_light.bounds, build_light.light_idx, true};
+        light_bit_trails[bounded_lights[build_light.light_idx]] = bit_trail;
+
+        return node_idx;
+    }
+
+    LightBounds node_bounds = build_lights[start_idx].bounds;
+    BoundingBoxF centroid_bounds(build_lights[start_idx].centroid);
+
+    for (unsigned int idx = start_idx + 1; idx < end_idx; idx++)
+    {
+        node_bounds = unionOf(node_bounds, build_lights[idx].bounds);
+        centroid_bounds.enclose(build_lights[idx].centroid);
+    }
+
+    const Vector3F& node_diagonal = node_bounds.bounding_box.diagonal();
+    const Vector3F& centroid_diagonal = centroid_bounds.diagonal();
+
+    const unsigned int n_buckets = 12;
+
+    imp_float lowest_cost = IMP_INFINITY;
+    unsigned int split_dim = 0;
+    unsigned int split_bucket = 0;
+
+    // Deep trees would overflow the bit trails, so there the lights are simply split in half
+    if (depth < 48)
+    {
+        for (unsigned int dim = 0; dim < 3; dim++)
+        {
+            if (centroid_diagonal[dim] == 0)
+                continue;
+
+            LightBounds bucket_bounds[n_buckets];
+
+            for (unsigned int bucket_idx = 0; bucket_idx < n_buckets; bucket_idx++)
+                bucket_bounds[bucket_idx].power = 0;
+
+            for (unsigned int idx = start_idx; idx < end_idx; idx++)
+            {
+                unsigned int bucket_idx = std::min(n_buckets - 1,
+                                                   (unsigned int)(n_buckets*(build_lights[idx].centroid[dim] - centroid_bounds.lower_corner[dim])/centroid_diagonal[dim]));
+
+                bucket_bounds[bucket_idx] = unionOf(bucket_bounds[bucket_idx], build_lights[idx].bounds);
+            }
+
+            for (unsigned int bucket_idx = 1; bucket_idx < n_buckets; bucket_idx++)
+            {
+                LightBounds lower_bounds = bucket_bounds[0];
+                LightBounds upper_bounds = bucket_bounds[bucket_idx];
+
+                for (unsigned int idx = 1; idx < bucket_idx; idx++)
+                    lower_bounds = unionOf(lower_bounds, bucket_bounds[idx]);
+
+                for (unsigned int idx = bucket_idx + 1; idx < n_buckets; idx++)
+                    upper_bounds = unionOf(upper_bounds, bucket_bounds[idx]);
+
+                imp_float cost = orientationCost(lower_bounds, node_diagonal, dim) + orientationCost(upper_bounds, node_diagonal, dim);
+
+                if (cost < lowest_cost)
+                {
+                    lowest_cost = cost;
+                    split_dim = dim;
+                    split_bucket = bucket_idx;
+                }
+            }
+        }
+    }
+
+    unsigned int mid_idx = start_idx;
+
+    if (lowest_cost < IMP_INFINITY)
+    {
+        mid_idx = (unsigned int)(std::partition(build_lights.begin() + start_idx,
+                                                build_lights.begin() + end_idx,
+                                                [&](const BuildLight& build_light)
+                                                {
+                                                    unsigned int bucket_idx = std::min(n_buckets - 1,
+                                                                                       (unsigned int)(n_buckets*(build_light.centroid[split_dim] - centroid_bounds.lower_corner[split_dim])/centroid_diagonal[split_dim]));
+                                                    return bucket_idx < split_bucket;
+                                                })
+                                 - build_lights.begin());
+    }
+
+    // Fall back to splitting into equal counts along the largest centroid extent
+    if (mid_idx == start_idx || mid_idx == end_idx)
+    {
+        unsigned int dim = centroid_bounds.maxDimension();
+        mid_idx = (start_idx + end_idx)/2;
+
+        std::nth_element(build_lights.begin() + start_idx,
+                         build_lights.begin() + mid_idx,
+                         build_lights.begin() + end_idx,
+                         [dim](const BuildLight& build_light_1, const BuildLight& build_light_2)
+                         {
+                             return build_light_1.centroid[dim] < build_light_2.centroid[dim];
+                         });
+    }
+
+    buildNodes(build_lights, start_idx, mid_idx, bit_trail, depth + 1);
+    unsigned int second_child_idx = buildNodes(build_lights, mid_idx, end_idx, bit_trail | ((uint64_t)1 << depth), depth + 1);
+
+    nodes[node_idx] = {node_bounds, second_child_idx, false};
+
+    return node_idx;
+}
+
+const Light* LightBVH::selectLight(const ScatteringEvent& scattering_event,
+                                   imp_float uniform_sample,
+                                   imp_float* selection_probability) const
+{
+    imp_float hierarchy_probability = hierarchyProbability();
+
+    // Select one of the infinite lights
+    if (uniform_sample >= hierarchy_probability)
+    {
+        if (infinite_lights.empty())
+        {
+            *selection_probability = 0;
+            return nullptr;
+        }
+
+        unsigned int n_infinite_lights = (unsigned int)infinite_lights.size();
+        imp_float remapped_sample = (uniform_sample - hierarchy_probability)/(1 - hierarchy_probability);
+
+        *selection_probability = (1 - hierarchy_probability)/n_infinite_lights;
+
+        return infinite_lights[std::min((unsigned int)(remapped_sample*n_infinite_lights), n_infinite_lights - 1)];
+    }
+
+    const Point3F& position = scattering_event.position;
+    const Normal3F& surface_normal = (scattering_event.isOnSurface())? scattering_event.surface_normal : Normal3F(0, 0, 0);
+
+    imp_float probability = hierarchy_probability;
+    imp_float sample = std::min(uniform_sample/hierarchy_probability, IMP_ONE_MINUS_EPS);
+    unsigned int node_idx = 0;
+
+    // Descend the hierarchy, reusing the sample for each choice after remapping it to the unit interval
+    while (!nodes[node_idx].is_leaf)
+    {
+        const Node& node = nodes[node_idx];
+
+        imp_float importance_1 = lightImportance(nodes[node_idx + 1].bounds, position, surface_normal);
+        imp_float importance_2 = lightImportance(nodes[node.second_child_or_light_idx].bounds, position, surface_normal);
+
+        if (importance_1 == 0 && importance_2 == 0)
+        {
+            *selection_probability = 0;
+            return nullptr;
+        }
+
+        imp_float probability_1 = importance_1/(importance_1 + importance_2);
+
+        if (sample < probability_1)
+        {
+            node_idx = node_idx + 1;
+            sample = std::min(sample/probability_1, IMP_ONE_MINUS_EPS);
+            probability *= probability_1;
+        }
+        else
+        {
+            node_idx = node.second_child_or_light_idx;
+            sample = std::min((sample - probability_1)/(1 - probability_1), IMP_ONE_MINUS_EPS);
+            probability *= 1 - probability_1;
+        }
+    }
+
+    const Node& leaf = nodes[node_idx];
+
+    if (lightImportance(leaf.bounds, position, surface_normal) == 0)
+    {
+        *selection_probability = 0;
+        return nullptr;
+    }
+
+    *selection_probability = probability;
+
+    return bounded_lights[leaf.second_child_or_light_idx];
+}
+
+// Computes the probability of selectLight selecting the given light, by following the path to its leaf
+imp_float LightBVH::selectionProbability(const ScatteringEvent& scattering_event,
+                                         const Light* light) const
+{
+    imp_float hierarchy_probability = hierarchyProbability();
+
+    auto bit_trail_entry = light_bit_trails.find(light);
+
+    if (bit_trail_entry == light_bit_trails.end())
+    {
+        if (std::find(infinite_lights.begin(), infinite_lights.end(), light) == infinite_lights.end())
+            return 0;
+
+        return (1 - hierarchy_probability)/infinite_lights.size();
+    }
+
+    const Point3F& position = scattering_event.position;
+    const Normal3F& surface_normal = (scattering_event.isOnSurface())? scattering_event.surface_normal : Normal3F(0, 0, 0);
+
+    uint64_t bit_trail = bit_trail_entry->second;
+    imp_float probability = hierarchy_probability;
+    unsigned int node_idx = 0;
+
+    while (!nodes[node_idx].is_leaf)
+    {
+        const Node& node = nodes[node_idx];
+
+        imp_float importance_1 = lightImportance(nodes[node_idx + 1].bounds, position, surface_normal);
+        imp_float importance_2 = lightImportance(nodes[node.second_child_or_light_idx].bounds, position, surface_normal);
+
+        if (importance_1 == 0 && importance_2 == 0)
+            return 0;
+
+        imp_float probability_1 = importance_1/(importance_1 + importance_2);
+
+        if (bit_trail & 1)
+        {
+            node_idx = node.second_child_or_light_idx;
+            probability *= 1 - probability_1;
+        }
+        else
+        {
+            node_idx = node_idx + 1;
+            probability *= probability_1;
+        }
+
+        bit_trail >>= 1;
+    }
+
+    return (lightImportance(nodes[node_idx].bounds, position, surface_normal) > 0)? probability : 0;
+}
+
+// LightBVH function definitions
+
+// Creates light bounds encompassing both the given light bounds. Bounds with zero power are treated as empty.
+LightBounds unionOf(const LightBounds& bounds_1, const LightBounds& bounds_2)
+{
+    if (bounds_1.power == 0)
+        return bounds_2;
+
+    if (bounds_2.power == 0)
+        return bounds_1;
+
+    LightBounds bounds;
+
+    bounds.bounding_box = unionOf(bounds_1.bounding_box, bounds_2.bounding_box);
+    bounds.cos_emission_angle = std::min(bounds_1.cos_emission_angle, bounds_2.cos_emission_angle);
+    bounds.power = bounds_1.power + bounds_2.power;
+
+    // Find the smallest cone containing both normal cones
+
+    imp_float angle_1 = std::acos(clamp(bounds_1.cos_normal_angle, -1.0f, 1.0f));
+    imp_float angle_2 = std::acos(clamp(bounds_2.cos_normal_angle, -1.0f, 1.0f));
+    imp_float angle_between_axes = std::acos(clamp(bounds_1.axis.dot(bounds_2.axis), -1.0f, 1.0f));
+
+    if (std::min<imp_float>(angle_between_axes + angle_2, IMP_PI) <= angle_1)
+    {
+        bounds.axis = bounds_1.axis;
+        bounds.cos_normal_angle = bounds_1.cos_normal_angle;
+        return bounds;
+    }
+
+    if (std::min<imp_float>(angle_between_axes + angle_1, IMP_PI) <= angle_2)
+    {
+        bounds.axis = bounds_2.axis;
+        bounds.cos_normal_angle = bounds_2.cos_normal_angle;
+        return bounds;
+    }
+
+    imp_float angle = 0.5f*(angle_1 + angle_between_axes + angle_2);
+
+    const Vector3F& rotation_axis = bounds_1.axis.cross(bounds_2.axis);
+    imp_float rotation_axis_length = rotation_axis.length();
+
+    if (angle >= IMP_PI || rotation_axis_length == 0)
+    {
+        bounds.axis = bounds_1.axis;
+        bounds.cos_normal_angle = -1;
+        return bounds;
+    }
+
+    // Rotate the first axis towards the second, so that the new cone just touches both cones
+    imp_float rotation_angle = angle - angle_1;
+    const Vector3F& normalized_rotation_axis = rotation_axis/rotation_axis_length;
+
+    bounds.axis = (bounds_1.axis*std::cos(rotation_angle) + normalized_rotation_axis.cross(bounds_1.axis)*std::sin(rotation_angle)).normalized();
+    bounds.cos_normal_angle = std::cos(angle);
+
+    return bounds;
+}
+
+// Computes a conservative estimate of the radiance that the lights inside the given bounds can deliver to the given
+// position, taking into account the distance to the bounds and the angles between the emission cone, the direction
+// to the bounds and the surface normal at the position (which is ignored if it is zero)
+imp_float lightImportance(const LightBounds& bounds,
+                          const Point3F& position,
+                          const Normal3F& surface_normal)
+{
+    Point3F center = 0.5f*(bounds.bounding_box.lower_corner + bounds.bounding_box.upper_corner);
+    imp_float squared_radius = 0.25f*bounds.bounding_box.diagonal().squaredLength();
+
+    const Vector3F& offset = position - center;
+    imp_float squared_distance = offset.squaredLength();
+
+    // Avoid unbounded importance for positions close to or inside small bounds
+    imp_float clamped_squared_distance = std::max(squared_distance, std::max<imp_float>(std::sqrt(squared_radius), 1e-6f));
+
+    // Angle between the cone axis and the direction from the bounds to the position
+    const Vector3F& direction = (squared_distance > 0)? offset/std::sqrt(squared_distance) : bounds.axis;
+
+    imp_float cos_axis_angle = bounds.axis.dot(direction);
+    imp_float sin_axis_angle = sinFromCos(cos_axis_angle);
+
+    // Half the angle subtended by the bounding sphere of the bounds as seen from the position
+    imp_float cos_bounds_angle = (squared_distance > squared_radius)? std::sqrt(1 - squared_radius/squared_distance) : -1;
+    imp_float sin_bounds_angle = sinFromCos(cos_bounds_angle);
+
+    // Smallest possible angle between a normal inside the cone and a direction from the bounds to the position
+    imp_float cos_normal_angle = cos_axis_angle;
+    imp_float sin_normal_angle = sin_axis_angle;
+
+    imp_float cos_cone_angle = bounds.cos_normal_angle;
+    imp_float sin_cone_angle = sinFromCos(cos_cone_angle);
+
+    imp_float cos_reduced_angle = cosOfClampedDifference(sin_normal_angle, cos_normal_angle, sin_cone_angle, cos_cone_angle);
+    imp_float sin_reduced_angle = sinOfClampedDifference(sin_normal_angle, cos_normal_angle, sin_cone_angle, cos_cone_angle);
+
+    imp_float cos_min_angle = cosOfClampedDifference(sin_reduced_angle, cos_reduced_angle, sin_bounds_angle, cos_bounds_angle);
+
+    if (cos_min_angle <= bounds.cos_emission_angle)
+        return 0;
+
+    // Emission cones wider than a hemisphere allow negative cosines, so for them the cosine is remapped to stay positive
+    imp_float angular_falloff = (bounds.cos_emission_angle >= 0)? cos_min_angle :
+                                (cos_min_angle - bounds.cos_emission_angle)/(1 - bounds.cos_emission_angle);
+
+    imp_float importance = bounds.power*angular_falloff/clamped_squared_distance;
+
+    // Account for the smallest possible angle of incidence on the receiving surface
+    if (surface_normal.x != 0 || surface_normal.y != 0 || surface_normal.z != 0)
+    {
+        imp_float cos_incidence_angle = direction.absDot(surface_normal);
+        imp_float sin_incidence_angle = sinFromCos(cos_incidence_angle);
+
+        importance *= cosOfClampedDifference(sin_incidence_angle, cos_incidence_angle, sin_bounds_angle, cos_bounds_angle);
+    }
+
+    return importance;
+}
+
+} // RayImpact
+} // Impact
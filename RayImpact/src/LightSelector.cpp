@@ -0,0 +1,98 @@
+#include "LightSelector.hpp"
+#include "LightBVH.hpp"
+#include "error.hpp"
+#include <algorithm>
+
+namespace Impact {
+namespace RayImpact {
+
+// LightSelector utility functions
+
+// Computes the scalar emitted power of each light, used as the unnormalized selection probability
+static std::vector<imp_float> computeLightPowers(const std::vector<Light*>& lights)
+{
+    std::vector<imp_float> light_powers;
+    light_powers.reserve(lights.size());
+
+    for (const Light* light : lights)
+        light_powers.push_back(std::max<imp_float>(0, light->emittedPower().tristimulusY()));
+
+    return light_powers;
+}
+
+// PowerLightSelector method definitions
+
+PowerLightSelector::PowerLightSelector(const std::vector<Light*>& lights)
+    : lights(lights),
+      light_indices(),
+      power_distribution(computeLightPowers(lights).data(), (unsigned int)lights.size()),
+      has_power(power_distribution.integral > 0)
+{
+    for (unsigned int light_idx = 0; light_idx < lights.size(); light_idx++)
+        light_indices[lights[light_idx]] = light_idx;
+}
+
+const Light* PowerLightSelector::selectLight(const ScatteringEvent& scattering_event,
+                                             imp_float uniform_sample,
+                                             imp_float* selection_probability) const
+{
+    if (lights.empty())
+    {
+        *selection_probability = 0;
+        return nullptr;
+    }
+
+    unsigned int light_idx = power_distribution.discreteSample(uniform_sample);
+
+    // The distribution is uniform if no light emits any power
+    *selection_probability = (has_power)? power_distribution.discretePDF(light_idx) : 1.0f/lights.size();
+
+    return lights[light_idx];
+}
+
+imp_float PowerLightSelector::selectionProbability(const ScatteringEvent& scattering_event,
+                                                   const Light* light) const
+{
+    auto light_index = light_indices.find(light);
+
+    if (light_index == light_indices.end())
+        return 0;
+
+    return (has_power)? power_distribution.discretePDF(light_index->second) : 1.0f/lights.size();
+}
+
+// LightSelector function definitions
+
+LightSelectionStrategy lightSelectionStrategyFromName(const std::string& strategy_name)
+{
+    if (strategy_name == "uniform")
+        return LightSelectionStrategy::UNIFORM;
+    else if (strategy_name == "power")
+        return LightSelectionStrategy::POWER;
+    else if (strategy_name == "bvh")
+        return LightSelectionStrategy::BVH;
+    else if (strategy_name != "all")
+        printErrorMessage("light selection strategy \"%s\" is invalid. Sampling all lights.", strategy_name.c_str());
+
+    return LightSelectionStrategy::ALL;
+}
+
+// Creates a selector for the lights in the given scene, or returns null if all lights should be sampled
+LightSelector* createLightSelector(LightSelectionStrategy strategy,
+                                   const Scene& scene)
+{
+    switch (strategy)
+    {
+        case LightSelectionStrategy::UNIFORM:
+            return new UniformLightSelector(scene.lights);
+        case LightSelectionStrategy::POWER:
+            return new PowerLightSelector(scene.lights);
+        case LightSelectionStrategy::BVH:
+            return new LightBVH(scene.lights);
+        default:
+            return nullptr;
+    }
+}
+
+} // RayImpact
+} // Impact
@@ -3,11 +3,46 @@
 namespace Impact {
 namespace RayImpact {
 
+// Model method definitions
+
+// Finds the closest intersection of each ray in the packet, one ray at a time. The scattering
+// events and intersection flags of the rays are written to the given arrays at the ray indices.
+void Model::intersectPacket(const RayPacket& packet,
+                            SurfaceScatteringEvent* scattering_events,
+                            bool* has_intersections) const
+{
+    imp_assert(scattering_events && has_intersections);
+
+    for (unsigned int ray_idx = 0; ray_idx < packet.n_rays; ray_idx++)
+        has_intersections[ray_idx] = intersect(packet.rays[ray_idx], scattering_events + ray_idx);
+}
+
+// Tests each ray in the packet for an intersection, one ray at a time, and
+// returns a bit mask with the bits of the rays that intersect the model set
+uint32_t Model::hasIntersectionPacket(const RayPacket& packet) const
+{
+    uint32_t ray_mask = 0;
+
+    for (unsigned int ray_idx = 0; ray_idx < packet.n_rays; ray_idx++)
+        ray_mask |= (uint32_t)hasIntersection(packet.rays[ray_idx]) << ray_idx;
+
+    return ray_mask;
+}
+
+// Returns a model intersected by the given ray, or null if there is none. Aggregates return the
+// innermost model they contain that was hit, while other models return themselves.
+const Model* Model::occludingModel(const Ray& ray) const
+{
+    return (hasIntersection(ray))? this : nullptr;
+}
+
 // GeometricModel method definitions
 
 bool GeometricModel::intersect(const Ray& ray,
                                SurfaceScatteringEvent* scattering_event) const
 {
+    IMP_STAT_INCREMENT(n_primitive_tests);
+
     imp_float intersection_distance;
 
     if (!shape->intersect(ray, &intersection_distance, scattering_event))
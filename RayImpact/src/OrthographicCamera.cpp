@@ -99,6 +99,29 @@ imp_float OrthographicCamera::generateRayWithOffsets(const CameraSample& sample,
     return 1.0f;
 }
 
+bool OrthographicCamera::computeViewBounds(const BoundingRectangleF& raster_bounds,
+                                           const BoundingBoxF& scene_bounds,
+                                           BoundingBoxF* view_bounds) const
+{
+    Point3F corner_origins[4];
+    Vector3F corner_directions[4];
+
+    for (unsigned int corner_idx = 0; corner_idx < 4; corner_idx++)
+    {
+        Point3F sensor_point_in_raster_space((corner_idx & 1)? raster_bounds.upper_corner.x : raster_bounds.lower_corner.x,
+                                             (corner_idx & 2)? raster_bounds.upper_corner.y : raster_bounds.lower_corner.y,
+                                             0);
+
+        const Point3F& sensor_point = raster_to_camera(sensor_point_in_raster_space);
+
+        // Rays through the lens center start at the sensor point and point in the negative z-direction
+        corner_origins[corner_idx] = sensor_point;
+        corner_directions[corner_idx] = Vector3F(0, 0, -1);
+    }
+
+    return viewBoundsFromCornerRays(corner_origins, corner_directions, scene_bounds, view_bounds);
+}
+
 // OrthographicCamera function definitions
 
 Camera* createOrthographicCamera(const AnimatedTransformation& camera_to_world,
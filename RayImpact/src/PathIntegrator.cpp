@@ -0,0 +1,767 @@
+#include "PathIntegrator.hpp"
+#include "BSDF.hpp"
+#include "sampling.hpp"
+#include "spherical.hpp"
+#include "Scene.hpp"
+#include "parallel.hpp"
+#include "api.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <chrono>
+
+namespace Impact {
+namespace RayImpact {
+
+// PathIntegrator statistics variables
+
+IMP_STAT_HISTOGRAM("Path scatterings", path_scattering_counts, 16);
+IMP_STAT_COUNTER("Russian roulette terminations", n_roulette_terminations);
+IMP_STAT_COUNTER("Irradiance cache gathers", n_irradiance_gathers);
+
+// PathIntegrator method definitions
+
+// Creates the light selector and requests sample arrays for the light samples at each scattering event along a path.
+// When all lights are sampled, each light gets its own array, and otherwise there are arrays for the selected lights.
+// An empty irradiance cache covering the scene is created if it is to be used, and the path guide is trained.
+void PathIntegrator::preprocess(const Scene& scene, Sampler& sampler)
+{
+    light_selector.reset(createLightSelector(light_selection_strategy, scene));
+
+    if (use_irradiance_cache)
+    {
+        const BoundingBoxF& scene_bounds = scene.worldSpaceBoundingBox();
+
+        Point3F scene_center;
+        imp_float scene_radius;
+        scene_bounds.boundingSphere(&scene_center, &scene_radius);
+
+        irradiance_cache.reset(new IrradianceCache(scene_bounds.expanded(1e-3f*scene_radius),
+                                                   irradiance_error_tolerance,
+                                                   min_irradiance_radius*scene_radius,
+                                                   max_irradiance_radius*scene_radius));
+    }
+
+    for (unsigned int scattering_idx = 0; scattering_idx < max_scattering_count; scattering_idx++)
+    {
+        if (light_selector)
+        {
+            sampler.createArraysForNext1DSampleComponent(sampler.roundedArraySize(n_selected_lights));
+            sampler.createArraysForNext2DSampleComponent(sampler.roundedArraySize(n_selected_lights));
+        }
+        else
+        {
+            for (const auto& light : scene.lights)
+                sampler.createArraysForNext2DSampleComponent(sampler.roundedArraySize(light->n_samples));
+        }
+    }
+
+    // The path guide is trained after the sample arrays have been requested, since training clones the sampler
+    if (use_path_guiding)
+    {
+        const BoundingBoxF& scene_bounds = scene.worldSpaceBoundingBox();
+
+        Point3F scene_center;
+        imp_float scene_radius;
+        scene_bounds.boundingSphere(&scene_center, &scene_radius);
+
+        path_guide.reset(new SDTree(scene_bounds.expanded(1e-3f*scene_radius)));
+
+        trainPathGuide(scene);
+    }
+}
+
+RadianceSpectrum PathIntegrator::incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                                  const Scene& scene,
+                                                  Sampler& sampler,
+                                                  RegionAllocator& allocator,
+                                                  unsigned int scattering_count /* = 0 */,
+                                                  OccluderCache* occluder_cache /* = nullptr */) const
+{
+    SurfaceScatteringEvent scattering_event;
+
+    bool has_intersection = scene.intersect(outgoing_ray, &scattering_event);
+
+    return incidentRadianceFromIntersection(outgoing_ray,
+                                            (has_intersection)? &scattering_event : nullptr,
+                                            scene,
+                                            sampler,
+                                            allocator,
+                                            scattering_count,
+                                            nullptr,
+                                            nullptr,
+                                            occluder_cache);
+}
+
+RadianceSpectrum PathIntegrator::incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                                  SurfaceScatteringEvent* intersection_event,
+                                                                  const Scene& scene,
+                                                                  Sampler& sampler,
+                                                                  RegionAllocator& allocator,
+                                                                  unsigned int scattering_count /* = 0 */,
+                                                                  ShadowRayBatch* shadow_ray_batch /* = nullptr */,
+                                                                  const std::vector<Light*>* tile_lights /* = nullptr */,
+                                                                  OccluderCache* occluder_cache /* = nullptr */) const
+{
+    RadianceSpectrum total_incident_radiance(0.0f);
+
+    Spectrum path_throughput(1.0f); // Product of the BSDF values, cosines and inverse PDFs along the path
+    RayWithOffsets ray(outgoing_ray); // The current ray along the path
+
+    SurfaceScatteringEvent scattering_event; // Storage for the scattering events found after the first one
+    SurfaceScatteringEvent* current_event = intersection_event; // The current scattering event (null if the ray escaped)
+
+    ScatteringEvent previous_event; // The scattering event where the current ray was spawned
+    imp_float bsdf_pdf_value = 0; // Probability density of the BSDF sample giving the direction of the current ray
+    bool emission_is_unweighted = true; // Whether the current ray could not have been found by sampling lights
+    bool used_light_sample_arrays = false; // Whether the lights were sampled with the requested sample arrays at the previous scattering event
+    bool indirect_is_cached = false; // Whether the indirect radiance at the previous scattering event came from the irradiance cache
+
+    // Storage for the scattering events to record into the path guide while it is being trained
+    GuidedVertex* guided_vertices = (path_guide_is_training)? allocator.allocate<GuidedVertex>(max_scattering_count + 1) : nullptr;
+    unsigned int n_guided_vertices = 0;
+
+    unsigned int n_scatterings = scattering_count;
+
+    while (true)
+    {
+        // Add radiance from infinite lights if the ray escaped the scene
+        if (!current_event)
+        {
+            for (const auto& light : scene.lights)
+            {
+                const RadianceSpectrum& emitted_radiance = light->emittedRadianceFromDirection(ray);
+
+                if (!emitted_radiance.isBlack())
+                {
+                    imp_float weight = (emission_is_unweighted)? 1 : emittedRadianceWeight(*light, sampler, used_light_sample_arrays, previous_event, ray.direction, bsdf_pdf_value);
+                    total_incident_radiance += path_throughput*emitted_radiance*weight;
+                }
+            }
+
+            break;
+        }
+
+        const Vector3F outgoing_direction = current_event->outgoing_direction;
+
+        // Add radiance from the surface if it is emissive
+        const RadianceSpectrum& emitted_radiance = current_event->emittedRadiance(outgoing_direction);
+
+        if (!emitted_radiance.isBlack())
+        {
+            imp_float weight = (emission_is_unweighted)? 1 : emittedRadianceWeight(*(current_event->model->getAreaLight()), sampler, used_light_sample_arrays, previous_event, ray.direction, bsdf_pdf_value);
+            total_incident_radiance += path_throughput*emitted_radiance*weight;
+        }
+
+        // Only direct emission is needed after a scattering event whose indirect radiance was cached
+        if (n_scatterings >= max_scattering_count || indirect_is_cached)
+            break;
+
+        current_event->generateBSDF(ray, allocator);
+
+        // Continue through surfaces without a material (like medium boundaries) without scattering
+        if (!current_event->bsdf)
+        {
+            ray = RayWithOffsets(current_event->spawnRay(ray.direction));
+            current_event = (scene.intersect(ray, &scattering_event))? &scattering_event : nullptr;
+            continue;
+        }
+
+        const DirectionalQuadtree* guide_distribution = guideDistribution(*current_event);
+
+        total_incident_radiance += sampledDirectRadiance(*current_event, scene, sampler, path_throughput, guide_distribution, shadow_ray_batch, occluder_cache, &used_light_sample_arrays);
+
+        // Use the irradiance cache for the indirect radiance at the first diffuse surface seen by the camera
+        if (n_scatterings == 0 && usesIrradianceCache(*current_event))
+        {
+            total_incident_radiance += path_throughput*cachedIndirectRadiance(*current_event, scene, sampler, allocator, occluder_cache);
+            indirect_is_cached = true;
+        }
+
+        // Sample a new direction for the path from the BSDF (or from the path guide)
+        Vector3F incident_direction;
+        BXDFType sampled_type;
+
+        const Spectrum& bsdf_value = sampledScatteringDirection(*current_event,
+                                                                guide_distribution,
+                                                                sampler,
+                                                                &incident_direction,
+                                                                &bsdf_pdf_value,
+                                                                &sampled_type);
+
+        if (bsdf_value.isBlack() || bsdf_pdf_value == 0)
+            break;
+
+        path_throughput *= bsdf_value*(incident_direction.absDot(current_event->shading.surface_normal)/bsdf_pdf_value);
+
+        emission_is_unweighted = (sampled_type & BSDF_SPECULAR) != 0;
+
+        previous_event = *current_event;
+        ray = RayWithOffsets(current_event->spawnRay(incident_direction));
+
+        // The radiance gathered so far is stored so that the part arriving along the new direction can be found when
+        // the path ends. Cached events are skipped since their indirect radiance does not come from the continued path.
+        bool records_guide = guided_vertices && guide_distribution && !indirect_is_cached;
+
+        n_scatterings++;
+
+        // Terminate paths with low throughput with a probability that keeps the estimate unbiased
+        if (n_scatterings > roulette_scattering_count)
+        {
+            imp_float termination_probability = std::max<imp_float>(0.05f, 1 - path_throughput.maxCoefficient());
+
+            if (sampler.next1DSampleComponent() < termination_probability)
+            {
+                IMP_STAT_INCREMENT(n_roulette_terminations);
+                break;
+            }
+
+            path_throughput = path_throughput/(1 - termination_probability);
+        }
+
+        if (records_guide)
+        {
+            GuidedVertex& vertex = guided_vertices[n_guided_vertices++];
+
+            vertex.position = previous_event.position;
+            vertex.incident_direction = incident_direction;
+            vertex.pdf_value = bsdf_pdf_value;
+            vertex.path_throughput = path_throughput;
+            vertex.previous_radiance = total_incident_radiance;
+        }
+
+        current_event = (scene.intersect(ray, &scattering_event))? &scattering_event : nullptr;
+    }
+
+    IMP_STAT_HISTOGRAM_ADD(path_scattering_counts, n_scatterings);
+
+    if (n_guided_vertices > 0)
+        recordGuidedVertices(guided_vertices, n_guided_vertices, total_incident_radiance);
+
+    return total_incident_radiance;
+}
+
+// Estimates the direct radiance scattered along the outgoing direction of the given scattering event by sampling each
+// light (or a number of selected lights), weighted by the given path throughput. If a shadow ray batch is given, the
+// unoccluded contributions are added to the batch instead of being tested for visibility immediately, and are not
+// included in the returned radiance. Otherwise the given occluder cache (if any) is used for the visibility tests. Whether the requested sample arrays were available, rather than a single sample
+// being used for each light, is written to the given flag.
+RadianceSpectrum PathIntegrator::sampledDirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                                       const Scene& scene,
+                                                       Sampler& sampler,
+                                                       const Spectrum& path_throughput,
+                                                       const DirectionalQuadtree* guide_distribution,
+                                                       ShadowRayBatch* shadow_ray_batch,
+                                                       OccluderCache* occluder_cache,
+                                                       bool* used_sample_arrays) const
+{
+    RadianceSpectrum direct_radiance(0.0f);
+
+    *used_sample_arrays = true;
+
+    if (light_selector)
+    {
+        unsigned int n_selections = sampler.roundedArraySize(n_selected_lights);
+        const imp_float* selection_samples = sampler.arrayOfNext1DSampleComponent(n_selections);
+        const Point2F* light_samples = sampler.arrayOfNext2DSampleComponent(n_selections);
+
+        // Use a single selection if no arrays were requested for this scattering event
+        if (!selection_samples || !light_samples)
+        {
+            n_selections = 1;
+            *used_sample_arrays = false;
+        }
+
+        for (unsigned int selection_idx = 0; selection_idx < n_selections; selection_idx++)
+        {
+            imp_float selection_probability;
+
+            const Light* light = light_selector->selectLight(scattering_event,
+                                                             (selection_samples)? selection_samples[selection_idx] : sampler.next1DSampleComponent(),
+                                                             &selection_probability);
+
+            if (!light || selection_probability == 0)
+                continue;
+
+            direct_radiance += sampledLightRadiance(*light,
+                                                    scattering_event,
+                                                    (light_samples)? light_samples[selection_idx] : sampler.next2DSampleComponent(),
+                                                    n_selections,
+                                                    selection_probability,
+                                                    scene,
+                                                    path_throughput,
+                                                    guide_distribution,
+                                                    shadow_ray_batch,
+                                                    occluder_cache);
+        }
+
+        return direct_radiance;
+    }
+
+    for (const auto& light : scene.lights)
+    {
+        unsigned int n_light_samples = sampler.roundedArraySize(light->n_samples);
+        const Point2F* light_samples = sampler.arrayOfNext2DSampleComponent(n_light_samples);
+
+        // Use a single sample if no array was requested for this scattering event
+        if (!light_samples)
+        {
+            n_light_samples = 1;
+            *used_sample_arrays = false;
+        }
+
+        for (unsigned int sample_idx = 0; sample_idx < n_light_samples; sample_idx++)
+        {
+            direct_radiance += sampledLightRadiance(*light,
+                                                    scattering_event,
+                                                    (light_samples)? light_samples[sample_idx] : sampler.next2DSampleComponent(),
+                                                    n_light_samples,
+                                                    1,
+                                                    scene,
+                                                    path_throughput,
+                                                    guide_distribution,
+                                                    shadow_ray_batch,
+                                                    occluder_cache);
+        }
+    }
+
+    return direct_radiance;
+}
+
+// Computes the contribution of a single sample of the given light to the direct radiance estimate, where the light
+// is sampled the given number of times in total and was selected with the given probability
+RadianceSpectrum PathIntegrator::sampledLightRadiance(const Light& light,
+                                                      const SurfaceScatteringEvent& scattering_event,
+                                                      const Point2F& uniform_sample,
+                                                      unsigned int n_light_samples,
+                                                      imp_float selection_probability,
+                                                      const Scene& scene,
+                                                      const Spectrum& path_throughput,
+                                                      const DirectionalQuadtree* guide_distribution,
+                                                      ShadowRayBatch* shadow_ray_batch,
+                                                      OccluderCache* occluder_cache) const
+{
+    const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
+
+    Vector3F incident_direction;
+    imp_float light_pdf_value;
+    VisibilityTester visibility_tester;
+
+    const RadianceSpectrum& incident_radiance = light.sampleIncidentRadiance(scattering_event,
+                                                                             uniform_sample,
+                                                                             &incident_direction,
+                                                                             &light_pdf_value,
+                                                                             &visibility_tester);
+
+    if (incident_radiance.isBlack() || light_pdf_value == 0)
+        return RadianceSpectrum(0.0f);
+
+    const Spectrum& bsdf_value = scattering_event.bsdf->evaluate(outgoing_direction, incident_direction)*
+                                 incident_direction.absDot(scattering_event.shading.surface_normal);
+
+    if (bsdf_value.isBlack())
+        return RadianceSpectrum(0.0f);
+
+    // The probability density of the sample includes the probability of selecting the light
+    light_pdf_value *= selection_probability;
+
+    // Lights with a delta distribution can not be hit by BSDF sampled rays, so their samples get the full weight
+    imp_float weight = (lightIsDelta(light.flags))? 1 : powerHeuristic(n_light_samples, light_pdf_value,
+                                                                       1, scatteringPDF(scattering_event, incident_direction, guide_distribution));
+
+    const RadianceSpectrum& contribution = path_throughput*bsdf_value*incident_radiance*(weight/(n_light_samples*light_pdf_value));
+
+    if (shadow_ray_batch)
+        shadow_ray_batch->addShadowRay(visibility_tester.shadowRay(), contribution, &light);
+    else if (visibility_tester.beamIsUnobstructed(scene, &light, occluder_cache))
+        return contribution;
+
+    return RadianceSpectrum(0.0f);
+}
+
+// Computes the multiple importance sampling weight for radiance from the given light reached by a BSDF sampled ray,
+// taking into account that the light could also have been sampled from the previous scattering event. The number of
+// light samples taken there is the sample array size if the arrays were used, and one otherwise.
+imp_float PathIntegrator::emittedRadianceWeight(const Light& light,
+                                                const Sampler& sampler,
+                                                bool used_light_sample_arrays,
+                                                const ScatteringEvent& previous_scattering_event,
+                                                const Vector3F& incident_direction,
+                                                imp_float bsdf_pdf_value) const
+{
+    imp_float light_pdf_value = light.incidentRadiancePDF(previous_scattering_event, incident_direction);
+
+    if (light_selector)
+    {
+        light_pdf_value *= light_selector->selectionProbability(previous_scattering_event, &light);
+
+        return powerHeuristic(1, bsdf_pdf_value, (used_light_sample_arrays)? sampler.roundedArraySize(n_selected_lights) : 1, light_pdf_value);
+    }
+
+    return powerHeuristic(1, bsdf_pdf_value, (used_light_sample_arrays)? sampler.roundedArraySize(light.n_samples) : 1, light_pdf_value);
+}
+
+// Returns the learned distribution of incident radiance to sample directions from at the given scattering event,
+// or null if the path is not guided there. Events with specular components are not guided, since the learned
+// distribution can not represent their delta distributions.
+const DirectionalQuadtree* PathIntegrator::guideDistribution(const SurfaceScatteringEvent& scattering_event) const
+{
+    if (!path_guide)
+        return nullptr;
+
+    unsigned int n_components = scattering_event.bsdf->numberOfComponents();
+
+    if (n_components == 0 || scattering_event.bsdf->numberOfComponents(BXDFType(BSDF_ALL & ~BSDF_SPECULAR)) < n_components)
+        return nullptr;
+
+    return &(path_guide->samplingDistribution(scattering_event.position));
+}
+
+// Samples an incident direction at the given scattering event and returns the BSDF value for it. If a guide
+// distribution is given, the direction is sampled from it rather than from the BSDF with probability one minus
+// the BSDF sampling fraction, and the returned probability density is that of the combined distribution.
+Spectrum PathIntegrator::sampledScatteringDirection(const SurfaceScatteringEvent& scattering_event,
+                                                    const DirectionalQuadtree* guide_distribution,
+                                                    Sampler& sampler,
+                                                    Vector3F* incident_direction,
+                                                    imp_float* pdf_value,
+                                                    BXDFType* sampled_type) const
+{
+    const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
+    const Point2F& direction_sample = sampler.next2DSampleComponent();
+
+    if (!guide_distribution)
+    {
+        return scattering_event.bsdf->sample(outgoing_direction,
+                                             incident_direction,
+                                             direction_sample,
+                                             pdf_value,
+                                             BSDF_ALL,
+                                             sampled_type);
+    }
+
+    if (sampler.next1DSampleComponent() < bsdf_sampling_fraction)
+    {
+        scattering_event.bsdf->sample(outgoing_direction,
+                                      incident_direction,
+                                      direction_sample,
+                                      pdf_value,
+                                      BSDF_ALL,
+                                      sampled_type);
+
+        if (*pdf_value == 0)
+            return Spectrum(0.0f);
+    }
+    else
+    {
+        imp_float guide_pdf_value;
+        *incident_direction = guide_distribution->sample(direction_sample, &guide_pdf_value);
+
+        // Guided events have no specular components
+        *sampled_type = BXDFType(BSDF_ALL & ~BSDF_SPECULAR);
+    }
+
+    *pdf_value = scatteringPDF(scattering_event, *incident_direction, guide_distribution);
+
+    return scattering_event.bsdf->evaluate(outgoing_direction, *incident_direction);
+}
+
+// Returns the probability density of sampling the given incident direction at the given scattering event,
+// taking into account the guide distribution if one is given
+imp_float PathIntegrator::scatteringPDF(const SurfaceScatteringEvent& scattering_event,
+                                        const Vector3F& incident_direction,
+                                        const DirectionalQuadtree* guide_distribution) const
+{
+    imp_float bsdf_pdf_value = scattering_event.bsdf->pdf(scattering_event.outgoing_direction, incident_direction);
+
+    if (!guide_distribution)
+        return bsdf_pdf_value;
+
+    return bsdf_sampling_fraction*bsdf_pdf_value + (1 - bsdf_sampling_fraction)*guide_distribution->pdf(incident_direction);
+}
+
+// Records the incident radiance at each of the given scattering events into the path guide. The radiance
+// arriving along the sampled direction of an event is the radiance gathered by the path after it was continued,
+// divided by the path throughput up to that point. Its luminance divided by the probability density of the
+// direction is recorded, so that the learned distribution becomes proportional to the incident radiance.
+void PathIntegrator::recordGuidedVertices(const GuidedVertex* guided_vertices,
+                                          unsigned int n_guided_vertices,
+                                          const RadianceSpectrum& total_radiance) const
+{
+    for (unsigned int vertex_idx = 0; vertex_idx < n_guided_vertices; vertex_idx++)
+    {
+        const GuidedVertex& vertex = guided_vertices[vertex_idx];
+
+        if (!(vertex.pdf_value > 0))
+            continue;
+
+        const RadianceSpectrum& gathered_radiance = total_radiance - vertex.previous_radiance;
+
+        RadianceSpectrum incident_radiance(0.0f);
+
+        for (unsigned int coefficient_idx = 0; coefficient_idx < Spectrum::n_coefficients; coefficient_idx++)
+        {
+            if (vertex.path_throughput[coefficient_idx] > 0)
+                incident_radiance[coefficient_idx] = gathered_radiance[coefficient_idx]/vertex.path_throughput[coefficient_idx];
+        }
+
+        imp_float energy = std::max<imp_float>(0, incident_radiance.tristimulusY()/vertex.pdf_value);
+
+        if (std::isfinite(energy))
+            path_guide->record(vertex.position, vertex.incident_direction, energy);
+    }
+}
+
+// Learns the distribution of incident radiance in the scene by tracing paths through every pixel in a number of
+// training passes, where the number of samples per pixel doubles with each pass. Each pass is guided by the
+// distribution learned in the previous pass and records into a refined version of it. The radiance computed in
+// the training passes is discarded.
+void PathIntegrator::trainPathGuide(const Scene& scene)
+{
+    const BoundingRectangleI& sampling_bounds = camera->sensor->samplingBounds();
+    const Vector2I& sampling_extents = sampling_bounds.diagonal();
+
+    const unsigned int n_samples_per_pixel = sampler->n_samples_per_pixel;
+    const imp_float offset_scale = 1.0f/std::sqrt((imp_float)n_samples_per_pixel);
+
+    auto training_start_time = std::chrono::steady_clock::now();
+
+    // Each pass continues from the sample index where the previous pass ended, so that the passes use different samples
+    unsigned int first_sample_idx = 0;
+
+    path_guide_is_training = true;
+
+    for (unsigned int pass_idx = 0; pass_idx < n_guide_training_passes; pass_idx++)
+    {
+        unsigned int n_pass_samples = std::min(1u << std::min(pass_idx, 16u), n_samples_per_pixel);
+
+        // Loop over the rows of pixels in parallel
+        parallelFor(
+        [&](uint64_t row_idx)
+        {
+            // Create thread-private allocator and occluder cache
+            RegionAllocator allocator;
+            OccluderCache occluder_cache;
+
+            // Create thread-private sampler
+            std::unique_ptr<Sampler> row_sampler = sampler->cloned((unsigned int)(pass_idx*sampling_extents.y + row_idx));
+
+            int y = sampling_bounds.lower_corner.y + (int)row_idx;
+
+            for (int x = sampling_bounds.lower_corner.x; x < sampling_bounds.upper_corner.x; x++)
+            {
+                Point2I pixel(x, y);
+
+                for (unsigned int sample_idx = 0; sample_idx < n_pass_samples; sample_idx++)
+                {
+                    unsigned int pixel_sample_idx = (first_sample_idx + sample_idx) % n_samples_per_pixel;
+
+                    if (sample_idx == 0 || pixel_sample_idx == 0)
+                        beginPixelSamples(*row_sampler, sampling_bounds, pixel, pixel_sample_idx);
+                    else
+                        row_sampler->beginNextSample();
+
+                    const CameraSample& camera_sample = row_sampler->generateCameraSample(pixel);
+
+                    RayWithOffsets eye_ray;
+
+                    if (camera->generateRayWithOffsets(camera_sample, &eye_ray) > 0)
+                    {
+                        eye_ray.scaleOffsets(offset_scale);
+                        incidentRadiance(eye_ray, scene, *row_sampler, allocator, 0, &occluder_cache);
+                    }
+
+                    allocator.release();
+                }
+            }
+        },
+        sampling_extents.y);
+
+        first_sample_idx = (first_sample_idx + n_pass_samples) % n_samples_per_pixel;
+
+        path_guide->refine();
+
+        if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        {
+            double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - training_start_time).count();
+            printInfoMessage("Completed %u of %u path guide training passes in %.2f s (%u spatial leaves)",
+                             pass_idx + 1, n_guide_training_passes, elapsed_seconds, path_guide->numberOfLeaves());
+        }
+    }
+
+    path_guide_is_training = false;
+}
+
+// Returns whether the indirect radiance at the given scattering event should come from the irradiance cache,
+// which is the case when a cache is used and the BSDF only has diffuse reflection components
+bool PathIntegrator::usesIrradianceCache(const SurfaceScatteringEvent& scattering_event) const
+{
+    if (!irradiance_cache)
+        return false;
+
+    unsigned int n_components = scattering_event.bsdf->numberOfComponents();
+
+    return n_components > 0 && scattering_event.bsdf->numberOfComponents(BXDFType(BSDF_REFLECTION | BSDF_DIFFUSE)) == n_components;
+}
+
+// Computes the indirect radiance scattered along the outgoing direction of the given scattering event from the cached
+// irradiance, gathering the irradiance and adding it to the cache if no cached records can be used
+RadianceSpectrum PathIntegrator::cachedIndirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                                        const Scene& scene,
+                                                        Sampler& sampler,
+                                                        RegionAllocator& allocator,
+                                                        OccluderCache* occluder_cache) const
+{
+    // Gather over the hemisphere on the side of the outgoing direction
+    Vector3F surface_normal(scattering_event.shading.surface_normal);
+
+    if (surface_normal.dot(scattering_event.outgoing_direction) < 0)
+        surface_normal = -surface_normal;
+
+    IrradianceSpectrum irradiance;
+
+    if (!irradiance_cache->interpolatedIrradiance(scattering_event.position, surface_normal, &irradiance))
+        irradiance = gatheredIndirectIrradiance(scattering_event, surface_normal, scene, sampler, allocator, occluder_cache);
+
+    // The diffuse BSDF scatters the fraction reflectance/pi of the irradiance along any outgoing direction
+    const Point2F& reflectance_sample = sampler.next2DSampleComponent();
+
+    const ReflectionSpectrum& reflectance = scattering_event.bsdf->reduced(scattering_event.outgoing_direction,
+                                                                           1, &reflectance_sample,
+                                                                           BXDFType(BSDF_REFLECTION | BSDF_DIFFUSE));
+
+    return reflectance*irradiance*IMP_ONE_OVER_PI;
+}
+
+// Gathers the indirect irradiance at the given scattering event with stratified cosine-weighted paths over the
+// hemisphere around the given normal, and adds a record of it to the irradiance cache. The radiance emitted directly
+// from lights is excluded from the gather, since it is accounted for by the light samples.
+IrradianceSpectrum PathIntegrator::gatheredIndirectIrradiance(const SurfaceScatteringEvent& scattering_event,
+                                                              const Vector3F& surface_normal,
+                                                              const Scene& scene,
+                                                              Sampler& sampler,
+                                                              RegionAllocator& allocator,
+                                                              OccluderCache* occluder_cache) const
+{
+    IMP_STAT_INCREMENT(n_irradiance_gathers);
+
+    const unsigned int n_gather_samples = n_irradiance_theta_strata*n_irradiance_phi_strata;
+
+    std::vector<RadianceSpectrum> radiances(n_gather_samples, RadianceSpectrum(0.0f));
+    std::vector<imp_float> distances(n_gather_samples, IMP_INFINITY);
+
+    Vector3F x_axis, y_axis;
+    coordinateSystem(surface_normal, &x_axis, &y_axis);
+
+    SurfaceScatteringEvent gather_event;
+
+    for (unsigned int j = 0; j < n_irradiance_theta_strata; j++) {
+        for (unsigned int k = 0; k < n_irradiance_phi_strata; k++)
+        {
+            unsigned int sample_idx = j*n_irradiance_phi_strata + k;
+
+            const Point2F& stratum_sample = sampler.next2DSampleComponent();
+
+            // Sampling sin^2(theta) uniformly gives a cosine-weighted distribution of directions
+            imp_float sin_theta = std::sqrt((j + stratum_sample.x)/n_irradiance_theta_strata);
+            imp_float cos_theta = std::sqrt(std::max<imp_float>(0, 1 - sin_theta*sin_theta));
+            imp_float phi = IMP_TWO_PI*(k + stratum_sample.y)/n_irradiance_phi_strata;
+
+            const Vector3F& direction = sphericalToDirection(cos_theta, sin_theta, phi, x_axis, y_axis, surface_normal);
+
+            RayWithOffsets gather_ray(scattering_event.spawnRay(direction));
+
+            if (!scene.intersect(gather_ray, &gather_event))
+                continue;
+
+            distances[sample_idx] = (gather_event.position - scattering_event.position).length();
+
+            // Continue the path from the surface hit, without the radiance it emits itself
+            radiances[sample_idx] = incidentRadianceFromIntersection(gather_ray, &gather_event, scene, sampler, allocator, 1, nullptr, nullptr, occluder_cache) -
+                                    gather_event.emittedRadiance(gather_event.outgoing_direction);
+        }
+    }
+
+    return irradiance_cache->addRecord(scattering_event.position,
+                                       x_axis, y_axis, surface_normal,
+                                       n_irradiance_theta_strata, n_irradiance_phi_strata,
+                                       radiances.data(), distances.data());
+}
+
+// PathIntegrator function definitions
+
+Integrator* createPathIntegrator(std::shared_ptr<const Camera> camera,
+                                 std::shared_ptr<Sampler> sampler,
+                                 const ParameterSet& parameters)
+{
+    unsigned int max_scatterings = (unsigned int)std::abs(parameters.getSingleIntValue("max_scatterings", 5));
+    unsigned int roulette_scatterings = (unsigned int)std::abs(parameters.getSingleIntValue("roulette_scatterings", 3));
+    std::string light_selection_name = parameters.getSingleStringValue("light_selection", "all");
+    unsigned int selected_lights = (unsigned int)std::max(1, std::abs(parameters.getSingleIntValue("selected_lights", 1)));
+
+    bool irradiance_cache = parameters.getSingleBoolValue("irradiance_cache", false);
+    unsigned int irradiance_samples = (unsigned int)std::max(1, std::abs(parameters.getSingleIntValue("irradiance_samples", 256)));
+    imp_float irradiance_error = std::abs(parameters.getSingleFloatValue("irradiance_error", 0.3f));
+    imp_float min_irradiance_radius = std::abs(parameters.getSingleFloatValue("min_irradiance_radius", 0.005f));
+    imp_float max_irradiance_radius = std::abs(parameters.getSingleFloatValue("max_irradiance_radius", 0.2f));
+
+    bool path_guiding = parameters.getSingleBoolValue("path_guiding", false);
+    unsigned int guide_training_passes = (unsigned int)std::abs(parameters.getSingleIntValue("guide_training_passes", 6));
+    imp_float bsdf_sampling_fraction = clamp(parameters.getSingleFloatValue("bsdf_sampling_fraction", 0.5f), 0.0f, 1.0f);
+
+    LightSelectionStrategy light_selection = lightSelectionStrategyFromName(light_selection_name);
+
+    if (light_selection == LightSelectionStrategy::ALL)
+        light_selection_name = "all";
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+    {
+        printInfoMessage("Integrator:"
+                         "\n    %-20s%s"
+                         "\n    %-20s%u"
+                         "\n    %-20s%u"
+                         "\n    %-20s%s"
+                         "\n    %-20s%u",
+                         "Type:", "Path",
+                         "Max scatterings:", max_scatterings,
+                         "Roulette after:", roulette_scatterings,
+                         "Light selection:", light_selection_name.c_str(),
+                         "Selected lights:", selected_lights);
+
+        if (irradiance_cache)
+        {
+            printInfoMessage("Irradiance cache:"
+                             "\n    %-20s%u"
+                             "\n    %-20s%g"
+                             "\n    %-20s%g"
+                             "\n    %-20s%g",
+                             "Gather samples:", irradiance_samples,
+                             "Error tolerance:", irradiance_error,
+                             "Min radius:", min_irradiance_radius,
+                             "Max radius:", max_irradiance_radius);
+        }
+
+        if (path_guiding)
+        {
+            printInfoMessage("Path guiding:"
+                             "\n    %-20s%u"
+                             "\n    %-20s%g",
+                             "Training passes:", guide_training_passes,
+                             "BSDF fraction:", bsdf_sampling_fraction);
+        }
+    }
+
+    return new PathIntegrator(camera, sampler,
+                              max_scatterings, roulette_scatterings,
+                              light_selection, selected_lights,
+                              irradiance_cache, irradiance_samples,
+                              irradiance_error,
+                              min_irradiance_radius, max_irradiance_radius,
+                              path_guiding, guide_training_passes,
+                              bsdf_sampling_fraction);
+}
+
+} // RayImpact
+} // Impact
@@ -108,6 +108,32 @@ imp_float PerspectiveCamera::generateRayWithOffsets(const CameraSample& sample,
     return 1.0f;
 }
 
+bool PerspectiveCamera::computeViewBounds(const BoundingRectangleF& raster_bounds,
+                                          const BoundingBoxF& scene_bounds,
+                                          BoundingBoxF* view_bounds) const
+{
+    Point3F corner_origins[4];
+    Vector3F corner_directions[4];
+
+    for (unsigned int corner_idx = 0; corner_idx < 4; corner_idx++)
+    {
+        Point3F sensor_point_in_raster_space((corner_idx & 1)? raster_bounds.upper_corner.x : raster_bounds.lower_corner.x,
+                                             (corner_idx & 2)? raster_bounds.upper_corner.y : raster_bounds.lower_corner.y,
+                                             0);
+
+        const Point3F& sensor_point = raster_to_camera(sensor_point_in_raster_space);
+
+        if (sensor_point.z >= 0)
+            return false;
+
+        // Rays through the lens center start at the origin and point towards the sensor point at the near plane (scaled to unit depth)
+        corner_origins[corner_idx] = Point3F(0, 0, 0);
+        corner_directions[corner_idx] = Vector3F(sensor_point)*(1.0f/(-sensor_point.z));
+    }
+
+    return viewBoundsFromCornerRays(corner_origins, corner_directions, scene_bounds, view_bounds);
+}
+
 // PerspectiveCamera function definitions
 
 Camera* createPerspectiveCamera(const AnimatedTransformation& camera_to_world,
@@ -1,4 +1,5 @@
 #include "PointLight.hpp"
+#include "sampling.hpp"
 #include "api.hpp"
 
 namespace Impact {
@@ -18,31 +19,60 @@ RadianceSpectrum PointLight::sampleIncidentRadiance(const ScatteringEvent& scatt
 
     *visibility_tester = VisibilityTester(ScatteringEvent(position, medium_interface, scattering_event.time), scattering_event);
 
-    return emitted_intensity/squaredDistanceBetween(position, scattering_event.position);
+    imp_float squared_distance = squaredDistanceBetween(position, scattering_event.position);
+
+    if (squared_distance > range*range)
+        return RadianceSpectrum(0.0f);
+
+    return emitted_intensity/squared_distance;
+}
+
+// Emits rays uniformly in all directions. The rays end at the range of the light.
+RadianceSpectrum PointLight::sampleEmittedRadiance(const Point2F& position_sample,
+                                                   const Point2F& direction_sample,
+                                                   imp_float time,
+                                                   Ray* emitted_ray,
+                                                   Normal3F* surface_normal,
+                                                   imp_float* position_pdf_value,
+                                                   imp_float* direction_pdf_value) const
+{
+    const Vector3F& direction = uniformSphereSample(direction_sample);
+
+    *emitted_ray = Ray(position, direction, range, time);
+    *surface_normal = Normal3F(direction);
+    *position_pdf_value = 1.0f;
+    *direction_pdf_value = uniformSpherePDF();
+
+    return emitted_intensity;
 }
 
 // PointLight function definitions
 
-std::shared_ptr<Light> createPointLight(const Transformation& light_to_world,
-                                        const MediumInterface& medium_interface,
-                                        const ParameterSet& parameters)
+Light* createPointLight(const Transformation& light_to_world,
+                        const MediumInterface& medium_interface,
+                        const ParameterSet& parameters,
+                        ObjectArena& arena)
 {
     const IntensitySpectrum& intensity = parameters.getSingleSpectrumValue("intensity", RadianceSpectrum(1.0f));
+    imp_float range = parameters.getSingleFloatValue("range", IMP_INFINITY);
 	
 	if (RIMP_OPTIONS.verbosity >= IMP_LIGHTS_VERBOSITY)
 	{
 		printInfoMessage("Light:"
 						 "\n    %-20s%s"
 						 "\n    %-20s%s W/sr"
-						 "\n    %-20s%s m",
+						 "\n    %-20s%s m"
+						 "\n    %-20s%g m",
 						 "Type:", "Point",
 						 "Intensity:", intensity.toRGBString().c_str(),
-						 "Position:", light_to_world(Point3F(0, 0, 0)).toString().c_str());
+						 "Position:", light_to_world(Point3F(0, 0, 0)).toString().c_str(),
+						 "Range:", range);
 	}
 
-    return std::make_shared<PointLight>(light_to_world,
-                                        medium_interface,
-                                        intensity);
+    return arena.create<PointLight>(light_to_world,
+                                    medium_interface,
+                                    intensity,
+                                    range);
 }
 
 } // RayImpact
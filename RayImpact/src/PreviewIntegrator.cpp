@@ -0,0 +1,197 @@
+#include "PreviewIntegrator.hpp"
+#include "BSDF.hpp"
+#include "sampling.hpp"
+#include "math.hpp"
+#include "api.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// PreviewIntegrator statistics variables
+
+IMP_STAT_COUNTER("Ambient occlusion rays", n_ambient_occlusion_rays);
+
+// PreviewIntegrator method definitions
+
+// Requests a sample array for the occlusion rays or reflectance samples at the eye ray intersections
+void PreviewIntegrator::preprocess(const Scene& scene, Sampler& sampler)
+{
+    if (quantity == PreviewQuantity::AMBIENT_OCCLUSION || quantity == PreviewQuantity::ALBEDO)
+        sampler.createArraysForNext2DSampleComponent(sampler.roundedArraySize(n_samples));
+}
+
+RadianceSpectrum PreviewIntegrator::incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                                     const Scene& scene,
+                                                     Sampler& sampler,
+                                                     RegionAllocator& allocator,
+                                                     unsigned int scattering_count /* = 0 */,
+                                                     OccluderCache* occluder_cache /* = nullptr */) const
+{
+    SurfaceScatteringEvent scattering_event;
+
+    bool has_intersection = scene.intersect(outgoing_ray, &scattering_event);
+
+    return incidentRadianceFromIntersection(outgoing_ray,
+                                            (has_intersection)? &scattering_event : nullptr,
+                                            scene,
+                                            sampler,
+                                            allocator,
+                                            scattering_count,
+                                            nullptr,
+                                            nullptr,
+                                            occluder_cache);
+}
+
+// Returns the preview quantity for the given intersection as a spectrum, or black if the ray escaped
+RadianceSpectrum PreviewIntegrator::incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                                     SurfaceScatteringEvent* intersection_event,
+                                                                     const Scene& scene,
+                                                                     Sampler& sampler,
+                                                                     RegionAllocator& allocator,
+                                                                     unsigned int scattering_count /* = 0 */,
+                                                                     ShadowRayBatch* shadow_ray_batch /* = nullptr */,
+                                                                     const std::vector<Light*>* tile_lights /* = nullptr */,
+                                                                     OccluderCache* occluder_cache /* = nullptr */) const
+{
+    if (!intersection_event)
+        return RadianceSpectrum(0.0f);
+
+    SurfaceScatteringEvent& scattering_event = *intersection_event;
+
+    switch (quantity)
+    {
+        case PreviewQuantity::AMBIENT_OCCLUSION:
+        {
+            return RadianceSpectrum(ambientOcclusion(scattering_event, scene, sampler));
+        }
+        case PreviewQuantity::ALBEDO:
+        {
+            scattering_event.generateBSDF(outgoing_ray, allocator);
+
+            if (!scattering_event.bsdf)
+                return RadianceSpectrum(0.0f);
+
+            unsigned int n_reflectance_samples = sampler.roundedArraySize(n_samples);
+            const Point2F* reflectance_samples = sampler.arrayOfNext2DSampleComponent(n_reflectance_samples);
+
+            // Use a single sample if no array was requested
+            Point2F single_sample;
+
+            if (!reflectance_samples)
+            {
+                single_sample = sampler.next2DSampleComponent();
+                reflectance_samples = &single_sample;
+                n_reflectance_samples = 1;
+            }
+
+            return scattering_event.bsdf->reduced(scattering_event.outgoing_direction, n_reflectance_samples, reflectance_samples);
+        }
+        case PreviewQuantity::NORMALS:
+        {
+            const Normal3F& normal = scattering_event.shading.surface_normal;
+
+            imp_float rgb[3] = {0.5f*(normal.x + 1), 0.5f*(normal.y + 1), 0.5f*(normal.z + 1)};
+
+            return RadianceSpectrum::fromRGBValues(rgb);
+        }
+        case PreviewQuantity::DEPTH:
+        {
+            imp_float distance = (scattering_event.position - outgoing_ray.origin).length();
+
+            return RadianceSpectrum((max_distance < IMP_INFINITY)? std::min<imp_float>(1, distance/max_distance) : distance);
+        }
+    }
+
+    return RadianceSpectrum(0.0f);
+}
+
+// Estimates the fraction of the cosine-weighted hemisphere around the shading normal on the side of the
+// outgoing direction that is not occluded within the maximum distance. Only the existence of a hit matters,
+// so the occlusion rays terminate at the first hit found.
+imp_float PreviewIntegrator::ambientOcclusion(const SurfaceScatteringEvent& scattering_event,
+                                              const Scene& scene,
+                                              Sampler& sampler) const
+{
+    Vector3F surface_normal(scattering_event.shading.surface_normal);
+
+    if (surface_normal.dot(scattering_event.outgoing_direction) < 0)
+        surface_normal = -surface_normal;
+
+    Vector3F x_axis, y_axis;
+    coordinateSystem(surface_normal, &x_axis, &y_axis);
+
+    unsigned int n_occlusion_rays = sampler.roundedArraySize(n_samples);
+    const Point2F* direction_samples = sampler.arrayOfNext2DSampleComponent(n_occlusion_rays);
+
+    // Use a single ray if no array was requested
+    if (!direction_samples)
+        n_occlusion_rays = 1;
+
+    unsigned int n_unoccluded_rays = 0;
+
+    for (unsigned int ray_idx = 0; ray_idx < n_occlusion_rays; ray_idx++)
+    {
+        const Vector3F& local_direction = cosineWeightedHemisphereSample((direction_samples)? direction_samples[ray_idx] : sampler.next2DSampleComponent());
+
+        Ray occlusion_ray = scattering_event.spawnRay(x_axis*local_direction.x + y_axis*local_direction.y + surface_normal*local_direction.z);
+        occlusion_ray.max_distance = max_distance;
+
+        if (!scene.hasIntersection(occlusion_ray))
+            n_unoccluded_rays++;
+    }
+
+    IMP_STAT_ADD(n_ambient_occlusion_rays, n_occlusion_rays);
+
+    return (imp_float)n_unoccluded_rays/n_occlusion_rays;
+}
+
+// PreviewIntegrator function definitions
+
+Integrator* createPreviewIntegrator(std::shared_ptr<const Camera> camera,
+                                    std::shared_ptr<Sampler> sampler,
+                                    PreviewQuantity quantity,
+                                    const ParameterSet& parameters)
+{
+    unsigned int samples = 1;
+    imp_float max_distance = IMP_INFINITY;
+    const char* type_name = "";
+
+    switch (quantity)
+    {
+        case PreviewQuantity::AMBIENT_OCCLUSION:
+            samples = (unsigned int)std::max(1, std::abs(parameters.getSingleIntValue("samples", 16)));
+            max_distance = std::abs(parameters.getSingleFloatValue("max_distance", IMP_INFINITY));
+            type_name = "Ambient occlusion";
+            break;
+        case PreviewQuantity::ALBEDO:
+            samples = (unsigned int)std::max(1, std::abs(parameters.getSingleIntValue("samples", 4)));
+            type_name = "Albedo";
+            break;
+        case PreviewQuantity::NORMALS:
+            type_name = "Normals";
+            break;
+        case PreviewQuantity::DEPTH:
+            max_distance = std::abs(parameters.getSingleFloatValue("max_distance", IMP_INFINITY));
+            type_name = "Depth";
+            break;
+    }
+
+	if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+	{
+		printInfoMessage("Integrator:"
+						 "\n    %-20s%s"
+						 "\n    %-20s%u"
+						 "\n    %-20s%g",
+						 "Type:", type_name,
+						 "Samples:", samples,
+						 "Max distance:", max_distance);
+	}
+
+    return new PreviewIntegrator(camera, sampler, quantity, samples, max_distance);
+}
+
+} // RayImpact
+} // Impact
@@ -0,0 +1,341 @@
+#include "SDTree.hpp"
+#include "math.hpp"
+#include "spherical.hpp"
+#include "statistics.hpp"
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// SDTree statistics variables
+
+IMP_STAT_COUNTER("Path guide records", n_path_guide_records);
+
+// DirectionalQuadtree method definitions
+
+// Returns the point in the unit square corresponding to the given normalized direction
+Point2F DirectionalQuadtree::directionToSquare(const Vector3F& direction)
+{
+    return Point2F(clamp((direction.z + 1)*0.5f, 0.0f, IMP_ONE_MINUS_EPS),
+                   std::min(sphericalPhi(direction)*IMP_ONE_OVER_TWO_PI, IMP_ONE_MINUS_EPS));
+}
+
+// Returns the normalized direction corresponding to the given point in the unit square
+Vector3F DirectionalQuadtree::squareToDirection(const Point2F& point)
+{
+    imp_float cos_theta = 2*point.x - 1;
+    imp_float sin_theta = std::sqrt(std::max<imp_float>(0, 1 - cos_theta*cos_theta));
+
+    return sphericalToDirection(cos_theta, sin_theta, IMP_TWO_PI*point.y);
+}
+
+// Chooses the lower or upper half of an interval with probabilities proportional to the given energies
+// (or with equal probability if both are zero), and remaps the uniform sample to the chosen half
+unsigned int DirectionalQuadtree::sampledHalf(imp_float lower_energy, imp_float upper_energy, imp_float* uniform_sample)
+{
+    imp_float total_energy = lower_energy + upper_energy;
+    imp_float lower_fraction = (total_energy > 0)? lower_energy/total_energy : 0.5f;
+
+    if (*uniform_sample < lower_fraction)
+    {
+        *uniform_sample = std::min(*uniform_sample/lower_fraction, IMP_ONE_MINUS_EPS);
+        return 0;
+    }
+
+    *uniform_sample = std::min((*uniform_sample - lower_fraction)/(1 - lower_fraction), IMP_ONE_MINUS_EPS);
+    return 1;
+}
+
+// Adds the given energy to every quadrant containing the given direction
+void DirectionalQuadtree::record(const Vector3F& direction, imp_float energy)
+{
+    Point2F point = directionToSquare(direction);
+    uint32_t node_idx = 0;
+
+    while (true)
+    {
+        unsigned int quadrant_idx = quadrantIndex(&point);
+
+        nodes[node_idx].energies[quadrant_idx].add(energy);
+
+        node_idx = nodes[node_idx].children[quadrant_idx];
+
+        if (node_idx == 0)
+            break;
+    }
+}
+
+// Samples a direction with probability proportional to the recorded energy, by descending into quadrants
+// chosen first along the x-axis and then along the y-axis of the square. Each choice consumes one bit of the
+// corresponding sample component, so the precision of the samples is enough for the maximum depth. A tree
+// without any energy gives uniformly distributed directions.
+Vector3F DirectionalQuadtree::sample(const Point2F& uniform_sample, imp_float* pdf_value) const
+{
+    Point2F remapped_sample(uniform_sample);
+    Point2F origin(0, 0);
+    imp_float size = 1;
+    imp_float square_pdf_value = 1;
+
+    uint32_t node_idx = 0;
+
+    while (true)
+    {
+        const Node& node = nodes[node_idx];
+
+        imp_float total_energy = node.totalEnergy();
+
+        if (!(total_energy > 0))
+            break;
+
+        unsigned int x_half = sampledHalf(node.energies[0] + node.energies[2],
+                                          node.energies[1] + node.energies[3],
+                                          &remapped_sample.x);
+
+        unsigned int y_half = sampledHalf(node.energies[x_half],
+                                          node.energies[x_half + 2],
+                                          &remapped_sample.y);
+
+        unsigned int quadrant_idx = x_half + 2*y_half;
+
+        square_pdf_value *= 4*node.energies[quadrant_idx]/total_energy;
+
+        size *= 0.5f;
+        origin.x += x_half*size;
+        origin.y += y_half*size;
+
+        node_idx = node.children[quadrant_idx];
+
+        if (node_idx == 0)
+            break;
+    }
+
+    *pdf_value = square_pdf_value*IMP_ONE_OVER_FOUR_PI;
+
+    return squareToDirection(Point2F(origin.x + remapped_sample.x*size,
+                                     origin.y + remapped_sample.y*size));
+}
+
+// Returns the probability density with respect to solid angle of sampling the given normalized direction
+imp_float DirectionalQuadtree::pdf(const Vector3F& direction) const
+{
+    Point2F point = directionToSquare(direction);
+    imp_float square_pdf_value = 1;
+
+    uint32_t node_idx = 0;
+
+    while (true)
+    {
+        const Node& node = nodes[node_idx];
+
+        imp_float total_energy = node.totalEnergy();
+
+        if (!(total_energy > 0))
+            break;
+
+        unsigned int quadrant_idx = quadrantIndex(&point);
+
+        square_pdf_value *= 4*node.energies[quadrant_idx]/total_energy;
+
+        node_idx = node.children[quadrant_idx];
+
+        if (node_idx == 0)
+            break;
+    }
+
+    return square_pdf_value*IMP_ONE_OVER_FOUR_PI;
+}
+
+// Rebuilds the tree with empty quadrants, subdividing every quadrant that holds more than the given fraction
+// of the total energy of the source tree. Source quadrants without children are assumed to have their energy
+// spread uniformly, so they may be subdivided further, while quadrants with little energy are collapsed.
+void DirectionalQuadtree::refine(const DirectionalQuadtree& source, imp_float subdivision_threshold)
+{
+    nodes.clear();
+    nodes.emplace_back();
+
+    imp_float total_energy = source.totalEnergy();
+
+    if (total_energy > 0)
+        buildNode(0, source, 0, total_energy, subdivision_threshold*total_energy, 1);
+}
+
+// Creates the children of the given node for the quadrants that exceed the threshold energy. The source node
+// index refers to the corresponding node in the source tree, or is zero if the node lies inside a source leaf.
+void DirectionalQuadtree::buildNode(uint32_t node_idx,
+                                    const DirectionalQuadtree& source,
+                                    uint32_t source_node_idx,
+                                    imp_float node_energy,
+                                    imp_float threshold_energy,
+                                    unsigned int depth)
+{
+    if (depth >= max_depth)
+        return;
+
+    bool has_source_node = (depth == 1 || source_node_idx > 0);
+
+    for (unsigned int quadrant_idx = 0; quadrant_idx < 4; quadrant_idx++)
+    {
+        imp_float quadrant_energy = (has_source_node)? (imp_float)source.nodes[source_node_idx].energies[quadrant_idx] : 0.25f*node_energy;
+
+        if (quadrant_energy <= threshold_energy)
+            continue;
+
+        uint32_t child_idx = (uint32_t)nodes.size();
+        nodes.emplace_back();
+        nodes[node_idx].children[quadrant_idx] = child_idx;
+
+        buildNode(child_idx,
+                  source,
+                  (has_source_node)? source.nodes[source_node_idx].children[quadrant_idx] : 0,
+                  quadrant_energy,
+                  threshold_energy,
+                  depth + 1);
+    }
+}
+
+// SDTree method definitions
+
+SDTree::SDTree(const BoundingBoxF& bounds,
+               imp_float spatial_threshold /* = 12000 */,
+               imp_float directional_threshold /* = 0.01f */)
+    : bounds(bounds),
+      spatial_threshold(spatial_threshold),
+      directional_threshold(directional_threshold),
+      nodes(),
+      leaves(),
+      n_iterations(0),
+      memory(MemoryCategory::PathGuide)
+{
+    Node root;
+    root.children[0] = root.children[1] = 0;
+    root.split_axis = 0;
+    root.depth = 0;
+    root.leaf_idx = 0;
+
+    nodes.push_back(root);
+    leaves.emplace_back(new Leaf());
+
+    updateMemoryUsage();
+}
+
+// Sets the tracked memory to the number of bytes currently allocated for the spatial nodes and the leaves
+void SDTree::updateMemoryUsage()
+{
+    size_t n_bytes = nodes.capacity()*sizeof(Node) + leaves.capacity()*sizeof(std::unique_ptr<Leaf>);
+
+    for (const auto& leaf : leaves)
+        n_bytes += sizeof(Leaf) + leaf->sampling_distribution.memoryUsage() + leaf->recording_distribution.memoryUsage();
+
+    memory.remove(memory.bytes());
+    memory.add(n_bytes);
+}
+
+// Returns the index of the spatial leaf node containing the given position
+uint32_t SDTree::leafNodeIndex(const Point3F& position) const
+{
+    Vector3F local_position = bounds.getLocalCoordinate(position);
+    uint32_t node_idx = 0;
+
+    while (nodes[node_idx].children[0] > 0)
+    {
+        const Node& node = nodes[node_idx];
+
+        imp_float& coordinate = local_position[node.split_axis];
+
+        if (coordinate < 0.5f)
+        {
+            coordinate *= 2;
+            node_idx = node.children[0];
+        }
+        else
+        {
+            coordinate = 2*coordinate - 1;
+            node_idx = node.children[1];
+        }
+    }
+
+    return node_idx;
+}
+
+// Records an estimate of the incident radiance at the given position from the given normalized direction,
+// divided by the probability density of the direction. Can be called concurrently from multiple threads.
+void SDTree::record(const Point3F& position, const Vector3F& direction, imp_float energy)
+{
+    IMP_STAT_INCREMENT(n_path_guide_records);
+
+    Leaf& leaf = *leaves[nodes[leafNodeIndex(position)].leaf_idx];
+
+    leaf.n_samples.fetch_add(1, std::memory_order_relaxed);
+
+    if (energy > 0)
+        leaf.recording_distribution.record(direction, energy);
+}
+
+// Splits the given spatial leaf node, and then its children recursively, as long as the number of samples that
+// it is assumed to have received exceeds the given threshold. Both children inherit the directional distributions
+// of the parent.
+void SDTree::splitNode(uint32_t node_idx, imp_float n_samples, imp_float sample_threshold)
+{
+    if (n_samples <= sample_threshold || nodes[node_idx].depth >= max_depth)
+        return;
+
+    Leaf* upper_leaf = new Leaf();
+    const Leaf& lower_leaf = *leaves[nodes[node_idx].leaf_idx];
+
+    upper_leaf->sampling_distribution = lower_leaf.sampling_distribution;
+    upper_leaf->recording_distribution = lower_leaf.recording_distribution;
+
+    uint32_t upper_leaf_idx = (uint32_t)leaves.size();
+    leaves.emplace_back(upper_leaf);
+
+    Node child;
+    child.children[0] = child.children[1] = 0;
+    child.split_axis = (nodes[node_idx].split_axis + 1) % 3;
+    child.depth = nodes[node_idx].depth + 1;
+
+    uint32_t lower_child_idx = (uint32_t)nodes.size();
+    uint32_t upper_child_idx = lower_child_idx + 1;
+
+    child.leaf_idx = nodes[node_idx].leaf_idx;
+    nodes.push_back(child);
+
+    child.leaf_idx = upper_leaf_idx;
+    nodes.push_back(child);
+
+    nodes[node_idx].children[0] = lower_child_idx;
+    nodes[node_idx].children[1] = upper_child_idx;
+
+    splitNode(lower_child_idx, 0.5f*n_samples, sample_threshold);
+    splitNode(upper_child_idx, 0.5f*n_samples, sample_threshold);
+}
+
+// Ends the current training iteration. Spatial leaves are split where the number of recorded samples exceeds a
+// threshold that grows with the square root of the number of samples per iteration, which is assumed to double
+// with each iteration. The recorded distributions then become the sampling distributions, and the recording
+// distributions are refined for the next iteration. Must not be called concurrently with recording.
+void SDTree::refine()
+{
+    imp_float sample_threshold = spatial_threshold*std::sqrt(std::pow(2.0f, (imp_float)n_iterations));
+
+    uint32_t n_nodes = (uint32_t)nodes.size();
+
+    for (uint32_t node_idx = 0; node_idx < n_nodes; node_idx++)
+    {
+        if (nodes[node_idx].children[0] == 0)
+            splitNode(node_idx, (imp_float)leaves[nodes[node_idx].leaf_idx]->n_samples.load(), sample_threshold);
+    }
+
+    for (auto& leaf : leaves)
+    {
+        leaf->sampling_distribution = leaf->recording_distribution;
+        leaf->recording_distribution.refine(leaf->sampling_distribution, directional_threshold);
+        leaf->n_samples = 0;
+    }
+
+    n_iterations++;
+
+    updateMemoryUsage();
+}
+
+} // RayImpact
+} // Impact
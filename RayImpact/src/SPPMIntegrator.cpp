@@ -0,0 +1,586 @@
+#include "SPPMIntegrator.hpp"
+#include "parallel.hpp"
+#include "BSDF.hpp"
+#include "sampling.hpp"
+#include "statistics.hpp"
+#include "tracing.hpp"
+#include "string_util.hpp"
+#include "api.hpp"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+namespace Impact {
+namespace RayImpact {
+
+// SPPMIntegrator statistics variables
+
+IMP_STAT_RATE("Photons", n_photons);
+IMP_STAT_RATIO("Grid cells per visible point", n_visible_point_grid_cells, n_visible_points);
+IMP_STAT_RATIO("Visible points updated per photon deposit", n_photon_visible_point_updates, n_photon_deposits);
+
+// SPPMIntegrator utility functions
+
+// Finds the cell of the uniform grid with the given bounds and resolution that contains the given point.
+// Points outside the grid are assigned to the nearest cell, and false is returned for them.
+static bool gridCellOf(const Point3F& point,
+                       const BoundingBoxF& grid_bounds,
+                       const Point3I& grid_resolution,
+                       Point3I* cell)
+{
+    bool is_inside = true;
+
+    const Vector3F& extent = grid_bounds.diagonal();
+
+    for (unsigned int dim = 0; dim < 3; dim++)
+    {
+        int index = (int)(grid_resolution[dim]*(point[dim] - grid_bounds.lower_corner[dim])/extent[dim]);
+
+        is_inside = is_inside && index >= 0 && index < grid_resolution[dim];
+
+        (*cell)[dim] = std::min(std::max(index, 0), grid_resolution[dim] - 1);
+    }
+
+    return is_inside;
+}
+
+// Maps the given grid cell to an entry in a hash table of the given size
+static uint32_t hashGridCell(const Point3I& cell, uint32_t grid_size)
+{
+    return (uint32_t)(((uint32_t)cell.x*73856093u) ^ ((uint32_t)cell.y*19349663u) ^ ((uint32_t)cell.z*83492791u)) % grid_size;
+}
+
+// SPPMIntegrator method definitions
+
+// Follows the eye path for the current sample of the given pixel until it reaches a non-specular surface, and records
+// the visible point there. The radiance emitted towards the camera along the path and the direct radiance from lights
+// at each scattering event are added to the direct radiance sum of the pixel.
+void SPPMIntegrator::findVisiblePoint(const Scene& scene,
+                                      const LightSelector& light_selector,
+                                      const Point2I& pixel,
+                                      Sampler& pixel_sampler,
+                                      RegionAllocator& allocator,
+                                      OccluderCache* occluder_cache,
+                                      SPPMPixel* sppm_pixel) const
+{
+    const CameraSample& camera_sample = pixel_sampler.generateCameraSample(pixel);
+
+    RayWithOffsets ray;
+    imp_float ray_weight = camera->generateRayWithOffsets(camera_sample, &ray);
+    ray.scaleOffsets(1.0f/std::sqrt((imp_float)pixel_sampler.n_samples_per_pixel));
+
+    if (ray_weight == 0)
+        return;
+
+    Spectrum path_throughput(ray_weight);
+    bool is_specular_path = true; // Whether every scattering so far was specular
+
+    unsigned int n_scatterings = 0;
+
+    while (n_scatterings < max_scattering_count)
+    {
+        SurfaceScatteringEvent scattering_event;
+
+        if (!scene.intersect(ray, &scattering_event))
+        {
+            for (const auto& light : scene.lights)
+                sppm_pixel->direct_radiance += path_throughput*light->emittedRadianceFromDirection(ray);
+
+            break;
+        }
+
+        scattering_event.generateBSDF(ray, allocator);
+
+        // Continue through surfaces without a material without scattering
+        if (!scattering_event.bsdf)
+        {
+            ray = RayWithOffsets(scattering_event.spawnRay(ray.direction));
+            continue;
+        }
+
+        const BSDF& bsdf = *scattering_event.bsdf;
+        const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
+
+        // Emission reached through non-specular scattering is already included in the direct radiance estimates
+        if (is_specular_path)
+            sppm_pixel->direct_radiance += path_throughput*scattering_event.emittedRadiance(outgoing_direction);
+
+        sppm_pixel->direct_radiance += path_throughput*sampledDirectRadiance(scattering_event, scene, light_selector, pixel_sampler, occluder_cache);
+
+        bool is_diffuse = bsdf.numberOfComponents(BXDFType(BSDF_DIFFUSE | BSDF_REFLECTION | BSDF_TRANSMISSION)) > 0;
+        bool is_glossy = bsdf.numberOfComponents(BXDFType(BSDF_GLOSSY | BSDF_REFLECTION | BSDF_TRANSMISSION)) > 0;
+
+        // Glossy surfaces are scattered through unless the path can not be continued further
+        if (is_diffuse || (is_glossy && n_scatterings + 1 == max_scattering_count))
+        {
+            sppm_pixel->position = scattering_event.position;
+            sppm_pixel->outgoing_direction = outgoing_direction;
+            sppm_pixel->bsdf = &bsdf;
+            sppm_pixel->weight = path_throughput;
+            break;
+        }
+
+        Vector3F incident_direction;
+        imp_float pdf_value;
+        BXDFType sampled_type;
+
+        const Spectrum& bsdf_value = bsdf.sample(outgoing_direction,
+                                                 &incident_direction,
+                                                 pixel_sampler.next2DSampleComponent(),
+                                                 &pdf_value,
+                                                 BSDF_ALL,
+                                                 &sampled_type);
+
+        if (bsdf_value.isBlack() || pdf_value == 0)
+            break;
+
+        path_throughput *= bsdf_value*(incident_direction.absDot(scattering_event.shading.surface_normal)/pdf_value);
+
+        is_specular_path = is_specular_path && (sampled_type & BSDF_SPECULAR) != 0;
+
+        ray = RayWithOffsets(scattering_event.spawnRay(incident_direction));
+
+        n_scatterings++;
+    }
+}
+
+// Estimates the direct radiance scattered along the outgoing direction of the given scattering event
+// by sampling a single light selected in proportion to its emitted power. The shadow ray is first tested
+// against the model in the given occluder cache that last occluded a shadow ray towards the light.
+RadianceSpectrum SPPMIntegrator::sampledDirectRadiance(const SurfaceScatteringEvent& scattering_event,
+                                                       const Scene& scene,
+                                                       const LightSelector& light_selector,
+                                                       Sampler& pixel_sampler,
+                                                       OccluderCache* occluder_cache) const
+{
+    imp_float selection_probability;
+
+    const Light* light = light_selector.selectLight(scattering_event, pixel_sampler.next1DSampleComponent(), &selection_probability);
+
+    const Point2F& light_sample = pixel_sampler.next2DSampleComponent();
+
+    if (!light || selection_probability == 0)
+        return RadianceSpectrum(0.0f);
+
+    const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
+
+    Vector3F incident_direction;
+    imp_float light_pdf_value;
+    VisibilityTester visibility_tester;
+
+    const RadianceSpectrum& incident_radiance = light->sampleIncidentRadiance(scattering_event,
+                                                                              light_sample,
+                                                                              &incident_direction,
+                                                                              &light_pdf_value,
+                                                                              &visibility_tester);
+
+    if (incident_radiance.isBlack() || light_pdf_value == 0)
+        return RadianceSpectrum(0.0f);
+
+    const Spectrum& bsdf_value = scattering_event.bsdf->evaluate(outgoing_direction, incident_direction)*
+                                 incident_direction.absDot(scattering_event.shading.surface_normal);
+
+    if (bsdf_value.isBlack() || !visibility_tester.beamIsUnobstructed(scene, light, occluder_cache))
+        return RadianceSpectrum(0.0f);
+
+    return bsdf_value*incident_radiance/(light_pdf_value*selection_probability);
+}
+
+// Emits a photon from a light selected in proportion to its emitted power and traces it through the scene. At each
+// surface hit after the first, the flux of the photon is added to the visible points whose radius contains the hit.
+void SPPMIntegrator::tracePhoton(const Scene& scene,
+                                 const LightSelector& light_selector,
+                                 const std::atomic<SPPMPixelNode*>* grid,
+                                 uint32_t grid_size,
+                                 const BoundingBoxF& grid_bounds,
+                                 const Point3I& grid_resolution,
+                                 RandomNumberGenerator& rng,
+                                 RegionAllocator& allocator) const
+{
+    IMP_STAT_INCREMENT(n_photons);
+
+    imp_float selection_probability;
+
+    const Light* light = light_selector.selectLight(ScatteringEvent(), rng.uniformFloat(), &selection_probability);
+
+    if (!light || selection_probability == 0)
+        return;
+
+    const Point2F position_sample(rng.uniformFloat(), rng.uniformFloat());
+    const Point2F direction_sample(rng.uniformFloat(), rng.uniformFloat());
+    imp_float time = ::Impact::lerp(rng.uniformFloat(), camera->shutter_opening_time, camera->shutter_closing_time);
+
+    Ray emitted_ray;
+    Normal3F light_normal;
+    imp_float position_pdf_value;
+    imp_float direction_pdf_value;
+
+    const RadianceSpectrum& emitted_radiance = light->sampleEmittedRadiance(position_sample,
+                                                                            direction_sample,
+                                                                            time,
+                                                                            &emitted_ray,
+                                                                            &light_normal,
+                                                                            &position_pdf_value,
+                                                                            &direction_pdf_value);
+
+    if (emitted_radiance.isBlack() || position_pdf_value == 0 || direction_pdf_value == 0)
+        return;
+
+    Spectrum photon_weight = emitted_radiance*(emitted_ray.direction.absDot(light_normal)/
+                                               (selection_probability*position_pdf_value*direction_pdf_value));
+
+    if (photon_weight.isBlack())
+        return;
+
+    RayWithOffsets ray(emitted_ray);
+
+    unsigned int n_scatterings = 0;
+
+    while (n_scatterings < max_scattering_count)
+    {
+        SurfaceScatteringEvent scattering_event;
+
+        if (!scene.intersect(ray, &scattering_event))
+            break;
+
+        // Direct radiance is estimated separately for the visible points, so only scattered photons contribute
+        Point3I cell;
+
+        if (n_scatterings > 0 && gridCellOf(scattering_event.position, grid_bounds, grid_resolution, &cell))
+        {
+            IMP_STAT_INCREMENT(n_photon_deposits);
+
+            for (SPPMPixelNode* node = grid[hashGridCell(cell, grid_size)].load(std::memory_order_acquire); node; node = node->next)
+            {
+                SPPMPixel& pixel = *node->pixel;
+
+                if (squaredDistanceBetween(pixel.position, scattering_event.position) > pixel.radius*pixel.radius)
+                    continue;
+
+                IMP_STAT_INCREMENT(n_photon_visible_point_updates);
+
+                const Spectrum& photon_flux = photon_weight*pixel.bsdf->evaluate(pixel.outgoing_direction, scattering_event.outgoing_direction);
+
+                for (unsigned int i = 0; i < Spectrum::n_coefficients; i++)
+                    pixel.photon_flux[i].add(photon_flux[i]);
+
+                pixel.n_new_photons++;
+            }
+        }
+
+        scattering_event.generateBSDF(ray, allocator, TransportMode::Importance);
+
+        // Continue through surfaces without a material without scattering
+        if (!scattering_event.bsdf)
+        {
+            ray = RayWithOffsets(scattering_event.spawnRay(ray.direction));
+            continue;
+        }
+
+        Vector3F incident_direction;
+        imp_float pdf_value;
+
+        const Spectrum& bsdf_value = scattering_event.bsdf->sample(scattering_event.outgoing_direction,
+                                                                   &incident_direction,
+                                                                   Point2F(rng.uniformFloat(), rng.uniformFloat()),
+                                                                   &pdf_value);
+
+        if (bsdf_value.isBlack() || pdf_value == 0)
+            break;
+
+        const Spectrum& scattered_weight = photon_weight*bsdf_value*(incident_direction.absDot(scattering_event.shading.surface_normal)/pdf_value);
+
+        // Terminate the photon with a probability given by the reduction in its weight, so that surviving photons
+        // keep roughly the same weight
+        imp_float continuation_probability = std::min<imp_float>(1, scattered_weight.tristimulusY()/photon_weight.tristimulusY());
+
+        if (!(continuation_probability > 0) || rng.uniformFloat() >= continuation_probability)
+            break;
+
+        photon_weight = scattered_weight/continuation_probability;
+
+        ray = RayWithOffsets(scattering_event.spawnRay(incident_direction));
+
+        n_scatterings++;
+    }
+}
+
+void SPPMIntegrator::render(const Scene& scene)
+{
+    IMP_TRACE_SCOPE("Render");
+
+    #ifdef IMP_ENABLE_STATISTICS
+    auto start_time = std::chrono::steady_clock::now();
+    #endif
+
+    const BoundingRectangleI& pixel_bounds = camera->sensor->raster_crop_window;
+    const Vector2I& pixel_extents = pixel_bounds.diagonal();
+    const uint32_t n_pixels = (uint32_t)pixel_bounds.area();
+
+    std::unique_ptr<SPPMPixel[]> pixels(new SPPMPixel[n_pixels]);
+
+    // The final radiance estimates are written to the sensor as splats
+    camera->sensor->enableSplats();
+
+    for (uint32_t pixel_idx = 0; pixel_idx < n_pixels; pixel_idx++)
+        pixels[pixel_idx].radius = initial_radius;
+
+    // The same lights are selected for sampling direct radiance and for emitting photons
+    PowerLightSelector light_selector(scene.lights);
+
+    // The visible points and their grid entries live until the end of the iteration, so each thread allocates them
+    // in its own region, while the BSDFs along a photon path are released when the path is completed
+    std::unique_ptr<RegionAllocator[]> visible_point_allocators(new RegionAllocator[IMP_N_THREADS]);
+    std::unique_ptr<RegionAllocator[]> photon_allocators(new RegionAllocator[IMP_N_THREADS]);
+
+    // The hash table of grid cells has one entry per pixel
+    const uint32_t grid_size = n_pixels;
+    std::unique_ptr<std::atomic<SPPMPixelNode*>[]> grid(new std::atomic<SPPMPixelNode*>[grid_size]);
+
+    const int tile_extent = 16;
+    const uint32_t n_tiles_x = (uint32_t)((pixel_extents.x + tile_extent - 1)/tile_extent);
+    const uint32_t n_tiles_y = (uint32_t)((pixel_extents.y + tile_extent - 1)/tile_extent);
+
+    // Photons are traced in chunks with a random sequence each, so that the result does not depend on the threads
+    const uint32_t photons_per_chunk = 4096;
+    const uint32_t n_photon_chunks = (photons_per_iteration + photons_per_chunk - 1)/photons_per_chunk;
+
+    auto render_start_time = std::chrono::steady_clock::now();
+
+    for (unsigned int iteration_idx = 0; iteration_idx < n_iterations; iteration_idx++)
+    {
+        IMP_TRACE_SCOPE_WITH_ARGUMENTS("SPPM iteration", formatString("\"iteration\": %u", iteration_idx));
+
+        // Find the visible point of every pixel
+        parallelFor2D(
+        [&](uint32_t tile_i, uint32_t tile_j)
+        {
+            RegionAllocator& allocator = visible_point_allocators[IMP_THREAD_ID];
+            OccluderCache occluder_cache;
+
+            std::unique_ptr<Sampler> tile_sampler = sampler->cloned(tile_j*n_tiles_x + tile_i);
+
+            const Point2I tile_lower_corner(pixel_bounds.lower_corner.x + tile_i*tile_extent,
+                                            pixel_bounds.lower_corner.y + tile_j*tile_extent);
+
+            const BoundingRectangleI tile_bounds(tile_lower_corner,
+                                                 Point2I(std::min(tile_lower_corner.x + tile_extent, pixel_bounds.upper_corner.x),
+                                                         std::min(tile_lower_corner.y + tile_extent, pixel_bounds.upper_corner.y)));
+
+            for (Point2I pixel : tile_bounds)
+            {
+                beginPixelSamples(*tile_sampler, pixel_bounds, pixel, iteration_idx);
+
+                uint32_t pixel_idx = (uint32_t)(pixel_extents.x*(pixel.y - pixel_bounds.lower_corner.y) + (pixel.x - pixel_bounds.lower_corner.x));
+
+                findVisiblePoint(scene, light_selector, pixel, *tile_sampler, allocator, &occluder_cache, &pixels[pixel_idx]);
+            }
+        },
+        n_tiles_x, n_tiles_y);
+
+        // Make the grid cells about as large as the largest photon gathering disk
+        BoundingBoxF grid_bounds;
+        imp_float max_radius = 0;
+
+        for (uint32_t pixel_idx = 0; pixel_idx < n_pixels; pixel_idx++)
+        {
+            const SPPMPixel& pixel = pixels[pixel_idx];
+
+            if (!pixel.bsdf || pixel.weight.isBlack())
+                continue;
+
+            grid_bounds = unionOf(grid_bounds, BoundingBoxF(pixel.position).expanded(pixel.radius));
+            max_radius = std::max(max_radius, pixel.radius);
+        }
+
+        // Without any photon gathering disks, no photons can contribute in this iteration
+        if (max_radius > 0)
+        {
+            const Vector3F& grid_extent = grid_bounds.diagonal();
+            imp_float max_extent = grid_extent.maxComponent();
+            imp_float base_resolution = max_extent/max_radius;
+
+            Point3I grid_resolution;
+
+            for (unsigned int dim = 0; dim < 3; dim++)
+                grid_resolution[dim] = std::max(1, (int)std::min<imp_float>(base_resolution*grid_extent[dim]/max_extent, (imp_float)(1 << 20)));
+
+            for (uint32_t cell_idx = 0; cell_idx < grid_size; cell_idx++)
+                grid[cell_idx].store(nullptr, std::memory_order_relaxed);
+
+            // Add each visible point to the list of every grid cell overlapped by its photon gathering disk
+            parallelFor(
+            [&](uint64_t pixel_idx)
+            {
+                SPPMPixel& pixel = pixels[pixel_idx];
+
+                if (!pixel.bsdf || pixel.weight.isBlack())
+                    return;
+
+                RegionAllocator& allocator = visible_point_allocators[IMP_THREAD_ID];
+
+                const Vector3F radius_vector(pixel.radius, pixel.radius, pixel.radius);
+
+                Point3I lower_cell, upper_cell;
+                gridCellOf(pixel.position - radius_vector, grid_bounds, grid_resolution, &lower_cell);
+                gridCellOf(pixel.position + radius_vector, grid_bounds, grid_resolution, &upper_cell);
+
+                IMP_STAT_INCREMENT(n_visible_points);
+
+                for (int z = lower_cell.z; z <= upper_cell.z; z++)
+                    for (int y = lower_cell.y; y <= upper_cell.y; y++)
+                        for (int x = lower_cell.x; x <= upper_cell.x; x++)
+                        {
+                            IMP_STAT_INCREMENT(n_visible_point_grid_cells);
+
+                            std::atomic<SPPMPixelNode*>& cell_list = grid[hashGridCell(Point3I(x, y, z), grid_size)];
+
+                            SPPMPixelNode* node = allocator.allocate<SPPMPixelNode>();
+                            node->pixel = &pixel;
+                            node->next = cell_list.load(std::memory_order_relaxed);
+
+                            // Prepend the node to the list, retrying if another thread modified the list in the meantime
+                            while (!cell_list.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+                        }
+            },
+            n_pixels, 4096);
+
+            // Trace photons and gather them at the visible points
+            parallelFor(
+            [&](uint64_t chunk_idx)
+            {
+                RandomNumberGenerator rng((unsigned int)((uint64_t)iteration_idx*n_photon_chunks + chunk_idx));
+
+                RegionAllocator& allocator = photon_allocators[IMP_THREAD_ID];
+
+                uint32_t n_chunk_photons = std::min(photons_per_chunk, photons_per_iteration - (uint32_t)chunk_idx*photons_per_chunk);
+
+                for (uint32_t photon_idx = 0; photon_idx < n_chunk_photons; photon_idx++)
+                {
+                    tracePhoton(scene, light_selector, grid.get(), grid_size, grid_bounds, grid_resolution, rng, allocator);
+
+                    allocator.release();
+                }
+            },
+            n_photon_chunks);
+        }
+
+        // Shrink the radius of each pixel according to the number of gathered photons and update the accumulated flux
+        parallelFor(
+        [&](uint64_t pixel_idx)
+        {
+            SPPMPixel& pixel = pixels[pixel_idx];
+
+            uint32_t n_new_photons = pixel.n_new_photons;
+
+            if (n_new_photons > 0)
+            {
+                imp_float reduced_n_photons = pixel.n_photons + photon_fraction*n_new_photons;
+                imp_float radius = pixel.radius*std::sqrt(reduced_n_photons/(pixel.n_photons + n_new_photons));
+
+                Spectrum photon_flux;
+                for (unsigned int i = 0; i < Spectrum::n_coefficients; i++)
+                {
+                    photon_flux[i] = pixel.photon_flux[i];
+                    pixel.photon_flux[i] = 0;
+                }
+
+                pixel.flux = (pixel.flux + pixel.weight*photon_flux)*((radius*radius)/(pixel.radius*pixel.radius));
+                pixel.n_photons = reduced_n_photons;
+                pixel.radius = radius;
+                pixel.n_new_photons = 0;
+            }
+
+            pixel.bsdf = nullptr;
+            pixel.weight = Spectrum(0.0f);
+        },
+        n_pixels, 4096);
+
+        for (unsigned int thread_idx = 0; thread_idx < IMP_N_THREADS; thread_idx++)
+            visible_point_allocators[thread_idx].release();
+
+        if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        {
+            double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start_time).count();
+            printInfoMessage("Completed %u of %u iterations in %.2f s", iteration_idx + 1, n_iterations, elapsed_seconds);
+        }
+    }
+
+    #ifdef IMP_ENABLE_STATISTICS
+    // Gather the statistics recorded by each thread during rendering
+    mergeThreadStatistics();
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+    {
+        double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        printInfoMessage("%s", statisticsReport(elapsed_seconds).c_str());
+    }
+
+    clearStatistics();
+    #endif
+
+    // Combine the direct and photon radiance estimates and splat them onto the centers of the sensor pixels
+    const imp_float n_emitted_photons = (imp_float)n_iterations*(imp_float)photons_per_iteration;
+
+    parallelFor(
+    [&](uint64_t pixel_idx)
+    {
+        const SPPMPixel& pixel = pixels[pixel_idx];
+
+        const RadianceSpectrum& radiance = pixel.direct_radiance/(imp_float)n_iterations +
+                                           pixel.flux/(n_emitted_photons*IMP_PI*pixel.radius*pixel.radius);
+
+        const Point2F pixel_center(pixel_bounds.lower_corner.x + (imp_float)(pixel_idx % pixel_extents.x) + 0.5f,
+                                   pixel_bounds.lower_corner.y + (imp_float)(pixel_idx/pixel_extents.x) + 0.5f);
+
+        camera->sensor->addSplat(pixel_center, radiance);
+    },
+    n_pixels, 4096);
+
+    // Add the splats to the image while no threads are adding more
+    camera->sensor->mergeSplats();
+
+    // Write the final image to file
+    camera->sensor->writeImage();
+}
+
+// Photons affect every pixel, so a single pixel can not be rendered separately
+void SPPMIntegrator::renderSinglePixel(const Scene& scene, const Point2I& single_pixel)
+{
+    printWarningMessage("the SPPM integrator can not render a single pixel. Rendering the full image.");
+
+    render(scene);
+}
+
+// SPPMIntegrator function definitions
+
+Integrator* createSPPMIntegrator(std::shared_ptr<const Camera> camera,
+                                 std::shared_ptr<Sampler> sampler,
+                                 const ParameterSet& parameters)
+{
+    const Vector2I& resolution = camera->sensor->raster_crop_window.diagonal();
+
+    unsigned int photons_per_iteration = (unsigned int)std::abs(parameters.getSingleIntValue("photons_per_iteration", resolution.x*resolution.y));
+    unsigned int max_scatterings = (unsigned int)std::abs(parameters.getSingleIntValue("max_scatterings", 5));
+    imp_float radius = std::abs(parameters.getSingleFloatValue("radius", 1.0f));
+
+	if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+	{
+		printInfoMessage("Integrator:"
+						 "\n    %-20s%s"
+						 "\n    %-20s%u"
+						 "\n    %-20s%u"
+						 "\n    %-20s%u"
+						 "\n    %-20s%g m",
+						 "Type:", "SPPM",
+						 "Iterations:", sampler->n_samples_per_pixel,
+						 "Photons/iteration:", photons_per_iteration,
+						 "Max scatterings:", max_scatterings,
+						 "Initial radius:", radius);
+	}
+
+    return new SPPMIntegrator(camera, sampler, photons_per_iteration, max_scatterings, radius);
+}
+
+} // RayImpact
+} // Impact
@@ -6,6 +6,10 @@ namespace RayImpact {
 
 // Sampler method definitions
 
+// Resets the state of any random number generator used by the sampler (does nothing for deterministic samplers)
+void Sampler::setSeed(unsigned int seed)
+{}
+
 void Sampler::setPixel(const Point2I& pixel)
 {
     current_pixel = pixel;
@@ -50,12 +54,14 @@ void Sampler::createArraysForNext1DSampleComponent(unsigned int n_values)
 {
     sizes_of_1D_component_arrays.push_back(n_values);
     sample_component_arrays_1D.push_back(std::vector<imp_float>(n_values*n_samples_per_pixel));
+    array_memory.add(n_values*n_samples_per_pixel*sizeof(imp_float));
 }
 
 void Sampler::createArraysForNext2DSampleComponent(unsigned int n_values)
 {
     sizes_of_2D_component_arrays.push_back(n_values);
     sample_component_arrays_2D.push_back(std::vector<Point2F>(n_values*n_samples_per_pixel));
+    array_memory.add(n_values*n_samples_per_pixel*sizeof(Point2F));
 }
 
 const imp_float* Sampler::arrayOfNext1DSampleComponent(unsigned int n_values)
@@ -92,6 +98,13 @@ PixelSampler::PixelSampler(unsigned int n_samples_per_pixel,
         sample_components_1D.push_back(std::vector<imp_float>(n_samples_per_pixel));
         sample_components_2D.push_back(std::vector<Point2F>(n_samples_per_pixel));
     }
+
+    array_memory.add(n_sampled_dimensions*n_samples_per_pixel*(sizeof(imp_float) + sizeof(Point2F)));
+}
+
+void PixelSampler::setSeed(unsigned int seed)
+{
+    rng.setSeed(seed);
 }
 
 void PixelSampler::setPixel(const Point2I& pixel)
@@ -1,15 +1,61 @@
 #include "Scene.hpp"
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 namespace Impact {
 namespace RayImpact {
 
+// Scene statistics variables
+
+IMP_STAT_RATIO("Primitive tests per ray", n_primitive_tests, n_scene_rays);
+
+// Scene utility functions
+
+// Inserts two zero bits between each of the lowest 10 bits of the given value
+static uint32_t spreadBitsForMortonCode(uint32_t value)
+{
+    value &= 0x000003ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value <<  8)) & 0x0300f00f;
+    value = (value | (value <<  4)) & 0x030c30c3;
+    value = (value | (value <<  2)) & 0x09249249;
+    return value;
+}
+
+// Computes a key that groups rays by the octant of their direction, and orders
+// the rays in each octant along a Morton curve through the cells of their origins
+static uint64_t coherenceSortKey(const Ray& ray, const BoundingBoxF& world_bounding_box)
+{
+    const imp_float n_cells = 1024;
+
+    const Vector3F& local_origin = world_bounding_box.getLocalCoordinate(ray.origin);
+
+    uint32_t cell_x = (uint32_t)std::min(std::max(local_origin.x*n_cells, (imp_float)0), n_cells - 1);
+    uint32_t cell_y = (uint32_t)std::min(std::max(local_origin.y*n_cells, (imp_float)0), n_cells - 1);
+    uint32_t cell_z = (uint32_t)std::min(std::max(local_origin.z*n_cells, (imp_float)0), n_cells - 1);
+
+    uint64_t octant = (uint64_t)std::signbit(ray.direction.x) |
+                      ((uint64_t)std::signbit(ray.direction.y) << 1) |
+                      ((uint64_t)std::signbit(ray.direction.z) << 2);
+
+    uint64_t morton_code = (uint64_t)((spreadBitsForMortonCode(cell_z) << 2) |
+                                      (spreadBitsForMortonCode(cell_y) << 1) |
+                                       spreadBitsForMortonCode(cell_x));
+
+    return (octant << 30) | morton_code;
+}
+
 // Scene method definitions
 
-Scene::Scene(std::shared_ptr<Model> model_aggregate,
-             const std::vector< std::shared_ptr<Light> >& lights)
-    : model_aggregate(model_aggregate),
-      lights(lights),
-      world_bounding_box(model_aggregate->worldSpaceBoundingBox())
+Scene::Scene(std::unique_ptr<ObjectArena> arena,
+             const Model* model_aggregate,
+             const std::vector<Light*>& lights)
+    : arena(std::move(arena)),
+      model_aggregate(model_aggregate),
+      world_bounding_box(model_aggregate->worldSpaceBoundingBox()),
+      lights(lights)
 {
     for (const auto& light : lights)
     {
@@ -17,5 +63,56 @@ Scene::Scene(std::shared_ptr<Model> model_aggregate,
     }
 }
 
+// Tests whether each of the given rays is occluded by any model within its max distance. The rays are
+// sorted by direction octant and origin cell and traced as packets of rays sharing an octant. Bit
+// ray_idx % 64 of element ray_idx/64 in the given occlusion mask array is set for each occluded ray.
+void Scene::occluded(const Ray* rays, unsigned int n_rays, uint64_t* occlusion_mask) const
+{
+    imp_assert(rays || n_rays == 0);
+    imp_assert(occlusion_mask || n_rays == 0);
+
+    IMP_STAT_ADD(n_scene_rays, n_rays);
+
+    for (unsigned int word_idx = 0; word_idx < (n_rays + 63)/64; word_idx++)
+        occlusion_mask[word_idx] = 0;
+
+    std::vector< std::pair<uint64_t, unsigned int> > sorted_rays(n_rays);
+
+    for (unsigned int ray_idx = 0; ray_idx < n_rays; ray_idx++)
+        sorted_rays[ray_idx] = std::make_pair(coherenceSortKey(rays[ray_idx], world_bounding_box), ray_idx);
+
+    std::sort(sorted_rays.begin(), sorted_rays.end());
+
+    unsigned int sorted_idx = 0;
+
+    while (sorted_idx < n_rays)
+    {
+        const uint64_t octant = sorted_rays[sorted_idx].first >> 30;
+
+        // Gather consecutive rays in the same octant into a packet
+        RayPacket packet;
+        unsigned int packet_ray_indices[IMP_MAX_PACKET_SIZE];
+
+        while (sorted_idx < n_rays && packet.n_rays < IMP_MAX_PACKET_SIZE && (sorted_rays[sorted_idx].first >> 30) == octant)
+        {
+            unsigned int ray_idx = sorted_rays[sorted_idx++].second;
+            packet_ray_indices[packet.addRay(rays[ray_idx])] = ray_idx;
+        }
+
+        packet.prepare();
+
+        uint32_t ray_mask = model_aggregate->hasIntersectionPacket(packet);
+
+        for (unsigned int packet_ray_idx = 0; packet_ray_idx < packet.n_rays; packet_ray_idx++)
+        {
+            if (ray_mask & (1u << packet_ray_idx))
+            {
+                unsigned int ray_idx = packet_ray_indices[packet_ray_idx];
+                occlusion_mask[ray_idx/64] |= (uint64_t)1 << (ray_idx % 64);
+            }
+        }
+    }
+}
+
 } // RayImpact
 } // Impact
@@ -3,13 +3,37 @@
 #include "memory.hpp"
 #include "image_util.hpp"
 #include "string_util.hpp"
+#include "tracing.hpp"
+#include "file_util.hpp"
+#include "parallel.hpp"
 #include "api.hpp"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
 
 namespace Impact {
 namespace RayImpact {
 
+// Sensor checkpoint constants
+
+static const char checkpoint_magic[8] = "IMPCKPT"; // Identifier at the start of every checkpoint file
+static const uint32_t checkpoint_version = 1; // Version of the checkpoint file layout
+
+// Sensor checkpoint utility functions
+
+template <typename T>
+static void writeCheckpointValue(std::ofstream& file, const T& value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readCheckpointValue(std::ifstream& file, T* value)
+{
+    return (bool)file.read(reinterpret_cast<char*>(value), sizeof(T));
+}
+
 // Sensor method definitions
 
 Sensor::Sensor(const Vector2I& resolution,
@@ -18,7 +42,14 @@ Sensor::Sensor(const Vector2I& resolution,
                imp_float diagonal_extent,
                const std::string& output_filename,
                imp_float final_image_scale /* = 1.0f */)
-    : full_resolution(resolution),
+    : pixels(nullptr),
+      pixel_memory(MemoryCategory::SensorPixels),
+      sample_statistics(),
+      statistics_memory(MemoryCategory::SensorPixels),
+      splat_xyz_sums(),
+      thread_splat_caches(),
+      splat_memory(MemoryCategory::SensorPixels),
+      full_resolution(resolution),
       diagonal_extent(diagonal_extent),
       filter(std::move(reconstruction_filter)),
       output_filename(output_filename),
@@ -32,8 +63,13 @@ Sensor::Sensor(const Vector2I& resolution,
 
     imp_assert(!raster_crop_window.isDegenerate());
 
-    // Allocate memory for pixels
-    pixels = std::unique_ptr<Pixel[]>(new Pixel[raster_crop_window.area()]);
+    // Allocate memory for pixels (backed by huge pages if the array is large enough)
+    pixels = allocateLarge<Pixel>(raster_crop_window.area());
+
+    for (int i = 0; i < raster_crop_window.area(); i++)
+        new (pixels + i) Pixel();
+
+    pixel_memory.add(raster_crop_window.area()*sizeof(Pixel));
 
     // Precompute filter values for a range of offsets covering the radii of the filter
 
@@ -51,6 +87,11 @@ Sensor::Sensor(const Vector2I& resolution,
     }
 }
 
+Sensor::~Sensor()
+{
+    freeLarge(pixels);
+}
+
 // Returns a bounding rectangle encompassing all pixels on the sensor that need to be sampled
 BoundingRectangleI Sensor::samplingBounds() const
 {
@@ -97,9 +138,11 @@ std::unique_ptr<SensorRegion> Sensor::sensorRegion(const BoundingRectangleI& reg
                                                                    raster_crop_window);
 
     return std::unique_ptr<SensorRegion>(new SensorRegion(region_pixel_bounds,
+                                                          region_sampling_bounds,
                                                           filter->radius,
                                                           filter_table_width,
-                                                          filter_table));
+                                                          filter_table,
+                                                          hasSampleStatistics()));
 }
 
 Sensor::Pixel& Sensor::pixel(const Point2I& pixel_position)
@@ -116,7 +159,13 @@ Sensor::Pixel& Sensor::pixel(const Point2I& pixel_position)
 void Sensor::mergeSensorRegion(std::unique_ptr<SensorRegion> sensor_region)
 {
     // Aquire lock to the mutex so that only one thread can merge pixels at a time
-    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    {
+        IMP_TRACE_SCOPE("Wait for sensor lock");
+        lock.lock();
+    }
+
+    IMP_TRACE_SCOPE("Merge sensor region");
 
     // Iterate over all pixels in the region
     for (Point2I pixel_position : sensor_region->pixelBounds())
@@ -136,6 +185,115 @@ void Sensor::mergeSensorRegion(std::unique_ptr<SensorRegion> sensor_region)
         // Update sum of filter weights
         merge_pixel.sum_of_filter_weights += raw_pixel.sum_of_filter_weights;
     }
+
+    // Add the sample statistics of the region to those of the sensor
+    if (hasSampleStatistics())
+    {
+        for (Point2I sampling_pixel : sensor_region->samplingBounds())
+        {
+            const PixelSampleStatistics* region_statistics = sensor_region->sampleStatistics(sampling_pixel);
+
+            if (region_statistics)
+                sample_statistics[samplingPixelIndex(sampling_pixel)].add(*region_statistics);
+        }
+    }
+}
+
+// Merges pixel values computed with SensorRegion::computePixelValues into the sensor pixel array,
+// in the same way as mergeSensorRegion. Returns false if the bounds are not inside the crop window.
+bool Sensor::mergePixelValues(const BoundingRectangleI& region_pixel_bounds,
+                              const imp_float* region_pixel_values)
+{
+    imp_assert(region_pixel_values);
+
+    if (!region_pixel_bounds.isDegenerate() &&
+        (region_pixel_bounds.lower_corner.x < raster_crop_window.lower_corner.x ||
+         region_pixel_bounds.lower_corner.y < raster_crop_window.lower_corner.y ||
+         region_pixel_bounds.upper_corner.x > raster_crop_window.upper_corner.x ||
+         region_pixel_bounds.upper_corner.y > raster_crop_window.upper_corner.y))
+        return false;
+
+    // Aquire lock to the mutex so that only one thread can merge pixels at a time
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    {
+        IMP_TRACE_SCOPE("Wait for sensor lock");
+        lock.lock();
+    }
+
+    IMP_TRACE_SCOPE("Merge sensor region");
+
+    unsigned int region_pixel_idx = 0;
+
+    for (Point2I pixel_position : region_pixel_bounds)
+    {
+        const imp_float* values = region_pixel_values + 4*region_pixel_idx;
+        Pixel& merge_pixel = pixel(pixel_position);
+
+        merge_pixel.xyz_values[0] += values[0];
+        merge_pixel.xyz_values[1] += values[1];
+        merge_pixel.xyz_values[2] += values[2];
+
+        merge_pixel.sum_of_filter_weights += values[3];
+
+        region_pixel_idx++;
+    }
+
+    return true;
+}
+
+// Starts keeping track of the mean and variance of the sample luminances in each pixel,
+// which is needed for estimating the error of the pixels
+void Sensor::enableSampleStatistics()
+{
+    if (hasSampleStatistics())
+        return;
+
+    sample_statistics.resize(samplingBounds().area());
+    statistics_memory.add(sample_statistics.size()*sizeof(PixelSampleStatistics));
+}
+
+bool Sensor::hasSampleStatistics() const
+{
+    return !sample_statistics.empty();
+}
+
+// Returns the index of the given pixel in the array of sample statistics
+size_t Sensor::samplingPixelIndex(const Point2I& sampling_pixel) const
+{
+    const BoundingRectangleI& sampling_bounds = samplingBounds();
+
+    imp_assert(sampling_bounds.containsExclusive(sampling_pixel));
+
+    int sampling_width = sampling_bounds.upper_corner.x - sampling_bounds.lower_corner.x;
+
+    return (size_t)(sampling_width*(sampling_pixel.y - sampling_bounds.lower_corner.y)
+                                 + (sampling_pixel.x - sampling_bounds.lower_corner.x));
+}
+
+// Returns the estimated relative error of the mean luminance of the samples in the given pixel
+imp_float Sensor::relativeError(const Point2I& sampling_pixel) const
+{
+    if (!hasSampleStatistics())
+        return IMP_INFINITY;
+
+    return sample_statistics[samplingPixelIndex(sampling_pixel)].relativeError();
+}
+
+// Returns the number of sampled pixels whose relative error exceeds the given threshold
+unsigned int Sensor::numberOfUnconvergedPixels(imp_float error_threshold) const
+{
+    if (!hasSampleStatistics())
+        return samplingBounds().area();
+
+    unsigned int n_unconverged_pixels = 0;
+
+    for (const PixelSampleStatistics& statistics : sample_statistics)
+    {
+        if (statistics.relativeError() > error_threshold)
+            n_unconverged_pixels++;
+    }
+
+    return n_unconverged_pixels;
 }
 
 // Assigns the given energy spectra to the sensor pixels in the crop window
@@ -150,32 +308,132 @@ void Sensor::setPixels(const EnergySpectrum* pixel_values)
         pixel_values[i].computeTristimulusValues(pixel.xyz_values);
 
         pixel.sum_of_filter_weights = 1.0f;
-
-        pixel.xyz_sums_of_splats[0] = 0;
-        pixel.xyz_sums_of_splats[1] = 0;
-        pixel.xyz_sums_of_splats[2] = 0;
     }
+
+    std::fill(splat_xyz_sums.begin(), splat_xyz_sums.end(), 0.0f);
+
+    for (std::vector<CachedSplat>& splat_cache : thread_splat_caches)
+        splat_cache.clear();
 }
 
+// Allocates the storage for splats, which consists of the merged splat sums and a small cache of splats for
+// each thread, so that threads only need to synchronize when their cache is full. Must be called by integrators
+// that add splats before rendering.
+void Sensor::enableSplats()
+{
+    if (hasSplats())
+        return;
+
+    size_t n_values = 3*(size_t)raster_crop_window.area();
+
+    splat_xyz_sums.assign(n_values, 0.0f);
+
+    thread_splat_caches.resize(IMP_N_THREADS);
+
+    for (std::vector<CachedSplat>& splat_cache : thread_splat_caches)
+        splat_cache.reserve(splat_cache_size);
+
+    splat_memory.add(n_values*sizeof(imp_float) + IMP_N_THREADS*splat_cache_size*sizeof(CachedSplat));
+}
+
+bool Sensor::hasSplats() const
+{
+    return !splat_xyz_sums.empty();
+}
+
+// Adds the given radiance to the pixel containing the given sample position, without any filtering. The
+// contribution goes to the splat cache of the calling thread, and becomes part of the image when the cache is
+// flushed, which happens when it is full or when the splats are merged.
 void Sensor::addSplat(const Point2F& sample_position,
                       const RadianceSpectrum& radiance)
 {
-    if (!raster_crop_window.containsExclusive(static_cast<Point2I>(sample_position)))
+    imp_assert(hasSplats());
+
+    const Point2I& pixel_position = static_cast<Point2I>(sample_position);
+
+    if (!raster_crop_window.containsExclusive(pixel_position))
         return;
 
-    imp_float xyz[3];
+    int crop_window_width = raster_crop_window.upper_corner.x - raster_crop_window.lower_corner.x;
 
-    radiance.computeTristimulusValues(xyz);
+    CachedSplat splat;
 
-    Pixel& sample_pixel = pixel(static_cast<Point2I>(sample_position));
+    splat.crop_window_pixel_idx = (uint32_t)(crop_window_width*(pixel_position.y - raster_crop_window.lower_corner.y)
+                                                             + (pixel_position.x - raster_crop_window.lower_corner.x));
 
-    sample_pixel.xyz_sums_of_splats[0].add(xyz[0]);
-    sample_pixel.xyz_sums_of_splats[1].add(xyz[1]);
-    sample_pixel.xyz_sums_of_splats[2].add(xyz[2]);
+    radiance.computeTristimulusValues(splat.xyz_values);
+
+    std::vector<CachedSplat>& splat_cache = thread_splat_caches[IMP_THREAD_ID];
+
+    splat_cache.push_back(splat);
+
+    if (splat_cache.size() >= splat_cache_size)
+        flushSplatCache(splat_cache);
 }
 
+// Adds the given cached splats to the splat sums and empties the cache
+void Sensor::flushSplatCache(std::vector<CachedSplat>& splat_cache)
+{
+    std::lock_guard<std::mutex> lock(splat_mutex);
+
+    for (const CachedSplat& splat : splat_cache)
+    {
+        imp_float* xyz_sums = &splat_xyz_sums[3*(size_t)splat.crop_window_pixel_idx];
+
+        xyz_sums[0] += splat.xyz_values[0];
+        xyz_sums[1] += splat.xyz_values[1];
+        xyz_sums[2] += splat.xyz_values[2];
+    }
+
+    splat_cache.clear();
+}
+
+// Adds the splats remaining in the caches of all threads to the splat sums and empties the caches. The pixels
+// are divided into disjoint ranges that are merged in parallel, each by scanning all the caches for splats in its
+// range, so no locking is needed. Must not be called while splats are being added, typically at the end of a pass.
+void Sensor::mergeSplats()
+{
+    if (!hasSplats())
+        return;
+
+    IMP_TRACE_SCOPE("Merge splats");
+
+    const uint64_t n_pixels = splat_xyz_sums.size()/3;
+    const uint64_t n_ranges = std::min<uint64_t>(IMP_N_THREADS, n_pixels);
+    const uint64_t pixels_per_range = (n_pixels + n_ranges - 1)/n_ranges;
+
+    parallelFor(
+    [&](uint64_t range_idx)
+    {
+        const uint64_t start_idx = range_idx*pixels_per_range;
+        const uint64_t end_idx = std::min(start_idx + pixels_per_range, n_pixels);
+
+        for (const std::vector<CachedSplat>& splat_cache : thread_splat_caches)
+        {
+            for (const CachedSplat& splat : splat_cache)
+            {
+                if (splat.crop_window_pixel_idx < start_idx || splat.crop_window_pixel_idx >= end_idx)
+                    continue;
+
+                imp_float* xyz_sums = &splat_xyz_sums[3*(size_t)splat.crop_window_pixel_idx];
+
+                xyz_sums[0] += splat.xyz_values[0];
+                xyz_sums[1] += splat.xyz_values[1];
+                xyz_sums[2] += splat.xyz_values[2];
+            }
+        }
+    },
+    n_ranges);
+
+    for (std::vector<CachedSplat>& splat_cache : thread_splat_caches)
+        splat_cache.clear();
+}
+
+// Writes the image to file, including any splats (scaled by the given factor), which are merged first
 void Sensor::writeImage(imp_float splat_scale /* = 1 */)
 {
+    mergeSplats();
+
     std::unique_ptr<imp_float[]> pixel_rgb_values(new imp_float[3*raster_crop_window.area()]);
 
     unsigned int pixel_idx = 0;
@@ -199,18 +457,16 @@ void Sensor::writeImage(imp_float splat_scale /* = 1 */)
         }
 
         // Add color contributions from splats
+        if (hasSplats())
+        {
+            imp_float splat_rgb[3];
 
-        imp_float splat_xyz[3] = {sensor_pixel.xyz_sums_of_splats[0],
-                                  sensor_pixel.xyz_sums_of_splats[1],
-                                  sensor_pixel.xyz_sums_of_splats[2]};
-
-        imp_float splat_rgb[3];
-
-        tristimulusToRGB(splat_xyz, splat_rgb);
+            tristimulusToRGB(&splat_xyz_sums[3*pixel_idx], splat_rgb);
 
-        pixel_rgb_values[3*pixel_idx    ] += splat_rgb[0]*splat_scale;
-        pixel_rgb_values[3*pixel_idx + 1] += splat_rgb[1]*splat_scale;
-        pixel_rgb_values[3*pixel_idx + 2] += splat_rgb[2]*splat_scale;
+            pixel_rgb_values[3*pixel_idx    ] += splat_rgb[0]*splat_scale;
+            pixel_rgb_values[3*pixel_idx + 1] += splat_rgb[1]*splat_scale;
+            pixel_rgb_values[3*pixel_idx + 2] += splat_rgb[2]*splat_scale;
+        }
 
         pixel_idx++;
     }
@@ -221,6 +477,202 @@ void Sensor::writeImage(imp_float splat_scale /* = 1 */)
 			 final_image_scale);
 }
 
+// Writes the accumulated pixel values, sample statistics and given rendering progress to a binary checkpoint file.
+// The file is first written under a temporary name and then renamed, so an existing checkpoint is only
+// replaced by a complete one. The values are stored in the native byte order and precision. Any cached
+// splats are merged first.
+bool Sensor::writeCheckpoint(const std::string& filename, const RenderProgress& progress)
+{
+    IMP_TRACE_SCOPE("Write checkpoint");
+
+    mergeSplats();
+
+    const std::string& temporary_filename = filename + ".tmp";
+
+    std::ofstream file;
+    file.open(temporary_filename.c_str(), std::ios::binary);
+
+    if (!file.is_open())
+    {
+        printErrorMessage("cannot open file \"%s\" for output", temporary_filename.c_str());
+        return false;
+    }
+
+    const BoundingRectangleI& sampling_bounds = samplingBounds();
+
+    // Write header
+    file.write(checkpoint_magic, sizeof(checkpoint_magic));
+    writeCheckpointValue(file, checkpoint_version);
+    writeCheckpointValue(file, (uint32_t)sizeof(imp_float));
+
+    writeCheckpointValue(file, (int32_t)raster_crop_window.lower_corner.x);
+    writeCheckpointValue(file, (int32_t)raster_crop_window.lower_corner.y);
+    writeCheckpointValue(file, (int32_t)raster_crop_window.upper_corner.x);
+    writeCheckpointValue(file, (int32_t)raster_crop_window.upper_corner.y);
+
+    writeCheckpointValue(file, (int32_t)sampling_bounds.lower_corner.x);
+    writeCheckpointValue(file, (int32_t)sampling_bounds.lower_corner.y);
+    writeCheckpointValue(file, (int32_t)sampling_bounds.upper_corner.x);
+    writeCheckpointValue(file, (int32_t)sampling_bounds.upper_corner.y);
+
+    writeCheckpointValue(file, progress.n_samples_per_pixel);
+    writeCheckpointValue(file, progress.n_pass_samples);
+    writeCheckpointValue(file, progress.n_completed_samples);
+    writeCheckpointValue(file, progress.n_completed_passes);
+
+    writeCheckpointValue(file, (uint32_t)hasSampleStatistics());
+
+    // Write the state of each pixel in the crop window
+    unsigned int n_pixels = raster_crop_window.area();
+
+    std::vector<imp_float> pixel_values(7*n_pixels);
+
+    for (unsigned int i = 0; i < n_pixels; i++)
+    {
+        const Pixel& sensor_pixel = pixels[i];
+
+        pixel_values[7*i    ] = sensor_pixel.xyz_values[0];
+        pixel_values[7*i + 1] = sensor_pixel.xyz_values[1];
+        pixel_values[7*i + 2] = sensor_pixel.xyz_values[2];
+        pixel_values[7*i + 3] = sensor_pixel.sum_of_filter_weights;
+        pixel_values[7*i + 4] = (hasSplats())? splat_xyz_sums[3*i    ] : 0.0f;
+        pixel_values[7*i + 5] = (hasSplats())? splat_xyz_sums[3*i + 1] : 0.0f;
+        pixel_values[7*i + 6] = (hasSplats())? splat_xyz_sums[3*i + 2] : 0.0f;
+    }
+
+    file.write(reinterpret_cast<const char*>(pixel_values.data()), pixel_values.size()*sizeof(imp_float));
+
+    // Write the sample statistics of each pixel in the sampling bounds
+    for (const PixelSampleStatistics& statistics : sample_statistics)
+    {
+        writeCheckpointValue(file, statistics.sum_of_luminances);
+        writeCheckpointValue(file, statistics.sum_of_squared_luminances);
+        writeCheckpointValue(file, statistics.n_samples);
+    }
+
+    file.close();
+
+    if (file.fail())
+    {
+        printErrorMessage("could not write checkpoint to \"%s\"", temporary_filename.c_str());
+        removeFile(temporary_filename);
+        return false;
+    }
+
+    return replaceFile(temporary_filename, filename);
+}
+
+// Restores the pixel values and sample statistics from the given checkpoint file and returns the stored rendering progress.
+// The given progress must specify the number of samples per pixel and per pass of the current rendering. Returns false
+// without modifying the sensor if the file does not exist or was not written for the same sensor and sampling settings.
+bool Sensor::readCheckpoint(const std::string& filename, RenderProgress* progress)
+{
+    imp_assert(progress);
+
+    IMP_TRACE_SCOPE("Read checkpoint");
+
+    std::ifstream file;
+    file.open(filename.c_str(), std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    const BoundingRectangleI& sampling_bounds = samplingBounds();
+
+    char magic[sizeof(checkpoint_magic)];
+    uint32_t version;
+    uint32_t float_size;
+    int32_t bounds[8];
+    RenderProgress stored_progress;
+    uint32_t has_statistics;
+
+    bool success = (bool)file.read(magic, sizeof(magic)) &&
+                   readCheckpointValue(file, &version) &&
+                   readCheckpointValue(file, &float_size);
+
+    for (unsigned int i = 0; i < 8 && success; i++)
+        success = readCheckpointValue(file, &bounds[i]);
+
+    success = success &&
+              readCheckpointValue(file, &stored_progress.n_samples_per_pixel) &&
+              readCheckpointValue(file, &stored_progress.n_pass_samples) &&
+              readCheckpointValue(file, &stored_progress.n_completed_samples) &&
+              readCheckpointValue(file, &stored_progress.n_completed_passes) &&
+              readCheckpointValue(file, &has_statistics);
+
+    if (!success || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0 || version != checkpoint_version)
+    {
+        printWarningMessage("\"%s\" is not a valid checkpoint file. Starting from scratch.", filename.c_str());
+        return false;
+    }
+
+    if (float_size != sizeof(imp_float) ||
+        bounds[0] != raster_crop_window.lower_corner.x || bounds[1] != raster_crop_window.lower_corner.y ||
+        bounds[2] != raster_crop_window.upper_corner.x || bounds[3] != raster_crop_window.upper_corner.y ||
+        bounds[4] != sampling_bounds.lower_corner.x || bounds[5] != sampling_bounds.lower_corner.y ||
+        bounds[6] != sampling_bounds.upper_corner.x || bounds[7] != sampling_bounds.upper_corner.y ||
+        (has_statistics != 0) != hasSampleStatistics())
+    {
+        printWarningMessage("checkpoint \"%s\" was written for a different sensor configuration. Starting from scratch.", filename.c_str());
+        return false;
+    }
+
+    if (stored_progress.n_samples_per_pixel != progress->n_samples_per_pixel ||
+        stored_progress.n_pass_samples != progress->n_pass_samples ||
+        stored_progress.n_completed_samples > stored_progress.n_samples_per_pixel ||
+        stored_progress.n_completed_passes == 0)
+    {
+        printWarningMessage("checkpoint \"%s\" was written with different sampling settings. Starting from scratch.", filename.c_str());
+        return false;
+    }
+
+    // Read everything before modifying the sensor, so that a truncated file leaves it untouched
+
+    unsigned int n_pixels = raster_crop_window.area();
+
+    std::vector<imp_float> pixel_values(7*n_pixels);
+
+    success = (bool)file.read(reinterpret_cast<char*>(pixel_values.data()), pixel_values.size()*sizeof(imp_float));
+
+    std::vector<PixelSampleStatistics> stored_statistics(sample_statistics.size());
+
+    for (size_t i = 0; i < stored_statistics.size() && success; i++)
+    {
+        success = readCheckpointValue(file, &stored_statistics[i].sum_of_luminances) &&
+                  readCheckpointValue(file, &stored_statistics[i].sum_of_squared_luminances) &&
+                  readCheckpointValue(file, &stored_statistics[i].n_samples);
+    }
+
+    if (!success)
+    {
+        printWarningMessage("checkpoint \"%s\" is incomplete. Starting from scratch.", filename.c_str());
+        return false;
+    }
+
+    for (unsigned int i = 0; i < n_pixels; i++)
+    {
+        Pixel& sensor_pixel = pixels[i];
+
+        sensor_pixel.xyz_values[0] = pixel_values[7*i    ];
+        sensor_pixel.xyz_values[1] = pixel_values[7*i + 1];
+        sensor_pixel.xyz_values[2] = pixel_values[7*i + 2];
+        sensor_pixel.sum_of_filter_weights = pixel_values[7*i + 3];
+
+        if (hasSplats())
+        {
+            splat_xyz_sums[3*i    ] = pixel_values[7*i + 4];
+            splat_xyz_sums[3*i + 1] = pixel_values[7*i + 5];
+            splat_xyz_sums[3*i + 2] = pixel_values[7*i + 6];
+        }
+    }
+
+    sample_statistics = std::move(stored_statistics);
+
+    *progress = stored_progress;
+
+    return true;
+}
+
 // SensorSection method definitions
 
 // Finds the pixels affected by the given sample and gives them their corresponding radiance contribution
@@ -271,6 +723,41 @@ void SensorRegion::addSample(const Point2F& sample_position,
             pixel.sum_of_filter_weights += filter_weight;
         }
     }
+
+    // Record the luminance of the sample for the pixel it was taken in
+    if (!sample_statistics.empty())
+    {
+        Point2I sampling_pixel((int)std::floor(sample_position.x), (int)std::floor(sample_position.y));
+
+        if (sampling_bounds.containsExclusive(sampling_pixel))
+        {
+            int region_width = sampling_bounds.upper_corner.x - sampling_bounds.lower_corner.x;
+
+            PixelSampleStatistics& statistics = sample_statistics[region_width*(sampling_pixel.y - sampling_bounds.lower_corner.y)
+                                                                             + (sampling_pixel.x - sampling_bounds.lower_corner.x)];
+
+            double luminance = radiance.tristimulusY()*sample_weight;
+
+            statistics.sum_of_luminances += luminance;
+            statistics.sum_of_squared_luminances += luminance*luminance;
+            statistics.n_samples++;
+        }
+    }
+}
+
+// Writes the tristimulus values and sum of filter weights of each region pixel to the given array,
+// which must have room for four values per pixel
+void SensorRegion::computePixelValues(imp_float* region_pixel_values) const
+{
+    imp_assert(region_pixel_values);
+
+    for (size_t region_pixel_idx = 0; region_pixel_idx < pixels.size(); region_pixel_idx++)
+    {
+        imp_float* values = region_pixel_values + 4*region_pixel_idx;
+
+        pixels[region_pixel_idx].recieved_energy.computeTristimulusValues(values);
+        values[3] = pixels[region_pixel_idx].sum_of_filter_weights;
+    }
 }
 
 const RawPixel& SensorRegion::rawPixel(const Point2I& pixel_position) const
@@ -0,0 +1,161 @@
+#include "ShadowRayBatch.hpp"
+#include "error.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+
+namespace Impact {
+namespace RayImpact {
+
+// ShadowRayBatch statistics variables
+
+IMP_STAT_RATE("Batched shadow rays", n_batched_shadow_rays);
+IMP_STAT_RATIO("Shadow rays per batch", n_traced_batched_shadow_rays, n_shadow_ray_batches);
+IMP_STAT_RATIO("Batched shadow rays occluded by cached occluder", n_batched_cached_occluder_hits, n_batched_cached_occluder_tests);
+
+// ShadowRayBatch method definitions
+
+ShadowRayBatch::ShadowRayBatch(const Scene& scene,
+                               SensorRegion& sensor_region,
+                               unsigned int max_shadow_rays /* = 512 */)
+    : scene(scene),
+      sensor_region(sensor_region),
+      max_shadow_rays(std::max(1u, max_shadow_rays)),
+      pending_samples(),
+      shadow_rays(),
+      contributions(),
+      sample_indices(),
+      shadow_ray_lights(),
+      occlusion_mask(),
+      occluder_cache(),
+      traced_rays(),
+      traced_ray_indices(),
+      traced_occlusion_mask(),
+      updated_lights(),
+      n_current_shadow_rays(0)
+{
+    shadow_rays.reserve(this->max_shadow_rays);
+    contributions.reserve(this->max_shadow_rays);
+    sample_indices.reserve(this->max_shadow_rays);
+    shadow_ray_lights.reserve(this->max_shadow_rays);
+}
+
+// Defers a shadow ray of the sample currently being computed. The given contribution is added to the
+// sample if the shadow ray turns out to be unoccluded. If the light that the shadow ray points towards
+// is given, the ray can make use of the cached occluder for that light.
+void ShadowRayBatch::addShadowRay(const Ray& shadow_ray,
+                                  const RadianceSpectrum& contribution,
+                                  const Light* light /* = nullptr */)
+{
+    IMP_STAT_INCREMENT(n_batched_shadow_rays);
+
+    shadow_rays.push_back(shadow_ray);
+    contributions.push_back(contribution);
+    sample_indices.push_back((unsigned int)pending_samples.size());
+    shadow_ray_lights.push_back(light);
+
+    n_current_shadow_rays++;
+}
+
+// Completes the sample currently being computed. The sample is added to the sensor region
+// right away if it has no deferred shadow rays, and otherwise when its shadow rays have been traced.
+void ShadowRayBatch::addSample(const Point2F& sensor_point,
+                               const RadianceSpectrum& radiance,
+                               imp_float weight)
+{
+    if (n_current_shadow_rays == 0)
+    {
+        sensor_region.addSample(sensor_point, radiance, weight);
+        return;
+    }
+
+    pending_samples.push_back({sensor_point, radiance, weight});
+    n_current_shadow_rays = 0;
+
+    if (shadow_rays.size() >= max_shadow_rays)
+        traceShadowRays();
+}
+
+// Traces all accumulated shadow rays and adds the pending samples to the sensor region.
+// Must not be called while a sample with deferred shadow rays is being computed.
+void ShadowRayBatch::traceShadowRays()
+{
+    imp_assert(n_current_shadow_rays == 0);
+
+    if (shadow_rays.empty())
+        return;
+
+    IMP_STAT_INCREMENT(n_shadow_ray_batches);
+    IMP_STAT_ADD(n_traced_batched_shadow_rays, shadow_rays.size());
+
+    occlusion_mask.assign((shadow_rays.size() + 63)/64, 0);
+
+    traced_rays.clear();
+    traced_ray_indices.clear();
+
+    // Shadow rays that hit the model that last occluded a shadow ray towards the same light need not be traced
+    for (size_t ray_idx = 0; ray_idx < shadow_rays.size(); ray_idx++)
+    {
+        const Model* cached_occluder = (shadow_ray_lights[ray_idx])? occluder_cache.cachedOccluder(shadow_ray_lights[ray_idx]) : nullptr;
+
+        if (cached_occluder)
+        {
+            IMP_STAT_INCREMENT(n_batched_cached_occluder_tests);
+
+            if (cached_occluder->hasIntersection(shadow_rays[ray_idx]))
+            {
+                IMP_STAT_INCREMENT(n_batched_cached_occluder_hits);
+                occlusion_mask[ray_idx/64] |= (uint64_t)1 << (ray_idx % 64);
+                continue;
+            }
+        }
+
+        traced_rays.push_back(shadow_rays[ray_idx]);
+        traced_ray_indices.push_back((unsigned int)ray_idx);
+    }
+
+    traced_occlusion_mask.resize((traced_rays.size() + 63)/64);
+
+    scene.occluded(traced_rays.data(), (unsigned int)traced_rays.size(), traced_occlusion_mask.data());
+
+    updated_lights.clear();
+
+    for (size_t traced_idx = 0; traced_idx < traced_rays.size(); traced_idx++)
+    {
+        if (!(traced_occlusion_mask[traced_idx/64] & ((uint64_t)1 << (traced_idx % 64))))
+            continue;
+
+        unsigned int ray_idx = traced_ray_indices[traced_idx];
+
+        occlusion_mask[ray_idx/64] |= (uint64_t)1 << (ray_idx % 64);
+
+        // The batched trace does not tell which model occluded the ray, so find it with a separate trace,
+        // but only for the first occluded ray towards each light in the batch to bound the extra work
+        const Light* light = shadow_ray_lights[ray_idx];
+
+        if (light && updated_lights.insert(light).second)
+        {
+            const Model* occluder = scene.occludingModel(traced_rays[traced_idx]);
+
+            if (occluder)
+                occluder_cache.update(light, occluder);
+        }
+    }
+
+    for (size_t ray_idx = 0; ray_idx < shadow_rays.size(); ray_idx++)
+    {
+        if (!(occlusion_mask[ray_idx/64] & ((uint64_t)1 << (ray_idx % 64))))
+            pending_samples[sample_indices[ray_idx]].radiance += contributions[ray_idx];
+    }
+
+    for (const PendingSample& sample : pending_samples)
+        sensor_region.addSample(sample.sensor_point, sample.radiance, sample.weight);
+
+    pending_samples.clear();
+    shadow_rays.clear();
+    contributions.clear();
+    sample_indices.clear();
+    shadow_ray_lights.clear();
+}
+
+} // RayImpact
+} // Impact
@@ -14,6 +14,54 @@ bool Shape::hasIntersection(const Ray& ray,
     return intersect(ray, &intersection_distance, &scattering_event, test_alpha_texture);
 }
 
+// Samples a point on the surface as seen from the given reference point. The returned probability density is
+// with respect to solid angle at the reference point. By default, the surface is sampled uniformly by area.
+ScatteringEvent Shape::sampleSurfaceFrom(const ScatteringEvent& reference_event,
+                                         const Point2F& uniform_sample,
+                                         imp_float* pdf_value) const
+{
+    const ScatteringEvent& sampled_event = sampleSurface(uniform_sample, pdf_value);
+
+    Vector3F incident_direction = sampled_event.position - reference_event.position;
+    imp_float squared_distance = incident_direction.squaredLength();
+
+    if (squared_distance == 0)
+    {
+        *pdf_value = 0;
+        return sampled_event;
+    }
+
+    incident_direction.normalize();
+
+    imp_float cos_emission_angle = incident_direction.absDot(sampled_event.surface_normal);
+
+    // Convert from probability density with respect to area to probability density with respect to solid angle
+    *pdf_value = (cos_emission_angle == 0)? 0 : (*pdf_value)*squared_distance/cos_emission_angle;
+
+    return sampled_event;
+}
+
+// Computes the probability density, with respect to solid angle, that sampleSurfaceFrom samples
+// the point on the surface hit by a ray from the given reference point in the given direction
+imp_float Shape::pdfFrom(const ScatteringEvent& reference_event,
+                         const Vector3F& incident_direction) const
+{
+    const Ray& ray = reference_event.spawnRay(incident_direction);
+
+    imp_float intersection_distance;
+    SurfaceScatteringEvent scattering_event;
+
+    if (!intersect(ray, &intersection_distance, &scattering_event, false))
+        return 0;
+
+    imp_float cos_emission_angle = incident_direction.absDot(scattering_event.surface_normal);
+
+    if (cos_emission_angle == 0)
+        return 0;
+
+    return squaredDistanceBetween(reference_event.position, scattering_event.position)/(cos_emission_angle*surfaceArea());
+}
+
 // Shape function definitions
 
 // Computes derivatives of the surface normal with respect to the surface parameters
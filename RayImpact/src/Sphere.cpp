@@ -2,7 +2,9 @@
 #include "math.hpp"
 #include "ErrorFloat.hpp"
 #include "geometry.hpp"
+#include "sampling.hpp"
 #include "api.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace Impact {
@@ -329,12 +331,116 @@ bool Sphere::hasIntersection(const Ray& ray,
     return true;
 }
 
+// Samples a point uniformly by area on the partial sphere, which is the same as sampling the
+// y-coordinate and azimuthal angle uniformly (the area of a spherical zone is proportional to its height)
+ScatteringEvent Sphere::sampleSurface(const Point2F& uniform_sample,
+                                      imp_float* pdf_value) const
+{
+    imp_float sample_y = ::Impact::lerp(y_min, y_max, uniform_sample.x);
+    imp_float sample_phi = uniform_sample.y*phi_max;
+    imp_float zx_radius = std::sqrt(std::max<imp_float>(0, radius*radius - sample_y*sample_y));
+
+    const Point3F sample_point(zx_radius*std::sin(sample_phi), sample_y, zx_radius*std::cos(sample_phi));
+
+    const Vector3F& sample_point_error = abs(static_cast<Vector3F>(sample_point))*errorPowerBound(5);
+
+    Vector3F position_error;
+    const Point3F& position = (*object_to_world)(sample_point, sample_point_error, &position_error);
+
+    // dpdu x dpdv points towards the center of the sphere
+    const Normal3F& surface_normal = worldSpaceSurfaceNormal(Normal3F(-sample_point.x, -sample_point.y, -sample_point.z));
+
+    *pdf_value = 1/surfaceArea();
+
+    return ScatteringEvent(position, position_error, Vector3F(0, 0, 0), surface_normal, MediumInterface(), 0);
+}
+
+// Samples a point on the sphere as seen from the given reference point. If the reference point is outside a
+// full sphere, only the visible cap is sampled, by sampling directions uniformly inside the cone subtended by the sphere.
+ScatteringEvent Sphere::sampleSurfaceFrom(const ScatteringEvent& reference_event,
+                                          const Point2F& uniform_sample,
+                                          imp_float* pdf_value) const
+{
+    const Point3F& center = (*object_to_world)(Point3F(0, 0, 0));
+
+    imp_float squared_center_distance = squaredDistanceBetween(reference_event.position, center);
+
+    // Fall back to area sampling if the cone does not contain exactly the sampled surface
+    if (y_min > -radius || y_max < radius || phi_max < IMP_TWO_PI ||
+        object_to_world->hasScaling() ||
+        squared_center_distance <= radius*radius)
+    {
+        return Shape::sampleSurfaceFrom(reference_event, uniform_sample, pdf_value);
+    }
+
+    imp_float center_distance = std::sqrt(squared_center_distance);
+
+    // Construct a coordinate system with the z-axis pointing towards the sphere center
+    const Vector3F& center_direction = (center - reference_event.position)/center_distance;
+    Vector3F center_direction_x, center_direction_y;
+    coordinateSystem(center_direction, &center_direction_x, &center_direction_y);
+
+    // Sample a direction uniformly inside the cone
+    imp_float sin_sq_theta_max = radius*radius/squared_center_distance;
+    imp_float cos_theta_max = std::sqrt(std::max<imp_float>(0, 1 - sin_sq_theta_max));
+
+    imp_float cos_theta = ::Impact::lerp((imp_float)1, cos_theta_max, uniform_sample.x);
+    imp_float sin_sq_theta = std::max<imp_float>(0, 1 - cos_theta*cos_theta);
+    imp_float phi = uniform_sample.y*IMP_TWO_PI;
+
+    // Compute the angle between the sampled direction and the sphere normal at the point it hits, as seen from the center
+    imp_float hit_distance = center_distance*cos_theta - std::sqrt(std::max<imp_float>(0, radius*radius - squared_center_distance*sin_sq_theta));
+    imp_float cos_alpha = clamp((squared_center_distance + radius*radius - hit_distance*hit_distance)/(2*center_distance*radius), -1.0f, 1.0f);
+    imp_float sin_alpha = std::sqrt(std::max<imp_float>(0, 1 - cos_alpha*cos_alpha));
+
+    // Direction from the center to the sampled point
+    const Vector3F& outward_direction = center_direction_x*(-sin_alpha*std::cos(phi)) +
+                                        center_direction_y*(-sin_alpha*std::sin(phi)) +
+                                        center_direction*(-cos_alpha);
+
+    const Point3F& position = center + outward_direction*radius;
+
+    const Vector3F& position_error = abs(static_cast<Vector3F>(position))*errorPowerBound(5);
+
+    // dpdu x dpdv points towards the center of the sphere (the transformation has no scaling, so
+    // the transformed object space normal is also the negated world space outward direction)
+    Normal3F surface_normal(-outward_direction.x, -outward_direction.y, -outward_direction.z);
+
+    if (has_reverse_orientation ^ transformation_swaps_handedness)
+        surface_normal.reverse();
+
+    *pdf_value = uniformConePDF(cos_theta_max);
+
+    return ScatteringEvent(position, position_error, Vector3F(0, 0, 0), surface_normal, MediumInterface(), 0);
+}
+
+imp_float Sphere::pdfFrom(const ScatteringEvent& reference_event,
+                          const Vector3F& incident_direction) const
+{
+    const Point3F& center = (*object_to_world)(Point3F(0, 0, 0));
+
+    imp_float squared_center_distance = squaredDistanceBetween(reference_event.position, center);
+
+    if (y_min > -radius || y_max < radius || phi_max < IMP_TWO_PI ||
+        object_to_world->hasScaling() ||
+        squared_center_distance <= radius*radius)
+    {
+        return Shape::pdfFrom(reference_event, incident_direction);
+    }
+
+    imp_float sin_sq_theta_max = radius*radius/squared_center_distance;
+    imp_float cos_theta_max = std::sqrt(std::max<imp_float>(0, 1 - sin_sq_theta_max));
+
+    return uniformConePDF(cos_theta_max);
+}
+
 // Sphere function definitions
 
-std::shared_ptr<Shape> createSphere(const Transformation* object_to_world,
-                                    const Transformation* world_to_object,
-                                    bool has_reverse_orientation,
-                                    const ParameterSet& parameters)
+Shape* createSphere(const Transformation* object_to_world,
+                    const Transformation* world_to_object,
+                    bool has_reverse_orientation,
+                    const ParameterSet& parameters,
+                    ObjectArena& arena)
 {
     imp_float radius = parameters.getSingleFloatValue("radius", 1.0f);
     imp_float bottom = parameters.getSingleFloatValue("bottom", -1.0f);
@@ -362,12 +468,12 @@ std::shared_ptr<Shape> createSphere(const Transformation* object_to_world,
 						 "Forward direction:", (*object_to_world)(Vector3F(0, 0, 1)).toString().c_str());
 	}
 
-    return std::make_shared<Sphere>(object_to_world,
-                                    world_to_object,
-                                    has_reverse_orientation,
-                                    radius,
-                                    bottom*radius, top*radius,
-                                    sweep_angle);
+    return arena.create<Sphere>(object_to_world,
+                                world_to_object,
+                                has_reverse_orientation,
+                                radius,
+                                bottom*radius, top*radius,
+                                sweep_angle);
 }
 
 } // RayImpact
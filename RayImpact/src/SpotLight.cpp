@@ -1,4 +1,5 @@
 #include "SpotLight.hpp"
+#include "sampling.hpp"
 #include "api.hpp"
 #include <cmath>
 
@@ -36,18 +37,75 @@ RadianceSpectrum SpotLight::sampleIncidentRadiance(const ScatteringEvent& scatte
 
     *visibility_tester = VisibilityTester(ScatteringEvent(position, medium_interface, scattering_event.time), scattering_event);
 
-    return emitted_intensity*(falloffInDirection(-(*incident_direction))/squaredDistanceBetween(position, scattering_event.position));
+    imp_float squared_distance = squaredDistanceBetween(position, scattering_event.position);
+
+    if (squared_distance > range*range)
+        return RadianceSpectrum(0.0f);
+
+    return emitted_intensity*(falloffInDirection(-(*incident_direction))/squared_distance);
+}
+
+// Emits rays uniformly inside the full light cone. The rays end at the range of the light.
+RadianceSpectrum SpotLight::sampleEmittedRadiance(const Point2F& position_sample,
+                                                  const Point2F& direction_sample,
+                                                  imp_float time,
+                                                  Ray* emitted_ray,
+                                                  Normal3F* surface_normal,
+                                                  imp_float* position_pdf_value,
+                                                  imp_float* direction_pdf_value) const
+{
+    const Vector3F& direction = light_to_world(uniformConeSample(direction_sample, cos_max_angle));
+
+    *emitted_ray = Ray(position, direction, range, time);
+    *surface_normal = Normal3F(direction);
+    *position_pdf_value = 1.0f;
+    *direction_pdf_value = uniformConePDF(cos_max_angle);
+
+    return emitted_intensity*falloffInDirection(direction);
+}
+
+// A spot light can only illuminate regions that are within its range and overlap its light cone. The
+// region is approximated by its bounding sphere, which is tested against the cone by comparing the angle
+// from the cone axis to the sphere center with the sum of the cone angle and the angular radius of the sphere.
+bool SpotLight::mayIlluminate(const BoundingBoxF& region) const
+{
+    if (squaredDistanceBetween(region, position) > range*range)
+        return false;
+
+    Point3F center;
+    imp_float radius;
+    region.boundingSphere(&center, &radius);
+
+    const Vector3F& center_direction = center - position;
+    imp_float center_distance = center_direction.length();
+
+    if (center_distance <= radius)
+        return true;
+
+    imp_float max_angle = std::acos(clamp(cos_max_angle, -1.0f, 1.0f));
+    imp_float angular_radius = std::asin(radius/center_distance);
+
+    if (max_angle + angular_radius >= IMP_PI)
+        return true;
+
+    const Vector3F& axis = light_to_world(Vector3F(0, 0, 1)).normalized();
+
+    imp_float center_angle = std::acos(clamp(axis.dot(center_direction)/center_distance, -1.0f, 1.0f));
+
+    return center_angle <= max_angle + angular_radius;
 }
 
 // SpotLight function definitions
 
-std::shared_ptr<Light> createSpotLight(const Transformation& light_to_world,
-                                       const MediumInterface& medium_interface,
-                                       const ParameterSet& parameters)
+Light* createSpotLight(const Transformation& light_to_world,
+                       const MediumInterface& medium_interface,
+                       const ParameterSet& parameters,
+                       ObjectArena& arena)
 {
     const IntensitySpectrum& intensity = parameters.getSingleSpectrumValue("intensity", RadianceSpectrum(1.0f));
     imp_float cone_width = parameters.getSingleFloatValue("cone_width", 180.0f);
     imp_float falloff_start = parameters.getSingleFloatValue("falloff_start", cone_width);
+    imp_float range = parameters.getSingleFloatValue("range", IMP_INFINITY);
 	
 	if (RIMP_OPTIONS.verbosity >= IMP_LIGHTS_VERBOSITY)
 	{
@@ -57,20 +115,23 @@ std::shared_ptr<Light> createSpotLight(const Transformation& light_to_world,
 						 "\n    %-20s%g degrees"
 						 "\n    %-20s%g degrees"
 						 "\n    %-20s%s m"
-						 "\n    %-20s%s",
+						 "\n    %-20s%s"
+						 "\n    %-20s%g m",
 						 "Type:", "Spot",
 						 "Intensity:", intensity.toRGBString().c_str(),
 						 "Cone width:", cone_width,
 						 "Falloff start", falloff_start,
 						 "Position:", light_to_world(Point3F(0, 0, 0)).toString().c_str(),
-						 "Direction:", light_to_world(Vector3F(0, 0, 1)).toString().c_str());
+						 "Direction:", light_to_world(Vector3F(0, 0, 1)).toString().c_str(),
+						 "Range:", range);
 	}
 
-    return std::make_shared<SpotLight>(light_to_world,
-                                       medium_interface,
-                                       intensity,
-                                       cone_width,
-                                       falloff_start);
+    return arena.create<SpotLight>(light_to_world,
+                                   medium_interface,
+                                   intensity,
+                                   cone_width,
+                                   falloff_start,
+                                   range);
 }
 
 } // RayImpact
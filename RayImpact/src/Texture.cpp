@@ -6,6 +6,10 @@
 namespace Impact {
 namespace RayImpact {
 
+// Texture statistics variables
+
+IMP_STAT_COUNTER("Texture evaluations", n_texture_evaluations);
+
 // ParametricMapper method definitions
 
 ParametricMapper::ParametricMapper(imp_float s_scale, imp_float t_scale,
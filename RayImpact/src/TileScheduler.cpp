@@ -0,0 +1,273 @@
+#include "TileScheduler.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// TileScheduler method definitions
+
+TileScheduler::TileScheduler(const BoundingRectangleI& sampling_bounds,
+                             unsigned int n_samples_per_pixel,
+                             unsigned int n_threads,
+                             TileOrdering ordering,
+                             int tile_extent /* = 0 */)
+    : sampling_bounds(sampling_bounds),
+      ordering(ordering),
+      n_threads(std::max(1u, n_threads)),
+      tile_extent((tile_extent > 0)? tile_extent : automaticTileExtent(sampling_bounds.diagonal(), n_samples_per_pixel, n_threads)),
+      min_split_extent(std::min(4, this->tile_extent)),
+      base_tiles(),
+      tile_costs(),
+      has_tile_costs(false),
+      pass_idx(0),
+      has_begun_pass(false),
+      queued_tiles(),
+      mutex()
+{
+    const Vector2I& sampling_extents = sampling_bounds.diagonal();
+
+    int n_tiles_x = (sampling_extents.x + this->tile_extent - 1)/this->tile_extent;
+    int n_tiles_y = (sampling_extents.y + this->tile_extent - 1)/this->tile_extent;
+
+    base_tiles.reserve(n_tiles_x*n_tiles_y);
+
+    for (int j = 0; j < n_tiles_y; j++)
+    {
+        for (int i = 0; i < n_tiles_x; i++)
+        {
+            Point2I lower_corner(sampling_bounds.lower_corner.x + i*this->tile_extent,
+                                 sampling_bounds.lower_corner.y + j*this->tile_extent);
+
+            Point2I upper_corner(std::min(lower_corner.x + this->tile_extent, sampling_bounds.upper_corner.x),
+                                 std::min(lower_corner.y + this->tile_extent, sampling_bounds.upper_corner.y));
+
+            base_tiles.emplace_back(lower_corner, upper_corner);
+        }
+    }
+
+    tile_costs.resize(base_tiles.size(), 0.0);
+}
+
+// Computes a tile width that gives each thread many tiles to choose from, while keeping
+// the number of samples in each tile large enough for the per-tile overhead to be negligible
+int TileScheduler::automaticTileExtent(const Vector2I& sampling_extents,
+                                       unsigned int n_samples_per_pixel,
+                                       unsigned int n_threads)
+{
+    const double tiles_per_thread = 16;
+    const double min_samples_per_tile = 4096;
+    const int min_tile_extent = 8;
+    const int max_tile_extent = 64;
+
+    double n_pixels = std::max(1.0, (double)sampling_extents.x*(double)sampling_extents.y);
+
+    int extent_for_balance = (int)std::sqrt(n_pixels/(tiles_per_thread*std::max(1u, n_threads)));
+    int extent_for_overhead = (int)std::ceil(std::sqrt(min_samples_per_tile/std::max(1u, n_samples_per_pixel)));
+
+    return std::min(std::max(std::max(extent_for_balance, extent_for_overhead), min_tile_extent), max_tile_extent);
+}
+
+// Sorts the given base tile indices according to the tile ordering. Cost ordering
+// falls back to Hilbert order until the costs have been measured in a pass.
+void TileScheduler::sortTileIndices(std::vector<unsigned int>& tile_indices) const
+{
+    if (ordering == TileOrdering::Hilbert || (ordering == TileOrdering::Cost && !has_tile_costs))
+    {
+        const Vector2I& sampling_extents = sampling_bounds.diagonal();
+
+        uint32_t n_tiles_x = (sampling_extents.x + tile_extent - 1)/tile_extent;
+        uint32_t n_tiles_y = (sampling_extents.y + tile_extent - 1)/tile_extent;
+
+        // Find the smallest power of two covering the tile grid
+        uint32_t n = 1;
+        while (n < std::max(n_tiles_x, n_tiles_y))
+            n *= 2;
+
+        std::vector<uint64_t> curve_indices(tile_indices.size());
+
+        for (unsigned int tile_idx : tile_indices)
+            curve_indices[tile_idx] = hilbertCurveIndex(n, tile_idx % n_tiles_x, tile_idx/n_tiles_x);
+
+        std::sort(tile_indices.begin(), tile_indices.end(),
+                  [&](unsigned int a, unsigned int b) { return curve_indices[a] < curve_indices[b]; });
+    }
+    else if (ordering == TileOrdering::Cost)
+    {
+        std::stable_sort(tile_indices.begin(), tile_indices.end(),
+                         [&](unsigned int a, unsigned int b) { return tile_costs[a] > tile_costs[b]; });
+    }
+}
+
+// Creates a tile covering the given bounds, seeded by the position of its first pixel and the pass index
+Tile TileScheduler::createTile(const BoundingRectangleI& bounds, unsigned int base_tile_idx) const
+{
+    const Vector2I& sampling_extents = sampling_bounds.diagonal();
+
+    unsigned int seed = (unsigned int)(pass_idx*sampling_bounds.area() +
+                                       (bounds.lower_corner.y - sampling_bounds.lower_corner.y)*sampling_extents.x +
+                                       (bounds.lower_corner.x - sampling_bounds.lower_corner.x));
+
+    return {bounds, base_tile_idx, seed};
+}
+
+// Adds the measured cost of rendering (part of) a base tile
+void TileScheduler::addTileCost(unsigned int base_tile_idx, double cost)
+{
+    imp_assert(base_tile_idx < tile_costs.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    tile_costs[base_tile_idx] += cost;
+    has_tile_costs = true;
+}
+
+// Queues all base tiles in the configured order. The costs are reset
+// afterwards so that costs measured during the pass can be accumulated.
+void TileScheduler::beginPass()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (has_begun_pass)
+        pass_idx++;
+
+    has_begun_pass = true;
+
+    std::vector<unsigned int> tile_indices(base_tiles.size());
+
+    for (unsigned int tile_idx = 0; tile_idx < tile_indices.size(); tile_idx++)
+        tile_indices[tile_idx] = tile_idx;
+
+    sortTileIndices(tile_indices);
+
+    queued_tiles.clear();
+
+    for (unsigned int tile_idx : tile_indices)
+        queued_tiles.push_back(createTile(base_tiles[tile_idx], tile_idx));
+
+    std::fill(tile_costs.begin(), tile_costs.end(), 0.0);
+    has_tile_costs = false;
+}
+
+// Makes the next call to beginPass start the pass following the given one, for continuing an interrupted rendering
+void TileScheduler::resumeAfterPass(unsigned int completed_pass_idx)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pass_idx = completed_pass_idx;
+    has_begun_pass = true;
+}
+
+// Removes the next tile from the queue and returns it via the given pointer.
+// Returns false if there are no more tiles in the current pass.
+bool TileScheduler::nextTile(Tile* tile)
+{
+    imp_assert(tile);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (queued_tiles.empty())
+        return false;
+
+    *tile = queued_tiles.front();
+    queued_tiles.pop_front();
+
+    // Near the end of the pass, split the tile in half along its largest dimension until
+    // there are enough remaining tiles for all threads or the tile has become small
+    while (queued_tiles.size() + 1 < n_threads)
+    {
+        const Vector2I& extents = tile->bounds.diagonal();
+
+        unsigned int split_dimension = tile->bounds.maxDimension();
+        int split_extent = extents[split_dimension];
+
+        if (split_extent < 2*min_split_extent)
+            break;
+
+        BoundingRectangleI first_half = tile->bounds;
+        BoundingRectangleI second_half = tile->bounds;
+
+        first_half.upper_corner[split_dimension] = tile->bounds.lower_corner[split_dimension] + split_extent/2;
+        second_half.lower_corner[split_dimension] = first_half.upper_corner[split_dimension];
+
+        queued_tiles.push_front(createTile(second_half, tile->base_tile_idx));
+
+        *tile = createTile(first_half, tile->base_tile_idx);
+    }
+
+    return true;
+}
+
+// Puts a tile that was handed out but never completed back at the front of the queue
+void TileScheduler::requeueTile(const Tile& tile)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    queued_tiles.push_front(tile);
+}
+
+unsigned int TileScheduler::numberOfQueuedTiles()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (unsigned int)queued_tiles.size();
+}
+
+// TileScheduler function definitions
+
+// Computes the distance along a Hilbert curve filling an n x n grid (n being a power of two) to the given grid point
+uint64_t hilbertCurveIndex(uint32_t n, uint32_t x, uint32_t y)
+{
+    uint64_t index = 0;
+
+    for (uint32_t s = n/2; s > 0; s /= 2)
+    {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+
+        index += (uint64_t)s*(uint64_t)s*((3*rx) ^ ry);
+
+        // Rotate the quadrant so that the curve is continuous
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+
+            std::swap(x, y);
+        }
+    }
+
+    return index;
+}
+
+bool parseTileOrdering(const std::string& name, TileOrdering* ordering)
+{
+    imp_assert(ordering);
+
+    if (name == "scanline")
+        *ordering = TileOrdering::Scanline;
+    else if (name == "hilbert")
+        *ordering = TileOrdering::Hilbert;
+    else if (name == "cost")
+        *ordering = TileOrdering::Cost;
+    else
+        return false;
+
+    return true;
+}
+
+const char* tileOrderingName(TileOrdering ordering)
+{
+    switch (ordering)
+    {
+        case TileOrdering::Scanline: return "scanline";
+        case TileOrdering::Hilbert:  return "hilbert";
+        case TileOrdering::Cost:     return "cost";
+        default:                     return "unknown";
+    }
+}
+
+} // RayImpact
+} // Impact
@@ -0,0 +1,353 @@
+#include "WavefrontIntegrator.hpp"
+#include "BSDF.hpp"
+#include "Model.hpp"
+#include "Sensor.hpp"
+#include "statistics.hpp"
+#include "tracing.hpp"
+#include "string_util.hpp"
+#include "api.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Impact {
+namespace RayImpact {
+
+// WavefrontIntegrator statistics variables
+
+IMP_STAT_RATE("Wavefront rays", n_wavefront_rays);
+IMP_STAT_RATE("Wavefront shadow rays", n_wavefront_shadow_rays);
+
+// WavefrontIntegrator utility functions
+
+// Advances the given random state and returns a pseudo-random 64-bit value (SplitMix64)
+static uint64_t nextPathRandomBits(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27))*0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static Point2F nextPathSample(uint64_t* state)
+{
+    uint64_t bits = nextPathRandomBits(state);
+
+    return Point2F(std::min((imp_float)(uint32_t)(bits >> 32)*(imp_float)2.3283064365386963e-10, IMP_ONE_MINUS_EPS),
+                   std::min((imp_float)(uint32_t)bits*(imp_float)2.3283064365386963e-10, IMP_ONE_MINUS_EPS));
+}
+
+// Computes the initial random state for the path of the given camera sample, so that the
+// scattering decisions only depend on the pixel and sample index
+static uint64_t initialPathRandomState(const Point2I& pixel, uint64_t sample_idx)
+{
+    uint64_t state = ((uint64_t)(uint32_t)pixel.x << 32) | (uint64_t)(uint32_t)pixel.y;
+    state ^= nextPathRandomBits(&sample_idx);
+
+    return nextPathRandomBits(&state);
+}
+
+// WavefrontRayQueue method definitions
+
+void WavefrontRayQueue::clear()
+{
+    origins.clear();
+    directions.clear();
+    times.clear();
+    has_offsets.clear();
+    x_offset_origins.clear();
+    x_offset_directions.clear();
+    y_offset_origins.clear();
+    y_offset_directions.clear();
+    weights.clear();
+    sample_indices.clear();
+    random_states.clear();
+}
+
+// WavefrontShadowQueue method definitions
+
+void WavefrontShadowQueue::clear()
+{
+    visibility_testers.clear();
+    contributions.clear();
+    sample_indices.clear();
+    lights.clear();
+}
+
+// WavefrontIntegrator method definitions
+
+// Finds the closest intersection of every queued ray. Rays that escape the scene
+// receive the radiance emitted towards them by the lights.
+void WavefrontIntegrator::intersectRays(const Scene& scene, WavefrontBuffers& buffers) const
+{
+    const WavefrontRayQueue& rays = buffers.rays;
+
+    size_t n_rays = rays.size();
+
+    IMP_STAT_ADD(n_wavefront_rays, n_rays);
+
+    buffers.scattering_events.resize(n_rays);
+    buffers.hit_ray_indices.clear();
+
+    for (size_t ray_idx = 0; ray_idx < n_rays; ray_idx++)
+    {
+        const RayWithOffsets& ray = rays.ray(ray_idx);
+
+        if (scene.intersect(ray, &buffers.scattering_events[ray_idx]))
+        {
+            buffers.hit_ray_indices.push_back((uint32_t)ray_idx);
+        }
+        else
+        {
+            RadianceSpectrum escaped_radiance(0.0f);
+
+            for (const auto& light : scene.lights)
+                escaped_radiance += light->emittedRadianceFromDirection(ray);
+
+            buffers.sample_radiances[rays.sample_indices[ray_idx]] += rays.weights[ray_idx]*escaped_radiance;
+        }
+    }
+}
+
+// Computes the emitted radiance and samples the lights at every hit, queueing a shadow ray for each light
+// sample that contributes, and queues the specularly reflected and transmitted rays for the next depth
+void WavefrontIntegrator::shadeHits(const Scene& scene,
+                                    WavefrontBuffers& buffers,
+                                    RegionAllocator& allocator,
+                                    unsigned int scattering_count) const
+{
+    const WavefrontRayQueue& rays = buffers.rays;
+
+    std::vector<uint32_t>& hit_ray_indices = buffers.hit_ray_indices;
+
+    // Shade hits on the same material together
+    std::stable_sort(hit_ray_indices.begin(), hit_ray_indices.end(),
+                     [&](uint32_t a, uint32_t b)
+                     {
+                         return buffers.scattering_events[a].model->getMaterial() < buffers.scattering_events[b].model->getMaterial();
+                     });
+
+    const bool spawns_secondary_rays = scattering_count + 1 < max_scattering_count;
+
+    for (uint32_t ray_idx : hit_ray_indices)
+    {
+        SurfaceScatteringEvent& scattering_event = buffers.scattering_events[ray_idx];
+
+        const RayWithOffsets& ray = rays.ray(ray_idx);
+        const Spectrum& ray_weight = rays.weights[ray_idx];
+        uint32_t sample_idx = rays.sample_indices[ray_idx];
+        uint64_t random_state = rays.random_states[ray_idx];
+
+        const Vector3F& outgoing_direction = scattering_event.outgoing_direction;
+
+        scattering_event.generateBSDF(ray, allocator);
+
+        buffers.sample_radiances[sample_idx] += ray_weight*scattering_event.emittedRadiance(outgoing_direction);
+
+        for (const auto& light : scene.lights)
+        {
+            Vector3F incident_direction;
+            imp_float pdf_value;
+            VisibilityTester visibility_tester;
+
+            const RadianceSpectrum& incident_radiance = light->sampleIncidentRadiance(scattering_event,
+                                                                                      nextPathSample(&random_state),
+                                                                                      &incident_direction,
+                                                                                      &pdf_value,
+                                                                                      &visibility_tester);
+
+            if (incident_radiance.isBlack() || pdf_value == 0)
+                continue;
+
+            const Spectrum& bsdf_value = scattering_event.bsdf->evaluate(outgoing_direction, incident_direction);
+
+            if (!bsdf_value.isBlack())
+                buffers.shadow_rays.push(visibility_tester,
+                                         ray_weight*bsdf_value*incident_radiance*(incident_direction.absDot(scattering_event.surface_normal)/pdf_value),
+                                         sample_idx,
+                                         light);
+        }
+
+        if (spawns_secondary_rays)
+        {
+            RayWithOffsets incident_ray;
+            Spectrum scattering_weight;
+
+            if (specularlyScatteredRay(ray, scattering_event, BXDFType(BSDF_REFLECTION | BSDF_SPECULAR),
+                                       nextPathSample(&random_state), &incident_ray, &scattering_weight))
+                buffers.secondary_rays.push(incident_ray, ray_weight*scattering_weight, sample_idx, nextPathRandomBits(&random_state));
+
+            if (specularlyScatteredRay(ray, scattering_event, BXDFType(BSDF_TRANSMISSION | BSDF_SPECULAR),
+                                       nextPathSample(&random_state), &incident_ray, &scattering_weight))
+                buffers.secondary_rays.push(incident_ray, ray_weight*scattering_weight, sample_idx, nextPathRandomBits(&random_state));
+        }
+    }
+}
+
+// Traces every queued shadow ray and adds the contribution of the unobstructed ones to their camera samples.
+// Each shadow ray is first tested against the model that last occluded a shadow ray towards its light in the tile.
+void WavefrontIntegrator::traceShadowRays(const Scene& scene, WavefrontBuffers& buffers) const
+{
+    const WavefrontShadowQueue& shadow_rays = buffers.shadow_rays;
+
+    size_t n_shadow_rays = shadow_rays.size();
+
+    IMP_STAT_ADD(n_wavefront_shadow_rays, n_shadow_rays);
+
+    for (size_t shadow_ray_idx = 0; shadow_ray_idx < n_shadow_rays; shadow_ray_idx++)
+    {
+        if (shadow_rays.visibility_testers[shadow_ray_idx].beamIsUnobstructed(scene, shadow_rays.lights[shadow_ray_idx], &buffers.occluder_cache))
+            buffers.sample_radiances[shadow_rays.sample_indices[shadow_ray_idx]] += shadow_rays.contributions[shadow_ray_idx];
+    }
+}
+
+// Runs the intersection, shading and shadow stages on the queued rays, one scattering depth at a time,
+// until no rays remain. The radiance of each camera sample is accumulated in the sample radiance array.
+void WavefrontIntegrator::traceWavefront(const Scene& scene,
+                                         WavefrontBuffers& buffers,
+                                         RegionAllocator& allocator,
+                                         unsigned int first_scattering_count /* = 0 */) const
+{
+    for (unsigned int scattering_count = first_scattering_count; !buffers.rays.empty(); scattering_count++)
+    {
+        IMP_TRACE_SCOPE_WITH_ARGUMENTS("Trace wavefront depth", formatString("\"depth\": %u, \"rays\": %u",
+                                                                              scattering_count, (unsigned int)buffers.rays.size()));
+
+        intersectRays(scene, buffers);
+
+        shadeHits(scene, buffers, allocator, scattering_count);
+
+        traceShadowRays(scene, buffers);
+
+        // The BSDFs are not needed by later stages
+        allocator.release();
+
+        std::swap(buffers.rays, buffers.secondary_rays);
+
+        buffers.secondary_rays.clear();
+        buffers.shadow_rays.clear();
+    }
+}
+
+// Generates the camera rays for the samples of the tile, and traces them in wavefronts of at most the configured number of samples
+std::unique_ptr<SensorRegion> WavefrontIntegrator::renderTile(const Scene& scene,
+                                                              const Tile& tile,
+                                                              unsigned int first_sample_idx,
+                                                              unsigned int n_samples,
+                                                              imp_float error_threshold /* = 0 */)
+{
+    IMP_TRACE_SCOPE_WITH_ARGUMENTS("Render tile", formatString("\"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d",
+                                                                tile.bounds.lower_corner.x, tile.bounds.lower_corner.y,
+                                                                tile.bounds.diagonal().x, tile.bounds.diagonal().y));
+
+    RegionAllocator allocator;
+
+    std::unique_ptr<Sampler> tile_sampler = sampler->cloned(tile.seed);
+
+    std::unique_ptr<SensorRegion> sensor_region = camera->sensor->sensorRegion(tile.bounds);
+
+    const BoundingRectangleI& sampling_bounds = camera->sensor->samplingBounds();
+
+    WavefrontBuffers buffers;
+
+    std::vector<Point2F> sensor_points; // Position on the sensor of each camera sample in the wavefront
+    std::vector<imp_float> camera_ray_weights; // Weight of the camera ray of each camera sample in the wavefront
+
+    // Traces the queued camera rays and adds the resulting samples to the sensor region
+    auto traceQueuedSamples = [&]()
+    {
+        buffers.sample_radiances.assign(sensor_points.size(), RadianceSpectrum(0.0f));
+
+        traceWavefront(scene, buffers, allocator);
+
+        for (size_t sample_idx = 0; sample_idx < sensor_points.size(); sample_idx++)
+            sensor_region->addSample(sensor_points[sample_idx], buffers.sample_radiances[sample_idx], camera_ray_weights[sample_idx]);
+
+        sensor_points.clear();
+        camera_ray_weights.clear();
+    };
+
+    // Generate camera rays
+    for (Point2I pixel : tile.bounds)
+    {
+        // Skip pixels that have already converged
+        if (error_threshold > 0 && camera->sensor->relativeError(pixel) <= error_threshold)
+            continue;
+
+        beginPixelSamples(*tile_sampler, sampling_bounds, pixel, first_sample_idx);
+
+        for (unsigned int sample_idx = 0; sample_idx < n_samples; sample_idx++)
+        {
+            const CameraSample& camera_sample = tile_sampler->generateCameraSample(pixel);
+
+            RayWithOffsets eye_ray;
+            imp_float ray_weight = camera->generateRayWithOffsets(camera_sample, &eye_ray);
+            eye_ray.scaleOffsets(1.0f/std::sqrt((imp_float)tile_sampler->n_samples_per_pixel));
+
+            if (ray_weight > 0)
+                buffers.rays.push(eye_ray, Spectrum(1.0f), (uint32_t)sensor_points.size(),
+                                  initialPathRandomState(pixel, first_sample_idx + sample_idx));
+
+            sensor_points.push_back(camera_sample.sensor_point);
+            camera_ray_weights.push_back(ray_weight);
+
+            tile_sampler->beginNextSample();
+
+            if (sensor_points.size() >= wavefront_size)
+                traceQueuedSamples();
+        }
+    }
+
+    if (!sensor_points.empty())
+        traceQueuedSamples();
+
+    return sensor_region;
+}
+
+// Computes the incident radiance along a single ray by tracing a wavefront containing only that ray
+RadianceSpectrum WavefrontIntegrator::incidentRadiance(const RayWithOffsets& outgoing_ray,
+                                                       const Scene& scene,
+                                                       Sampler& sampler,
+                                                       RegionAllocator& allocator,
+                                                       unsigned int scattering_count /* = 0 */,
+                                                       OccluderCache* occluder_cache /* = nullptr */) const
+{
+    WavefrontBuffers buffers;
+
+    uint64_t random_seed = (uint64_t)(sampler.next1DSampleComponent()*4294967296.0);
+
+    buffers.rays.push(outgoing_ray, Spectrum(1.0f), 0, nextPathRandomBits(&random_seed));
+    buffers.sample_radiances.assign(1, RadianceSpectrum(0.0f));
+
+    // Use a separate allocator, since the wavefront releases its allocations after each depth
+    RegionAllocator wavefront_allocator;
+
+    traceWavefront(scene, buffers, wavefront_allocator, scattering_count);
+
+    return buffers.sample_radiances[0];
+}
+
+// WavefrontIntegrator function definitions
+
+Integrator* createWavefrontIntegrator(std::shared_ptr<const Camera> camera,
+                                      std::shared_ptr<Sampler> sampler,
+                                      const ParameterSet& parameters)
+{
+    unsigned int max_scatterings = (unsigned int)std::abs(parameters.getSingleIntValue("max_scatterings", 5));
+    unsigned int wavefront_size = (unsigned int)std::max(1, parameters.getSingleIntValue("wavefront_size", 16384));
+
+	if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+	{
+		printInfoMessage("Integrator:"
+						 "\n    %-20s%s"
+						 "\n    %-20s%u"
+						 "\n    %-20s%u",
+						 "Type:", "Wavefront",
+						 "Max scatterings:", max_scatterings,
+						 "Wavefront size:", wavefront_size);
+	}
+
+    return new WavefrontIntegrator(camera, sampler, max_scatterings, wavefront_size);
+}
+
+} // RayImpact
+} // Impact
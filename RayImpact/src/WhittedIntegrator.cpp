@@ -1,6 +1,9 @@
 #include "WhittedIntegrator.hpp"
 #include "BSDF.hpp"
 #include "api.hpp"
+#include "statistics.hpp"
+#include <algorithm>
+#include <string>
 #include <cmath>
 
 #include <iostream>
@@ -8,19 +11,55 @@
 namespace Impact {
 namespace RayImpact {
 
+// WhittedIntegrator statistics variables
+
+IMP_STAT_HISTOGRAM("Whitted scattering depth", whitted_scattering_depths, 8);
+
 // WhittedIntegrator method definitions
 
+// Creates the light selector for the scene
+void WhittedIntegrator::preprocess(const Scene& scene, Sampler& sampler)
+{
+    light_selector.reset(createLightSelector(light_selection_strategy, scene));
+}
+
 RadianceSpectrum WhittedIntegrator::incidentRadiance(const RayWithOffsets& outgoing_ray,
                                                      const Scene& scene,
                                                      Sampler& sampler,
                                                      RegionAllocator& allocator,
-                                                     unsigned int scattering_count /* = 0 */) const
+                                                     unsigned int scattering_count /* = 0 */,
+                                                     OccluderCache* occluder_cache /* = nullptr */) const
 {
-    RadianceSpectrum total_incident_radiance(0.0f);
-
     SurfaceScatteringEvent scattering_event;
 
-    if (!scene.intersect(outgoing_ray, &scattering_event))
+    bool has_intersection = scene.intersect(outgoing_ray, &scattering_event);
+
+    return incidentRadianceFromIntersection(outgoing_ray,
+                                            (has_intersection)? &scattering_event : nullptr,
+                                            scene,
+                                            sampler,
+                                            allocator,
+                                            scattering_count,
+                                            nullptr,
+                                            nullptr,
+                                            occluder_cache);
+}
+
+RadianceSpectrum WhittedIntegrator::incidentRadianceFromIntersection(const RayWithOffsets& outgoing_ray,
+                                                                     SurfaceScatteringEvent* intersection_event,
+                                                                     const Scene& scene,
+                                                                     Sampler& sampler,
+                                                                     RegionAllocator& allocator,
+                                                                     unsigned int scattering_count /* = 0 */,
+                                                                     ShadowRayBatch* shadow_ray_batch /* = nullptr */,
+                                                                     const std::vector<Light*>* tile_lights /* = nullptr */,
+                                                                     OccluderCache* occluder_cache /* = nullptr */) const
+{
+    IMP_STAT_HISTOGRAM_ADD(whitted_scattering_depths, scattering_count);
+
+    RadianceSpectrum total_incident_radiance(0.0f);
+
+    if (!intersection_event)
     {
         for (const auto& light : scene.lights)
             total_incident_radiance += light->emittedRadianceFromDirection(outgoing_ray);
@@ -28,42 +67,94 @@ RadianceSpectrum WhittedIntegrator::incidentRadiance(const RayWithOffsets& outgo
         return total_incident_radiance;
     }
 
+    SurfaceScatteringEvent& scattering_event = *intersection_event;
+
     Vector3F outgoing_direction = scattering_event.outgoing_direction;
 
     scattering_event.generateBSDF(outgoing_ray, allocator);
 
     total_incident_radiance += scattering_event.emittedRadiance(outgoing_direction);
 
-    for (const auto& light : scene.lights)
+    if (light_selector)
     {
-        Vector3F incident_direction;
-        imp_float pdf_value;
-        VisibilityTester visibility_tester;
-
-        const RadianceSpectrum& incident_radiance = light->sampleIncidentRadiance(scattering_event,
-                                                                                  sampler.next2DSampleComponent(),
-                                                                                  &incident_direction,
-                                                                                  &pdf_value,
-                                                                                  &visibility_tester);
-
-        if (incident_radiance.isBlack() || pdf_value == 0)
-            continue;
+        // Sample only a few randomly selected lights
+        for (unsigned int selection_idx = 0; selection_idx < n_selected_lights; selection_idx++)
+        {
+            imp_float selection_probability;
 
-        const Spectrum& bsdf_value = scattering_event.bsdf->evaluate(outgoing_direction, incident_direction);
+            const Light* light = light_selector->selectLight(scattering_event, sampler.next1DSampleComponent(), &selection_probability);
 
-        if (!bsdf_value.isBlack() && visibility_tester.beamIsUnobstructed(scene))
-            total_incident_radiance += bsdf_value*incident_radiance*(incident_direction.absDot(scattering_event.surface_normal)/pdf_value);
+            if (light && selection_probability > 0)
+                total_incident_radiance += sampledLightRadiance(*light, scattering_event, sampler.next2DSampleComponent(),
+                                                                n_selected_lights, selection_probability, scene, shadow_ray_batch, occluder_cache);
+        }
+    }
+    else
+    {
+        // Only the lights in the tile light list can illuminate intersections of eye rays in the tile
+        const std::vector<Light*>& lights = (tile_lights)? *tile_lights : scene.lights;
+
+        for (const auto& light : lights)
+        {
+            // Average over the requested number of samples of the light (more than one only matters for area lights)
+            for (unsigned int sample_idx = 0; sample_idx < light->n_samples; sample_idx++)
+                total_incident_radiance += sampledLightRadiance(*light, scattering_event, sampler.next2DSampleComponent(),
+                                                                light->n_samples, 1, scene, shadow_ray_batch, occluder_cache);
+        }
     }
 
     if (scattering_count + 1 < max_scattering_count)
     {
-        total_incident_radiance += specularlyReflectedRadiance(outgoing_ray, scattering_event, scene, sampler, allocator, scattering_count);
-        total_incident_radiance += specularlyTransmittedRadiance(outgoing_ray, scattering_event, scene, sampler, allocator, scattering_count);
+        total_incident_radiance += specularlyReflectedRadiance(outgoing_ray, scattering_event, scene, sampler, allocator, scattering_count, occluder_cache);
+        total_incident_radiance += specularlyTransmittedRadiance(outgoing_ray, scattering_event, scene, sampler, allocator, scattering_count, occluder_cache);
     }
 
     return total_incident_radiance;
 }
 
+// Computes the contribution of a single sample of the given light to the direct radiance estimate, where the light is
+// sampled the given number of times in total and was selected with the given probability. If a shadow ray batch is given,
+// the unoccluded contribution is added to the batch instead, and is not included in the returned radiance. Otherwise
+// the shadow ray is traced immediately, using the given occluder cache if there is one.
+RadianceSpectrum WhittedIntegrator::sampledLightRadiance(const Light& light,
+                                                         const SurfaceScatteringEvent& scattering_event,
+                                                         const Point2F& uniform_sample,
+                                                         unsigned int n_light_samples,
+                                                         imp_float selection_probability,
+                                                         const Scene& scene,
+                                                         ShadowRayBatch* shadow_ray_batch,
+                                                         OccluderCache* occluder_cache) const
+{
+    Vector3F incident_direction;
+    imp_float pdf_value;
+    VisibilityTester visibility_tester;
+
+    const RadianceSpectrum& incident_radiance = light.sampleIncidentRadiance(scattering_event,
+                                                                             uniform_sample,
+                                                                             &incident_direction,
+                                                                             &pdf_value,
+                                                                             &visibility_tester);
+
+    if (incident_radiance.isBlack() || pdf_value == 0)
+        return RadianceSpectrum(0.0f);
+
+    const Spectrum& bsdf_value = scattering_event.bsdf->evaluate(scattering_event.outgoing_direction, incident_direction);
+
+    if (bsdf_value.isBlack())
+        return RadianceSpectrum(0.0f);
+
+    const RadianceSpectrum& contribution = bsdf_value*incident_radiance*(incident_direction.absDot(scattering_event.surface_normal)/
+                                                                         (n_light_samples*selection_probability*pdf_value));
+
+    // Leave the visibility test to the batch if possible, so that it can be traced together with the other shadow rays of the tile
+    if (shadow_ray_batch)
+        shadow_ray_batch->addShadowRay(visibility_tester.shadowRay(), contribution, &light);
+    else if (visibility_tester.beamIsUnobstructed(scene, &light, occluder_cache))
+        return contribution;
+
+    return RadianceSpectrum(0.0f);
+}
+
 // WhittedIntegrator function definitions
 
 Integrator* createWhittedIntegrator(std::shared_ptr<const Camera> camera,
@@ -71,17 +162,31 @@ Integrator* createWhittedIntegrator(std::shared_ptr<const Camera> camera,
                                     const ParameterSet& parameters)
 {
     unsigned int max_scatterings = (unsigned int)std::abs(parameters.getSingleIntValue("max_scatterings", 5));
+    std::string light_selection_name = parameters.getSingleStringValue("light_selection", "all");
+    unsigned int selected_lights = (unsigned int)std::max(1, std::abs(parameters.getSingleIntValue("selected_lights", 1)));
+    bool tile_light_culling = parameters.getSingleBoolValue("tile_light_culling", false);
 
-	if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
-	{
-		printInfoMessage("Integrator:"
-						 "\n    %-20s%s"
-						 "\n    %-20s%u",
-						 "Type:", "Whitted",
-						 "Max scatterings:", max_scatterings);
-	}
+    LightSelectionStrategy light_selection = lightSelectionStrategyFromName(light_selection_name);
+
+    if (light_selection == LightSelectionStrategy::ALL)
+        light_selection_name = "all";
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+    {
+        printInfoMessage("Integrator:"
+                         "\n    %-20s%s"
+                         "\n    %-20s%u"
+                         "\n    %-20s%s"
+                         "\n    %-20s%u"
+                         "\n    %-20s%s",
+                         "Type:", "Whitted",
+                         "Max scatterings:", max_scatterings,
+                         "Light selection:", light_selection_name.c_str(),
+                         "Selected lights:", selected_lights,
+                         "Tile light culling:", tile_light_culling? "yes" : "no");
+    }
 
-    return new WhittedIntegrator(camera, sampler, max_scatterings);
+    return new WhittedIntegrator(camera, sampler, max_scatterings, light_selection, selected_lights, tile_light_culling);
 }
 
 } // RayImpact
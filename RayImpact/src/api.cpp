@@ -3,6 +3,10 @@
 #include "parallel.hpp"
 #include "Matrix4x4.hpp"
 #include "RegionAllocator.hpp"
+#include "ObjectArena.hpp"
+#include "memory.hpp"
+#include "memory_accounting.hpp"
+#include "tracing.hpp"
 #include "Transformation.hpp"
 #include "AnimatedTransformation.hpp"
 #include "Camera.hpp"
@@ -17,6 +21,7 @@
 #include "PointLight.hpp"
 #include "SpotLight.hpp"
 #include "DistantLight.hpp"
+#include "InfiniteLight.hpp"
 #include "DiffuseAreaLight.hpp"
 #include "Texture.hpp"
 #include "ConstantTexture.hpp"
@@ -33,6 +38,10 @@
 #include "Scene.hpp"
 #include "Integrator.hpp"
 #include "WhittedIntegrator.hpp"
+#include "WavefrontIntegrator.hpp"
+#include "PathIntegrator.hpp"
+#include "SPPMIntegrator.hpp"
+#include "PreviewIntegrator.hpp"
 #include "Filter.hpp"
 #include "BoxFilter.hpp"
 #include "TriangleFilter.hpp"
@@ -110,6 +119,16 @@ static std::map<std::string, TransformationSet> defined_coordinate_systems; // A
 
 // Configurations tracking
 
+// Creates an arena for the models, shapes and lights of a scene
+static std::unique_ptr<ObjectArena> createSceneArena()
+{
+    // Use blocks spanning a whole huge page if possible to reduce TLB misses for large scenes. The blocks of each
+    // object type start small and grow up to this size, so only types with many objects get huge-page blocks.
+    size_t block_size = hugePagesEnabled()? IMP_HUGE_PAGE_SIZE : 65536;
+
+    return std::unique_ptr<ObjectArena>(new ObjectArena(block_size, MemoryCategory::Geometry, 65536));
+}
+
 // Container for rendering configurations
 class Configurations {
 
@@ -140,11 +159,13 @@ public:
 
     std::map< std::string, std::shared_ptr<Medium> > defined_media; // A table of named media
 
-    std::vector< std::shared_ptr<Model> > models; // List of models in the scene
-    std::vector< std::shared_ptr<Light> > lights; // List of lights in the scene
+    std::unique_ptr<ObjectArena> arena = createSceneArena(); // Arena owning the models, shapes and lights of the scene being described
+
+    std::vector<const Model*> models; // List of models in the scene
+    std::vector<Light*> lights; // List of lights in the scene
 
-    std::map< std::string, std::vector< std::shared_ptr<Model> > > objects; // Table of object instances in the scene
-    std::vector< std::shared_ptr<Model> >* current_object = nullptr; // The current object instance
+    std::map< std::string, std::vector<const Model*> > objects; // Table of object instances in the scene
+    std::vector<const Model*>* current_object = nullptr; // The current object instance
 
     Scene* createScene();
     Integrator* createIntegrator() const;
@@ -191,9 +212,16 @@ private:
 
     std::map< Transformation, std::pair<Transformation*, Transformation*> > cache; // Table of transformations and pointers to where they are stored
     RegionAllocator allocator; // Allocator for transformations
+    TrackedMemory cache_memory; // Accounting of the memory used by the table entries
 
 public:
 
+    TransformationCache()
+        : cache(),
+          allocator(262144, MemoryCategory::Transformations),
+          cache_memory(MemoryCategory::Transformations)
+    {}
+
     void lookup(const Transformation& transformation,
                 Transformation** stored_transformation,
                 Transformation** stored_inverse_transformation)
@@ -222,6 +250,7 @@ public:
 
             // Add the newly stored transformation to the cache
             cache[transformation] = std::make_pair(transformation_ptr, inverse_transformation_ptr);
+            cache_memory.add(sizeof(*cache.begin()));
         }
 
         // Set return pointers
@@ -362,34 +391,40 @@ Sensor* createSensor(const std::string& type,
     return sensor;
 }
 
-std::vector< std::shared_ptr<Shape> > createShapes(const std::string& type,
-                                                   const Transformation* object_to_world,
-                                                   const Transformation* world_to_object,
-                                                   bool use_reverse_orientation,
-                                                   const ParameterSet& parameters)
+std::vector<Shape*> createShapes(const std::string& type,
+                                 const Transformation* object_to_world,
+                                 const Transformation* world_to_object,
+                                 bool use_reverse_orientation,
+                                 const ParameterSet& parameters,
+                                 ObjectArena& arena)
 {
-    std::vector< std::shared_ptr<Shape> > shapes;
+    IMP_TRACE_SCOPE("Create shapes");
+
+    std::vector<Shape*> shapes;
 
     if (type == "sphere")
     {
         shapes.push_back(createSphere(object_to_world,
                                       world_to_object,
                                       use_reverse_orientation,
-                                      parameters));
+                                      parameters,
+                                      arena));
     }
     else if (type == "cylinder")
     {
         shapes.push_back(createCylinder(object_to_world,
                                         world_to_object,
                                         use_reverse_orientation,
-                                        parameters));
+                                        parameters,
+                                        arena));
     }
     else if (type == "disk")
     {
         shapes.push_back(createDisk(object_to_world,
                                     world_to_object,
                                     use_reverse_orientation,
-                                    parameters));
+                                    parameters,
+                                    arena));
     }
     else
     {
@@ -399,15 +434,18 @@ std::vector< std::shared_ptr<Shape> > createShapes(const std::string& type,
     return shapes;
 }
 
-std::shared_ptr<Model> CreateAccelerationStructure(const std::string& type,
-                                                   const std::vector< std::shared_ptr<Model> >& models,
-                                                   const ParameterSet& parameters)
+Model* CreateAccelerationStructure(const std::string& type,
+                                   const std::vector<const Model*>& models,
+                                   const ParameterSet& parameters,
+                                   ObjectArena& arena)
 {
-    std::shared_ptr<Model> accelerator;
+    IMP_TRACE_SCOPE("Build accelerator");
+
+    Model* accelerator = nullptr;
 
     if (type == "bvh")
     {
-        accelerator = createBoundingVolumeHierarchy(models, parameters);
+        accelerator = createBoundingVolumeHierarchy(models, parameters, arena);
     }
     else
     {
@@ -419,24 +457,29 @@ std::shared_ptr<Model> CreateAccelerationStructure(const std::string& type,
     return accelerator;
 }
 
-std::shared_ptr<Light> createLight(const std::string& type,
-                                   const Transformation& light_to_world,
-                                   const MediumInterface& medium_interface,
-                                   const ParameterSet& parameters)
+Light* createLight(const std::string& type,
+                   const Transformation& light_to_world,
+                   const MediumInterface& medium_interface,
+                   const ParameterSet& parameters,
+                   ObjectArena& arena)
 {
-    std::shared_ptr<Light> light;
+    Light* light = nullptr;
 
     if (type == "point")
     {
-        light = createPointLight(light_to_world, medium_interface, parameters);
+        light = createPointLight(light_to_world, medium_interface, parameters, arena);
     }
     else if (type == "spot")
     {
-        light = createSpotLight(light_to_world, medium_interface, parameters);
+        light = createSpotLight(light_to_world, medium_interface, parameters, arena);
     }
     else if (type == "distant")
     {
-        light = createDistantLight(light_to_world, medium_interface, parameters);
+        light = createDistantLight(light_to_world, medium_interface, parameters, arena);
+    }
+    else if (type == "infinite")
+    {
+        light = createInfiniteLight(light_to_world, medium_interface, parameters, arena);
     }
     else
     {
@@ -448,17 +491,18 @@ std::shared_ptr<Light> createLight(const std::string& type,
     return light;
 }
 
-std::shared_ptr<AreaLight> createAreaLight(const std::string& type,
-                                           const Transformation& light_to_world,
-                                           const MediumInterface& medium_interface,
-                                           const ParameterSet& parameters,
-                                           std::shared_ptr<Shape> shape)
+AreaLight* createAreaLight(const std::string& type,
+                           const Transformation& light_to_world,
+                           const MediumInterface& medium_interface,
+                           const ParameterSet& parameters,
+                           const Shape* shape,
+                           ObjectArena& arena)
 {
-    std::shared_ptr<AreaLight> area_light;
+    AreaLight* area_light = nullptr;
 
     if (type == "diffuse")
     {
-        area_light = createDiffuseAreaLight(light_to_world, medium_interface, parameters, shape);
+        area_light = createDiffuseAreaLight(light_to_world, medium_interface, parameters, shape, arena);
     }
     else
     {
@@ -617,18 +661,25 @@ MediumInterface GraphicsState::createMediumInterface()
 
 Scene* Configurations::createScene()
 {
-	std::shared_ptr<Model> accelerator = CreateAccelerationStructure(accelerator_type,
-                                                                     models,
-                                                                     accelerator_parameters);
+	Model* accelerator = CreateAccelerationStructure(accelerator_type,
+                                                     models,
+                                                     accelerator_parameters,
+                                                     *arena);
 
     if (!accelerator)
-        accelerator = std::make_shared<BoundingVolumeHierarchy>(models);
+        accelerator = arena->create<BoundingVolumeHierarchy>(models);
 
-    Scene* scene = new Scene(accelerator, lights);
+    // Hand ownership of all render-time objects over to the scene
+    Scene* scene = new Scene(std::move(arena), accelerator, lights);
 
     models.clear();
     lights.clear();
 
+    // Object instances live in the arena of the scene, so they can not be reused by later scenes
+    objects.clear();
+
+    arena = createSceneArena();
+
     return scene;
 }
 
@@ -656,6 +707,34 @@ Integrator* Configurations::createIntegrator() const
     {
         integrator = createWhittedIntegrator(camera, sampler, integrator_parameters);
     }
+    else if (integrator_type == "wavefront")
+    {
+        integrator = createWavefrontIntegrator(camera, sampler, integrator_parameters);
+    }
+    else if (integrator_type == "path")
+    {
+        integrator = createPathIntegrator(camera, sampler, integrator_parameters);
+    }
+    else if (integrator_type == "sppm")
+    {
+        integrator = createSPPMIntegrator(camera, sampler, integrator_parameters);
+    }
+    else if (integrator_type == "ao")
+    {
+        integrator = createPreviewIntegrator(camera, sampler, PreviewQuantity::AMBIENT_OCCLUSION, integrator_parameters);
+    }
+    else if (integrator_type == "albedo")
+    {
+        integrator = createPreviewIntegrator(camera, sampler, PreviewQuantity::ALBEDO, integrator_parameters);
+    }
+    else if (integrator_type == "normals")
+    {
+        integrator = createPreviewIntegrator(camera, sampler, PreviewQuantity::NORMALS, integrator_parameters);
+    }
+    else if (integrator_type == "depth")
+    {
+        integrator = createPreviewIntegrator(camera, sampler, PreviewQuantity::DEPTH, integrator_parameters);
+    }
     else
     {
         printErrorMessage("integrator type \"%s\" is invalid. Ignoring call.", integrator_type.c_str());
@@ -664,7 +743,10 @@ Integrator* Configurations::createIntegrator() const
 
     integrator_parameters.warnAboutUnusedParameters();
 
-    if (lights.empty())
+    // The preview integrators do not depend on the lights
+    bool uses_lights = integrator_type != "ao" && integrator_type != "albedo" && integrator_type != "normals" && integrator_type != "depth";
+
+    if (lights.empty() && uses_lights)
         printWarningMessage("no lights specified. Rendered image will be black.");
 
     return integrator;
@@ -766,6 +848,107 @@ void RIMP_SetOption(const std::string& option, const std::string& value)
 
         RIMP_OPTIONS.verbosity = verbosity;
     }
+    else if (option == "tile_ordering")
+    {
+        if (!parseTileOrdering(value, &RIMP_OPTIONS.tile_ordering))
+            printWarningMessage("invalid value for option \"tile_ordering\": \"%s\". Using default.", value.c_str());
+    }
+    else if (option == "tile_size")
+    {
+        int tile_extent = std::stoi(value);
+
+        if (tile_extent < 0)
+        {
+            printWarningMessage("invalid tile size: %d. Using default.", tile_extent);
+            return;
+        }
+
+        RIMP_OPTIONS.tile_extent = tile_extent;
+    }
+    else if (option == "packet_size")
+    {
+        int packet_size = std::stoi(value);
+
+        if (packet_size != 0 && packet_size != 1 && packet_size != 4 && packet_size != 8 && packet_size != 16)
+        {
+            printWarningMessage("invalid ray packet size: %d (must be 4, 8 or 16, or 0 for no packets). Using default.", packet_size);
+            return;
+        }
+
+        RIMP_OPTIONS.ray_packet_size = (unsigned int)packet_size;
+    }
+    else if (option == "pass_samples" || option == "snapshot_passes")
+    {
+        int count = std::stoi(value);
+
+        if (count < 0)
+        {
+            printWarningMessage("invalid value for option \"%s\": %d. Using default.", option.c_str(), count);
+            return;
+        }
+
+        if (option == "pass_samples")
+            RIMP_OPTIONS.n_pass_samples = (unsigned int)count;
+        else
+            RIMP_OPTIONS.snapshot_pass_interval = (unsigned int)count;
+    }
+    else if (option == "snapshot_interval" || option == "time_budget" || option == "checkpoint_interval" || option == "worker_timeout")
+    {
+        double seconds = std::stod(value);
+
+        if (seconds < 0)
+        {
+            printWarningMessage("invalid value for option \"%s\": %g. Using default.", option.c_str(), seconds);
+            return;
+        }
+
+        if (option == "snapshot_interval")
+            RIMP_OPTIONS.snapshot_interval = seconds;
+        else if (option == "time_budget")
+            RIMP_OPTIONS.time_budget = seconds;
+        else if (option == "checkpoint_interval")
+            RIMP_OPTIONS.checkpoint_interval = seconds;
+        else
+            RIMP_OPTIONS.worker_timeout = seconds;
+    }
+    else if (option == "adaptive_threshold")
+    {
+        imp_float threshold = std::stof(value);
+
+        if (threshold < 0)
+        {
+            printWarningMessage("invalid adaptive sampling threshold: %g. Using default.", threshold);
+            return;
+        }
+
+        RIMP_OPTIONS.adaptive_error_threshold = threshold;
+    }
+    else if (option == "trace_filename")
+    {
+        RIMP_OPTIONS.trace_filename = value;
+    }
+    else if (option == "checkpoint_filename")
+    {
+        RIMP_OPTIONS.checkpoint_filename = value;
+    }
+    else if (option == "distributed_role")
+    {
+        if (!parseDistributedRole(value, &RIMP_OPTIONS.distributed_role))
+            printWarningMessage("invalid value for option \"distributed_role\": \"%s\". Using default.", value.c_str());
+    }
+    else if (option == "distributed_address")
+    {
+        RIMP_OPTIONS.distributed_address = value;
+    }
+    else if (option == "huge_pages")
+    {
+        if (value == "true")
+            RIMP_OPTIONS.use_huge_pages = true;
+        else if (value == "false")
+            RIMP_OPTIONS.use_huge_pages = false;
+        else
+            printWarningMessage("invalid value for option \"huge_pages\": \"%s\". Using default.", value.c_str());
+    }
     else
     {
         printWarningMessage("invalid option \"%s\"", option.c_str());
@@ -785,12 +968,18 @@ void RIMP_Initialize()
 
     current_API_state = APIState::Configuration;
 
+    // Must be set before the configurations are created, since their scene arena picks its block size from it
+    setHugePagesEnabled(RIMP_OPTIONS.use_huge_pages);
+
     configurations.reset(new Configurations);
 
     current_graphics_state = GraphicsState();
 
     initializeParallel(RIMP_OPTIONS.n_threads);
 
+    if (!RIMP_OPTIONS.trace_filename.empty())
+        beginTracing();
+
     SampledSpectrum::initialize();
 }
 
@@ -807,6 +996,13 @@ void RIMP_Cleanup()
     configurations.reset(nullptr);
 
     cleanupParallel();
+
+    // Write the recorded trace now that all worker threads have finished
+    if (tracingEnabled() && endTracing(RIMP_OPTIONS.trace_filename))
+    {
+        if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+            printInfoMessage("Wrote trace to \"%s\"", RIMP_OPTIONS.trace_filename.c_str());
+    }
 }
 
 // Transformation functions
@@ -1194,7 +1390,7 @@ void RIMP_CreateLight(const std::string& type, const ParameterSet& parameters)
 
     const MediumInterface& medium_interface = current_graphics_state.createMediumInterface();
 
-    std::shared_ptr<Light> light = createLight(type, current_transformations[0], medium_interface, parameters);
+    Light* light = createLight(type, current_transformations[0], medium_interface, parameters, *(configurations->arena));
 
     if (!light)
         printErrorMessage("could not create light of type \"%s\"", type.c_str());
@@ -1214,8 +1410,10 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
 {
     verify_in_scene_descript_state("CreateModel");
 
-    std::vector< std::shared_ptr<Model> > models;
-    std::vector< std::shared_ptr<AreaLight> > area_lights;
+    ObjectArena& arena = *(configurations->arena);
+
+    std::vector<const Model*> models;
+    std::vector<Light*> area_lights;
 
     if (!current_transformations.isAnimated())
     {
@@ -1227,17 +1425,19 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
         // Make sure the transformation is stored in the cache and retrieve its pointers
         transformation_cache.lookup(current_transformations[0], &model_to_world, &world_to_model);
 
-        std::vector< std::shared_ptr<Shape> > shapes = createShapes(type,
-                                                                    model_to_world,
-                                                                    world_to_model,
-                                                                    current_graphics_state.use_reverse_orientation,
-                                                                    parameters);
+        std::vector<Shape*> shapes = createShapes(type,
+                                                  model_to_world,
+                                                  world_to_model,
+                                                  current_graphics_state.use_reverse_orientation,
+                                                  parameters,
+                                                  arena);
         if (shapes.empty())
             return;
 
         // Create geometric model(s) for the shape(s)
 
-        std::shared_ptr<Material> material = current_graphics_state.createMaterial(parameters);
+        // Materials are shared between models and graphics states, so the arena just keeps them alive
+        const Material* material = arena.retain(current_graphics_state.createMaterial(parameters));
 
         parameters.warnAboutUnusedParameters();
 
@@ -1245,7 +1445,7 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
 
         for (auto shape : shapes)
         {
-            std::shared_ptr<AreaLight> area_light;
+            AreaLight* area_light = nullptr;
 
             if (current_graphics_state.area_light_type != "")
             {
@@ -1253,12 +1453,14 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
                                              current_transformations[0],
                                              medium_interface,
                                              current_graphics_state.area_light_parameters,
-                                             shape);
+                                             shape,
+                                             arena);
 
-                area_lights.push_back(area_light);
+                if (area_light)
+                    area_lights.push_back(area_light);
             }
 
-            models.push_back(std::make_shared<GeometricModel>(shape, material, area_light, medium_interface));
+            models.push_back(arena.create<GeometricModel>(shape, material, area_light, medium_interface));
         }
     }
     else
@@ -1273,24 +1475,25 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
 
         transformation_cache.lookup(Transformation(), &identity, nullptr);
 
-        std::vector< std::shared_ptr<Shape> > shapes = createShapes(type,
-                                                                    identity,
-                                                                    identity,
-                                                                    current_graphics_state.use_reverse_orientation,
-                                                                    parameters);
+        std::vector<Shape*> shapes = createShapes(type,
+                                                  identity,
+                                                  identity,
+                                                  current_graphics_state.use_reverse_orientation,
+                                                  parameters,
+                                                  arena);
         if (shapes.empty())
             return;
 
         // Create geometric model(s) for the shape(s)
 
-        std::shared_ptr<Material> material = current_graphics_state.createMaterial(parameters);
+        const Material* material = arena.retain(current_graphics_state.createMaterial(parameters));
 
         parameters.warnAboutUnusedParameters();
 
         const MediumInterface& medium_interface = current_graphics_state.createMediumInterface();
 
         for (auto shape : shapes)
-            models.push_back(std::make_shared<GeometricModel>(shape, material, nullptr, medium_interface));
+            models.push_back(arena.create<GeometricModel>(shape, material, nullptr, medium_interface));
 
         // Create animated model for the geometric model(s)
 
@@ -1306,12 +1509,12 @@ void RIMP_CreateModel(const std::string& type, const ParameterSet& parameters)
         // Create aggregate from the geometric models if there is more than one
         if (models.size() > 1)
         {
-            std::shared_ptr<Model> BVH = std::make_shared<BoundingVolumeHierarchy>(models);
+            const Model* BVH = arena.create<BoundingVolumeHierarchy>(models);
             models.clear();
             models.push_back(BVH);
         }
 
-        models[0] = std::make_shared<TransformedModel>(models[0], animated_model_to_world);
+        models[0] = arena.create<TransformedModel>(models[0], animated_model_to_world);
     }
 
     // Store the model(s) in either the current object instance or the list of non-instanced models
@@ -1341,7 +1544,7 @@ void RIMP_BeginObject(const std::string& name)
     if (configurations->current_object)
         printErrorMessage("\"BeginObject\" called from inside object definition");
 
-    configurations->objects[name] = std::vector< std::shared_ptr<Model> >();
+    configurations->objects[name] = std::vector<const Model*>();
 
     configurations->current_object = &(configurations->objects[name]);
 }
@@ -1376,7 +1579,7 @@ void RIMP_CreateObjectInstance(const std::string& name)
         return;
     }
 
-    std::vector< std::shared_ptr<Model> >& object_models = entry->second;
+    std::vector<const Model*>& object_models = entry->second;
 
     if (object_models.empty())
         return;
@@ -1384,11 +1587,12 @@ void RIMP_CreateObjectInstance(const std::string& name)
     // Create aggregate from the models in the object if there is more than one
     if (object_models.size() > 1)
     {
-        std::shared_ptr<Model> aggregate(CreateAccelerationStructure(configurations->accelerator_type,
-                                                                     object_models,
-                                                                     configurations->accelerator_parameters));
+        const Model* aggregate = CreateAccelerationStructure(configurations->accelerator_type,
+                                                             object_models,
+                                                             configurations->accelerator_parameters,
+                                                             *(configurations->arena));
         if (!aggregate)
-            aggregate = std::make_shared<BoundingVolumeHierarchy>(object_models);
+            aggregate = configurations->arena->create<BoundingVolumeHierarchy>(object_models);
 
         object_models.clear();
         object_models.push_back(aggregate);
@@ -1403,7 +1607,7 @@ void RIMP_CreateObjectInstance(const std::string& name)
                                                     configurations->transformation_start_time,
                                                     configurations->transformation_end_time);
 
-    std::shared_ptr<Model> model(std::make_shared<TransformedModel>(object_models[0], animated_object_to_world));
+    const Model* model = configurations->arena->create<TransformedModel>(object_models[0], animated_object_to_world);
 
     configurations->models.push_back(model);
 }
@@ -1445,6 +1649,13 @@ void RIMP_EndSceneDescription()
 		else
 	        integrator->render(*scene);
 
+    // Free the scene before reporting, so that the current usage reveals any memory that was not released
+    integrator.reset();
+    scene.reset();
+
+    if (RIMP_OPTIONS.verbosity >= IMP_CORE_VERBOSITY)
+        printInfoMessage("%s", memoryUsageReport().c_str());
+
     current_API_state = APIState::Configuration;
 
     for (unsigned int idx = 0; idx < max_transformations; idx++)
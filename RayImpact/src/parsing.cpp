@@ -3,6 +3,7 @@
 #include "precision.hpp"
 #include "error.hpp"
 #include "string_util.hpp"
+#include "tracing.hpp"
 #include "geometry.hpp"
 #include "api.hpp"
 #include "ParameterSet.hpp"
@@ -656,6 +657,8 @@ void parseSceneDescriptionFiles(const std::vector<std::string>& filenames)
 
     for (const std::string& filename : filenames)
     {
+        IMP_TRACE_SCOPE_WITH_ARGUMENTS("Parse scene description", "\"filename\": \"" + escapedForJSON(filename) + "\"");
+
         parseFile(filename.c_str());
     }
 
@@ -70,6 +70,57 @@ unsigned int DistributionFunction1D::discreteSample(imp_float uniform_sample,
     return idx;
 }
 
+// DistributionFunction2D method definitions
+
+// The values are given row by row, with the u-coordinate varying fastest
+DistributionFunction2D::DistributionFunction2D(const imp_float* values,
+                                               unsigned int n_values_u,
+                                               unsigned int n_values_v)
+    : conditional_distributions(),
+      marginal_distribution()
+{
+    conditional_distributions.reserve(n_values_v);
+
+    for (unsigned int v = 0; v < n_values_v; v++)
+        conditional_distributions.emplace_back(values + (size_t)v*n_values_u, n_values_u);
+
+    std::vector<imp_float> row_integrals(n_values_v);
+
+    for (unsigned int v = 0; v < n_values_v; v++)
+        row_integrals[v] = conditional_distributions[v].integral;
+
+    marginal_distribution.reset(new DistributionFunction1D(row_integrals.data(), n_values_v));
+}
+
+Point2F DistributionFunction2D::continuousSample(const Point2F& uniform_sample,
+                                                 imp_float* pdf_value) const
+{
+    imp_float marginal_pdf_value, conditional_pdf_value;
+    unsigned int v;
+
+    imp_float sampled_v = marginal_distribution->continuousSample(uniform_sample.y, &marginal_pdf_value, &v);
+    imp_float sampled_u = conditional_distributions[v].continuousSample(uniform_sample.x, &conditional_pdf_value);
+
+    *pdf_value = marginal_pdf_value*conditional_pdf_value;
+
+    return Point2F(sampled_u, sampled_v);
+}
+
+// Returns the probability density, with respect to area in the unit square, of sampling the given point
+imp_float DistributionFunction2D::pdf(const Point2F& point) const
+{
+    unsigned int n_values_u = conditional_distributions[0].size();
+    unsigned int n_values_v = marginal_distribution->size();
+
+    unsigned int u = (unsigned int)clamp((int)(point.x*n_values_u), 0, (int)n_values_u - 1);
+    unsigned int v = (unsigned int)clamp((int)(point.y*n_values_v), 0, (int)n_values_v - 1);
+
+    if (marginal_distribution->integral == 0)
+        return 0;
+
+    return conditional_distributions[v].values[u]/marginal_distribution->integral;
+}
+
 // Sampling function definitions
 
 // Fills the given array with stratified sample values covering the unit interval
@@ -209,5 +260,26 @@ Vector3F cosineWeightedHemisphereSample(const Point2F& uniform_sample)
     return Vector3F(disk_sample.x, disk_sample.y, z);
 }
 
+// Given a sample point inside the unit square, returns a uniformly sampled direction vector on the unit sphere
+Vector3F uniformSphereSample(const Point2F& uniform_sample)
+{
+    imp_float cos_theta = 1 - 2*uniform_sample.x;
+    imp_float sin_theta = std::sqrt(std::max<imp_float>(0, 1 - cos_theta*cos_theta));
+    imp_float phi = IMP_TWO_PI*uniform_sample.y;
+
+    return Vector3F(sin_theta*std::cos(phi), sin_theta*std::sin(phi), cos_theta);
+}
+
+// Given a sample point inside the unit square, returns a uniformly sampled direction vector inside the cone around
+// the z-axis with the given cosine of the angle between the cone axis and the cone surface
+Vector3F uniformConeSample(const Point2F& uniform_sample, imp_float cos_max_angle)
+{
+    imp_float cos_theta = (1 - uniform_sample.x) + uniform_sample.x*cos_max_angle;
+    imp_float sin_theta = std::sqrt(std::max<imp_float>(0, 1 - cos_theta*cos_theta));
+    imp_float phi = IMP_TWO_PI*uniform_sample.y;
+
+    return Vector3F(sin_theta*std::cos(phi), sin_theta*std::sin(phi), cos_theta);
+}
+
 } // RayImpact
 } // Impact